@@ -0,0 +1,668 @@
+//------------------------------- Includes -------------------------------
+
+#include <stdint.h>
+#include <stdlib.h>
+
+uint64_t allocationCount = 0;	// How many times the engine asked for memory
+
+void *countedMalloc(size_t size);
+void *countedCalloc(size_t count, size_t size);
+
+#define malloc(s)				countedMalloc(s)		// Count every allocation lab makes
+#define calloc(c, s)			countedCalloc(c, s)
+
+#define LAB_NO_MAIN
+#include "lab.c"
+
+//------------------------------- Constants -------------------------------
+
+#define DEFAULT_BENCH_MS		20		// How long to run each benchmark for
+#define DEFAULT_CHECK_GAMES		20		// Random games on each board size for --check
+#define CHECK_REPORT_LIMIT		10		// Failures we describe before we just count them
+#define CHECK_MOVE_LIMIT		24		// Moves from each position the slow checks look at on boards past the contest's
+#define CHECK_BIG_SIZES			3		// Boards past the contest's that --check also plays on
+
+#define PHASE_EMPTY				0		// Nothing on the board
+#define PHASE_MIDGAME			1		// About half the lines drawn, nothing given away yet
+#define PHASE_ENDGAME			2		// Every safe line drawn, only chains are left
+#define PHASE_COUNT				3
+
+#define BENCH_GENERATE			0
+#define BENCH_RUN_MOVE			1
+#define BENCH_EVALUATE			2
+#define BENCH_SELECT			3
+#define BENCH_GAME				4
+#define BENCH_COUNT				5
+
+//------------------------------- Global Variables -------------------------------
+
+const char *phaseNames[PHASE_COUNT] = {"empty", "midgame", "endgame"};
+const char *benchNames[BENCH_COUNT] = {"generateMoveList", "runMove", "evaluateBoard", "selectMove", "selfPlayGame"};
+
+int *positionBoard;				// The position being benchmarked
+int *scratchBoard;				// Somewhere to make moves without touching the position
+
+rng_state benchRNG;				// Used to build positions, fixed so every run sees the same ones
+
+uint64_t benchMoves;			// Moves made in self play games, so we can report moves per game
+
+int checkFailures = 0;			// Checks that went wrong in --check
+arena checkArena;				// Holds the feature matrix checkScores builds
+
+const int checkBigSizes[CHECK_BIG_SIZES][2] = {{13, 7}, {MAX_BOARD_SIDE, 17}, {MAX_BOARD_SIDE, MAX_BOARD_SIDE}};	// Width, height
+
+// Function prototypes
+
+int lineIsDrawn(int *board, int horizontal, int x, int y);
+int lineIsSafe(int *board, int horizontal, int x, int y);
+void makePosition(int phase);
+int boardIsFull(int *board);
+void playGame();
+void prepareBenchmark(int which);
+void benchmarkOnce(int which, uint64_t iteration);
+void finishBenchmark();
+void runBenchmark(int which, int phase, uint64_t targetNs);
+void transformBoard(int symmetry, int *board, int *out);
+void checkFailed(const char *what, int symmetry, packed_move theMove);
+int checkStep(int moveCount);
+void checkPosition(int *board);
+void checkScores(int *board, int player);
+uint64_t checkGames(int games);
+void checkSize(int width, int height, int games);
+
+//------------------------------- Function definitions -------------------------------
+
+// Count an allocation, then do it
+
+void *countedMalloc(size_t size) {
+	allocationCount++;
+
+	return (malloc)(size);		// The parentheses keep our macro from catching this call
+}
+
+void *countedCalloc(size_t count, size_t size) {
+	allocationCount++;
+
+	return (calloc)(count, size);
+}
+
+// See if the line segment starting at x, y is already there
+
+int lineIsDrawn(int *board, int horizontal, int x, int y) {
+	if (horizontal) {
+		if (y < boardHeight)
+			return board[xyToIndex(x, y)] & TOP_LINE;
+		else
+			return board[xyToIndex(x, y - 1)] & BOTTOM_LINE;
+	} else {
+		if (x < boardWidth)
+			return board[xyToIndex(x, y)] & LEFT_LINE;
+		else
+			return board[xyToIndex(x - 1, y)] & RIGHT_LINE;
+	}
+}
+
+// See if drawing the line segment starting at x, y would leave a box with three sides
+
+int lineIsSafe(int *board, int horizontal, int x, int y) {
+	if (lineIsDrawn(board, horizontal, x, y))
+		return false;
+
+	if (horizontal) {
+		if ((y > 0) && (countLines(board, x, y - 1) >= 2))
+			return false;
+		if ((y < boardHeight) && (countLines(board, x, y) >= 2))
+			return false;
+	} else {
+		if ((x > 0) && (countLines(board, x - 1, y) >= 2))
+			return false;
+		if ((x < boardWidth) && (countLines(board, x, y) >= 2))
+			return false;
+	}
+
+	return true;
+}
+
+// Build a position for the given phase in positionBoard by drawing random safe segments
+
+void makePosition(int phase) {
+	int totalLines, linesDrawn, safeCount, pick;
+	int x, y, horizontal;
+
+	memset(positionBoard, 0, boardWidth * boardHeight * sizeof(int));
+
+	if (phase == PHASE_EMPTY)
+		return;
+
+	totalLines = boardWidth * (boardHeight + 1) + boardHeight * (boardWidth + 1);
+	linesDrawn = 0;
+
+	while ((phase == PHASE_ENDGAME) || (linesDrawn * 2 < totalLines)) {
+		// Count the safe segments, then pick one of them at random
+
+		safeCount = 0;
+
+		for (horizontal = 0; horizontal < 2; horizontal++) {
+			for (y = 0; y <= boardHeight; y++) {
+				for (x = 0; x <= boardWidth; x++) {
+					if ((horizontal && (x == boardWidth)) || (!horizontal && (y == boardHeight)))
+						continue;
+
+					if (lineIsSafe(positionBoard, horizontal, x, y))
+						safeCount++;
+				}
+			}
+		}
+
+		if (safeCount == 0)
+			break;	// Anything else gives boxes away
+
+		pick = randomInt(&benchRNG, safeCount);
+
+		for (horizontal = 0; horizontal < 2; horizontal++) {
+			for (y = 0; y <= boardHeight; y++) {
+				for (x = 0; x <= boardWidth; x++) {
+					if ((horizontal && (x == boardWidth)) || (!horizontal && (y == boardHeight)))
+						continue;
+
+					if (lineIsSafe(positionBoard, horizontal, x, y) && (pick-- == 0)) {
+						if (horizontal)
+							runMove(PLAYER_OTHER, x, y, x + 1, y, false, positionBoard);
+						else
+							runMove(PLAYER_OTHER, x, y, x, y + 1, false, positionBoard);
+					}
+				}
+			}
+		}
+
+		linesDrawn++;
+	}
+}
+
+// See if every box on a board has been taken
+
+int boardIsFull(int *board) {
+	int i;
+
+	for (i = 0; i < boardWidth * boardHeight; i++) {
+		if ((board[i] & FULL_BOX) != FULL_BOX)
+			return false;
+	}
+
+	return true;
+}
+
+// Play lab against itself from the position to the end of the game
+
+void playGame() {
+	int turn = PLAYER_ONE;
+
+	copyBoard(positionBoard, gameBoard);
+
+	while (!boardIsFull(gameBoard)) {
+		setPlayer(turn);
+
+		generateMoveList();
+		selectMove();
+		clearPossibleMoves();
+
+		runPackedMove(turn, finalMove, gameBoard);
+		benchMoves++;
+
+		if (turn == PLAYER_ONE)
+			turn = PLAYER_TWO;
+		else
+			turn = PLAYER_ONE;
+	}
+}
+
+// Get things ready for a benchmark, none of this is timed
+
+void prepareBenchmark(int which) {
+	copyBoard(positionBoard, gameBoard);
+	setPlayer(PLAYER_ONE);
+
+	if ((which == BENCH_RUN_MOVE) || (which == BENCH_SELECT)) {
+		generateMoveList();	// These work from the list of moves
+	}
+}
+
+// Run one operation of a benchmark
+
+void benchmarkOnce(int which, uint64_t iteration) {
+	switch (which) {
+		case BENCH_GENERATE:
+			generateMoveList();
+			clearPossibleMoves();
+			break;
+		case BENCH_RUN_MOVE:
+			copyBoard(positionBoard, scratchBoard);
+			runPackedMove(me, possibleMoves[iteration % possibleMovesFound], scratchBoard);
+			break;
+		case BENCH_EVALUATE:
+			evaluateBoard(positionBoard, NO_MOVE, null);
+			arenaReset(&evalArena);
+			break;
+		case BENCH_SELECT:
+			selectMove();
+			break;
+		case BENCH_GAME:
+			playGame();
+			break;
+		default:
+			printf("Unknown benchmark %d.\n", which);
+			exit(1);
+	}
+}
+
+// Clean up after a benchmark
+
+void finishBenchmark() {
+	clearPossibleMoves();
+}
+
+// Run a benchmark until it has taken up the target time, then print how it did
+
+void runBenchmark(int which, int phase, uint64_t targetNs) {
+	uint64_t iterations, i, start, elapsed, allocations;
+
+	prepareBenchmark(which);
+
+	iterations = 1;
+
+	while (true) {
+		allocations = allocationCount;
+		benchMoves = 0;
+
+		start = nanoTime();
+
+		for (i = 0; i < iterations; i++) {
+			benchmarkOnce(which, i);
+		}
+
+		elapsed = nanoTime() - start;
+		allocations = allocationCount - allocations;
+
+		if ((elapsed >= targetNs) || (iterations >= (1ULL << 40)))
+			break;
+
+		iterations *= 2;
+	}
+
+	finishBenchmark();
+
+	printf("%dx%d\t%-8s %-17s %14.1f ns/op %9.2f allocs/op", boardWidth, boardHeight, phaseNames[phase],
+				benchNames[which], ((double) elapsed) / iterations, ((double) allocations) / iterations);
+
+	if (which == BENCH_GAME)
+		printf(" %7.1f moves/op", ((double) benchMoves) / iterations);
+
+	printf("\n");
+	fflush(stdout);
+}
+
+// Turn or flip a whole board the way symmetryMove does a move. A box goes wherever its
+// corners do, and its lines get swapped around to match
+
+void transformBoard(int symmetry, int *board, int *out) {
+	int x, y, ax, ay, bx, by;
+
+	for (y = 0; y < boardHeight; y++) {
+		for (x = 0; x < boardWidth; x++) {
+			ax = x;
+			ay = y;
+			bx = x + 1;
+			by = y + 1;
+
+			symmetryPoint(symmetry, &ax, &ay);
+			symmetryPoint(symmetry, &bx, &by);
+
+			out[((ay < by) ? ay : by) * boardWidth + ((ax < bx) ? ax : bx)] = symmetryLines(symmetry, board[y * boardWidth + x]);
+		}
+	}
+}
+
+// Note a check that went wrong, and say what it was for the first few
+
+void checkFailed(const char *what, int symmetry, packed_move theMove) {
+	if (checkFailures < CHECK_REPORT_LIMIT)
+		printf("%dx%d: %s, symmetry %d, move %05X.\n", boardWidth, boardHeight, what, symmetry, theMove);
+
+	checkFailures++;
+}
+
+// How far apart the moves the slow checks look at are. Contest sizes get every move, bigger
+// boards a spread of them so they don't take all day
+
+int checkStep(int moveCount) {
+	if ((boardWidth <= CLASSIC_BOARD_SIDE) && (boardHeight <= CLASSIC_BOARD_SIDE))
+		return 1;
+
+	return (moveCount + CHECK_MOVE_LIMIT - 1) / CHECK_MOVE_LIMIT;
+}
+
+// Check the symmetry code on one position. Every symmetric copy has to get the same key, every
+// move has to map there and back again and land on the copy where the move on the board does,
+// and the canonical board has to be the copy canonicalBoard says it is
+
+void checkPosition(int *board) {
+	int image[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	int after[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	int moved[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	packed_move *moves;
+	packed_move mapped;
+	uint64_t key;
+	int moveCount, step, s, i;
+
+	copyBoard(board, gameBoard);
+	generateMoveList();
+
+	moveCount = possibleMovesFound;
+	moves = malloc((moveCount + 1) * sizeof(packed_move));
+
+	if (moves == null) {
+		printf("Unable to allocate the moves to check.\n");
+		exit(1);
+	}
+
+	memcpy(moves, possibleMoves, moveCount * sizeof(packed_move));
+
+	clearPossibleMoves();
+
+	step = checkStep(moveCount);
+	key = positionKey(board, PLAYER_ONE, null);
+
+	for (s = 0; s < symmetryCount(); s++) {
+		transformBoard(s, board, image);
+
+		if (positionKey(image, PLAYER_ONE, null) != key)
+			checkFailed("a symmetric copy has a different key", s, NO_MOVE);
+
+		for (i = 0; i < moveCount; i += step) {
+			mapped = symmetryMove(s, moves[i]);
+
+			if (symmetryMoveBack(s, mapped) != moves[i])
+				checkFailed("a move doesn't map back to itself", s, moves[i]);
+
+			copyBoard(board, after);
+			runPackedMove(PLAYER_ONE, moves[i], after);
+			transformBoard(s, after, moved);
+
+			copyBoard(image, after);
+			runPackedMove(PLAYER_ONE, mapped, after);
+
+			if (memcmp(after, moved, boardWidth * boardHeight * sizeof(int)) != 0)
+				checkFailed("a mapped move lands somewhere else", s, moves[i]);
+		}
+	}
+
+	s = canonicalBoard(board, after);
+	transformBoard(s, board, image);
+
+	if (memcmp(after, image, boardWidth * boardHeight * sizeof(int)) != 0)
+		checkFailed("the canonical board isn't the copy its symmetry makes", s, NO_MOVE);
+
+	free(moves);
+}
+
+// Check that the block scoring chooseForGenomes does gives the same scores as scoreEvaluation,
+// to the last bit, for a block of random genomes. Anything else and screen could break a near
+// tie the other way from lab
+
+void checkScores(int *board, int player) {
+	int after[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	dna genomes[GENOME_BLOCK];
+	double genes[FEATURE_COUNT][GENOME_BLOCK];
+	double scores[GENOME_BLOCK];
+	chain_state chains;
+	feature_matrix m;
+	dna *savedDNA;
+	double score;
+	int step, i, f, g;
+
+	savedDNA = myDNA;
+
+	// The random games don't keep score, so count the boxes. Without a margin the order the
+	// features are added in would hardly matter
+
+	playerOneScore = 0;
+	playerTwoScore = 0;
+
+	for (i = 0; i < boardWidth * boardHeight; i++) {
+		if ((board[i] & OWNER_MASK) == OWNED_BY_PLAYER_ONE)
+			playerOneScore++;
+		else if ((board[i] & OWNER_MASK) == OWNED_BY_PLAYER_TWO)
+			playerTwoScore++;
+	}
+
+	copyBoard(board, gameBoard);
+	setPlayer(player);
+	generateMoveList();
+
+	arenaReset(&checkArena);
+	candidateFeatures(&m, &checkArena);
+
+	clearPossibleMoves();
+
+	for (g = 0; g < GENOME_BLOCK; g++) {
+		genomes[g].geneCount = FEATURE_COUNT;
+
+		for (f = 0; f < MAX_GENES; f++)
+			genomes[g].genes[f] = (f < FEATURE_COUNT) ? randomDouble(&benchRNG) * 2.0 - 1.0 : 0.0;
+
+		for (f = 0; f < FEATURE_COUNT; f++)
+			genes[f][g] = genomes[g].genes[f];
+	}
+
+	step = checkStep(m.count);
+
+	for (i = 0; i < m.count; i += step) {
+		scoreGenomeBlock(&m, i, genes, scores);
+
+		copyBoard(board, after);
+		runPackedMove(player, m.moves[i], after);
+		findChains(after, &chains);
+
+		for (g = 0; g < GENOME_BLOCK; g++) {
+			myDNA = &genomes[g];
+
+			arenaReset(&evalArena);
+			score = scoreEvaluation(evaluateBoard(after, m.moves[i], &chains));
+
+			if (memcmp(&score, &scores[g], sizeof(double)) != 0)
+				checkFailed("the block score isn't the one scoreEvaluation gives", 0, m.moves[i]);
+		}
+	}
+
+	arenaReset(&evalArena);
+	myDNA = savedDNA;
+	playerOneScore = 0;
+	playerTwoScore = 0;
+}
+
+// Play random games on the current board size, checking every position on the way, and
+// that the chains kept move by move match findChains. Returns how many positions it checked
+
+uint64_t checkGames(int games) {
+	chain_state chains;
+	packed_move theMove;
+	uint64_t positions = 0;
+	int game, turn;
+
+	for (game = 0; game < games; game++) {
+		memset(positionBoard, 0, boardWidth * boardHeight * sizeof(int));
+		findChains(positionBoard, &chains);
+
+		turn = PLAYER_ONE;
+
+		while (!boardIsFull(positionBoard)) {
+			checkPosition(positionBoard);
+			checkScores(positionBoard, turn);
+			positions++;
+
+			copyBoard(positionBoard, gameBoard);
+			generateMoveList();
+			theMove = possibleMoves[randomInt(&benchRNG, possibleMovesFound)];
+			clearPossibleMoves();
+
+			runPackedMove(turn, theMove, positionBoard);
+			updateChains(positionBoard, &chains, theMove);
+
+			if (!chainsMatch(positionBoard, &chains))
+				checkFailed("the chains don't match findChains", 0, theMove);
+
+			turn = (turn == PLAYER_ONE) ? PLAYER_TWO : PLAYER_ONE;
+		}
+	}
+
+	return positions;
+}
+
+// Run the checks on one board size and say how it went
+
+void checkSize(int width, int height, int games) {
+	uint64_t positions;
+
+	boardWidth = width;
+	boardHeight = height;
+
+	gameBoard = malloc(boardWidth * boardHeight * sizeof(int));
+	positionBoard = malloc(boardWidth * boardHeight * sizeof(int));
+
+	if ((gameBoard == null) || (positionBoard == null)) {
+		printf("Unable to allocate the boards.\n");
+		exit(1);
+	}
+
+	seedRNG(&benchRNG, 2, boardWidth * (CLASSIC_BOARD_SIDE + 1) + boardHeight);
+
+	positions = checkGames(games);
+
+	printf("%dx%d\t%d games, %llu positions checked\n", boardWidth, boardHeight, games,
+				(unsigned long long) positions);
+	fflush(stdout);
+
+	free(gameBoard);
+	free(positionBoard);
+}
+
+// The main function. All hail main!
+
+int main(int argc, char** argv) {
+	int benchMs, onlyWidth, onlyHeight;
+	int phase, which;
+
+	benchMs = DEFAULT_BENCH_MS;
+	onlyWidth = 0;
+	onlyHeight = 0;
+
+	if ((argc >= 2) && (strcmp(argv[1], "--check") == 0)) {
+		// Check the symmetry and chain code instead of timing anything
+
+		int games = DEFAULT_CHECK_GAMES;
+		int width, height, i;
+
+		if ((argc > 3) || ((argc == 3) && ((sscanf(argv[2], "%d", &games) != 1) || (games <= 0)))) {
+			printf("Unable to read the number of games to check.\n");
+			exit(1);
+		}
+
+		myDNA = malloc(sizeof(dna));
+
+		if (myDNA == null) {
+			printf("Unable to allocate memory for the DNA!\n");
+			exit(1);
+		}
+
+		useDefaultDNA(myDNA);
+
+		// Every contest size, then a few bigger ones so the code for wide boards gets a look too.
+		// Those are slow, so they only get one game
+
+		for (height = MIN_BOARD_SIDE; height <= CLASSIC_BOARD_SIDE; height++) {
+			for (width = MIN_BOARD_SIDE; width <= CLASSIC_BOARD_SIDE; width++)
+				checkSize(width, height, games);
+		}
+
+		for (i = 0; i < CHECK_BIG_SIZES; i++)
+			checkSize(checkBigSizes[i][0], checkBigSizes[i][1], 1);
+
+		if (checkFailures != 0) {
+			printf("%d checks failed.\n", checkFailures);
+			exit(1);
+		}
+
+		printf("Every check passed.\n");
+
+		return 0;
+	}
+
+	if ((argc != 1) && (argc != 2) && (argc != 4)) {
+		printf("Please call as:\n");
+		printf("\t/path/to/bench [milliseconds per benchmark] [width height]\n");
+		printf("\t/path/to/bench --check [games]\n");
+		printf("--check plays random games (20 per size unless told) on every contest board size, and one on a few\n");
+		printf("bigger ones, and checks the symmetry, chain and scoring code on every position instead of\n");
+		printf("timing anything.\n");
+		exit(1);
+	}
+
+	if ((argc >= 2) && ((sscanf(argv[1], "%d", &benchMs) != 1) || (benchMs <= 0))) {
+		printf("Unable to read the milliseconds per benchmark. Given '%s'.\n", argv[1]);
+		exit(1);
+	}
+
+	if ((argc == 4) && ((sscanf(argv[2], "%d", &onlyWidth) != 1) || (sscanf(argv[3], "%d", &onlyHeight) != 1))) {
+		printf("Unable to read the board size.\n");
+		exit(1);
+	}
+
+	// Set up lab the way it would be for a tourney
+
+	myDNA = malloc(sizeof(dna));
+
+	if (myDNA == null) {
+		printf("Unable to allocate memory for the DNA!\n");
+		exit(1);
+	}
+
+	useDefaultDNA(myDNA);
+	seedRNG(&moveRNG, 1, 0);
+
+	// Now run everything on every board size. Boards bigger than the contest's are only run when asked for
+
+	for (boardHeight = MIN_BOARD_SIDE; boardHeight <= MAX_BOARD_SIDE; boardHeight++) {
+		for (boardWidth = MIN_BOARD_SIDE; boardWidth <= MAX_BOARD_SIDE; boardWidth++) {
+			if ((onlyWidth != 0) && ((boardWidth != onlyWidth) || (boardHeight != onlyHeight)))
+				continue;
+
+			if ((onlyWidth == 0) && ((boardWidth > CLASSIC_BOARD_SIDE) || (boardHeight > CLASSIC_BOARD_SIDE)))
+				continue;
+
+			gameBoard = malloc(boardWidth * boardHeight * sizeof(int));
+			positionBoard = malloc(boardWidth * boardHeight * sizeof(int));
+			scratchBoard = malloc(boardWidth * boardHeight * sizeof(int));
+
+			if ((gameBoard == null) || (positionBoard == null) || (scratchBoard == null)) {
+				printf("Unable to allocate the boards.\n");
+				exit(1);
+			}
+
+			seedRNG(&benchRNG, 1, boardWidth * (CLASSIC_BOARD_SIDE + 1) + boardHeight);	// Same positions every run
+
+			for (phase = 0; phase < PHASE_COUNT; phase++) {
+				makePosition(phase);
+
+				for (which = 0; which < BENCH_COUNT; which++) {
+					runBenchmark(which, phase, ((uint64_t) benchMs) * 1000000ULL);
+				}
+			}
+
+			free(gameBoard);
+			free(positionBoard);
+			free(scratchBoard);
+		}
+	}
+
+	return 0;
+}
@@ -1,11 +1,17 @@
 //------------------------------- Includes -------------------------------
 
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -17,12 +23,104 @@
 	#define DEBUG 1
 #endif
 
-//------------------------------- Constants -------------------------------
+#ifndef TIMING
+	#define TIMING 0
+#else
+	#define TIMING 1
+#endif
+
+#define PER_THREAD				__thread	// State for the position being worked on, each batch thread has its own
 
-#define MAX_POSSIBLE_MOVES		((9 + 9) * 36)
+//------------------------------- Constants -------------------------------
 
 #define MIN_BOARD_SIDE			3
-#define MAX_BOARD_SIDE			8
+#define MAX_BOARD_SIDE			32
+#define CLASSIC_BOARD_SIDE		8		// The biggest board the contest used, bench and selfplay stick to these
+#define NO_MOVE					0		// A packed move that can't be real, it has no length
+#define MOVE_VERTICAL			0x40000	// Set in packed moves that run up and down
+#define MOVE_FIELD_BITS			6		// Bits for each coordinate in a packed move
+#define MOVE_FIELD_MASK			0x3F
+
+#define ARENA_BLOCK_SIZE		(64 * 1024)	// Arenas grab memory in blocks at least this big
+
+#define MAX_SEARCH_DEPTH		16		// The deepest --search will look
+#define SEARCH_BOX_VALUE		13.0	// A box is worth more than anything the DNA can say about a board
+#define SEARCH_INFINITY			1.0e9
+#define SEARCH_TIME_SHARE		20		// A search gets at most this fraction of the time we have left
+#define SEARCH_CHECK_NODES		1024	// How often the search looks at the clock
+
+#define MCTS_EXPLORATION		1.4		// How much UCT favours moves it hasn't tried much
+#define MCTS_ROLLOUT_SAMPLES	4		// Moves the rollout policy looks at before picking one
+#define MCTS_CHECK_PLAYOUTS		64		// How often MCTS looks at the clock
+#define MAX_PLAY_THREADS		64
+#define SPLIT_MIN_MOVES			64		// Fewer moves than this aren't worth waking the pool for
+#define GENOME_BLOCK			2		// Genomes scored together against a feature matrix, one SSE2 register wide
+#define SPLIT_MIN_BLOCKS		64		// Fewer genome blocks than this aren't worth waking the pool for
+
+#define TABLE_BITS				20		// The transposition table has 2^20 entries, 16MB
+#define TABLE_EXACT				0		// The value in a table entry is right,
+#define TABLE_LOWER				1		// the real value is at least this,
+#define TABLE_UPPER				2		// or the real value is at most this
+
+#define ORDER_CAPTURE			3		// Classes of moves for search ordering, tried highest first
+#define ORDER_SAFE				2		// Doesn't leave a box with three sides
+#define ORDER_SACRIFICE			1		// Leaves a box for the other player to take
+#define ORDER_CLASS_SHIFT		28		// An ordering score is the class, then a killer bit, then history
+#define ORDER_KILLER			(1 << 27)
+#define ORDER_HISTORY_MAX		((1 << 27) - 1)
+#define ORDER_FIRST				0x7FFFFFFF	// For the best move from the last iteration
+#define HISTORY_SIZE			(MOVE_VERTICAL << 1)	// Every packed move has its own history entry
+
+#define MAX_GENES				16		// Room in the DNA, a file can have up to this many genes
+#define BASE_GENES				6		// Every DNA file has at least the original six
+#define STEPS_MARKER			"steps"	// Bred DNA files have mutation step sizes after this line
+
+#define FEATURE_NO_SIDES		0		// Features, in the order of the genes that weigh them
+#define FEATURE_ONE_SIDE		1
+#define FEATURE_TWO_SIDES		2
+#define FEATURE_THREE_SIDES		3
+#define FEATURE_LINE_LENGTH		4
+#define FEATURE_MARGIN			5
+#define FEATURE_CHAIN_BOXES		6
+#define FEATURE_LOOP_BOXES		7
+#define FEATURE_LONG_CHAINS		8
+#define FEATURE_CAPTURABLE		9
+#define FEATURE_COUNT			10
+
+#define NOT_IN_CHAIN			-1		// The chain parent of a box with less than two sides, or taken
+#define LONG_CHAIN				3		// Chains this long are the ones worth fighting over
+
+#define SYMMETRY_FLIP_X			1		// A symmetry is a left-right flip,
+#define SYMMETRY_FLIP_Y			2		// an up-down flip,
+#define SYMMETRY_TRANSPOSE		4		// and on square boards swapping rows and columns, which is done first
+#define MAX_SYMMETRIES			8
+
+#define HISTOGRAM_SUB_BITS		4		// Each power of two is split 16 ways, so timings are within 6.25%
+#define HISTOGRAM_SUB_COUNT		(1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS		(64 * HISTOGRAM_SUB_COUNT)
+
+#define STAGE_GENERATE			0		// Generating the list of possible moves
+#define STAGE_CANDIDATE			1		// Trying and scoring one possible move
+#define STAGE_SELECT			2		// Scoring all possible moves and choosing one
+#define STAGE_MOVE				3		// The whole turn
+#define TIMING_STAGES			4
+
+#define TIMING_FILE				"timing.csv"
+
+#define BATCH_SEPARATOR			"."		// Ends each position in a batch file
+#define BATCH_CHUNK				1024	// Positions we read in before scoring them
+#define MAX_BATCH_THREADS		64
+
+#define RING_CHECK_MS			1000	// How often an idle worker makes sure master is still there
+
+#define SEGMENT_MAGIC			"LBSM"
+#define IPC_VERSION				4		// Must match master, we won't use shared memory from another version
+#define SLOT_HEADER_SIZE		((sizeof(ipc_slot) + 7) & ~7)	// Where the edge bitset starts in a slot
+
+#define SLOT_FREE				0		// Nothing in the slot
+#define SLOT_REQUEST			1		// Master has put a position in the slot for someone to move in
+#define SLOT_WORKING			2		// A worker has claimed the position
+#define SLOT_DONE				3		// The worker has put its move in the slot
 
 #define NO_WINNER_YET			0
 
@@ -63,6 +161,16 @@
 
 //------------------------------- Structs -------------------------------
 
+typedef struct {				// Counts of the chains on a board, kept up to date as they change
+	int chains;					// Not counting loops
+	int loops;
+	int chainBoxes;
+	int loopBoxes;
+	int longChains;				// Chains with at least LONG_CHAIN boxes
+	int longest;				// Boxes in the longest chain or loop
+	int capturable;				// Boxes with three sides, whoever moves next can have them
+} chain_summary;
+
 typedef struct {				// Used to hold evaluation results
 	int noSides;
 	int oneSides;
@@ -73,193 +181,725 @@ typedef struct {				// Used to hold evaluation results
 	int playerOtherOwned;
 	int winner;
 	int moveLength;
+	chain_summary chains;		// All 0 unless the DNA weighs a chain feature
 } boardEvaluation;
 
-typedef struct {				// Used to hold the coords of a move
-	int from_x;
-	int to_x;
-	int from_y;
-	int to_y;
-	double score;				// Used in figuring out which move is best
-} move;
-
-typedef struct {				// Used in our scoring function
-	double noBasePair;
-	double oneBasePair;
-	double twoBasePair;
-	double threeBasePair;
-	double lineLengthBasePair;
-	double currentMarginBasePair;
+typedef struct {				// Chains and loops on a board, union-find over the boxes with two or three sides
+	chain_summary counts;
+	int parent[MAX_BOARD_SIDE * MAX_BOARD_SIDE];	// NOT_IN_CHAIN for other boxes, a root is its own parent
+	int boxes[MAX_BOARD_SIDE * MAX_BOARD_SIDE];		// For a root, how many boxes its chain has
+	int links[MAX_BOARD_SIDE * MAX_BOARD_SIDE];		// For a root, open lines between two of its boxes. A loop has one per box
+	int ends[MAX_BOARD_SIDE * MAX_BOARD_SIDE];		// For a root, how many of its boxes have three sides
+} chain_state;
+
+typedef uint32_t packed_move;	// A whole move in 19 bits, see packMove for the layout
+
+typedef struct {				// Used in our scoring function, gene i weighs feature i. Must match master
+	uint32_t geneCount;			// How many genes the DNA file had, the rest are 0
+	uint32_t unused;
+	double genes[MAX_GENES];
 } dna;
 
-typedef struct {				// Used to pass stuff between the parrent process and me
-	dna theDNA;
-	int gameBoard[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
-	move chosenMove;
-	int width;
-	int height;
-	int player;
+typedef struct {				// One thing about a board the DNA can weigh, see boardFeatures
+	const char *name;
+	int needsChains;			// Only worked out when the DNA gives it some weight
+} feature_info;
+
+typedef struct {				// Starts every shared memory segment master makes
+	char magic[4];				// Always SEGMENT_MAGIC
+	uint32_t version;			// IPC_VERSION
+	uint64_t size;				// The whole segment, header and all
+	uint32_t attached;			// How many workers have mapped it, we ring it as a bell too
+	uint32_t unused;
+} segment_header;
+
+typedef struct {				// One game in the ring. The start board's edge bitset and the moves so far follow it
+	uint32_t state;				// SLOT_FREE and friends, only touched with atomics
+	uint32_t moveCount;			// Moves made so far, master adds one each turn
+	double seconds;				// How long we took to move
+
+	dna players[2];				// Set once a game, player one's DNA then player two's
+
+	int player;					// Set each move
 	int pOneScore;
 	int pTwoScore;
 	double pOneTime;
 	double pTwoTime;
-} ipc_memory;
+	uint64_t seed;				// Seed for our random stream, so each move can be replayed
+
+	packed_move chosenMove;		// Our answer
+} ipc_slot;
+
+typedef struct {				// The shared memory master hands to its resident workers. The slots follow it
+	uint32_t slotCount;
+	uint32_t slotSize;			// Bytes from one slot to the next, it depends on the board size
+	uint32_t width;				// Every game in a tourney is on the same size board
+	uint32_t height;
+	uint32_t stop;				// Set when the workers should quit
+	uint32_t requestBell;		// Bumped each time master posts a position, idle workers sleep on it
+	uint32_t responseBell;		// Bumped each time a worker finishes one, master sleeps on it
+	uint32_t unused;
+} ipc_ring;
+
+typedef struct {				// State for one xoshiro256** random number stream
+	uint64_t s[4];
+} rng_state;
+
+typedef struct arena_block {	// One chunk of memory owned by an arena
+	struct arena_block *next;
+	size_t size;
+	size_t used;
+	char data[];
+} arena_block;
+
+typedef struct {				// A bump pointer allocator. Nothing in it is freed alone, arenaReset frees it all
+	arena_block *first;
+	arena_block *current;
+} arena;
+
+typedef struct {				// A spot in an arena to rewind to, freeing everything allocated since
+	arena_block *block;
+	size_t used;
+} arena_mark;
+
+typedef struct {				// A log/linear histogram of timings in nanoseconds
+	uint64_t counts[HISTOGRAM_BUCKETS];
+	uint64_t total;
+	uint64_t sum;
+	uint64_t max;
+} latency_histogram;
+
+typedef struct {				// One position from a batch file
+	int player;
+	int width;
+	int height;
+	int scoreOne;
+	int scoreTwo;
+	double timeOne;
+	double timeTwo;
+	int board[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	packed_move chosenMove;		// NO_MOVE if there was nothing left to play
+} batch_position;
+
+typedef struct {				// What the search needs at one ply, allocated once per move
+	int *board;					// The position at this ply
+	packed_move *moves;			// Its moves, best first once they're ordered
+	uint64_t *keys;				// Ordering score in the top half, the move in the bottom
+} search_ply;
+
+typedef struct {				// One transposition table entry. check is the key xored with data, so a
+	uint64_t check;				// torn write between threads just looks like a miss
+	uint64_t data;				// The value as a float, then 8 bits of depth, 2 of bound and the move
+} table_entry;
+
+typedef struct {				// One thread's part of a Lazy SMP search, every thread searches the same root
+	int thread;
+	int *board;					// The position we're choosing a move in, shared and only read
+	int width;
+	int height;
+	int player;
+	int scoreOne;
+	int scoreTwo;
+	packed_move *moves;			// The moves to choose from, shared and only read
+	int count;
+	uint64_t deadline;
+	uint64_t salt;				// Mixed into every key, so entries from other searches never match
+	uint32_t *stop;				// Set when thread 0 is done, the others give up then
+	packed_move bestMove;		// What this thread found
+	int depthDone;				// and how deep it got
+	uint64_t nodes;
+} search_work;
+
+typedef struct {				// The candidates for a greedy move, each pool thread scores every threads'th one
+	int *board;
+	int width;
+	int height;
+	int player;
+	int scoreOne;
+	int scoreTwo;
+	packed_move *moves;
+	double *scores;				// Where the scores go
+	int count;
+	int threads;
+} split_work;
+
+typedef struct {				// The features of every candidate move in one position, one row per move
+	int player;					// Who is moving, a move that ends the game scores by who won it
+	int count;
+	packed_move *moves;
+	double *features;			// count rows of FEATURE_COUNT
+	int *winners;				// NO_WINNER_YET, or who won if the move ends the game
+} feature_matrix;
+
+typedef struct {				// Genomes to choose moves for, each pool thread takes every threads'th block
+	feature_matrix *matrix;
+	dna *genomes;
+	int count;
+	int *choices;				// The row each genome picks
+	int threads;
+} genome_work;
+
+typedef void (*pool_job)(int thread, void *arg);	// Work for the pool, thread 0 is always the caller
+
+typedef struct mcts_node {		// One position in an MCTS tree, they all come from mctsArena
+	struct mcts_node *children;	// The first child, the rest hang off its sibling
+	struct mcts_node *sibling;
+	packed_move *untried;		// Moves from here that don't have a child yet, the one to try next is last
+	int untriedCount;			// -1 until we first reach the node and list its moves
+	packed_move move;			// The move that got here
+	int player;					// Who made it
+	uint32_t visits;
+	double wins;				// Playouts player won from here, ties count as half
+} mcts_node;
+
+typedef struct {				// One tree of a root parallel MCTS, each thread grows its own
+	int thread;
+	uint64_t seed;				// For the thread's random stream
+	int playouts;				// How many playouts this tree gets
+	uint64_t deadline;			// Stop early if we get to this
+	int *board;					// The position we're choosing a move in, shared and only read
+	int width;
+	int height;
+	int player;
+	int scoreOne;
+	int scoreTwo;
+	packed_move *moves;			// The moves to choose from, shared and only read
+	int count;
+	uint32_t *visits;			// Filled in with how many playouts went through each of the moves
+} mcts_work;
+
+typedef struct {				// The positions one batch thread scores
+	batch_position *positions;
+	int count;
+	int thread;					// The thread scores every threadCount'th position, starting here
+	int threadCount;
+	uint64_t firstNumber;		// Which position in the whole batch positions[0] is, for the random streams
+} batch_work;
 
 //------------------------------- Global Variables -------------------------------
 
-int me = 0;		// Which player we are, one or two
-int him = 0;	// Which player they are, one or two
+PER_THREAD int me = 0;		// Which player we are, one or two
+PER_THREAD int him = 0;		// Which player they are, one or two
 
-move finalMove;
+PER_THREAD packed_move finalMove;
 
 int nextMoveNum = 0;	// The number of the next move
 
-int playerOneScore = 0, playerTwoScore = 0;					// Scores for the two players
-double playerOneTimeLeft = 60.0, playerTwoTimeLeft = 60.0;	// Time left for the two players
+PER_THREAD int playerOneScore = 0, playerTwoScore = 0;					// Scores for the two players
+PER_THREAD double playerOneTimeLeft = 60.0, playerTwoTimeLeft = 60.0;	// Time left for the two players
 
-int *ourScore, *hisScore;						// Pointers to the scores for quick reference
-double *ourTime, *hisTime;						// Pointers to time left for quick reference
+PER_THREAD int *ourScore, *hisScore;						// Pointers to the scores for quick reference
+PER_THREAD double *ourTime, *hisTime;						// Pointers to time left for quick reference
 
 dna *myDNA;
 
-int boardWidth;
-int boardHeight;
-int *gameBoard;
-
-int possibleMovesFound;
-move *possibleMoves[MAX_POSSIBLE_MOVES];		// An array to hold all possible moves we find
+const feature_info featureInfo[FEATURE_COUNT] = {
+	{"none", false}, {"one", false}, {"two", false}, {"three", false}, {"line", false}, {"margin", false},
+	{"chain boxes", true}, {"loop boxes", true}, {"long chains", true}, {"capturable", true}
+};
+
+PER_THREAD chain_state scratchChains;	// For evaluateBoard when it isn't given any
+
+PER_THREAD rng_state moveRNG;	// Our random stream, only used to break ties between moves
+uint64_t batchSeed;				// Position n of a batch uses stream n of this seed
+
+latency_histogram *moveTimings[MAX_BOARD_SIDE + 1][MAX_BOARD_SIDE + 1];	// TIMING_STAGES for each board size
+const char *stageNames[TIMING_STAGES] = {"generate", "candidate", "select", "move"};
+
+PER_THREAD int boardWidth;
+PER_THREAD int boardHeight;
+PER_THREAD int *gameBoard;
+
+PER_THREAD int possibleMovesFound;
+PER_THREAD int possibleMovesRoom = 0;				// How many moves the two lists below have room for
+PER_THREAD packed_move *possibleMoves = null;		// All the possible moves we find, grown to fit the board
+PER_THREAD double *possibleScores = null;			// And the score of each one, once selectMove works it out
+
+PER_THREAD arena evalArena;		// Holds scratch boards and evaluations, reset every time we select a move
+
+int searchDepth = 0;			// 0 picks moves greedily, more runs an alpha-beta search this many plies deep
+int mctsPlayouts = 0;			// More than 0 picks moves with MCTS, using this many playouts
+int playThreads = 1;			// Threads to think with, for modes that can use them
+
+PER_THREAD search_ply searchPlies[MAX_SEARCH_DEPTH + 1];
+PER_THREAD int *historyScores = null;						// Cutoffs each move has caused, weighted by depth
+PER_THREAD packed_move killerMoves[MAX_SEARCH_DEPTH][2];	// The last two moves to cause a cutoff at each ply
+PER_THREAD uint64_t searchDeadline;
+PER_THREAD uint64_t searchNodes;
+PER_THREAD int searchStopped;	// Set when we run out of time, the search unwinds without a result
+PER_THREAD uint32_t *searchStop;	// For helper threads, set when the main search thread is done
+PER_THREAD uint64_t searchSalt;
+
+table_entry *searchTable = null;	// Shared by every search thread, allocated the first time we search
+pthread_once_t searchTableOnce = PTHREAD_ONCE_INIT;
+uint64_t searchCount = 0;			// Searches started, for their salts
+
+pthread_mutex_t poolBusy = PTHREAD_MUTEX_INITIALIZER;	// Held by whoever is using the pool
+pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;	// Guards everything below
+pthread_cond_t poolWake = PTHREAD_COND_INITIALIZER;		// Workers wait on this for a new round
+pthread_cond_t poolDone = PTHREAD_COND_INITIALIZER;		// The caller waits on this for them to finish
+uint32_t poolStarted[MAX_PLAY_THREADS];	// The round each worker was started in, it joins the next one
+int poolSize = 1;						// Workers running, counting the caller as thread 0
+uint32_t poolRound = 0;
+int poolPending = 0;					// Workers still working on this round
+int poolWanted = 0;						// Threads this round's job is split between
+pool_job poolJob = null;
+void *poolArg = null;
+
+PER_THREAD arena mctsArena;		// The MCTS tree, reset every move
 
 // Function prototypes
 
 void selectMove();
+void scoreCandidates(int thread, void *arg);
+void candidateFeatures(feature_matrix *m, arena *a);
+void chooseForGenomes(feature_matrix *m, dna *genomes, int count, int *choices);
+void chooseGenomeBlocks(int thread, void *arg);
+void scoreGenomeBlock(feature_matrix *m, int i, double genes[FEATURE_COUNT][GENOME_BLOCK], double *scores);
+void searchMove();
+void searchJob(int thread, void *arg);
+double alphaBeta(int ply, int depth, double alpha, double beta, int player, packed_move lastMove);
+double leafScore(int *board, packed_move lastMove);
+int moveClass(int *board, packed_move theMove);
+int compareKeys(const void *a, const void *b);
+void orderMoves(int *board, search_ply *p, int count, int ply, packed_move first);
+void noteCutoff(int ply, int depth, packed_move theMove);
+void allocateSearchTable();
+int probeTable(uint64_t key, int *depth, int *bound, double *value, packed_move *theMove);
+void storeTable(uint64_t key, int depth, int bound, double value, packed_move theMove);
+int readPlayOptions(int argc, char** argv);
+void mctsMove();
+void growTree(int thread, void *arg);
+int mctsPlayout(mcts_node *root, int *board, mcts_node **path, packed_move *moves, rng_state *r, int *scratch);
+mcts_node *newNode(packed_move theMove, int player);
+void sortUntried(int *board, packed_move *moves, int count, packed_move *untried, rng_state *r);
+mcts_node *uctChild(mcts_node *n);
+packed_move rolloutMove(int *board, packed_move *moves, int count, int player, rng_state *r, int *scratch);
+int boardWinner(int *board);
+int poolThreads();
+void poolRun(pool_job job, void *arg, int threads);
+void *poolWorker(void *arg);
 void readInputFile(const char *fileName);
+int readPosition(FILE *inputFile, const char *fileName);
+void setPlayer(int player);
+void *scoreBatch(void *arg);
+void runBatch(int argc, char** argv);
+void ringWait(uint32_t *bell, uint32_t seen, int ms);
+void ringBell(uint32_t *bell, int sleepers);
+void *attachSegment(const char *name, size_t *size);
+void detachSegment(void *data, size_t size);
+int edgeCount(int width, int height);
+uint32_t ringSlotSize(int width, int height);
+ipc_slot *ringSlot(ipc_ring *r, int i);
+uint64_t *slotEdges(ipc_slot *slot);
+packed_move *slotMoves(ipc_slot *slot, int width, int height);
+void unpackEdges(uint64_t *edges, int *board);
+void playSlot(ipc_ring *ring, ipc_slot *slot);
+void serveRing(ipc_ring *ring, size_t size);
 void runMove(int player, int from_x, int from_y, int to_x, int to_y, int test_only, int *board);
-boardEvaluation *evaluateBoard(int *board, move *theMove);
+void claimBox(int player, int x, int y, int test_only, int *board);
+boardEvaluation *evaluateBoard(int *board, packed_move theMove, chain_state *chains);
 int main(int argc, char** argv);
 void printBoard();
 int charToColumn(char c);
 char columnToChar(int x);
 int countLines(int *board, int x, int y);
 void generateMoveList();
+int listMoves(int *board, packed_move *moves);
+int maxPossibleMoves(int width, int height);
+void reservePossibleMoves();
+void freeThreadMemory();
+void clearPossibleMoves();
 int xyToIndex(int x, int y);
 void copyBoard(int *s, int *d);
-void copyMove(move *s, move *d);
-move *makeMove(int x_start, int y_start, int x_end, int y_end);
-void addPossibleMove(int from_x, int from_y, int to_x, int to_y);
+int symmetryCount();
+void symmetryPoint(int symmetry, int *x, int *y);
+void symmetryPointBack(int symmetry, int *x, int *y);
+int symmetryLines(int symmetry, int c);
+packed_move symmetryMove(int symmetry, packed_move theMove);
+packed_move symmetryMoveBack(int symmetry, packed_move theMove);
+int canonicalBoard(int *board, int *canon);
+uint64_t positionKey(int *board, int player, int *symmetry);
+void findChains(int *board, chain_state *c);
+void addChainBox(int *board, chain_state *c, int x, int y);
+int chainRoot(chain_state *c, int i);
+void joinChains(chain_state *c, int a, int b);
+void updateChains(int *board, chain_state *c, packed_move theMove);
+int chainsMatch(int *board, chain_state *c);
+void runChainMove(int player, packed_move theMove, int *board, chain_state *c);
+void dropChain(chain_state *c, int root);
+void copyChains(chain_state *s, chain_state *d);
 double scoreEvaluation(boardEvaluation *e);
-void runMoveWithStruct(int player, move *theMove, int *theBoard);
+void boardFeatures(boardEvaluation *e, double *features);
+int dnaNeedsChains(dna *d);
+packed_move packMove(int from_x, int from_y, int to_x, int to_y);
+void unpackMove(packed_move theMove, int *from_x, int *from_y, int *to_x, int *to_y);
+void runPackedMove(int player, packed_move theMove, int *theBoard);
 void loadDNA(char *path);
+void useDefaultDNA(dna *d);
+uint64_t mixBits(uint64_t z);
+uint64_t splitMix(uint64_t *x);
+void seedRNG(rng_state *r, uint64_t seed, uint64_t stream);
+uint64_t nextRandom(rng_state *r);
+double randomDouble(rng_state *r);
+int randomInt(rng_state *r, int n);
+void *arenaAlloc(arena *a, size_t size);
+void arenaReset(arena *a);
+void arenaFree(arena *a);
+void arenaMark(arena *a, arena_mark *m);
+void arenaRewind(arena *a, arena_mark *m);
+uint64_t nanoTime();
+int histogramBucket(uint64_t ns);
+uint64_t bucketValue(int bucket);
+uint64_t histogramValueAt(latency_histogram *h, double fraction);
+void recordTiming(int stage, uint64_t ns);
+void writeTimings();
 
 //------------------------------- Function definitions -------------------------------
 
-// Load DNA from a file
+// Get memory from an arena, it lives until the arena is reset
 
-void loadDNA(char *path) {
-	// Stuff we'll need
+void *arenaAlloc(arena *a, size_t size) {
+	arena_block *b;
+	size_t blockSize;
+	void *result;
 
-	FILE *in = null;
-	double temp;
-	char buffer[80];
+	size = (size + 7) & ~((size_t) 7);	// Keep everything lined up for doubles
 
-	// Now, the work
+	// Move on to blocks we already have if this one is full
 
-	in = fopen(path, "r");
+	while ((a->current != null) && (a->current->used + size > a->current->size) && (a->current->next != null)) {
+		a->current = a->current->next;
+	}
 
-	if (in == null) {
-		// Unable to open the file, complain.
-		printf("Unable to open our DNA file: error %d.\n", errno);
-		exit(1);
+	if ((a->current == null) || (a->current->used + size > a->current->size)) {
+		// Out of room, so we need a new block
+
+		blockSize = ARENA_BLOCK_SIZE;
+
+		if (size > blockSize)
+			blockSize = size;
+
+		b = malloc(sizeof(arena_block) + blockSize);
+
+		if (b == null) {
+			printf("Unable to allocate arena memory: error %d.\n", errno);
+			exit(1);
+		}
+
+		b->next = null;
+		b->size = blockSize;
+		b->used = 0;
+
+		if (a->current == null)
+			a->first = b;
+		else
+			a->current->next = b;
+
+		a->current = b;
 	}
 
-	// Now that the file is open, we'll read it
+	result = a->current->data + a->current->used;
+	a->current->used += size;
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the first base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
+	return result;
+}
+
+// Throw away everything in an arena at once. The memory is kept for next time
+
+void arenaReset(arena *a) {
+	arena_block *b;
+
+	for (b = a->first; b != null; b = b->next) {
+		b->used = 0;
 	}
 
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the first base pair.\n");
-		fclose(in);
-		exit(1);
+	a->current = a->first;
+}
+
+// Give all of an arena's memory back
+
+void arenaFree(arena *a) {
+	arena_block *b, *next;
+
+	for (b = a->first; b != null; b = next) {
+		next = b->next;
+		free(b);
 	}
 
-	myDNA->noBasePair = temp;
+	a->first = null;
+	a->current = null;
+}
+
+// Remember how full an arena is
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the second base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
+void arenaMark(arena *a, arena_mark *m) {
+	m->block = a->current;
+	m->used = (a->current == null) ? 0 : a->current->used;
+}
+
+// Free everything allocated since the mark, the blocks are kept for reuse
+
+void arenaRewind(arena *a, arena_mark *m) {
+	arena_block *b;
+
+	if (m->block == null) {
+		arenaReset(a);
+		return;
 	}
 
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the second base pair.\n");
-		fclose(in);
-		exit(1);
+	for (b = m->block->next; b != null; b = b->next)
+		b->used = 0;
+
+	m->block->used = m->used;
+	a->current = m->block;
+}
+
+// Scramble the bits of a number, the finishing step of splitmix64
+
+uint64_t mixBits(uint64_t z) {
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+}
+
+// Step a splitmix64 counter, which we only use to fill in xoshiro state
+
+uint64_t splitMix(uint64_t *x) {
+	*x += 0x9E3779B97F4A7C15ULL;
+
+	return mixBits(*x);
+}
+
+// Seed a random stream. Different stream numbers give unrelated sequences from the same seed
+
+void seedRNG(rng_state *r, uint64_t seed, uint64_t stream) {
+	uint64_t x;
+	int i;
+
+	x = mixBits(seed) ^ mixBits(stream + 0x9E3779B97F4A7C15ULL);
+
+	for (i = 0; i < 4; i++) {
+		r->s[i] = splitMix(&x);
 	}
+}
 
-	myDNA->oneBasePair = temp;
+// Get the next 64 random bits from a stream (xoshiro256**)
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the third base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
+uint64_t nextRandom(rng_state *r) {
+	uint64_t *s = r->s;
+	uint64_t result, t;
+
+	result = s[1] * 5;
+	result = ((result << 7) | (result >> 57)) * 9;
+
+	t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+
+	s[2] ^= t;
+	s[3] = (s[3] << 45) | (s[3] >> 19);
+
+	return result;
+}
+
+// A random number from 0 up to (but not including) 1
+
+double randomDouble(rng_state *r) {
+	return (nextRandom(r) >> 11) * (1.0 / 9007199254740992.0);	// 53 bits, all a double can hold
+}
+
+// A random number from 0 to n - 1
+
+int randomInt(rng_state *r, int n) {
+	return (int) (((nextRandom(r) >> 32) * (uint64_t) n) >> 32);
+}
+
+// Get a timestamp in nanoseconds, only good for measuring differences
+
+uint64_t nanoTime() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return ((uint64_t) t.tv_sec) * 1000000000ULL + (uint64_t) t.tv_nsec;
+}
+
+// Figure out which histogram bucket a timing goes in
+
+int histogramBucket(uint64_t ns) {
+	int top;
+
+	if (ns < HISTOGRAM_SUB_COUNT)
+		return (int) ns;	// Small values get a bucket each
+
+	top = 63 - __builtin_clzll(ns);	// The highest bit set
+
+	return (top - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT +
+				(int) ((ns >> (top - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_COUNT - 1));
+}
+
+// The smallest timing that goes into a bucket
+
+uint64_t bucketValue(int bucket) {
+	if (bucket < HISTOGRAM_SUB_COUNT)
+		return (uint64_t) bucket;
+
+	return ((uint64_t) (HISTOGRAM_SUB_COUNT + bucket % HISTOGRAM_SUB_COUNT)) << (bucket / HISTOGRAM_SUB_COUNT - 1);
+}
+
+// Find the timing that the given fraction of samples are at or under (0.5 is the median)
+
+uint64_t histogramValueAt(latency_histogram *h, double fraction) {
+	uint64_t wanted, seen;
+	int i;
+
+	wanted = (uint64_t) (fraction * h->total + 0.5);
+
+	if (wanted < 1)
+		wanted = 1;
+
+	seen = 0;
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += h->counts[i];
+
+		if (seen >= wanted) {
+			if (bucketValue(i) > h->max)
+				return h->max;	// The top bucket can be wider than what we actually saw
+			return bucketValue(i);
+		}
 	}
 
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the third base pair.\n");
-		fclose(in);
-		exit(1);
+	return h->max;
+}
+
+// Add a timing for the current board size
+
+void recordTiming(int stage, uint64_t ns) {
+	latency_histogram *h;
+
+	if (moveTimings[boardHeight][boardWidth] == null) {
+		moveTimings[boardHeight][boardWidth] = calloc(TIMING_STAGES, sizeof(latency_histogram));
+
+		if (moveTimings[boardHeight][boardWidth] == null) {
+			printf("Unable to allocate timing histograms.\n");
+			exit(1);
+		}
 	}
 
-	myDNA->twoBasePair = temp;
+	h = &(moveTimings[boardHeight][boardWidth][stage]);
 
+	h->counts[histogramBucket(ns)]++;
+	h->total++;
+	h->sum += ns;
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the fourth base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
+	if (ns > h->max)
+		h->max = ns;
+}
+
+// Write a summary of our timings to the timing file, run at exit
+
+void writeTimings() {
+	FILE *out = null;
+	latency_histogram *h;
+	int x, y, stage;
+
+	out = fopen(TIMING_FILE, "a");	// We add on, so many runs can go in one file
+
+	if (out == null) {
+		printf("Unable to open the timing file: error %d.\n", errno);
+		return;
 	}
 
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the fourth base pair.\n");
-		fclose(in);
-		exit(1);
+	if (ftell(out) == 0) {
+		fprintf(out, "Width,Height,Stage,Count,Mean_ns,P50_ns,P90_ns,P99_ns,Max_ns,Per_second\n");
 	}
 
-	myDNA->threeBasePair = temp;
+	for (y = MIN_BOARD_SIDE; y <= MAX_BOARD_SIDE; y++) {
+		for (x = MIN_BOARD_SIDE; x <= MAX_BOARD_SIDE; x++) {
+			if (moveTimings[y][x] == null)
+				continue;
 
+			for (stage = 0; stage < TIMING_STAGES; stage++) {
+				h = &(moveTimings[y][x][stage]);
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the fifth base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
+				if (h->total == 0)
+					continue;
+
+				fprintf(out, "%d,%d,%s,%llu,%llu,%llu,%llu,%llu,%llu,%.1f\n", x, y, stageNames[stage],
+						(unsigned long long) h->total, (unsigned long long) (h->sum / h->total),
+						(unsigned long long) histogramValueAt(h, 0.5), (unsigned long long) histogramValueAt(h, 0.9),
+						(unsigned long long) histogramValueAt(h, 0.99), (unsigned long long) h->max,
+						h->sum ? (h->total * 1000000000.0) / h->sum : 0.0);
+			}
+		}
 	}
 
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the fifth base pair.\n");
-		fclose(in);
+	fclose(out);
+}
+
+// Fill in the DNA we play with when we aren't given any
+
+void useDefaultDNA(dna *d) {
+	memset(d, 0, sizeof(dna));
+
+	d->geneCount = BASE_GENES;
+	d->genes[FEATURE_NO_SIDES] = 0.984120;	// After 47 evolutions
+	d->genes[FEATURE_ONE_SIDE] = 0.576126;
+	d->genes[FEATURE_TWO_SIDES] = 0.315090;
+	d->genes[FEATURE_THREE_SIDES] = -0.972065;
+	d->genes[FEATURE_LINE_LENGTH] = 0.020435;
+	d->genes[FEATURE_MARGIN] = 0.660055;
+}
+
+// Load DNA from a file, one gene a line. Genes for features we don't have yet are kept but not used
+
+void loadDNA(char *path) {
+	// Stuff we'll need
+
+	FILE *in = null;
+	double temp;
+	char buffer[80];
+	int i;
+
+	// Now, the work
+
+	in = fopen(path, "r");
+
+	if (in == null) {
+		// Unable to open the file, complain.
+		printf("Unable to open our DNA file: error %d.\n", errno);
 		exit(1);
 	}
 
-	myDNA->lineLengthBasePair = temp;
+	// Now that the file is open, we'll read it
 
+	memset(myDNA, 0, sizeof(dna));
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the sixth base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
+	while ((myDNA->geneCount < MAX_GENES) && (fgets(buffer, 80, in) != null)) {
+		if (strncmp(buffer, STEPS_MARKER, strlen(STEPS_MARKER)) == 0)
+			break;	// Only breeding needs the step sizes
+
+		if (sscanf(buffer, "%lf", &temp) != 1) {
+			printf("Unable to interpret base pair %d.\n", myDNA->geneCount + 1);
+			fclose(in);
+			exit(1);
+		}
+
+		myDNA->genes[myDNA->geneCount++] = temp;
 	}
 
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the sixth base pair.\n");
+	if (myDNA->geneCount < BASE_GENES) {
+		printf("Our DNA only has %d base pairs, it needs at least %d.\n", myDNA->geneCount, BASE_GENES);
 		fclose(in);
 		exit(1);
 	}
 
-	myDNA->currentMarginBasePair = temp;
-
 	// We're done
 
 	fclose(in);
@@ -268,20 +908,54 @@ void loadDNA(char *path) {
 
 	if (DEBUG) {
 		printf("We loaded the following DNA:\n");
-		printf("\t     0: %f\n", myDNA->noBasePair);
-		printf("\t     1: %f\n", myDNA->oneBasePair);
-		printf("\t     2: %f\n", myDNA->twoBasePair);
-		printf("\t     3: %f\n", myDNA->threeBasePair);
-		printf("\t  line: %f\n", myDNA->lineLengthBasePair);
-		printf("\tmargin: %f\n", myDNA->currentMarginBasePair);
+
+		for (i = 0; i < (int) myDNA->geneCount; i++)
+			printf("\t%12s: %f\n", (i < FEATURE_COUNT) ? featureInfo[i].name : "unused", myDNA->genes[i]);
+
 		printf("\n");	
 	}
 }
 
-// Call runMove using the data in a move struct
+// Pack a move into 19 bits. From the top down that's 1 bit saying the line is virticle,
+// 6 bits for the row or column it is on, then 6 bits each for where it starts and ends
+
+packed_move packMove(int from_x, int from_y, int to_x, int to_y) {
+	if (from_x == to_x)
+		return MOVE_VERTICAL | (from_x << (2 * MOVE_FIELD_BITS)) | (from_y << MOVE_FIELD_BITS) | to_y;
+	else
+		return (from_y << (2 * MOVE_FIELD_BITS)) | (from_x << MOVE_FIELD_BITS) | to_x;
+}
+
+// Get the coordinates back out of a packed move
+
+void unpackMove(packed_move theMove, int *from_x, int *from_y, int *to_x, int *to_y) {
+	int line, start, end;
+
+	line = (theMove >> (2 * MOVE_FIELD_BITS)) & MOVE_FIELD_MASK;
+	start = (theMove >> MOVE_FIELD_BITS) & MOVE_FIELD_MASK;
+	end = theMove & MOVE_FIELD_MASK;
+
+	if (theMove & MOVE_VERTICAL) {
+		*from_x = line;
+		*to_x = line;
+		*from_y = start;
+		*to_y = end;
+	} else {
+		*from_y = line;
+		*to_y = line;
+		*from_x = start;
+		*to_x = end;
+	}
+}
+
+// Call runMove using a packed move
+
+void runPackedMove(int player, packed_move theMove, int *theBoard) {
+	int from_x, from_y, to_x, to_y;
+
+	unpackMove(theMove, &from_x, &from_y, &to_x, &to_y);
 
-void runMoveWithStruct(int player, move *theMove, int *theBoard) {
-	runMove(player, theMove->from_x, theMove->from_y, theMove->to_x, theMove->to_y, false, theBoard);
+	runMove(player, from_x, from_y, to_x, to_y, false, theBoard);
 }
 
 // Using our magic DNA
@@ -289,10 +963,9 @@ void runMoveWithStruct(int player, move *theMove, int *theBoard) {
 double scoreEvaluation(boardEvaluation *e) {
 	// First, some variables we'll need
 
-	double squareCount;
-	double temp;
-	int margin;
+	double features[FEATURE_COUNT];
 	double score;
+	int i;
 
 	// First a quick check to see if we found a winner
 
@@ -304,74 +977,51 @@ double scoreEvaluation(boardEvaluation *e) {
 		}
 	}
 
-	// Initialize things
-
-	squareCount = boardWidth * boardHeight;
-	score = 0.0;
-
-	// Now, we do the calculations
-	// First, look at who is winning and by how much
-
-	margin = *ourScore - *hisScore;
-	temp = ((double) margin) / squareCount;
-
-	score += temp * myDNA->currentMarginBasePair;
-
-	// Now, look at how many squares have no lines on them
-
-	temp = ((double) e->noSides) / squareCount;
-	score += temp * myDNA->noBasePair;
-
-	// Now, look at how many squares have one line on them
-
-	temp = ((double) e->oneSides) / squareCount;
-	score += temp * myDNA->oneBasePair;
-
-	// Now, look at how many squares have two lines on them
+	// The score is each gene times its feature, one pass down two flat arrays. Genes a short
+	// DNA doesn't have are 0
 
-	temp = ((double) e->twoSides) / squareCount;
-	score += temp * myDNA->twoBasePair;
+	boardFeatures(e, features);
 
-	// Now, look at how many squares have three lines on them
+	score = myDNA->genes[FEATURE_MARGIN] * features[FEATURE_MARGIN];	// Margin first, the order it always went in
 
-	temp = ((double) e->threeSides) / squareCount;
-	score += temp * myDNA->threeBasePair;
-
-	// Now, how long was the last move (1 section, 3, 12, etc);
-
-	temp = ((double) e->moveLength) / 9.0;	// 9 segments is the longest possible line
-	score += temp * myDNA->lineLengthBasePair;
+	for (i = 0; i < FEATURE_COUNT; i++)
+		if (i != FEATURE_MARGIN)
+			score += myDNA->genes[i] * features[i];
 
 	// That's it
 
 	return score;
 }
 
-// A function to add a possible move to the list
-
-void addPossibleMove(int from_x, int from_y, int to_x, int to_y) {
-/*	if (DEBUG) {
-		char fromXChar, fromYChar, toXChar, toYChar;
-		fromXChar = columnToChar(from_x);
-		toXChar = columnToChar(to_x);
-	
-		fromYChar = '1' + from_y;
-		toYChar = '1' + to_y;
-	
-		printf("%c%c %c%c\n", fromXChar, fromYChar, toXChar, toYChar);
-	}
-*/
-	possibleMoves[possibleMovesFound++] = makeMove(from_x, from_y, to_x, to_y);
+// Turn an evaluation into the features the genes weigh. Counts are per box, so DNA weighs
+// them the same on any board
+
+void boardFeatures(boardEvaluation *e, double *features) {
+	double squareCount = boardWidth * boardHeight;
+
+	features[FEATURE_NO_SIDES] = e->noSides / squareCount;
+	features[FEATURE_ONE_SIDE] = e->oneSides / squareCount;
+	features[FEATURE_TWO_SIDES] = e->twoSides / squareCount;
+	features[FEATURE_THREE_SIDES] = e->threeSides / squareCount;
+	features[FEATURE_LINE_LENGTH] = e->moveLength / 9.0;	// Kept from the 8x8 days, so DNA weighs a line the same on any board
+	features[FEATURE_MARGIN] = (*ourScore - *hisScore) / squareCount;
+	features[FEATURE_CHAIN_BOXES] = e->chains.chainBoxes / squareCount;
+	features[FEATURE_LOOP_BOXES] = e->chains.loopBoxes / squareCount;
+	features[FEATURE_LONG_CHAINS] = e->chains.longChains / squareCount;
+	features[FEATURE_CAPTURABLE] = e->chains.capturable / squareCount;
 }
 
-// A function to copy a move
+// See if some DNA weighs any feature that needs the chains worked out
+
+int dnaNeedsChains(dna *d) {
+	int i;
+
+	for (i = 0; i < FEATURE_COUNT; i++) {
+		if (featureInfo[i].needsChains && (d->genes[i] != 0.0))
+			return true;
+	}
 
-void copyMove(move *s, move *d) {
-	d->from_x = s->from_x;
-	d->from_y = s->from_y;
-	d->to_x = s->to_x;
-	d->to_y = s->to_y;
-	d->score = s->score;
+	return false;
 }
 
 // A function to choose which move we want
@@ -385,13 +1035,14 @@ void selectMove() {
 	int bestCount;
 	int *tempBoard;
 	boardEvaluation *tempEval;
+	uint64_t selectStart = 0, candidateStart = 0;
+	split_work split;
+	int threads;
+	chain_state *baseChains = null, *moveChains = null;
 
-	tempBoard = malloc(boardWidth * boardHeight * sizeof(int));
+	arenaReset(&evalArena);	// Throw away the last turn's evaluations
 
-	if (tempBoard == null) {
-		printf("Unable to allocate space for a temporary game board.\n");
-		exit(1);
-	}
+	tempBoard = arenaAlloc(&evalArena, boardWidth * boardHeight * sizeof(int));
 
 	// A sanity check
 
@@ -401,757 +1052,2917 @@ void selectMove() {
 		exit(1);
 	}
 
+	// With --mcts or --search we look further ahead instead
+
+	if (mctsPlayouts > 0) {
+		mctsMove();
+		return;
+	}
+
+	if (searchDepth > 0) {
+		searchMove();
+		return;
+	}
+
 	// Now the real work
 
+	if (TIMING)
+		selectStart = nanoTime();
+
 	bestScore = -7.0;	// Lower than the lowest possible score
 	bestIndex = -1;
 	bestCount = -1;
 
+	// With enough moves the pool scores them all first. Choosing still happens below in
+	// order, so we pick the same move as we would on one thread
+
+	threads = poolThreads();
+
+	if (possibleMovesFound < SPLIT_MIN_MOVES)
+		threads = 1;
+
+	if (threads > 1) {
+		split.board = gameBoard;
+		split.width = boardWidth;
+		split.height = boardHeight;
+		split.player = me;
+		split.scoreOne = playerOneScore;
+		split.scoreTwo = playerTwoScore;
+		split.moves = possibleMoves;
+		split.scores = possibleScores;
+		split.count = possibleMovesFound;
+		split.threads = threads;
+
+		poolRun(scoreCandidates, &split, threads);
+	}
+
 //	i = rand() % possibleMovesFound;
 
+	if ((threads == 1) && dnaNeedsChains(myDNA)) {
+		// Each candidate's chains come from this board's with one move added
+
+		baseChains = arenaAlloc(&evalArena, sizeof(chain_state));
+		moveChains = arenaAlloc(&evalArena, sizeof(chain_state));
+
+		findChains(gameBoard, baseChains);
+	}
+
 	for (i = 0; i < possibleMovesFound; i++) {
-		// First, get us a temporary copy of the current game board
+		if (threads == 1) {
+			// First, get us a temporary copy of the current game board
 
-		copyBoard(gameBoard, tempBoard);
+			if (TIMING)
+				candidateStart = nanoTime();
 
-		// Now, run the trial move on it
+			copyBoard(gameBoard, tempBoard);
 
-		runMoveWithStruct(me, possibleMoves[i], tempBoard);
+			// Now, run the trial move on it
 
-		// Now, evaluate it
+			runPackedMove(me, possibleMoves[i], tempBoard);
 
-		tempEval = evaluateBoard(tempBoard, possibleMoves[i]);
+			if (baseChains != null) {
+				copyChains(baseChains, moveChains);
+				updateChains(tempBoard, moveChains, possibleMoves[i]);
+			}
+
+			// Now, evaluate it
 
-		// Now, score it
+			tempEval = evaluateBoard(tempBoard, possibleMoves[i], moveChains);
 
-		possibleMoves[i]->score = scoreEvaluation(tempEval);
+			// Now, score it
 
-		// Now free that evaluation
+			possibleScores[i] = scoreEvaluation(tempEval);
 
-		free(tempEval);
+			if (TIMING)
+				recordTiming(STAGE_CANDIDATE, nanoTime() - candidateStart);
+		}
 
 		// Now, see if it is the best one we've found
 
-		if (possibleMoves[i]->score == 7.0) {		// We found a winner, no need to score the rest
+		if (possibleScores[i] == 7.0) {		// We found a winner, no need to score the rest
 			bestIndex = i;
 			bestCount = 1;
 			break;
-		} else if (possibleMoves[i]->score > bestScore) {
+		} else if (possibleScores[i] > bestScore) {
 			bestCount = 1;
-			bestScore = possibleMoves[i]->score;
+			bestScore = possibleScores[i];
 			bestIndex = i;
-		} else if (possibleMoves[i]->score == bestScore) {	// If the scores are the same...
+		} else if (possibleScores[i] == bestScore) {	// If the scores are the same...
 			bestCount++;									// Make a random choice between them
-			if ((float) rand() / RAND_MAX <= ((double) (1.0 / (double) bestCount))) {
-				bestIndex = i;		// Note, this is biased towards the front
+			if (randomInt(&moveRNG, bestCount) == 0) {
+				bestIndex = i;		// Each tied move ends up with a 1 in bestCount chance
 			}
 		}
 	}
 
 	// Set up the move
 
-	copyMove(possibleMoves[bestIndex], &finalMove);
+	finalMove = possibleMoves[bestIndex];
+
+	if (TIMING)
+		recordTiming(STAGE_SELECT, nanoTime() - selectStart);
 
-	free(tempBoard);
 }
 
-// A function to allocate a move for us
+// Score every threads'th candidate for a greedy move, starting with the thread's own. Runs on
+// a pool thread, so it sets up the thread's copy of everything scoreEvaluation uses
 
-move *makeMove(int x_start, int y_start, int x_end, int y_end) {
-	move *temp = malloc(sizeof(move));
+void scoreCandidates(int thread, void *arg) {
+	split_work *work = (split_work *) arg;
+	int board[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	chain_state *baseChains = null, *moveChains = null;
+	arena_mark start, mark;
+	int i;
 
-	if (temp == null) {
-		printf("Unable to allocate a new move structure!\n");
-		exit(1);
+	boardWidth = work->width;
+	boardHeight = work->height;
+	playerOneScore = work->scoreOne;
+	playerTwoScore = work->scoreTwo;
+	setPlayer(work->player);
+
+	arenaMark(&evalArena, &start);
+
+	if (dnaNeedsChains(myDNA)) {
+		baseChains = arenaAlloc(&evalArena, sizeof(chain_state));
+		moveChains = arenaAlloc(&evalArena, sizeof(chain_state));
+
+		findChains(work->board, baseChains);
 	}
 
-	temp->from_x = x_start;
-	temp->from_y = y_start;
-	temp->to_x = x_end;
-	temp->to_y = y_end;
+	for (i = thread; i < work->count; i += work->threads) {
+		arenaMark(&evalArena, &mark);
+
+		copyBoard(work->board, board);
+		runPackedMove(work->player, work->moves[i], board);
+
+		if (baseChains != null) {
+			copyChains(baseChains, moveChains);
+			updateChains(board, moveChains, work->moves[i]);
+		}
+
+		work->scores[i] = scoreEvaluation(evaluateBoard(board, work->moves[i], moveChains));
 
-	temp->score = 0.0;
+		arenaRewind(&evalArena, &mark);
+	}
 
-	return temp;	// The caller must free the structure, it's their job now.
+	arenaRewind(&evalArena, &start);
 }
 
-// A function to copy a board to another
+// Work out the features of every move in possibleMoves, once, so any number of genomes can
+// choose between them with chooseForGenomes. The matrix comes from a, since selectMove resets
+// evalArena. The chains are always worked out, some genome may want them
 
-void copyBoard(int *s, int *d) {
+void candidateFeatures(feature_matrix *m, arena *a) {
+	int board[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	chain_state *baseChains, *moveChains;
+	boardEvaluation *e;
+	arena_mark start, mark;
 	int i;
 
-	for (i = 0; i < boardWidth * boardHeight; i++)
-		d[i] = s[i];
-}
+	m->player = me;
+	m->count = possibleMovesFound;
+	m->moves = arenaAlloc(a, possibleMovesFound * sizeof(packed_move));
+	m->features = arenaAlloc(a, possibleMovesFound * FEATURE_COUNT * sizeof(double));
+	m->winners = arenaAlloc(a, possibleMovesFound * sizeof(int));
 
-// A function to turn an x, y combination to an array indicie
+	arenaMark(&evalArena, &start);
 
-int xyToIndex(int x, int y) {
-	int i, j;
+	baseChains = arenaAlloc(&evalArena, sizeof(chain_state));
+	moveChains = arenaAlloc(&evalArena, sizeof(chain_state));
 
-	if (x == boardWidth)
-		i = x - 1;
-	else
-		i = x;
+	findChains(gameBoard, baseChains);
 
-	if (y == boardHeight)
-		j = y - 1;
-	else
-		j = y;
+	for (i = 0; i < possibleMovesFound; i++) {
+		arenaMark(&evalArena, &mark);
 
-	return j * boardWidth + i;
-}
+		copyBoard(gameBoard, board);
+		runPackedMove(me, possibleMoves[i], board);
 
-// A function to generate a list of all legal moves
+		copyChains(baseChains, moveChains);
+		updateChains(board, moveChains, possibleMoves[i]);
 
-void generateMoveList() {
-	// First, we'll figure out the horizontal moves that are possible
+		e = evaluateBoard(board, possibleMoves[i], moveChains);
 
-	int x, y, i, j;
-	int start, end;
-	move *temp;
+		m->moves[i] = possibleMoves[i];
+		m->winners[i] = e->winner;
+		boardFeatures(e, &m->features[i * FEATURE_COUNT]);
 
-	for (y = 0; y < boardHeight; y++) {
-		end = -1;
-		
-		while (end < boardWidth) {
-			start = -1;		
+		arenaRewind(&evalArena, &mark);
+	}
 
-			// First, find the first place where we can start a line
-			for (x = end + 1; x < boardWidth; x++) {
-				if ((gameBoard[xyToIndex(x, y)] & TOP_LINE) == 0) {
-					start = x;
-					break;
-				}
-			}
+	arenaRewind(&evalArena, &start);
+}
 
-			if (start == -1)
-				break;	// No free lines on this line
+// Find the row of a feature matrix each genome would play, the same as selectMove would give
+// that genome except ties go to the first move instead of a random one. Big batches of genomes
+// are split between the pool's threads
 
-			// Now that we know where to start, we'll find where to end
+void chooseForGenomes(feature_matrix *m, dna *genomes, int count, int *choices) {
+	genome_work work;
+	int threads;
 
-			end = boardWidth;	// So if we don't find lines, we have a good endpoint
+	threads = poolThreads();
 
-			for (x = start; x < boardWidth; x++) {
-				if (gameBoard[xyToIndex(x, y)] & TOP_LINE) {
-					// We found a place with a line! Stop just before it
-					end = x;
-					break;
-				}
-			}
+	if ((count + GENOME_BLOCK - 1) / GENOME_BLOCK < SPLIT_MIN_BLOCKS)
+		threads = 1;
 
-			// Now that we've got that, we create the list of possible lines
+	work.matrix = m;
+	work.genomes = genomes;
+	work.count = count;
+	work.choices = choices;
+	work.threads = threads;
 
-			for (i = start; i < end; i++) {
-				for (j = i + 1; j <= end; j++) {
-					addPossibleMove(i, y, j, y);
-				}
-			}
-		}
-	}
-	
-	// We have to handle the last line specially, because we have to check for BOTTOM_LINE, not TOP
+	if (threads > 1)
+		poolRun(chooseGenomeBlocks, &work, threads);
+	else
+		chooseGenomeBlocks(0, &work);
+}
 
-	end = -1;
+// Choose moves for every threads'th block of GENOME_BLOCK genomes. The block's genes are turned
+// on their side first, so scoring a row is FEATURE_COUNT steps that each run across the block
+// and the compiler can do them with vector instructions. Wider blocks run out of registers
+// without AVX. The rows are read once per block, and a position's matrix is small enough that
+// they stay in the cache between blocks
 
-	y = boardHeight - 1;
+void chooseGenomeBlocks(int thread, void *arg) {
+	genome_work *work = (genome_work *) arg;
+	feature_matrix *m = work->matrix;
+	double genes[FEATURE_COUNT][GENOME_BLOCK];
+	double scores[GENOME_BLOCK];
+	double best[GENOME_BLOCK];
+	int bestRow[GENOME_BLOCK];
+	int first, size, better, i, f, g;
 
-	while (end < boardWidth) {
-		start = -1;
+	for (first = thread * GENOME_BLOCK; first < work->count; first += work->threads * GENOME_BLOCK) {
+		size = work->count - first;
 
-		// First, find the first place where we can start a line
-		for (x = end + 1; x < boardWidth; x++) {
-			if ((gameBoard[xyToIndex(x, y)] & BOTTOM_LINE) == 0) {
-				start = x;
-				break;
-			}
-		}
-		
-		if (start == -1)
-			break;	// No free lines on this line
+		if (size > GENOME_BLOCK)
+			size = GENOME_BLOCK;
 
-		// Now that we know where to start, we'll find where to end
+		// Genes go in sideways, a short block is padded with genomes that weigh nothing
 
-		end = boardWidth;	// So if we don't find lines, we have a good endpoint
+		for (f = 0; f < FEATURE_COUNT; f++) {
+			for (g = 0; g < GENOME_BLOCK; g++)
+				genes[f][g] = (g < size) ? work->genomes[first + g].genes[f] : 0.0;
+		}
 
-		for (x = start; x < boardWidth; x++) {
-			if (gameBoard[xyToIndex(x, y)] & BOTTOM_LINE) {
-				// We found a place with a line! Stop just before it
-				end = x;
-				break;
-			}
+		for (g = 0; g < GENOME_BLOCK; g++) {
+			best[g] = -7.0;		// Lower than the lowest possible score
+			bestRow[g] = 0;
 		}
 
-		// Now that we've got that, we create the list of possible lines
+		for (i = 0; i < m->count; i++) {
+			scoreGenomeBlock(m, i, genes, scores);
 
-		for (i = start; i < end; i++) {
-			for (j = i + 1; j <= end; j++) {
-				addPossibleMove(i, boardHeight, j, boardHeight);
+			for (g = 0; g < GENOME_BLOCK; g++) {
+				better = scores[g] > best[g];	// No branch, so the compiler can keep this in vectors too
+				best[g] = better ? scores[g] : best[g];
+				bestRow[g] = better ? i : bestRow[g];
 			}
 		}
-	}
 
-	// Now, the same thing, only for virticle lines
-
-	for (x = 0; x < boardWidth; x++) {
-		end = -1;
-		
-		while (end < boardHeight) {
-			start = -1;
+		for (g = 0; g < size; g++)
+			work->choices[first + g] = bestRow[g];
+	}
+}
 
-			// First, find the first place where we can start a line
-			for (y = end + 1; y < boardHeight; y++) {
-				if ((gameBoard[xyToIndex(x, y)] & LEFT_LINE) == 0) {
-					start = y;
-					break;
-				}
-			}
-			
-			if (start == -1)
-				break;	// No free lines on this line
+// Score one row of a feature matrix for a block of genomes whose genes are on their side.
+// Summed in the same order as scoreEvaluation, so the scores are the same to the last bit
 
-			// Now that we know where to start, we'll find where to end
+void scoreGenomeBlock(feature_matrix *m, int i, double genes[FEATURE_COUNT][GENOME_BLOCK], double *scores) {
+	double *row, x;
+	int f, g;
 
-			end = boardHeight;	// So if we don't find lines, we have a good endpoint
+	if (m->winners[i] != NO_WINNER_YET) {
+		// The same for every genome, see scoreEvaluation
 
-			for (y = start; y < boardHeight; y++) {
-				if (gameBoard[xyToIndex(x, y)] & LEFT_LINE) {
-					// We found a place with a line! Stop just before it
-					end = y;
-					break;
-				}
-			}
+		x = (m->winners[i] == m->player) ? 7.0 : -6.0;
 
-			// Now that we've got that, we create the list of possible lines
+		for (g = 0; g < GENOME_BLOCK; g++)
+			scores[g] = x;
 
-			for (i = start; i < end; i++) {
-				for (j = i + 1; j <= end; j++) {
-					addPossibleMove(x, i, x, j);
-				}
-			}
-		}
+		return;
 	}
-	
-	// We have to handle the last line specially, because we have to check for BOTTOM_LINE, not TOP
 
-	end = -1;
+	row = &m->features[i * FEATURE_COUNT];
+	x = row[FEATURE_MARGIN];
 
-	x = boardWidth - 1;
+	for (g = 0; g < GENOME_BLOCK; g++)
+		scores[g] = genes[FEATURE_MARGIN][g] * x;	// Margin first, as scoreEvaluation does
 
-	while (end < boardHeight) {
-		start = -1;
+	for (f = 0; f < FEATURE_COUNT; f++) {
+		if (f == FEATURE_MARGIN)
+			continue;
 
-		// First, find the first place where we can start a line
-		for (y = end + 1; y < boardHeight; y++) {
-			if ((gameBoard[xyToIndex(x, y)] & RIGHT_LINE) == 0) {
-				start = y;
-				break;
-			}
-		}
-		
-		if (start == -1)
-			break;	// No free lines on this line
+		x = row[f];
 
-		// Now that we know where to start, we'll find where to end
+		for (g = 0; g < GENOME_BLOCK; g++)
+			scores[g] += genes[f][g] * x;
+	}
+}
 
-		end = boardHeight;	// So if we don't find lines, we have a good endpoint
+// Choose a move with an alpha-beta search searchDepth plies deep. The moves to pick from are
+// in possibleMoves. With more than one thread this is Lazy SMP: every thread searches the same
+// root and they help each other through the shared table
+
+void searchMove() {
+	search_work work[MAX_PLAY_THREADS];
+	uint64_t deadline, salt, selectStart = 0;
+	uint32_t stop;
+	int threads, t, best;
+
+	if (TIMING)
+		selectStart = nanoTime();
+
+	pthread_once(&searchTableOnce, allocateSearchTable);
+
+	threads = poolThreads();
+	deadline = nanoTime() + (uint64_t) (*ourTime * 1000000000.0 / SEARCH_TIME_SHARE);
+	salt = mixBits(__atomic_add_fetch(&searchCount, 1, __ATOMIC_RELAXED));
+	stop = false;
+
+	for (t = 0; t < threads; t++) {
+		work[t].thread = t;
+		work[t].board = gameBoard;
+		work[t].width = boardWidth;
+		work[t].height = boardHeight;
+		work[t].player = me;
+		work[t].scoreOne = playerOneScore;
+		work[t].scoreTwo = playerTwoScore;
+		work[t].moves = possibleMoves;
+		work[t].count = possibleMovesFound;
+		work[t].deadline = deadline;
+		work[t].salt = salt;
+		work[t].stop = &stop;
+	}
 
-		for (y = start; y < boardHeight; y++) {
-			if (gameBoard[xyToIndex(x, y)] & RIGHT_LINE) {
-				// We found a place with a line! Stop just before it
-				end = y;
-				break;
-			}
-		}
+	poolRun(searchJob, work, threads);
 
-		// Now that we've got that, we create the list of possible lines
+	// The deepest search wins, ties go to the lowest thread so thread 0 has the final say
 
-		for (i = start; i < end; i++) {
-			for (j = i + 1; j <= end; j++) {
-				addPossibleMove(boardWidth, i, boardWidth, j);
-			}
-		}
+	best = 0;
+
+	for (t = 1; t < threads; t++) {
+		if (work[t].depthDone > work[best].depthDone)
+			best = t;
 	}
 
-	// That's it, the possible move list is full!
-}
+	if (DEBUG) {
+		for (t = 0; t < threads; t++)
+			printf("Thread %d searched %d plies, %llu nodes.\n", t, work[t].depthDone, (unsigned long long) work[t].nodes);
+	}
 
-// A function to count the number of lines around a given box
+	finalMove = work[best].bestMove;
 
-int countLines(int *board, int x, int y) {
-	switch(board[xyToIndex(x, y)] & FULL_BOX) {
-		case FULL_BOX:
-			return 4;
-		case THREE_OPEN_TOP:
-		case THREE_OPEN_RIGHT:
-		case THREE_OPEN_BOTTOM:
-		case THREE_OPEN_LEFT:
-			return 3;
-		case TWO_TOP_RIGHT:
-		case TWO_TOP_BOTTOM:
-		case TWO_TOP_LEFT:
-		case TWO_RIGHT_BOTTOM:
-		case TWO_RIGHT_LEFT:
-		case TWO_BOTTOM_TWO:
-			return 2;
-		case TOP_LINE:
-		case RIGHT_LINE:
-		case BOTTOM_LINE:
-		case LEFT_LINE:
-			return 1;
-		default:
-			return 0;
-	}
+	if (TIMING)
+		recordTiming(STAGE_SELECT, nanoTime() - selectStart);
 }
 
-// A function to turn a char column specifier into a number we can use
+// One thread's search. We deepen a ply at a time so there is always an answer when time runs
+// out. Odd threads run a ply ahead, so they fill the table for the others' next iteration
 
-int charToColumn(char c) {
-	return (((int) c) - ((int) 'A'));
-}
+void searchJob(int thread, void *arg) {
+	search_work *work = &((search_work *) arg)[thread];
+	int i, d, count, depthDone;
+	double alpha, value;
+	packed_move bestMove, iterationBest;
+	search_ply *root;
+	arena_mark mark;
 
-// A function to turn a column number we use into a column character that is expected as input
+	boardWidth = work->width;
+	boardHeight = work->height;
+	playerOneScore = work->scoreOne;
+	playerTwoScore = work->scoreTwo;
+	setPlayer(work->player);
 
-char columnToChar(int x) {
-	return (char) (x + (int) 'A');
-}
+	arenaMark(&evalArena, &mark);
 
-// A function to read the given input file and set up our situation
+	// Room for each ply, the root gets its own copy of the moves since we reorder them
 
-void readInputFile(const char *fileName) {
-	// Variables we'll need
+	for (i = 0; i <= searchDepth; i++) {
+		searchPlies[i].board = arenaAlloc(&evalArena, boardWidth * boardHeight * sizeof(int));
+		searchPlies[i].moves = arenaAlloc(&evalArena, maxPossibleMoves(boardWidth, boardHeight) * sizeof(packed_move));
+		searchPlies[i].keys = arenaAlloc(&evalArena, maxPossibleMoves(boardWidth, boardHeight) * sizeof(uint64_t));
+	}
 
-	FILE *inputFile = null;
+	if (historyScores == null) {
+		historyScores = malloc(HISTORY_SIZE * sizeof(int));
 
-	char buffer[80];
+		if (historyScores == null) {
+			printf("Unable to allocate the history table.\n");
+			exit(1);
+		}
+	}
 
-	char fromXChar, toXChar;
-	char fromYChar, toYChar;
+	memset(historyScores, 0, HISTORY_SIZE * sizeof(int));
+	memset(killerMoves, 0, sizeof(killerMoves));
 
-	int got;
+	root = &searchPlies[0];
+	count = work->count;
 
-	int x, y;
+	copyBoard(work->board, root->board);
+	memcpy(root->moves, work->moves, count * sizeof(packed_move));
 
-	// Open the input file
+	bestMove = root->moves[0];
+	depthDone = 0;
 
-	inputFile = fopen(fileName, "r");
+	searchNodes = 0;
+	searchStopped = false;
+	searchDeadline = work->deadline;
+	searchStop = (thread == 0) ? null : work->stop;
+	searchSalt = work->salt;
 
-	if (inputFile == null) {
-		printf("Unable to open input file: '%s'", fileName);
-		printf("Error number %d.\n", errno);
-		exit(1);
-	}
+	for (d = 1 + (thread & 1); d <= searchDepth; d++) {
+		orderMoves(root->board, root, count, 0, bestMove);
 
-	// Get the first line
+		alpha = -SEARCH_INFINITY;
+		iterationBest = NO_MOVE;
 
-	fgets(buffer, 80, inputFile);
+		for (i = 0; i < count; i++) {
+			copyBoard(root->board, searchPlies[1].board);
+			runPackedMove(me, root->moves[i], searchPlies[1].board);
 
-	got = sscanf(buffer, "%d %d %d", &me, &boardHeight, &boardWidth);	// Read in the first line
+			value = alphaBeta(1, d - 1, alpha, SEARCH_INFINITY, him, root->moves[i]);
 
-	if (got != 3) {
-		printf("Error reading in first line of input.\n");
-		exit(1);
-	}
+			if (searchStopped)
+				break;
 
-	if (DEBUG)
-		printf("I'm player %d, board is %dx%d.\n", me, boardWidth, boardHeight);
+			// Only a strictly better move replaces the best, so ties go to the one ordered first
 
-	// Now that we know the board size, we need to allocate the board
-	
-	gameBoard = malloc(boardWidth * boardHeight * sizeof(int));
-	memset(gameBoard, 0, boardWidth * boardHeight * sizeof(int));
+			if (value > alpha) {
+				alpha = value;
+				iterationBest = root->moves[i];
+			}
+		}
 
-	if (gameBoard == null) {
-		printf("Unable to allocate game board.\n");
-		exit(1);
+		if (searchStopped)
+			break;	// A part searched ply can't be trusted, keep the last whole one
+
+		bestMove = iterationBest;
+		depthDone = d;
 	}
 
-//	if (DEBUG) {	// This prints out any spaces that aren't 0 as they should be
-//		for (y = 0; y < boardHeight; y++) {
-//			for (x = 0; x < boardWidth; x++) {
-//				if (gameBoard[xyToIndex(x, y)] != 0)
-//					printf("%d, %d was %d\n", x, y, gameBoard[xyToIndex(x, y)]);
-//			}
-//		}
-//	}
+	if (thread == 0)
+		__atomic_store_n(work->stop, true, __ATOMIC_RELAXED);
 
-//	if (DEBUG)
-//		printBoard(gameBoard);
+	work->bestMove = bestMove;
+	work->depthDone = depthDone;
+	work->nodes = searchNodes;
 
-	// Get the second line
+	arenaRewind(&evalArena, &mark);
+}
 
-	fgets(buffer, 80, inputFile);
+// Search the position at ply, player to move. Scores are always for us, we take the highest
+// on our turns and they take the lowest on theirs
 
-	got = sscanf(buffer, "1 %d %lf", &playerOneScore, &playerOneTimeLeft);	// Read in player info
+double alphaBeta(int ply, int depth, double alpha, double beta, int player, packed_move lastMove) {
+	search_ply *p = &searchPlies[ply];
+	int *child;
+	int i, count, next, symmetry, tableDepth, bound;
+	double value, best, startAlpha, startBeta;
+	packed_move bestMove, tableMove;
+	uint64_t key;
 
-	if (got != 2) {
-		printf("Error reading in second line of input.\n");
-		exit(1);
-	}
+	searchNodes++;
 
-	if (DEBUG)
-		printf("Player 1 has %d points and %lf seconds.\n", playerOneScore, playerOneTimeLeft);
+	if (((searchNodes % SEARCH_CHECK_NODES) == 0) && ((nanoTime() > searchDeadline) ||
+				((searchStop != null) && __atomic_load_n(searchStop, __ATOMIC_RELAXED))))
+		searchStopped = true;
 
-	// Get the third line
+	if (searchStopped)
+		return 0.0;
 
-	fgets(buffer, 80, inputFile);
+	if (depth == 0)
+		return leafScore(p->board, lastMove);
 
-	got = sscanf(buffer, "2 %d %lf", &playerTwoScore, &playerTwoTimeLeft);
+	// The table might already know this position, or at least its best move
 
-	if (got != 2) {
-		printf("Error reading in third line of input.\n");
-		exit(1);
+	key = positionKey(p->board, player, &symmetry) ^ searchSalt;
+	tableMove = NO_MOVE;
+
+	if (probeTable(key, &tableDepth, &bound, &value, &tableMove)) {
+		if (tableMove != NO_MOVE)
+			tableMove = symmetryMoveBack(symmetry, tableMove);
+
+		if (tableDepth >= depth) {
+			if ((bound == TABLE_EXACT) || ((bound == TABLE_LOWER) && (value >= beta)) ||
+						((bound == TABLE_UPPER) && (value <= alpha)))
+				return value;
+		}
 	}
 
-	if (DEBUG)
-		printf("Player 2 has %d points and %lf seconds.\n", playerTwoScore, playerTwoTimeLeft);
+	count = listMoves(p->board, p->moves);
 
-	// Now get the rest of the lines
+	if (count == 0)
+		return leafScore(p->board, lastMove);	// The game is over
 
-	while (true) {
-		int player, from_y, to_y, from_x_num, to_x_num;
-		char from_x, to_x;
+	orderMoves(p->board, p, count, ply, tableMove);	// A move from a bad key just isn't in the list
 
-		if (!fgets(buffer, 80, inputFile)) {	// Get the next line
-			if (feof(inputFile)) {
-				break;
-			} else {
-				printf("Error reading line from the file: '%s'.\n", buffer);
-				printf("Error number %d.\n", ferror(inputFile));
-				exit(1);
-			}
-		}
+	child = searchPlies[ply + 1].board;
+	next = (player == PLAYER_ONE) ? PLAYER_TWO : PLAYER_ONE;
+	best = (player == me) ? -SEARCH_INFINITY : SEARCH_INFINITY;
+	bestMove = NO_MOVE;
+	startAlpha = alpha;
+	startBeta = beta;
 
-		buffer[7] = '\0';	// Cover up the newline
+	for (i = 0; i < count; i++) {
+		copyBoard(p->board, child);
+		runPackedMove(player, p->moves[i], child);
 
-		got = sscanf(buffer, "%d %c%d %c%d", &player, &from_x, &from_y, &to_x, &to_y);
+		value = alphaBeta(ply + 1, depth - 1, alpha, beta, next, p->moves[i]);
 
-		if (got != 5) {
+		if (player == me) {
+			if (value > best) {
+				best = value;
+				bestMove = p->moves[i];
+			}
+			if (best > alpha)
+				alpha = best;
+		} else {
+			if (value < best) {
+				best = value;
+				bestMove = p->moves[i];
+			}
+			if (best < beta)
+				beta = best;
+		}
+
+		if (alpha >= beta) {
+			if ((p->keys[i] >> (32 + ORDER_CLASS_SHIFT)) != ORDER_CAPTURE)
+				noteCutoff(ply, depth, p->moves[i]);	// Captures go first anyway
+
+			break;
+		}
+	}
+
+	if (searchStopped)
+		return best;	// Not worth remembering
+
+	if (best <= startAlpha)
+		bound = TABLE_UPPER;
+	else if (best >= startBeta)
+		bound = TABLE_LOWER;
+	else
+		bound = TABLE_EXACT;
+
+	storeTable(key, depth, bound, best, symmetryMove(symmetry, bestMove));
+
+	return best;
+}
+
+// Score a position at the end of the search for us. Boxes come first, the DNA breaks ties
+
+double leafScore(int *board, packed_move lastMove) {
+	boardEvaluation *e;
+	arena_mark mark;
+	int margin;
+	double score;
+
+	arenaMark(&evalArena, &mark);
+
+	e = evaluateBoard(board, lastMove, null);
+
+	if (me == PLAYER_ONE)
+		margin = e->playerOneOwned - e->playerTwoOwned;
+	else
+		margin = e->playerTwoOwned - e->playerOneOwned;
+
+	score = margin * SEARCH_BOX_VALUE + scoreEvaluation(e);
+
+	arenaRewind(&evalArena, &mark);	// Leaves add up fast, so we don't keep their evaluations
+
+	return score;
+}
+
+// Sort a move into ORDER_CAPTURE, ORDER_SAFE or ORDER_SACRIFICE by looking at the boxes along
+// it. Each of them gets one more side from the move
+
+int moveClass(int *board, packed_move theMove) {
+	int from_x, from_y, to_x, to_y, i, sides;
+	int result = ORDER_SAFE;
+
+	unpackMove(theMove, &from_x, &from_y, &to_x, &to_y);
+
+	if (from_x == to_x) {
+		for (i = from_y; i < to_y; i++) {
+			if (from_x != 0) {
+				sides = countLines(board, from_x - 1, i);
+
+				if (sides == 3)
+					return ORDER_CAPTURE;
+				if (sides == 2)
+					result = ORDER_SACRIFICE;
+			}
+
+			if (from_x != boardWidth) {
+				sides = countLines(board, from_x, i);
+
+				if (sides == 3)
+					return ORDER_CAPTURE;
+				if (sides == 2)
+					result = ORDER_SACRIFICE;
+			}
+		}
+	} else {
+		for (i = from_x; i < to_x; i++) {
+			if (from_y != 0) {
+				sides = countLines(board, i, from_y - 1);
+
+				if (sides == 3)
+					return ORDER_CAPTURE;
+				if (sides == 2)
+					result = ORDER_SACRIFICE;
+			}
+
+			if (from_y != boardHeight) {
+				sides = countLines(board, i, from_y);
+
+				if (sides == 3)
+					return ORDER_CAPTURE;
+				if (sides == 2)
+					result = ORDER_SACRIFICE;
+			}
+		}
+	}
+
+	return result;
+}
+
+// For qsort, puts the biggest ordering key first
+
+int compareKeys(const void *a, const void *b) {
+	uint64_t x = *((uint64_t *) a);
+	uint64_t y = *((uint64_t *) b);
+
+	if (x > y)
+		return -1;
+
+	if (x < y)
+		return 1;
+
+	return 0;
+}
+
+// Put a ply's moves in the order we want to try them: first, then captures, safe moves and
+// sacrifices, each led by the killers and then by history. Moves are all different, so putting
+// the move under the score makes the order the same every time
+
+void orderMoves(int *board, search_ply *p, int count, int ply, packed_move first) {
+	int i, history;
+	uint32_t score;
+	packed_move m;
+
+	for (i = 0; i < count; i++) {
+		m = p->moves[i];
+
+		if ((m == first) && (first != NO_MOVE)) {
+			score = ORDER_FIRST;
+		} else {
+			score = moveClass(board, m) << ORDER_CLASS_SHIFT;
+
+			if ((ply < MAX_SEARCH_DEPTH) && ((m == killerMoves[ply][0]) || (m == killerMoves[ply][1])))
+				score |= ORDER_KILLER;
+
+			history = historyScores[m];
+			score |= (history > ORDER_HISTORY_MAX) ? ORDER_HISTORY_MAX : history;
+		}
+
+		p->keys[i] = ((uint64_t) score << 32) | m;
+	}
+
+	qsort(p->keys, count, sizeof(uint64_t), compareKeys);
+
+	for (i = 0; i < count; i++)
+		p->moves[i] = (packed_move) (p->keys[i] & 0xFFFFFFFF);
+}
+
+// Make the transposition table, there's one for the whole process
+
+void allocateSearchTable() {
+	searchTable = calloc((size_t) 1 << TABLE_BITS, sizeof(table_entry));
+
+	if (searchTable == null) {
+		printf("Unable to allocate the transposition table.\n");
+		exit(1);
+	}
+}
+
+// Look a key up in the transposition table. Returns false if it isn't there
+
+int probeTable(uint64_t key, int *depth, int *bound, double *value, packed_move *theMove) {
+	table_entry *e = &searchTable[key & (((uint64_t) 1 << TABLE_BITS) - 1)];
+	uint64_t check, data;
+	uint32_t bits;
+	float f;
+
+	check = __atomic_load_n(&e->check, __ATOMIC_RELAXED);
+	data = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+
+	if ((check ^ data) != key)
+		return false;
+
+	bits = (uint32_t) data;
+	memcpy(&f, &bits, sizeof(f));
+
+	*value = f;
+	*depth = (data >> 32) & 0xFF;
+	*bound = (data >> 40) & 3;
+	*theMove = (packed_move) (data >> 42);
+
+	return true;
+}
+
+// Put a search result in the transposition table. The newest result always wins the spot
+
+void storeTable(uint64_t key, int depth, int bound, double value, packed_move theMove) {
+	table_entry *e = &searchTable[key & (((uint64_t) 1 << TABLE_BITS) - 1)];
+	uint64_t data;
+	uint32_t bits;
+	float f = (float) value;
+
+	memcpy(&bits, &f, sizeof(bits));
+
+	data = bits | ((uint64_t) depth << 32) | ((uint64_t) bound << 40) | ((uint64_t) theMove << 42);
+
+	__atomic_store_n(&e->check, key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&e->data, data, __ATOMIC_RELAXED);
+}
+
+// A move caused a cutoff, so try it sooner next time
+
+void noteCutoff(int ply, int depth, packed_move theMove) {
+	if (killerMoves[ply][0] != theMove) {
+		killerMoves[ply][1] = killerMoves[ply][0];
+		killerMoves[ply][0] = theMove;
+	}
+
+	if (historyScores[theMove] < ORDER_HISTORY_MAX)
+		historyScores[theMove] += depth * depth;
+}
+
+// Choose a move with Monte Carlo tree search. Each thread grows its own tree from the same
+// position with its own random stream, then the trees vote with their visit counts
+
+void mctsMove() {
+	mcts_work work[MAX_PLAY_THREADS];
+	uint32_t *visits;
+	uint64_t total, best, deadline, selectStart = 0;
+	int threadCount, i, t, bestIndex;
+
+	if (TIMING)
+		selectStart = nanoTime();
+
+	threadCount = poolThreads();
+	deadline = nanoTime() + (uint64_t) (*ourTime * 1000000000.0 / SEARCH_TIME_SHARE);
+
+	arenaReset(&evalArena);
+
+	visits = arenaAlloc(&evalArena, threadCount * possibleMovesFound * sizeof(uint32_t));
+
+	for (t = 0; t < threadCount; t++) {
+		work[t].thread = t;
+		work[t].seed = nextRandom(&moveRNG);	// Taken from our stream, so the same seed plays the same move
+		work[t].playouts = (mctsPlayouts + threadCount - 1) / threadCount;
+		work[t].deadline = deadline;
+		work[t].board = gameBoard;
+		work[t].width = boardWidth;
+		work[t].height = boardHeight;
+		work[t].player = me;
+		work[t].scoreOne = playerOneScore;
+		work[t].scoreTwo = playerTwoScore;
+		work[t].moves = possibleMoves;
+		work[t].count = possibleMovesFound;
+		work[t].visits = visits + t * possibleMovesFound;
+	}
+
+	poolRun(growTree, work, threadCount);
+
+	// The most visited move wins, ties go to the one generated first
+
+	best = 0;
+	bestIndex = 0;
+
+	for (i = 0; i < possibleMovesFound; i++) {
+		total = 0;
+
+		for (t = 0; t < threadCount; t++)
+			total += work[t].visits[i];
+
+		if (total > best) {
+			best = total;
+			bestIndex = i;
+		}
+	}
+
+	finalMove = possibleMoves[bestIndex];
+
+	if (TIMING)
+		recordTiming(STAGE_SELECT, nanoTime() - selectStart);
+}
+
+// Grow one MCTS tree and count the root visits for each move. Runs on a pool thread, so it
+// sets up the thread's copy of everything the rollouts use
+
+void growTree(int thread, void *arg) {
+	mcts_work *work = &((mcts_work *) arg)[thread];
+	mcts_node *root, *n, **path;
+	packed_move *moves;
+	rng_state r;
+	int *board, *scratch;
+	int i, played;
+
+	boardWidth = work->width;
+	boardHeight = work->height;
+	playerOneScore = work->scoreOne;
+	playerTwoScore = work->scoreTwo;
+	setPlayer(work->player);
+
+	seedRNG(&r, work->seed, work->thread);
+
+	arenaReset(&mctsArena);
+
+	board = arenaAlloc(&mctsArena, boardWidth * boardHeight * sizeof(int));
+	scratch = arenaAlloc(&mctsArena, boardWidth * boardHeight * sizeof(int));
+	path = arenaAlloc(&mctsArena, (edgeCount(boardWidth, boardHeight) + 1) * sizeof(mcts_node *));
+	moves = arenaAlloc(&mctsArena, maxPossibleMoves(boardWidth, boardHeight) * sizeof(packed_move));
+
+	// The root's moves are the ones we were given, so every tree lines up with them
+
+	root = newNode(NO_MOVE, him);
+	root->untried = arenaAlloc(&mctsArena, work->count * sizeof(packed_move));
+	root->untriedCount = work->count;
+	sortUntried(work->board, work->moves, work->count, root->untried, &r);
+
+	for (played = 0; played < work->playouts; played++) {
+		if (((played % MCTS_CHECK_PLAYOUTS) == 0) && (nanoTime() > work->deadline))
+			break;
+
+		copyBoard(work->board, board);
+		mctsPlayout(root, board, path, moves, &r, scratch);
+	}
+
+	for (i = 0; i < work->count; i++) {
+		work->visits[i] = 0;
+
+		for (n = root->children; n != null; n = n->sibling) {
+			if (n->move == work->moves[i]) {
+				work->visits[i] = n->visits;
+				break;
+			}
+		}
+	}
+
+	if (DEBUG && (work->thread == 0))
+		printf("MCTS thread 0 ran %d playouts.\n", played);
+
+	setPlayer(work->player);	// The rollouts moved it around
+}
+
+// How many threads to think with. The timing histograms aren't safe to share between threads
+
+int poolThreads() {
+	if (TIMING)
+		return 1;
+
+	return playThreads;
+}
+
+// Run job on threads threads and wait for them all. We are thread 0, the pool's workers are the
+// rest and are started the first time they're wanted. If another thread has the pool, say a
+// batch thread, we run every part ourselves one after the other, which gives the same answer
+
+void poolRun(pool_job job, void *arg, int threads) {
+	int t;
+
+	if ((threads == 1) || (pthread_mutex_trylock(&poolBusy) != 0)) {
+		for (t = 0; t < threads; t++)
+			job(t, arg);
+
+		return;
+	}
+
+	pthread_mutex_lock(&poolLock);
+
+	for (; poolSize < threads; poolSize++) {
+		pthread_t worker;
+
+		poolStarted[poolSize] = poolRound;
+
+		if (pthread_create(&worker, null, poolWorker, (void *) (intptr_t) poolSize) != 0) {
+			printf("Unable to start pool thread %d: error %d.\n", poolSize, errno);
+			exit(1);
+		}
+
+		pthread_detach(worker);
+	}
+
+	poolJob = job;
+	poolArg = arg;
+	poolWanted = threads;
+	poolPending = poolSize - 1;
+	poolRound++;
+
+	pthread_cond_broadcast(&poolWake);
+	pthread_mutex_unlock(&poolLock);
+
+	job(0, arg);
+
+	pthread_mutex_lock(&poolLock);
+
+	while (poolPending > 0)
+		pthread_cond_wait(&poolDone, &poolLock);
+
+	pthread_mutex_unlock(&poolLock);
+	pthread_mutex_unlock(&poolBusy);
+}
+
+// A pool thread. It sits out rounds that want fewer threads than it has, and never ends
+
+void *poolWorker(void *arg) {
+	int thread = (int) (intptr_t) arg;
+	uint32_t seen;
+	pool_job job;
+	void *jobArg;
+
+	pthread_mutex_lock(&poolLock);
+
+	seen = poolStarted[thread];
+
+	while (true) {
+		while (poolRound == seen)
+			pthread_cond_wait(&poolWake, &poolLock);
+
+		seen = poolRound;
+
+		if (thread < poolWanted) {
+			job = poolJob;
+			jobArg = poolArg;
+
+			pthread_mutex_unlock(&poolLock);
+			job(thread, jobArg);
+			pthread_mutex_lock(&poolLock);
+		}
+
+		if (--poolPending == 0)
+			pthread_cond_signal(&poolDone);
+	}
+
+	return null;
+}
+
+// One playout: walk down the tree by UCT, add a node, play the game out with the rollout
+// policy and tell every node on the way who won. moves is scratch room for a move list.
+// Returns the winner
+
+int mctsPlayout(mcts_node *root, int *board, mcts_node **path, packed_move *moves, rng_state *r, int *scratch) {
+	mcts_node *n, *child;
+	int depth, count, i, player, winner;
+
+	n = root;
+	path[0] = root;
+	depth = 1;
+
+	// Selection, down through nodes that have all their moves expanded
+
+	while (true) {
+		if (n->untriedCount == -1) {
+			// First time here, so list the moves
+
+			count = listMoves(board, moves);
+
+			n->untried = arenaAlloc(&mctsArena, count * sizeof(packed_move));
+			n->untriedCount = count;
+			sortUntried(board, moves, count, n->untried, r);
+		}
+
+		if ((n->untriedCount > 0) || (n->children == null))
+			break;
+
+		n = uctChild(n);
+		runPackedMove(n->player, n->move, board);
+		path[depth++] = n;
+	}
+
+	player = (n->player == PLAYER_ONE) ? PLAYER_TWO : PLAYER_ONE;	// Whoever moves next
+
+	// Expansion, one new child for the best untried move
+
+	if (n->untriedCount > 0) {
+		child = newNode(n->untried[--n->untriedCount], player);
+
+		child->sibling = n->children;
+		n->children = child;
+
+		runPackedMove(player, child->move, board);
+		path[depth++] = child;
+
+		n = child;
+		player = (player == PLAYER_ONE) ? PLAYER_TWO : PLAYER_ONE;
+	}
+
+	// Rollout to the end of the game
+
+	while ((count = listMoves(board, moves)) > 0) {
+		runPackedMove(player, rolloutMove(board, moves, count, player, r, scratch), board);
+		player = (player == PLAYER_ONE) ? PLAYER_TWO : PLAYER_ONE;
+	}
+
+	winner = boardWinner(board);
+
+	// Backpropagation
+
+	for (i = 0; i < depth; i++) {
+		path[i]->visits++;
+
+		if (winner == path[i]->player)
+			path[i]->wins += 1.0;
+		else if (winner == PLAYER_TIE)
+			path[i]->wins += 0.5;
+	}
+
+	return winner;
+}
+// Get a new tree node from the pool
+
+mcts_node *newNode(packed_move theMove, int player) {
+	mcts_node *n = arenaAlloc(&mctsArena, sizeof(mcts_node));
+
+	n->children = null;
+	n->sibling = null;
+	n->untried = null;
+	n->untriedCount = -1;
+	n->move = theMove;
+	n->player = player;
+	n->visits = 0;
+	n->wins = 0.0;
+
+	return n;
+}
+
+// Put a node's moves in the order we'll expand them, which is from the end: captures, then safe
+// moves, then sacrifices. Each kind is shuffled so we don't favour the top of the board
+
+void sortUntried(int *board, packed_move *moves, int count, packed_move *untried, rng_state *r) {
+	int c, i, j, first, used;
+	packed_move t;
+
+	used = 0;
+
+	for (c = ORDER_SACRIFICE; c <= ORDER_CAPTURE; c++) {
+		first = used;
+
+		for (i = 0; i < count; i++) {
+			if (moveClass(board, moves[i]) == c)
+				untried[used++] = moves[i];
+		}
+
+		for (i = used - 1; i > first; i--) {
+			j = first + randomInt(r, i - first + 1);
+
+			t = untried[i];
+			untried[i] = untried[j];
+			untried[j] = t;
+		}
+	}
+}
+
+// The child UCT likes best, trading how well a move has done against how little it's been tried
+
+mcts_node *uctChild(mcts_node *n) {
+	mcts_node *c, *best;
+	double value, bestValue, logVisits;
+
+	best = null;
+	bestValue = -1.0;
+	logVisits = log((double) n->visits);
+
+	for (c = n->children; c != null; c = c->sibling) {
+		value = c->wins / c->visits + MCTS_EXPLORATION * sqrt(logVisits / c->visits);
+
+		if (value > bestValue) {
+			bestValue = value;
+			best = c;
+		}
+	}
+
+	return best;
+}
+
+// The rollout policy: look at a few random moves and play the best for player. Captures beat
+// safe moves and safe moves beat sacrifices, the DNA picks between moves of the same kind
+
+packed_move rolloutMove(int *board, packed_move *moves, int count, int player, rng_state *r, int *scratch) {
+	packed_move m, best;
+	double score, bestScore;
+	arena_mark mark;
+	int i;
+
+	setPlayer(player);	// scoreEvaluation scores for me
+	arenaMark(&evalArena, &mark);
+
+	best = NO_MOVE;
+	bestScore = 0.0;
+
+	for (i = 0; i < MCTS_ROLLOUT_SAMPLES; i++) {
+		m = moves[randomInt(r, count)];
+
+		score = moveClass(board, m) * SEARCH_BOX_VALUE;
+
+		copyBoard(board, scratch);
+		runPackedMove(player, m, scratch);
+
+		score += scoreEvaluation(evaluateBoard(scratch, m, null));
+
+		if ((best == NO_MOVE) || (score > bestScore)) {
+			best = m;
+			bestScore = score;
+		}
+	}
+
+	arenaRewind(&evalArena, &mark);
+
+	return best;
+}
+
+// Who won a finished board, PLAYER_ONE, PLAYER_TWO or PLAYER_TIE
+
+int boardWinner(int *board) {
+	int i, one, two;
+
+	one = 0;
+	two = 0;
+
+	for (i = 0; i < boardWidth * boardHeight; i++) {
+		if (board[i] & OWNED_BY_PLAYER_ONE)
+			one++;
+		else if (board[i] & OWNED_BY_PLAYER_TWO)
+			two++;
+	}
+
+	if (one > two)
+		return PLAYER_ONE;
+
+	if (two > one)
+		return PLAYER_TWO;
+
+	return PLAYER_TIE;
+}
+
+// A function to copy a board to another
+
+void copyBoard(int *s, int *d) {
+	int i;
+
+	for (i = 0; i < boardWidth * boardHeight; i++)
+		d[i] = s[i];
+}
+
+// A function to turn an x, y combination to an array indicie
+
+int xyToIndex(int x, int y) {
+	int i, j;
+
+	if (x == boardWidth)
+		i = x - 1;
+	else
+		i = x;
+
+	if (y == boardHeight)
+		j = y - 1;
+	else
+		j = y;
+
+	return j * boardWidth + i;
+}
+
+// How many ways the board can be turned or flipped onto itself. Square boards can also be
+// turned a quarter, so they have 8, others only 4
+
+int symmetryCount() {
+	if (boardWidth == boardHeight)
+		return MAX_SYMMETRIES;
+
+	return MAX_SYMMETRIES / 2;
+}
+
+// Move a dot to where it ends up under a symmetry
+
+void symmetryPoint(int symmetry, int *x, int *y) {
+	int t;
+
+	if (symmetry & SYMMETRY_TRANSPOSE) {
+		t = *x;
+		*x = *y;
+		*y = t;
+	}
+
+	if (symmetry & SYMMETRY_FLIP_X)
+		*x = boardWidth - *x;
+
+	if (symmetry & SYMMETRY_FLIP_Y)
+		*y = boardHeight - *y;
+}
+
+// Undo symmetryPoint, the same steps in the other order
+
+void symmetryPointBack(int symmetry, int *x, int *y) {
+	int t;
+
+	if (symmetry & SYMMETRY_FLIP_Y)
+		*y = boardHeight - *y;
+
+	if (symmetry & SYMMETRY_FLIP_X)
+		*x = boardWidth - *x;
+
+	if (symmetry & SYMMETRY_TRANSPOSE) {
+		t = *x;
+		*x = *y;
+		*y = t;
+	}
+}
+
+// Swap a box's line bits around to match a symmetry, the owner bits stay put
+
+int symmetryLines(int symmetry, int c) {
+	int t;
+
+	if (symmetry & SYMMETRY_TRANSPOSE) {
+		t = c & ~FULL_BOX;
+
+		if (c & TOP_LINE)
+			t |= LEFT_LINE;
+		if (c & LEFT_LINE)
+			t |= TOP_LINE;
+		if (c & RIGHT_LINE)
+			t |= BOTTOM_LINE;
+		if (c & BOTTOM_LINE)
+			t |= RIGHT_LINE;
+
+		c = t;
+	}
+
+	if (symmetry & SYMMETRY_FLIP_X) {
+		t = c & ~(LEFT_LINE | RIGHT_LINE);
+
+		if (c & LEFT_LINE)
+			t |= RIGHT_LINE;
+		if (c & RIGHT_LINE)
+			t |= LEFT_LINE;
+
+		c = t;
+	}
+
+	if (symmetry & SYMMETRY_FLIP_Y) {
+		t = c & ~(TOP_LINE | BOTTOM_LINE);
+
+		if (c & TOP_LINE)
+			t |= BOTTOM_LINE;
+		if (c & BOTTOM_LINE)
+			t |= TOP_LINE;
+
+		c = t;
+	}
+
+	return c;
+}
+
+// Where a move on the board ends up under a symmetry
+
+packed_move symmetryMove(int symmetry, packed_move theMove) {
+	int from_x, from_y, to_x, to_y;
+
+	unpackMove(theMove, &from_x, &from_y, &to_x, &to_y);
+
+	symmetryPoint(symmetry, &from_x, &from_y);
+	symmetryPoint(symmetry, &to_x, &to_y);
+
+	// Flips can turn the line around, packMove wants it to run down or right
+
+	if ((from_x > to_x) || (from_y > to_y))
+		return packMove(to_x, to_y, from_x, from_y);
+
+	return packMove(from_x, from_y, to_x, to_y);
+}
+
+// Take a move made on a transformed board back to the real one
+
+packed_move symmetryMoveBack(int symmetry, packed_move theMove) {
+	int from_x, from_y, to_x, to_y;
+
+	unpackMove(theMove, &from_x, &from_y, &to_x, &to_y);
+
+	symmetryPointBack(symmetry, &from_x, &from_y);
+	symmetryPointBack(symmetry, &to_x, &to_y);
+
+	if ((from_x > to_x) || (from_y > to_y))
+		return packMove(to_x, to_y, from_x, from_y);
+
+	return packMove(from_x, from_y, to_x, to_y);
+}
+
+// Put the smallest of the board's symmetric copies (comparing box by box) in canon and return
+// the symmetry that makes it. Positions that are the same under some symmetry get the same canon,
+// and symmetryMoveBack turns a move on canon into one on board
+
+int canonicalBoard(int *board, int *canon) {
+	int candidate[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	int s, best, count, i, x, y, sx, sy, c;
+	int better;
+
+	copyBoard(board, canon);
+	best = 0;
+	count = symmetryCount();
+
+	for (s = 1; s < count; s++) {
+		better = false;
+
+		for (y = 0; y < boardHeight; y++) {
+			for (x = 0; x < boardWidth; x++) {
+				// The box that lands here is the one whose top left dot lands on our top left dot,
+				// after a flip that's the dot on its far side
+
+				sx = x;
+				sy = y;
+
+				if (s & SYMMETRY_FLIP_Y)
+					sy = boardHeight - 1 - sy;
+
+				if (s & SYMMETRY_FLIP_X)
+					sx = boardWidth - 1 - sx;
+
+				if (s & SYMMETRY_TRANSPOSE) {
+					c = sx;
+					sx = sy;
+					sy = c;
+				}
+
+				i = y * boardWidth + x;
+				c = symmetryLines(s, board[sy * boardWidth + sx]);
+
+				if (!better) {
+					if (c > canon[i])
+						break;	// Bigger, this one can't win
+
+					if (c < canon[i])
+						better = true;
+				}
+
+				candidate[i] = c;
+			}
+
+			if (x < boardWidth)
+				break;
+		}
+
+		if (better) {
+			copyBoard(candidate, canon);
+			best = s;
+		}
+	}
+
+	return best;
+}
+
+// A key for a position that is the same for every rotation and reflection of it, for caches and
+// tables to use. Collisions are possible but with 64 bits very unlikely. If symmetry isn't null
+// it gets the symmetry that took board to the canonical one, to map moves with
+
+uint64_t positionKey(int *board, int player, int *symmetry) {
+	int canon[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	uint64_t key;
+	int i, s;
+
+	s = canonicalBoard(board, canon);
+
+	if (symmetry != null)
+		*symmetry = s;
+
+	key = mixBits(((uint64_t) boardWidth << 16) | ((uint64_t) boardHeight << 8) | player);
+
+	for (i = 0; i < boardWidth * boardHeight; i++)
+		key = mixBits(key ^ canon[i]);
+
+	return key;
+}
+
+// Work out the chains and loops on a board from scratch. A chain is boxes with two or three sides
+// joined by the open lines between them. Two sided boxes have two open lines and three sided ones
+// have one, so every chain is a path or, if it closes up, a loop
+
+void findChains(int *board, chain_state *c) {
+	int i, sides;
+
+	memset(&c->counts, 0, sizeof(chain_summary));
+
+	for (i = 0; i < boardWidth * boardHeight; i++)
+		c->parent[i] = NOT_IN_CHAIN;
+
+	for (i = 0; i < boardWidth * boardHeight; i++) {
+		sides = __builtin_popcount(board[i] & FULL_BOX);
+
+		if ((sides == 2) || (sides == 3))
+			addChainBox(board, c, i % boardWidth, i / boardWidth);
+	}
+}
+
+// Put a box in the chains, joined to each neighbour that's already in one through an open line
+
+void addChainBox(int *board, chain_state *c, int x, int y) {
+	int i = y * boardWidth + x;
+
+	c->parent[i] = i;
+	c->boxes[i] = 1;
+	c->links[i] = 0;
+	c->ends[i] = (__builtin_popcount(board[i] & FULL_BOX) == 3) ? 1 : 0;
+
+	c->counts.chains++;
+	c->counts.chainBoxes++;
+	c->counts.capturable += c->ends[i];
+
+	if (c->counts.longest == 0)
+		c->counts.longest = 1;
+
+	if ((y != 0) && !(board[i] & TOP_LINE) && (c->parent[i - boardWidth] != NOT_IN_CHAIN))
+		joinChains(c, i, i - boardWidth);
+	if ((x != boardWidth - 1) && !(board[i] & RIGHT_LINE) && (c->parent[i + 1] != NOT_IN_CHAIN))
+		joinChains(c, i, i + 1);
+	if ((y != boardHeight - 1) && !(board[i] & BOTTOM_LINE) && (c->parent[i + boardWidth] != NOT_IN_CHAIN))
+		joinChains(c, i, i + boardWidth);
+	if ((x != 0) && !(board[i] & LEFT_LINE) && (c->parent[i - 1] != NOT_IN_CHAIN))
+		joinChains(c, i, i - 1);
+}
+
+// Find the root of a box's chain, halving the path on the way
+
+int chainRoot(chain_state *c, int i) {
+	while (c->parent[i] != i) {
+		c->parent[i] = c->parent[c->parent[i]];
+		i = c->parent[i];
+	}
+
+	return i;
+}
+
+// Two boxes in chains have an open line between them. Either it joins two chains or it closes a
+// loop. A loop's boxes have no open lines left over, so it never joins anything
+
+void joinChains(chain_state *c, int a, int b) {
+	chain_summary *s = &c->counts;
+	int t;
+
+	a = chainRoot(c, a);
+	b = chainRoot(c, b);
+
+	if (a == b) {
+		c->links[a]++;
+
+		if (c->links[a] == c->boxes[a]) {
+			s->chains--;
+			s->chainBoxes -= c->boxes[a];
+			s->loops++;
+			s->loopBoxes += c->boxes[a];
+
+			if (c->boxes[a] >= LONG_CHAIN)
+				s->longChains--;
+		}
+
+		return;
+	}
+
+	if (c->boxes[a] < c->boxes[b]) {	// The smaller chain goes under the bigger one
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	s->chains--;
+	s->longChains -= (c->boxes[a] >= LONG_CHAIN) + (c->boxes[b] >= LONG_CHAIN);
+
+	c->parent[b] = a;
+	c->boxes[a] += c->boxes[b];
+	c->links[a] += c->links[b] + 1;
+	c->ends[a] += c->ends[b];
+
+	s->longChains += (c->boxes[a] >= LONG_CHAIN);
+
+	if (c->boxes[a] > s->longest)
+		s->longest = c->boxes[a];
+}
+
+// Bring the chains up to date after theMove was run on board. Lines are only ever added, so a box
+// that gets its second side just joins the chains. A line on a box that's already in a chain can
+// split it, which union-find can't undo, so the chains it touched are taken apart and their boxes
+// put back one at a time. That only happens on sacrifices and captures
+
+void updateChains(int *board, chain_state *c, packed_move theMove) {
+	int touched[2 * MAX_BOARD_SIDE];
+	int members[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	int from_x, from_y, to_x, to_y, i, r, count, memberCount, sides, dropped;
+
+	unpackMove(theMove, &from_x, &from_y, &to_x, &to_y);
+
+	count = 0;
+
+	if (from_x == to_x) {
+		for (i = from_y; i < to_y; i++) {
+			if (from_x != 0)
+				touched[count++] = i * boardWidth + from_x - 1;
+			if (from_x != boardWidth)
+				touched[count++] = i * boardWidth + from_x;
+		}
+	} else {
+		for (i = from_x; i < to_x; i++) {
+			if (from_y != 0)
+				touched[count++] = (from_y - 1) * boardWidth + i;
+			if (from_y != boardHeight)
+				touched[count++] = from_y * boardWidth + i;
+		}
+	}
+
+	// Take apart every chain the move touched. Their roots get 0 boxes while we find their members,
+	// and we work out the longest chain again from the ones that are left
+
+	memberCount = 0;
+	dropped = false;
+
+	for (i = 0; i < count; i++) {
+		if (c->parent[touched[i]] == NOT_IN_CHAIN)
+			continue;
+
+		r = chainRoot(c, touched[i]);
+
+		if (c->boxes[r] != 0) {
+			dropChain(c, r);
+			dropped = true;
+		}
+	}
+
+	if (dropped) {
+		c->counts.longest = 0;
+
+		for (i = 0; i < boardWidth * boardHeight; i++) {
+			if (c->parent[i] == NOT_IN_CHAIN)
+				continue;
+
+			r = chainRoot(c, i);
+
+			if (c->boxes[r] == 0)
+				members[memberCount++] = i;
+			else if ((r == i) && (c->boxes[i] > c->counts.longest))
+				c->counts.longest = c->boxes[i];
+		}
+	}
+
+	for (i = 0; i < memberCount; i++)
+		c->parent[members[i]] = NOT_IN_CHAIN;
+
+	// Now put back whatever still has two or three sides, plus the boxes that just got their second
+
+	for (i = 0; i < memberCount; i++) {
+		sides = __builtin_popcount(board[members[i]] & FULL_BOX);
+
+		if ((sides == 2) || (sides == 3))
+			addChainBox(board, c, members[i] % boardWidth, members[i] / boardWidth);
+	}
+
+	for (i = 0; i < count; i++) {
+		if ((c->parent[touched[i]] == NOT_IN_CHAIN) && (__builtin_popcount(board[touched[i]] & FULL_BOX) == 2))
+			addChainBox(board, c, touched[i] % boardWidth, touched[i] / boardWidth);
+	}
+
+	if (DEBUG && !chainsMatch(board, c)) {
+		printf("The chains after move %05X don't match a fresh look at the board.\n", theMove);
+		exit(1);
+	}
+}
+
+// See if chains kept up move by move match the ones findChains gets from scratch. It's far
+// too slow to do every move, so only debug builds and bench's checks use it
+
+int chainsMatch(int *board, chain_state *c) {
+	chain_state fresh;
+
+	findChains(board, &fresh);
+
+	return memcmp(&fresh.counts, &c->counts, sizeof(chain_summary)) == 0;
+}
+
+// Take a chain out of the counts and mark its root with 0 boxes, for updateChains
+
+void dropChain(chain_state *c, int root) {
+	chain_summary *s = &c->counts;
+
+	if (c->links[root] == c->boxes[root]) {
+		s->loops--;
+		s->loopBoxes -= c->boxes[root];
+	} else {
+		s->chains--;
+		s->chainBoxes -= c->boxes[root];
+
+		if (c->boxes[root] >= LONG_CHAIN)
+			s->longChains--;
+	}
+
+	s->capturable -= c->ends[root];
+	c->boxes[root] = 0;
+}
+
+// Run a move and keep the board's chains up to date with it
+
+void runChainMove(int player, packed_move theMove, int *board, chain_state *c) {
+	runPackedMove(player, theMove, board);
+	updateChains(board, c, theMove);
+}
+
+// Copy the chains for one board to another, like copyBoard
+
+void copyChains(chain_state *s, chain_state *d) {
+	int n = boardWidth * boardHeight;
+
+	d->counts = s->counts;
+
+	memcpy(d->parent, s->parent, n * sizeof(int));
+	memcpy(d->boxes, s->boxes, n * sizeof(int));
+	memcpy(d->links, s->links, n * sizeof(int));
+	memcpy(d->ends, s->ends, n * sizeof(int));
+}
+
+// Empty the possible move list
+
+void clearPossibleMoves() {
+	possibleMovesFound = 0;
+}
+
+// The most moves there can be on a board this size, which is when no lines are drawn.
+// A row or column n segments long has n (n + 1) / 2 moves on it
+
+int maxPossibleMoves(int width, int height) {
+	return (height + 1) * (width * (width + 1) / 2) + (width + 1) * (height * (height + 1) / 2);
+}
+
+// Make sure the possible move list has room for every move on the current board
+
+void reservePossibleMoves() {
+	int needed = maxPossibleMoves(boardWidth, boardHeight);
+
+	if (needed <= possibleMovesRoom)
+		return;
+
+	possibleMoves = realloc(possibleMoves, needed * sizeof(packed_move));
+	possibleScores = realloc(possibleScores, needed * sizeof(double));
+
+	if ((possibleMoves == null) || (possibleScores == null)) {
+		printf("Unable to allocate room for %d possible moves.\n", needed);
+		exit(1);
+	}
+
+	possibleMovesRoom = needed;
+}
+
+// Give back the possible move list and the evaluation arena, for a thread that is done
+
+void freeThreadMemory() {
+	free(possibleMoves);
+	free(possibleScores);
+
+	possibleMoves = null;
+	possibleScores = null;
+	possibleMovesRoom = 0;
+	possibleMovesFound = 0;
+
+	free(historyScores);
+	historyScores = null;
+
+	arenaFree(&evalArena);
+	arenaFree(&mctsArena);
+}
+
+// A function to generate a list of all legal moves on the game board
+
+void generateMoveList() {
+	reservePossibleMoves();
+
+	possibleMovesFound = listMoves(gameBoard, possibleMoves);
+}
+
+// Put every legal move on a board in moves, which needs room for maxPossibleMoves, and return how many
+// there are. Each row and column is walked once to find
+// its runs of open segments, then every line inside each run is added
+
+int listMoves(int *board, packed_move *moves) {
+	// First, we'll figure out the horizontal moves that are possible
+
+	int x, y, i, j;
+	int start, end;
+	int count = 0;
+
+	for (y = 0; y < boardHeight; y++) {
+		end = -1;
+		
+		while (end < boardWidth) {
+			start = -1;		
+
+			// First, find the first place where we can start a line
+			for (x = end + 1; x < boardWidth; x++) {
+				if ((board[xyToIndex(x, y)] & TOP_LINE) == 0) {
+					start = x;
+					break;
+				}
+			}
+
+			if (start == -1)
+				break;	// No free lines on this line
+
+			// Now that we know where to start, we'll find where to end
+
+			end = boardWidth;	// So if we don't find lines, we have a good endpoint
+
+			for (x = start; x < boardWidth; x++) {
+				if (board[xyToIndex(x, y)] & TOP_LINE) {
+					// We found a place with a line! Stop just before it
+					end = x;
+					break;
+				}
+			}
+
+			// Now that we've got that, we create the list of possible lines
+
+			for (i = start; i < end; i++) {
+				for (j = i + 1; j <= end; j++) {
+					moves[count++] = packMove(i, y, j, y);
+				}
+			}
+		}
+	}
+	
+	// We have to handle the last line specially, because we have to check for BOTTOM_LINE, not TOP
+
+	end = -1;
+
+	y = boardHeight - 1;
+
+	while (end < boardWidth) {
+		start = -1;
+
+		// First, find the first place where we can start a line
+		for (x = end + 1; x < boardWidth; x++) {
+			if ((board[xyToIndex(x, y)] & BOTTOM_LINE) == 0) {
+				start = x;
+				break;
+			}
+		}
+		
+		if (start == -1)
+			break;	// No free lines on this line
+
+		// Now that we know where to start, we'll find where to end
+
+		end = boardWidth;	// So if we don't find lines, we have a good endpoint
+
+		for (x = start; x < boardWidth; x++) {
+			if (board[xyToIndex(x, y)] & BOTTOM_LINE) {
+				// We found a place with a line! Stop just before it
+				end = x;
+				break;
+			}
+		}
+
+		// Now that we've got that, we create the list of possible lines
+
+		for (i = start; i < end; i++) {
+			for (j = i + 1; j <= end; j++) {
+				moves[count++] = packMove(i, boardHeight, j, boardHeight);
+			}
+		}
+	}
+
+	// Now, the same thing, only for virticle lines
+
+	for (x = 0; x < boardWidth; x++) {
+		end = -1;
+		
+		while (end < boardHeight) {
+			start = -1;
+
+			// First, find the first place where we can start a line
+			for (y = end + 1; y < boardHeight; y++) {
+				if ((board[xyToIndex(x, y)] & LEFT_LINE) == 0) {
+					start = y;
+					break;
+				}
+			}
+			
+			if (start == -1)
+				break;	// No free lines on this line
+
+			// Now that we know where to start, we'll find where to end
+
+			end = boardHeight;	// So if we don't find lines, we have a good endpoint
+
+			for (y = start; y < boardHeight; y++) {
+				if (board[xyToIndex(x, y)] & LEFT_LINE) {
+					// We found a place with a line! Stop just before it
+					end = y;
+					break;
+				}
+			}
+
+			// Now that we've got that, we create the list of possible lines
+
+			for (i = start; i < end; i++) {
+				for (j = i + 1; j <= end; j++) {
+					moves[count++] = packMove(x, i, x, j);
+				}
+			}
+		}
+	}
+	
+	// We have to handle the last line specially, because we have to check for BOTTOM_LINE, not TOP
+
+	end = -1;
+
+	x = boardWidth - 1;
+
+	while (end < boardHeight) {
+		start = -1;
+
+		// First, find the first place where we can start a line
+		for (y = end + 1; y < boardHeight; y++) {
+			if ((board[xyToIndex(x, y)] & RIGHT_LINE) == 0) {
+				start = y;
+				break;
+			}
+		}
+		
+		if (start == -1)
+			break;	// No free lines on this line
+
+		// Now that we know where to start, we'll find where to end
+
+		end = boardHeight;	// So if we don't find lines, we have a good endpoint
+
+		for (y = start; y < boardHeight; y++) {
+			if (board[xyToIndex(x, y)] & RIGHT_LINE) {
+				// We found a place with a line! Stop just before it
+				end = y;
+				break;
+			}
+		}
+
+		// Now that we've got that, we create the list of possible lines
+
+		for (i = start; i < end; i++) {
+			for (j = i + 1; j <= end; j++) {
+				moves[count++] = packMove(boardWidth, i, boardWidth, j);
+			}
+		}
+	}
+
+	// That's it, the move list is full!
+
+	return count;
+}
+
+// A function to count the number of lines around a given box
+
+int countLines(int *board, int x, int y) {
+	switch(board[xyToIndex(x, y)] & FULL_BOX) {
+		case FULL_BOX:
+			return 4;
+		case THREE_OPEN_TOP:
+		case THREE_OPEN_RIGHT:
+		case THREE_OPEN_BOTTOM:
+		case THREE_OPEN_LEFT:
+			return 3;
+		case TWO_TOP_RIGHT:
+		case TWO_TOP_BOTTOM:
+		case TWO_TOP_LEFT:
+		case TWO_RIGHT_BOTTOM:
+		case TWO_RIGHT_LEFT:
+		case TWO_BOTTOM_TWO:
+			return 2;
+		case TOP_LINE:
+		case RIGHT_LINE:
+		case BOTTOM_LINE:
+		case LEFT_LINE:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+// A function to turn a char column specifier into a number we can use. Columns go A to Z, then a to z
+
+int charToColumn(char c) {
+	if ((c >= 'a') && (c <= 'z'))
+		return (((int) c) - ((int) 'a')) + 26;
+
+	return (((int) c) - ((int) 'A'));
+}
+
+// A function to turn a column number we use into a column character that is expected as input
+
+char columnToChar(int x) {
+	if (x >= 26)
+		return (char) (x - 26 + (int) 'a');
+
+	return (char) (x + (int) 'A');
+}
+
+// A function to read the given input file and set up our situation
+
+void readInputFile(const char *fileName) {
+	FILE *inputFile = null;
+
+	// Open the input file
+
+	inputFile = fopen(fileName, "r");
+
+	if (inputFile == null) {
+		printf("Unable to open input file: '%s'", fileName);
+		printf("Error number %d.\n", errno);
+		exit(1);
+	}
+
+	// The board has room for any size, we don't know the size until we read it
+	
+	gameBoard = malloc(MAX_BOARD_SIDE * MAX_BOARD_SIDE * sizeof(int));
+
+	if (gameBoard == null) {
+		printf("Unable to allocate game board.\n");
+		exit(1);
+	}
+
+	if (!readPosition(inputFile, fileName)) {
+		printf("The input file '%s' is empty.\n", fileName);
+		exit(1);
+	}
+
+	// That takes care of all input, so close the file.
+
+	fclose(inputFile);
+}
+
+// Read one position in the input file format into gameBoard and the other globals. It ends at the
+// end of the file or a BATCH_SEPARATOR line. Returns false if the file ended before the position started
+
+int readPosition(FILE *inputFile, const char *fileName) {
+	// Variables we'll need
+
+	char buffer[80];
+
+	int got;
+
+	// Get the first line
+
+	if (fgets(buffer, 80, inputFile) == null)
+		return false;
+
+	got = sscanf(buffer, "%d %d %d", &me, &boardHeight, &boardWidth);	// Read in the first line
+
+	if (got != 3) {
+		printf("Error reading in first line of input.\n");
+		exit(1);
+	}
+
+	if ((boardWidth < MIN_BOARD_SIDE) || (boardWidth > MAX_BOARD_SIDE) || (boardHeight < MIN_BOARD_SIDE) || (boardHeight > MAX_BOARD_SIDE)) {
+		printf("We can't play on a %dx%d board.\n", boardWidth, boardHeight);
+		exit(1);
+	}
+
+	if (DEBUG)
+		printf("I'm player %d, board is %dx%d.\n", me, boardWidth, boardHeight);
+
+	// Now that we know the board size, we can clear the board
+	
+	memset(gameBoard, 0, boardWidth * boardHeight * sizeof(int));
+
+//	if (DEBUG) {	// This prints out any spaces that aren't 0 as they should be
+//		for (y = 0; y < boardHeight; y++) {
+//			for (x = 0; x < boardWidth; x++) {
+//				if (gameBoard[xyToIndex(x, y)] != 0)
+//					printf("%d, %d was %d\n", x, y, gameBoard[xyToIndex(x, y)]);
+//			}
+//		}
+//	}
+
+//	if (DEBUG)
+//		printBoard(gameBoard);
+
+	// Get the second line
+
+	fgets(buffer, 80, inputFile);
+
+	got = sscanf(buffer, "1 %d %lf", &playerOneScore, &playerOneTimeLeft);	// Read in player info
+
+	if (got != 2) {
+		printf("Error reading in second line of input.\n");
+		exit(1);
+	}
+
+	if (DEBUG)
+		printf("Player 1 has %d points and %lf seconds.\n", playerOneScore, playerOneTimeLeft);
+
+	// Get the third line
+
+	fgets(buffer, 80, inputFile);
+
+	got = sscanf(buffer, "2 %d %lf", &playerTwoScore, &playerTwoTimeLeft);
+
+	if (got != 2) {
+		printf("Error reading in third line of input.\n");
+		exit(1);
+	}
+
+	if (DEBUG)
+		printf("Player 2 has %d points and %lf seconds.\n", playerTwoScore, playerTwoTimeLeft);
+
+	// Now get the rest of the lines
+
+	while (true) {
+		int player, from_y, to_y, from_x_num, to_x_num;
+		char from_x, to_x;
+
+		if (!fgets(buffer, 80, inputFile)) {	// Get the next line
+			if (feof(inputFile)) {
+				break;
+			} else {
+				printf("Error reading line from '%s': '%s'.\n", fileName, buffer);
+				printf("Error number %d.\n", ferror(inputFile));
+				exit(1);
+			}
+		}
+
+		if (strncmp(buffer, BATCH_SEPARATOR, strlen(BATCH_SEPARATOR)) == 0)
+			break;	// That's the end of this position in a batch
+
+		buffer[strcspn(buffer, "\r\n")] = '\0';	// Cover up the newline
+
+		got = sscanf(buffer, "%d %c%d %c%d", &player, &from_x, &from_y, &to_x, &to_y);
+
+		if (got != 5) {
 			printf("Error reading line from the file: '%s'.\n", buffer);
 			printf("Only parsed out %d things.\n", got);
 			exit(1);
 		}
 
-		from_x_num = charToColumn(from_x);
-		to_x_num = charToColumn(to_x);
-		from_y = from_y - 1;
-		to_y = to_y - 1;
+		from_x_num = charToColumn(from_x);
+		to_x_num = charToColumn(to_x);
+		from_y = from_y - 1;
+		to_y = to_y - 1;
+
+		if (DEBUG) {
+			printf("Player %d made a move from %d, %d to %d, %d.\n", player, from_x_num, from_y, to_x_num, to_y);
+		}
+
+		runMove(player, from_x_num, from_y, to_x_num, to_y, false, gameBoard);
+//		printBoard();
+	}
+
+	if (DEBUG) {
+		boardEvaluation *temp;
+		chain_state *chains;
+		chain_summary *summary;
+		
+		printBoard(gameBoard);	// Show the board
+		
+		chains = arenaAlloc(&evalArena, sizeof(chain_state));
+		findChains(gameBoard, chains);
+		summary = &chains->counts;
+
+		temp = evaluateBoard(gameBoard, NO_MOVE, chains);	// Figure out the counts
+
+		printf("Boxes with no lines:     %d\n", temp->noSides);		// Print out the counts
+		printf("Boxes with one line:     %d\n", temp->oneSides);
+		printf("Boxes with two lines:    %d\n", temp->twoSides);
+		printf("Boxes with three lines:  %d\n", temp->threeSides);
+		printf("Boxes owned by player 0: %d\n", temp->playerOtherOwned);
+		printf("Boxes owned by player 1: %d\n", temp->playerOneOwned);
+		printf("Boxes owned by player 2: %d\n", temp->playerTwoOwned);
+		printf("Chains:                  %d (%d boxes, %d long, longest %d)\n", summary->chains, summary->chainBoxes,
+					summary->longChains, summary->longest);
+		printf("Loops:                   %d (%d boxes)\n", summary->loops, summary->loopBoxes);
+		printf("Boxes free to take:      %d\n", summary->capturable);
+		printf("Winner is: ");
+
+		if (temp->winner == PLAYER_ONE)
+			printf("Player 1\n");
+		else if (temp->winner == PLAYER_TWO)
+			printf("Player 2\n");
+		else if (temp->winner == PLAYER_TIE)
+			printf("Game was a tie\n");
+		else if (temp->winner == NO_WINNER_YET)
+			printf("None yet\n");
+		else {
+			printf("Unknown winner for board: %d\n", temp->winner);
+			exit(1);
+		}
+		
+		printf("\n");
+
+	}
+
+	// Set some quick stuff up
+
+	setPlayer(me);
+
+	return true;
+}
+
+// Set up the globals that say who we are playing for
+
+void setPlayer(int player) {
+	me = player;
+
+	if (me == PLAYER_ONE) {
+		him = PLAYER_TWO;
+		ourScore = &playerOneScore;
+		ourTime = &playerOneTimeLeft;
+		hisScore = &playerTwoScore;
+		hisTime = &playerTwoTimeLeft;
+	} else {
+		him = PLAYER_ONE;
+		hisScore = &playerOneScore;
+		hisTime = &playerOneTimeLeft;
+		ourScore = &playerTwoScore;
+		ourTime = &playerTwoTimeLeft;
+	}
+}
+
+// A function make a move on the game board
+
+void runMove(int player, int from_x, int from_y, int to_x, int to_y, int test_only, int *board) {
+	// This function makes a move on the board
+
+	int x, y, i;
+
+	// First, draw the new line
+
+	if (from_x == to_x) {
+		// It's a virticle line
+
+		x = from_x;
+
+		for (i = from_y; i < to_y; i++) {
+			// Mark the left line if needed
+			if (x != boardWidth)
+				board[xyToIndex(x,i)] = board[xyToIndex(x, i)] | LEFT_LINE;
+			// Mark the right line if needed
+			if (x != 0)
+				board[xyToIndex(x - 1, i)] = board[xyToIndex(x - 1, i)] | RIGHT_LINE;
+		}
+	} else {
+		// It's a horizontal line
+
+		y = from_y;
+
+		for (i = from_x; i < to_x; i++) {
+			// Mark the top line if needed
+			if (y != boardHeight)
+				board[xyToIndex(i, y)] = board[xyToIndex(i, y)] | TOP_LINE;
+			// Mark the bottom line if needed
+			if (y != 0)
+				board[xyToIndex(i, y - 1)] = board[xyToIndex(i, y - 1)] | BOTTOM_LINE;
+		}
+	}
+
+	// Now mark any new boxes with the owner. Only the boxes on either side of the new line can have been finished
+
+	if (from_x == to_x) {
+		for (i = from_y; i < to_y; i++) {
+			if (from_x != 0)
+				claimBox(player, from_x - 1, i, test_only, board);
+			if (from_x != boardWidth)
+				claimBox(player, from_x, i, test_only, board);
+		}
+	} else {
+		for (i = from_x; i < to_x; i++) {
+			if (from_y != 0)
+				claimBox(player, i, from_y - 1, test_only, board);
+			if (from_y != boardHeight)
+				claimBox(player, i, from_y, test_only, board);
+		}
+	}
+}
+
+// If a box has all four sides and nobody owns it yet, it belongs to player
+
+void claimBox(int player, int x, int y, int test_only, int *board) {
+	int c, bit;
+
+	c = board[xyToIndex(x, y)];
+
+	if (((c & FULL_BOX) != FULL_BOX) || ((c & OWNER_MASK) != 0))
+		return;
+
+	// It's a new box! Mark it as the correct player
+
+	switch(player) {
+		case PLAYER_ONE:
+			bit = OWNED_BY_PLAYER_ONE;
+			break;
+		case PLAYER_TWO:
+			bit = OWNED_BY_PLAYER_TWO;
+			break;
+		case PLAYER_OTHER:
+			bit = OWNED_BY_OTHER;
+			break;
+		default:
+			printf("ERROR: Got bad player: %d\n", player);
+			exit(1);
+	}
+
+	if (test_only == false) {
+		board[xyToIndex(x, y)] = c | bit;	// Mark the owner
+	}
+}
+
+// A function to evalue a gameboard. chains can be the board's chains if the caller keeps them,
+// otherwise they're worked out here, but only if the DNA cares
+
+boardEvaluation *evaluateBoard(int *board, packed_move lastMove, chain_state *chains) {
+	// Variables
+	
+	int x, y, i, o;
+	int from_x, from_y, to_x, to_y;
+	boardEvaluation *temp;
+
+	// Allocate our structure
+	
+	temp = arenaAlloc(&evalArena, sizeof(boardEvaluation));
+
+	// Initialize it
+
+	temp->noSides = 0;
+	temp->oneSides = 0;
+	temp->twoSides = 0;
+	temp->threeSides = 0;
+	temp->playerOneOwned = 0;
+	temp->playerTwoOwned = 0;
+	temp->playerOtherOwned = 0;
+	temp->winner = PLAYER_OTHER;
+	temp->moveLength = -1;
+
+	if (chains != null) {
+		temp->chains = chains->counts;
+	} else if (dnaNeedsChains(myDNA)) {
+		findChains(board, &scratchChains);
+		temp->chains = scratchChains.counts;
+	} else {
+		memset(&temp->chains, 0, sizeof(chain_summary));
+	}
+
+	// Now we count
+
+	for (y = 0; y < boardHeight; y++) {
+		for (x = 0; x < boardWidth; x++) {
+			i = countLines(board, x, y);
+
+//			printf("%d, %d: %d with %d lines\n", x, y, gameBoard[xyToIndex(x, y)], i);
+			
+			switch(i) {
+				case 0:
+					temp->noSides++;
+					break;
+				case 1:
+					temp->oneSides++;
+					break;
+				case 2:
+					temp->twoSides++;
+					break;
+				case 3:
+					temp->threeSides++;
+					break;
+				case 4:
+					o = board[xyToIndex(x, y)] & OWNER_MASK;
+
+					switch(o) {
+						case OWNED_BY_PLAYER_ONE:
+							temp->playerOneOwned++;
+							break;
+						case OWNED_BY_PLAYER_TWO:
+							temp->playerTwoOwned++;
+							break;
+						case OWNED_BY_OTHER:
+							temp->playerOtherOwned++;
+							break;
+						default:
+							printf("Recieved an unknown owner! It was %d.\n", o);
+							exit(1);
+					}
+					
+					break;
+				default:
+					printf("Box %d, %d had an invalid number of lines! Got %d.\n", x, y, i);
+					exit(1);
+			}
+		}
+	}
+
+	// Now figure out if someone won
+
+	if (temp->playerOneOwned + temp->playerTwoOwned + temp->playerOtherOwned == boardWidth * boardHeight) {
+		// The game is over
+		if (temp->playerOneOwned > temp->playerTwoOwned) {
+			temp->winner = PLAYER_ONE;
+		} else if (temp->playerOneOwned == temp->playerTwoOwned) {
+			temp->winner = PLAYER_TIE;
+		} else {
+			temp->winner = PLAYER_TWO;
+		}
+	} else {
+		temp->winner = NO_WINNER_YET;
+	}
+
+	if (lastMove != NO_MOVE) {
+		unpackMove(lastMove, &from_x, &from_y, &to_x, &to_y);
+
+		temp->moveLength = abs(from_x - to_x) + abs(from_y + to_y);
+	}
+
+	// Return it, note that it only lives until the evaluation arena is reset
+
+	return temp;
+}
+
+// A debug function to print out the game board for us
+
+void printBoard(int *board) {
+	int x, y, outputLine, c;
+
+	printf("\n");
+
+	// Draw the board (except the last line)
+
+	for (outputLine = 0; outputLine < 2 * boardHeight; outputLine++) {
+		y = outputLine / 2;
+
+		for (x = 0; x < boardWidth; x++) {
+			c = board[xyToIndex(x, y)];
+			
+			if (outputLine % 2 == false) {
+				// This is a horizontal line
+				printf("*");	// Put a dot
+
+				if (c & TOP_LINE)
+					printf("-");	//	There was a line on top
+				else
+					printf(" ");	// No line on top
+			} else {
+				// Print the virticle line if needed
+				
+				if (c & LEFT_LINE)
+					printf("|");	// There was a line on left
+				else
+					printf(" ");
+
+				// Print the box's owner
+
+				switch(c & OWNER_MASK) {
+					case OWNED_BY_PLAYER_ONE:
+						printf("1");
+						break;
+					case OWNED_BY_PLAYER_TWO:
+						printf("2");
+						break;
+					case OWNED_BY_OTHER:
+						printf("X");
+						break;
+					case OWNED_BY_NO_ONE:
+						printf(" ");
+						break;
+					default:
+						printf("Recieved an unknown owner! It was %d.\n", c & OWNER_MASK);
+						exit(1);
+				}
+			}
+		}
+
+		// Now the ending characters on the line
 
-		if (DEBUG) {
-			printf("Player %d made a move from %d, %d to %d, %d.\n", player, from_x_num, from_y, to_x_num, to_y);
+		if (outputLine % 2 == false) {
+			printf("*\n");	// The last dot on thel ine
+		} else {
+			if (board[xyToIndex(x - 1, y)] & RIGHT_LINE)	// Is the right line set on the last box?
+				printf("|");
+			printf("\n");
 		}
+	}
 
-		runMove(player, from_x_num, from_y, to_x_num, to_y, false, gameBoard);
-//		printBoard();
+	// Now we draw the last line
+
+	y = boardHeight - 1;
+
+	for (x = 0; x < boardWidth; x++) {
+		// This is a horizontal line
+		printf("*");	// Put a dot
+
+		if (board[xyToIndex(x, y)] & BOTTOM_LINE)
+			printf("-");	//	There was a line on bottom
+		else
+			printf(" ");	// No line on top
 	}
+	
+	printf("*\n\n");	// Print the last dot, and two new lines.
+}
 
-	if (DEBUG) {
-		boardEvaluation *temp;
-		
-		printBoard(gameBoard);	// Show the board
-		
-		temp = evaluateBoard(gameBoard, null);	// Figure out the counts
+// Score the positions a batch thread was given. Each position gets its own random stream, so the
+// moves we choose don't depend on how many threads there are
 
-		printf("Boxes with no lines:     %d\n", temp->noSides);		// Print out the counts
-		printf("Boxes with one line:     %d\n", temp->oneSides);
-		printf("Boxes with two lines:    %d\n", temp->twoSides);
-		printf("Boxes with three lines:  %d\n", temp->threeSides);
-		printf("Boxes owned by player 0: %d\n", temp->playerOtherOwned);
-		printf("Boxes owned by player 1: %d\n", temp->playerOneOwned);
-		printf("Boxes owned by player 2: %d\n", temp->playerTwoOwned);
-		printf("Winner is: ");
+void *scoreBatch(void *arg) {
+	batch_work *work = (batch_work *) arg;
+	batch_position *p;
+	int i;
 
-		if (temp->winner == PLAYER_ONE)
-			printf("Player 1\n");
-		else if (temp->winner == PLAYER_TWO)
-			printf("Player 2\n");
-		else if (temp->winner == PLAYER_TIE)
-			printf("Game was a tie\n");
-		else if (temp->winner == NO_WINNER_YET)
-			printf("None yet\n");
-		else {
-			printf("Unknown winner for board: %d\n", temp->winner);
+	for (i = work->thread; i < work->count; i += work->threadCount) {
+		p = &(work->positions[i]);
+
+		boardWidth = p->width;
+		boardHeight = p->height;
+		gameBoard = p->board;
+
+		playerOneScore = p->scoreOne;
+		playerTwoScore = p->scoreTwo;
+		playerOneTimeLeft = p->timeOne;
+		playerTwoTimeLeft = p->timeTwo;
+
+		setPlayer(p->player);
+		seedRNG(&moveRNG, batchSeed, work->firstNumber + i);
+
+		generateMoveList();
+
+		if (possibleMovesFound == 0) {
+			p->chosenMove = NO_MOVE;	// The game is over, so there's nothing to choose
+		} else {
+			selectMove();
+			p->chosenMove = finalMove;
+		}
+
+		clearPossibleMoves();
+	}
+
+	if (work->thread != 0)
+		freeThreadMemory();	// Our thread is about to end
+
+	return null;
+}
+
+// Batch mode. Read positions from a batch file (or stdin) and write one move for each to a file (or stdout).
+// Positions are read BATCH_CHUNK at a time, then split between the threads
+
+void runBatch(int argc, char** argv) {
+	FILE *in = null;
+	FILE *out = null;
+	batch_position *positions;
+	batch_work work[MAX_BATCH_THREADS];
+	pthread_t threads[MAX_BATCH_THREADS];
+	int threadCount, count, i;
+	int fromX, fromY, toX, toY;
+	uint64_t positionNumber;
+	unsigned long long seed;
+
+	if ((argc < 3) || (argc > 7)) {
+		printf("Error: bad command line arguments for batch mode. Please call as:\n");
+		printf("\t/path/to/program --batch input|- [output|-] [/path/to/dna|-] [threads] [seed]\n");
+		printf("Any of them can start with --search depth (alpha-beta) or --mcts playouts, and --threads n\n");
+		exit(1);
+	}
+
+	// Sort out the arguments, - means the default
+
+	if (strcmp(argv[2], "-") == 0) {
+		in = stdin;
+	} else {
+		in = fopen(argv[2], "r");
+
+		if (in == null) {
+			printf("Unable to open the batch file '%s': error %d.\n", argv[2], errno);
 			exit(1);
 		}
-		
-		printf("\n");
+	}
+
+	if ((argc < 4) || (strcmp(argv[3], "-") == 0)) {
+		out = stdout;
+	} else {
+		out = fopen(argv[3], "w");
 
-		free(temp);									// Free the object that was given to us
+		if (out == null) {
+			printf("Unable to open output file '%s': error %d.\n", argv[3], errno);
+			exit(1);
+		}
 	}
 
-	// That takes care of all input, so close the file.
+	if ((argc >= 5) && (strcmp(argv[4], "-") != 0))
+		loadDNA(argv[4]);
 
-	fclose(inputFile);
+	threadCount = 1;
 
-	// Set some quick stuff up
+	if ((argc >= 6) && ((sscanf(argv[5], "%d", &threadCount) != 1) ||
+				(threadCount < 1) || (threadCount > MAX_BATCH_THREADS))) {
+		printf("The thread count needs to be between 1 and %d. Given '%s'.\n", MAX_BATCH_THREADS, argv[5]);
+		exit(1);
+	}
 
-	if (me == 1) {
-		him = 2;
-		ourScore = &playerOneScore;
-		ourTime = &playerOneTimeLeft;
-		hisScore = &playerTwoScore;
-		hisTime = &playerTwoTimeLeft;
+	if (TIMING)
+		threadCount = 1;	// The timing histograms aren't safe to share between threads
+
+	if (argc == 7) {
+		if (sscanf(argv[6], "%llu", &seed) != 1) {
+			printf("Unable to read the seed. Given '%s'.\n", argv[6]);
+			exit(1);
+		}
+
+		batchSeed = (uint64_t) seed;
 	} else {
-		him = 1;
-		hisScore = &playerOneScore;
-		hisTime = &playerOneTimeLeft;
-		ourScore = &playerTwoScore;
-		ourTime = &playerTwoTimeLeft;	
+		batchSeed = (uint64_t) time(NULL);
+	}
+
+	positions = malloc(BATCH_CHUNK * sizeof(batch_position));
+
+	if (positions == null) {
+		printf("Unable to allocate memory for the batch.\n");
+		exit(1);
+	}
+
+	// Now work through the batch a chunk at a time
+
+	positionNumber = 0;
+
+	while (true) {
+		for (count = 0; count < BATCH_CHUNK; count++) {
+			gameBoard = positions[count].board;		// Read the board straight into place
+
+			playerOneScore = 0;
+			playerTwoScore = 0;
+
+			if (!readPosition(in, argv[2]))
+				break;
+
+			positions[count].player = me;
+			positions[count].width = boardWidth;
+			positions[count].height = boardHeight;
+			positions[count].scoreOne = playerOneScore;
+			positions[count].scoreTwo = playerTwoScore;
+			positions[count].timeOne = playerOneTimeLeft;
+			positions[count].timeTwo = playerTwoTimeLeft;
+		}
+
+		if (count == 0)
+			break;
+
+		for (i = 0; i < threadCount; i++) {
+			work[i].positions = positions;
+			work[i].count = count;
+			work[i].thread = i;
+			work[i].threadCount = threadCount;
+			work[i].firstNumber = positionNumber;
+		}
+
+		// We score our share on this thread while the others do theirs
+
+		for (i = 1; i < threadCount; i++) {
+			if (pthread_create(&threads[i], null, scoreBatch, &work[i]) != 0) {
+				printf("Unable to start batch thread %d: error %d.\n", i, errno);
+				exit(1);
+			}
+		}
+
+		scoreBatch(&work[0]);
+
+		for (i = 1; i < threadCount; i++) {
+			pthread_join(threads[i], null);
+		}
+
+		// Write the moves out in the order the positions came in
+
+		for (i = 0; i < count; i++) {
+			if (positions[i].chosenMove == NO_MOVE) {
+				fprintf(out, "--\n");
+			} else {
+				unpackMove(positions[i].chosenMove, &fromX, &fromY, &toX, &toY);
+				fprintf(out, "%c%d %c%d\n", columnToChar(fromX), fromY + 1, columnToChar(toX), toY + 1);
+			}
+		}
+
+		positionNumber += count;
+
+		if (count < BATCH_CHUNK)
+			break;
 	}
+
+	free(positions);
+
+	if (in != stdin)
+		fclose(in);
+
+	if (out != stdout)
+		fclose(out);
+	else
+		fflush(stdout);
 }
 
-// A function make a move on the game board
+// Sleep until someone rings the bell (it stops being seen), or ms go by
 
-void runMove(int player, int from_x, int from_y, int to_x, int to_y, int test_only, int *board) {
-	// This function makes a move on the board
+void ringWait(uint32_t *bell, uint32_t seen, int ms) {
+	struct timespec t;
+
+	t.tv_sec = ms / 1000;
+	t.tv_nsec = (ms % 1000) * 1000000L;
+
+	syscall(SYS_futex, bell, FUTEX_WAIT, seen, &t, null, 0);
+}
+
+// Ring a bell, waking up to sleepers processes waiting on it
+
+void ringBell(uint32_t *bell, int sleepers) {
+	__atomic_add_fetch(bell, 1, __ATOMIC_RELEASE);
+
+	syscall(SYS_futex, bell, FUTEX_WAKE, sleepers, null, null, 0);
+}
+
+// Map the shared memory segment master told us about ("fd:N" or a shm_open name). We make sure
+// it's a version we understand, then let master know we have it. Returns our part of it, size is set to how big it is
+
+void *attachSegment(const char *name, size_t *size) {
+	segment_header *h;
+	uint64_t total;
+	int fd;
+
+	if (strncmp(name, "fd:", 3) == 0) {
+		if (sscanf(name + 3, "%d", &fd) != 1) {
+			printf("Unable to read the shared memory name. Given '%s'.\n", name);
+			exit(1);
+		}
+	} else {
+		fd = shm_open(name, O_RDWR, 0);
+
+		if (fd < 0) {
+			printf("Unable to open shared memory '%s': error %d.\n", name, errno);
+			exit(1);
+		}
+	}
+
+	// The header tells us how much there is to map
+
+	h = (segment_header *) mmap(null, sizeof(segment_header), PROT_READ, MAP_SHARED, fd, 0);
+
+	if (h == MAP_FAILED) {
+		printf("Unable to get shared memory: error %d\n", errno);
+		exit(1);
+	}
+
+	if ((memcmp(h->magic, SEGMENT_MAGIC, 4) != 0) || (h->version != IPC_VERSION) ||
+				(h->size < sizeof(segment_header))) {
+		printf("Shared memory '%s' is not what we expect (version %u), we want version %u.\n",
+					name, h->version, IPC_VERSION);
+		exit(1);
+	}
+
+	total = h->size;
+
+	munmap(h, sizeof(segment_header));
+
+	h = (segment_header *) mmap(null, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	close(fd);	// The mapping keeps it around
+
+	if (h == MAP_FAILED) {
+		printf("Unable to get shared memory: error %d\n", errno);
+		exit(1);
+	}
+
+	ringBell(&(h->attached), 1);
+
+	*size = total - sizeof(segment_header);
+
+	return (char *) h + sizeof(segment_header);
+}
+
+// Unmap a segment attachSegment gave us
+
+void detachSegment(void *data, size_t size) {
+	munmap((char *) data - sizeof(segment_header), sizeof(segment_header) + size);
+}
+
+// How many lines a board has. Edge bitsets have a bit for each, the horizontal lines
+// a row at a time starting from the top, then the vertical ones the same way
+
+int edgeCount(int width, int height) {
+	return width * (height + 1) + (width + 1) * height;
+}
+
+// How much room a ring slot needs for a board this size, it has to work out the same as master's
+
+uint32_t ringSlotSize(int width, int height) {
+	size_t size;
+
+	size = SLOT_HEADER_SIZE;
+	size += ((edgeCount(width, height) + 63) / 64) * sizeof(uint64_t);
+	size += edgeCount(width, height) * sizeof(packed_move);
+
+	return (size + 7) & ~7;
+}
+
+// Find slot i of the ring
+
+ipc_slot *ringSlot(ipc_ring *r, int i) {
+	return (ipc_slot *) ((char *) r + sizeof(ipc_ring) + (size_t) i * r->slotSize);
+}
+
+// The start board of the game in a slot, as an edge bitset
+
+uint64_t *slotEdges(ipc_slot *slot) {
+	return (uint64_t *) ((char *) slot + SLOT_HEADER_SIZE);
+}
 
-	int x, y, i, count, c;
+// The moves made so far in the game in a slot
 
-	// First, draw the new line
+packed_move *slotMoves(ipc_slot *slot, int width, int height) {
+	return (packed_move *) (slotEdges(slot) + (edgeCount(width, height) + 63) / 64);
+}
 
-	if (from_x == to_x) {
-		// It's a virticle line
+// Draw the lines in an edge bitset on an empty board. Nobody owns the lines, so it comes out
+// just like the start board master drew them on
 
-		x = from_x;
+void unpackEdges(uint64_t *edges, int *board) {
+	int x, y, e;
 
-		for (i = from_y; i < to_y; i++) {
-			// Mark the left line if needed
-			if (x != boardWidth)
-				board[xyToIndex(x,i)] = board[xyToIndex(x, i)] | LEFT_LINE;
-			// Mark the right line if needed
-			if (x != 0)
-				board[xyToIndex(x - 1, i)] = board[xyToIndex(x - 1, i)] | RIGHT_LINE;
-		}
-	} else {
-		// It's a horizontal line
+	memset(board, 0, boardWidth * boardHeight * sizeof(int));
 
-		y = from_y;
+	e = 0;
 
-		for (i = from_x; i < to_x; i++) {
-			// Mark the top line if needed
-			if (y != boardHeight)
-				board[xyToIndex(i, y)] = board[xyToIndex(i, y)] | TOP_LINE;
-			// Mark the bottom line if needed
-			if (y != 0)
-				board[xyToIndex(i, y - 1)] = board[xyToIndex(i, y - 1)] | BOTTOM_LINE;
+	for (y = 0; y <= boardHeight; y++) {
+		for (x = 0; x < boardWidth; x++, e++) {
+			if (edges[e / 64] & (1ULL << (e % 64)))
+				runMove(PLAYER_OTHER, x, y, x + 1, y, false, board);
 		}
 	}
 
-	// Now mark any new boxes with the owner
-
 	for (y = 0; y < boardHeight; y++) {
-		for (x = 0; x < boardWidth; x++) {
-			c = board[xyToIndex(x, y)];
-			if (((c & FULL_BOX) == FULL_BOX) && ((c & OWNER_MASK) == 0)) {
-				// It's a new box! Mark it as the correct player
-				int bit;
-
-				switch(player) {
-					case PLAYER_ONE:
-						bit = OWNED_BY_PLAYER_ONE;
-						break;
-					case PLAYER_TWO:
-						bit = OWNED_BY_PLAYER_TWO;
-						break;
-					case PLAYER_OTHER:
-						bit = OWNED_BY_OTHER;
-						break;
-					default:
-						printf("ERROR: Got bad player: %d\n", player);
-						exit(1);
-				}
-
-				if (test_only == false) {
-					board[xyToIndex(x, y)] = c | bit;	// Mark the owner
-				}
-			}
+		for (x = 0; x <= boardWidth; x++, e++) {
+			if (edges[e / 64] & (1ULL << (e % 64)))
+				runMove(PLAYER_OTHER, x, y, x, y + 1, false, board);
 		}
 	}
 }
 
-// A function to evalue a gameboard
+// Make a move in the game master put in a slot, the same way we would for an input file.
+// We rebuild the board from the start board and the moves so far, they're all master sends
 
-boardEvaluation *evaluateBoard(int *board, move *lastMove) {
-	// Variables
-	
-	int x, y, i, o;
-	boardEvaluation *temp;
+void playSlot(ipc_ring *ring, ipc_slot *slot) {
+	int board[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	packed_move *moves;
+	uint64_t start;
+	int i;
 
-	// Allocate our structure
-	
-	temp = malloc(sizeof(boardEvaluation));
+	start = nanoTime();
 
-	// Initialize it
+	boardHeight = ring->height;
+	boardWidth = ring->width;
+	gameBoard = board;
 
-	temp->noSides = 0;
-	temp->oneSides = 0;
-	temp->twoSides = 0;
-	temp->threeSides = 0;
-	temp->playerOneOwned = 0;
-	temp->playerTwoOwned = 0;
-	temp->playerOtherOwned = 0;
-	temp->winner = PLAYER_OTHER;
-	temp->moveLength = -1;
+	unpackEdges(slotEdges(slot), gameBoard);
 
-	// Now we count
+	moves = slotMoves(slot, boardWidth, boardHeight);
 
-	for (y = 0; y < boardHeight; y++) {
-		for (x = 0; x < boardWidth; x++) {
-			i = countLines(board, x, y);
+	for (i = 0; i < (int) slot->moveCount; i++) {
+		if (i % 2 == 0)
+			runPackedMove(PLAYER_ONE, moves[i], gameBoard);
+		else
+			runPackedMove(PLAYER_TWO, moves[i], gameBoard);
+	}
 
-//			printf("%d, %d: %d with %d lines\n", x, y, gameBoard[xyToIndex(x, y)], i);
-			
-			switch(i) {
-				case 0:
-					temp->noSides++;
-					break;
-				case 1:
-					temp->oneSides++;
-					break;
-				case 2:
-					temp->twoSides++;
-					break;
-				case 3:
-					temp->threeSides++;
-					break;
-				case 4:
-					o = board[xyToIndex(x, y)] & OWNER_MASK;
+	playerOneScore = slot->pOneScore;
+	playerOneTimeLeft = slot->pOneTime;
 
-					switch(o) {
-						case OWNED_BY_PLAYER_ONE:
-							temp->playerOneOwned++;
-							break;
-						case OWNED_BY_PLAYER_TWO:
-							temp->playerTwoOwned++;
-							break;
-						case OWNED_BY_OTHER:
-							temp->playerOtherOwned++;
-							break;
-						default:
-							printf("Recieved an unknown owner! It was %d.\n", o);
-							exit(1);
-					}
-					
-					break;
-				default:
-					printf("Box %d, %d had an invalid number of lines! Got %d.\n", x, y, i);
-					exit(1);
-			}
-		}
-	}
+	playerTwoScore = slot->pTwoScore;
+	playerTwoTimeLeft = slot->pTwoTime;
 
-	// Now figure out if someone won
+	setPlayer(slot->player);
 
-	if (temp->playerOneOwned + temp->playerTwoOwned + temp->playerOtherOwned == boardWidth * boardHeight) {
-		// The game is over
-		if (temp->playerOneOwned > temp->playerTwoOwned) {
-			temp->winner = PLAYER_ONE;
-		} else if (temp->playerOneOwned == temp->playerTwoOwned) {
-			temp->winner = PLAYER_TIE;
-		} else {
-			temp->winner = PLAYER_TWO;
-		}
-	} else {
-		temp->winner = NO_WINNER_YET;
-	}
+	myDNA = &(slot->players[slot->player - 1]);
 
-	if (lastMove != null) {
-		temp->moveLength = abs(lastMove->from_x - lastMove->to_x) + abs(lastMove->from_y + lastMove->to_y);
-	}
+	generateMoveList();
 
-	// Return it, note that the caller MUST FREE THE STRUCTURE
+	if (TIMING)
+		recordTiming(STAGE_GENERATE, nanoTime() - start);
 
-	return temp;
+	seedRNG(&moveRNG, slot->seed, 0);
+
+	selectMove();
+
+	if (TIMING)
+		recordTiming(STAGE_MOVE, nanoTime() - start);
+
+	slot->chosenMove = finalMove;
+
+	clearPossibleMoves();
+
+	slot->seconds = (nanoTime() - start) / 1000000000.0;
 }
 
-// A debug function to print out the game board for us
+// Serve the ring for master until it tells us to stop (or goes away).
+// Slots are claimed with a compare and swap, so a game only goes to one worker at a time
 
-void printBoard(int *board) {
-	int x, y, outputLine, c;
+void serveRing(ipc_ring *ring, size_t size) {
+	pid_t master = getppid();
+	uint32_t seen, expected;
+	int i, claimed;
 
-	printf("\n");
+	// Make sure we can play what master is going to send us
 
-	// Draw the board (except the last line)
+	if ((size < sizeof(ipc_ring)) || (ring->width < MIN_BOARD_SIDE) || (ring->height < MIN_BOARD_SIDE) ||
+				(ring->width > MAX_BOARD_SIDE) || (ring->height > MAX_BOARD_SIDE)) {
+		printf("This lab can't play %ux%u boards, only %dx%d to %dx%d.\n", ring->width, ring->height,
+					MIN_BOARD_SIDE, MIN_BOARD_SIDE, MAX_BOARD_SIDE, MAX_BOARD_SIDE);
+		exit(1);
+	}
 
-	for (outputLine = 0; outputLine < 2 * boardHeight; outputLine++) {
-		y = outputLine / 2;
+	if ((ring->slotSize != ringSlotSize(ring->width, ring->height)) ||
+				(sizeof(ipc_ring) + (size_t) ring->slotCount * ring->slotSize != size)) {
+		printf("The ring is laid out differently than we expect.\n");
+		exit(1);
+	}
 
-		for (x = 0; x < boardWidth; x++) {
-			c = board[xyToIndex(x, y)];
-			
-			if (outputLine % 2 == false) {
-				// This is a horizontal line
-				printf("*");	// Put a dot
+	while (!__atomic_load_n(&ring->stop, __ATOMIC_ACQUIRE)) {
+		// Note the bell before looking, so a game posted while we look still wakes us
 
-				if (c & TOP_LINE)
-					printf("-");	//	There was a line on top
-				else
-					printf(" ");	// No line on top
-			} else {
-				// Print the virticle line if needed
-				
-				if (c & LEFT_LINE)
-					printf("|");	// There was a line on left
-				else
-					printf(" ");
+		seen = __atomic_load_n(&ring->requestBell, __ATOMIC_ACQUIRE);
 
-				// Print the box's owner
+		claimed = -1;
 
-				switch(c & OWNER_MASK) {
-					case OWNED_BY_PLAYER_ONE:
-						printf("1");
-						break;
-					case OWNED_BY_PLAYER_TWO:
-						printf("2");
-						break;
-					case OWNED_BY_OTHER:
-						printf("X");
-						break;
-					case OWNED_BY_NO_ONE:
-						printf(" ");
-						break;
-					default:
-						printf("Recieved an unknown owner! It was %d.\n", c & OWNER_MASK);
-						exit(1);
-				}
-			}
+		for (i = 0; (i < (int) ring->slotCount) && (claimed == -1); i++) {
+			expected = SLOT_REQUEST;
+
+			if (__atomic_compare_exchange_n(&(ringSlot(ring, i)->state), &expected, SLOT_WORKING,
+												false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+				claimed = i;
 		}
 
-		// Now the ending characters on the line
+		if (claimed == -1) {
+			ringWait(&ring->requestBell, seen, RING_CHECK_MS);
 
-		if (outputLine % 2 == false) {
-			printf("*\n");	// The last dot on thel ine
-		} else {
-			if (board[xyToIndex(x - 1, y)] & RIGHT_LINE)	// Is the right line set on the last box?
-				printf("|");
-			printf("\n");
+			if (getppid() != master)
+				return;	// Master died, nobody is going to tell us to stop
+
+			continue;
 		}
+
+		playSlot(ring, ringSlot(ring, claimed));
+
+		// Release, so master sees the move before it sees the slot is done
+
+		__atomic_store_n(&(ringSlot(ring, claimed)->state), SLOT_DONE, __ATOMIC_RELEASE);
+
+		ringBell(&ring->responseBell, 1);
 	}
+}
 
-	// Now we draw the last line
+// Read the options that change how we play, which come before everything else. Returns how many
+// arguments they took up
 
-	y = boardHeight - 1;
+int readPlayOptions(int argc, char** argv) {
+	int i = 1;
 
-	for (x = 0; x < boardWidth; x++) {
-		// This is a horizontal line
-		printf("*");	// Put a dot
+	while ((i + 1 < argc) && (strncmp(argv[i], "--", 2) == 0)) {
+		if (strcmp(argv[i], "--search") == 0) {
+			if ((sscanf(argv[i + 1], "%d", &searchDepth) != 1) || (searchDepth < 0) || (searchDepth > MAX_SEARCH_DEPTH)) {
+				printf("The search depth has to be from 0 to %d. Given '%s'.\n", MAX_SEARCH_DEPTH, argv[i + 1]);
+				exit(1);
+			}
+		} else if (strcmp(argv[i], "--mcts") == 0) {
+			if ((sscanf(argv[i + 1], "%d", &mctsPlayouts) != 1) || (mctsPlayouts < 0)) {
+				printf("Unable to read the number of MCTS playouts. Given '%s'.\n", argv[i + 1]);
+				exit(1);
+			}
+		} else if (strcmp(argv[i], "--threads") == 0) {
+			if ((sscanf(argv[i + 1], "%d", &playThreads) != 1) || (playThreads < 1) || (playThreads > MAX_PLAY_THREADS)) {
+				printf("The thread count needs to be between 1 and %d. Given '%s'.\n", MAX_PLAY_THREADS, argv[i + 1]);
+				exit(1);
+			}
+		} else {
+			break;	// Not one of ours, it's up to the mode
+		}
 
-		if (board[xyToIndex(x, y)] & BOTTOM_LINE)
-			printf("-");	//	There was a line on bottom
-		else
-			printf(" ");	// No line on top
+		i += 2;
 	}
-	
-	printf("*\n\n");	// Print the last dot, and two new lines.
+
+	return i - 1;
 }
 
 // The main function. All hail main!
+// Tools that build on our engine (like bench.c) include this file with LAB_NO_MAIN defined
+
+#ifndef LAB_NO_MAIN
 
 int main(int argc, char** argv) {
 
-	char fromXChar, toXChar, fromYChar, toYChar;
-	int useIPC;
-	ipc_memory *ipc;
+	char fromXChar, toXChar;
+	int fromX, fromY, toX, toY;
+	ipc_ring *ring;
+	size_t ringSize;
+	uint64_t moveStart = 0;
+	int i, used;
 
 	myDNA = malloc(sizeof(dna));
 
@@ -1160,189 +3971,160 @@ int main(int argc, char** argv) {
 		exit(1);
 	}
 
-	myDNA->noBasePair = 0.984120;	// After 47 evolutions
-	myDNA->oneBasePair = 0.576126;
-	myDNA->twoBasePair = 0.315090;
-	myDNA->threeBasePair = -0.972065;
-	myDNA->lineLengthBasePair = 0.020435;
-	myDNA->currentMarginBasePair = 0.660055;
+	useDefaultDNA(myDNA);
 
 	// Initial stuff
 
+	if (TIMING)
+		atexit(writeTimings);
+
 	gameBoard = null;
 	possibleMovesFound = 0;
-	useIPC = 0;
 
 	if (DEBUG) {
 		printf("\n");
 	}
 
+	// Options for how we play come first, we take them out so the rest is the same for every mode
+
+	used = readPlayOptions(argc, argv);
+
+	for (i = 1; i + used < argc; i++)
+		argv[i] = argv[i + used];
+
+	argc -= used;
+
+	// Batch mode has its own arguments
+
+	if ((argc >= 2) && (strncmp(argv[1], "--batch", 7) == 0)) {
+		runBatch(argc, argv);
+		return 0;
+	}
+
 	// Make sure we have arguments
 
-	if ((argc < 2) || (argc > 4)) {
+	if ((argc < 2) || (argc > 5)) {
 		printf("Error: bad command line arguments. Please call as:\n");
 
-		printf("\t/path/to/program /path/to/input [/path/to/output] [/path/to/dna]\n");
-		printf("\t/path/to/program --ipc key_number\n");
+		printf("\t/path/to/program /path/to/input [/path/to/output] [/path/to/dna] [seed]\n");
+		printf("\t/path/to/program --ipc shared_memory_name\n");
+		printf("\t/path/to/program --batch input|- [output|-] [/path/to/dna|-] [threads] [seed]\n");
+		printf("Any of them can start with --search depth (alpha-beta) or --mcts playouts, and --threads n\n");
 
 		exit(1);
 	}
 
 	if (strncmp(argv[1], "--ipc", 5) == 0) {
-		if (argc == 3) {
-			// Key is in the command line, so let's get it
-
-			if(sscanf(argv[2], "%d", &useIPC) != 1) {
-				// We couldn't load it
-
-				printf("Unable to load the IPC key. Given '%s'.\n", argv[3]);
-				exit(1);
-			}
-		} else {
+		if (argc != 3) {
 			// We didn't get enough info
 
 			printf("Error: bad command line arguments for IPC. Please call as:\n");
 	
-			printf("\t/path/to/program /path/to/input [/path/to/output] [/path/to/dna]\n");
-			printf("\t/path/to/program --ipc key_number\n");
+			printf("\t/path/to/program /path/to/input [/path/to/output] [/path/to/dna] [seed]\n");
+			printf("\t/path/to/program --ipc shared_memory_name\n");
+			printf("\t/path/to/program --batch input|- [output|-] [/path/to/dna|-] [threads] [seed]\n");
+			printf("Any of them can start with --search depth (alpha-beta) or --mcts playouts, and --threads n\n");
 	
 			exit(1);
 		}
-	}
 
-	// Read the input file
-
-	if (useIPC) {
-		// Set up the IPC shared memory
-
-		ipc = null;
-
-		ipc = (ipc_memory *) shmat(useIPC, 0, 0);
+		// Set up the IPC shared memory and make moves for master until it's done with us
 
-		if (ipc == (ipc_memory *) -1) {
-			printf("Unable to get shared memory: error %d\n", errno);
-			exit(1);
-		}
+		ring = (ipc_ring *) attachSegment(argv[2], &ringSize);
 
-		// Now set the stuff that readInputFile would do for us
+		serveRing(ring, ringSize);
 
-		me = ipc->player;
-		boardHeight = ipc->height;
-		boardWidth = ipc->width;
-		gameBoard = (int *) &(ipc->gameBoard);
+		detachSegment(ring, ringSize);
 
-		playerOneScore = ipc->pOneScore;
-		playerOneTimeLeft = ipc->pOneTime;
+		return 0;
+	}
 
-		playerTwoScore = ipc->pTwoScore;
-		playerTwoTimeLeft = ipc->pTwoTime;
+	// Read the input file
 
-		if (me == 1) {
-			him = 2;
-			ourScore = &playerOneScore;
-			ourTime = &playerOneTimeLeft;
-			hisScore = &playerTwoScore;
-			hisTime = &playerTwoTimeLeft;
-		} else {
-			him = 1;
-			hisScore = &playerOneScore;
-			hisTime = &playerOneTimeLeft;
-			ourScore = &playerTwoScore;
-			ourTime = &playerTwoTimeLeft;	
-		}
-	} else {
-		readInputFile(argv[1]);
-	}
+	readInputFile(argv[1]);
 
-	// Read our DNA if they gave it to us
+	// Load the DNA from a file if given
 
-	if (useIPC) {
-		// We get the DNA through the IPC
-		myDNA = &(ipc->theDNA);
-	} else {
-		// Load the DNA from a file if given
-		if (argc == 4) {
-			loadDNA(argv[3]);
-		}
+	if (argc >= 4) {
+		loadDNA(argv[3]);
 	}
 
-	// Initialize other stuff
+	// Generate a list of possible moves
 
-	memset(possibleMoves, 0, MAX_POSSIBLE_MOVES * sizeof(move *));	// Clear out the possible moves array
+	if (TIMING)
+		moveStart = nanoTime();
 
-	// Generate a list of possible moves
-	
 	generateMoveList();
 
+	if (TIMING)
+		recordTiming(STAGE_GENERATE, nanoTime() - moveStart);
+
 	if (DEBUG) {
 		printf("We found %d possible moves.\n\n", possibleMovesFound);
 	}
 
-	// Seed the RNG
+	// Seed the RNG if they gave us a seed, so the move can be repeated
+
+	if (argc == 5) {
+		unsigned long long seed;
+
+		if (sscanf(argv[4], "%llu", &seed) != 1) {
+			printf("Unable to read the seed. Given '%s'.\n", argv[4]);
+			exit(1);
+		}
 
-	srand((unsigned) time(NULL));
+		seedRNG(&moveRNG, (uint64_t) seed, 0);
+	} else {
+		seedRNG(&moveRNG, (uint64_t) time(NULL), 0);
+	}
 
 	// Time to start processing.
 
 	selectMove();	// Figure out our move
 
+	if (TIMING)
+		recordTiming(STAGE_MOVE, nanoTime() - moveStart);
+
 	// Print out the move
-	if (useIPC) {
-		// Since we are using IPC, things are easy
 
-		copyMove(&finalMove, &(ipc->chosenMove));
+	unpackMove(finalMove, &fromX, &fromY, &toX, &toY);
+
+	fromXChar = columnToChar(fromX);
+	toXChar = columnToChar(toX);
+
+	if (argc == 2) {
+		// Just print out the result
+		printf("%c%d %c%d\n", fromXChar, fromY + 1, toXChar, toY + 1);
 	} else {
+		// They want our output put into a file, so we'll have to do that.
+		FILE *out = null;
 
-		fromXChar = columnToChar(finalMove.from_x);
-		toXChar = columnToChar(finalMove.to_x);
-	
-		fromYChar = '1' + finalMove.from_y;
-		toYChar = '1' + finalMove.to_y;
+		out = fopen(argv[2], "w");
 
-		if (argc == 2) {
-			// Just print out the result
-			printf("%c%c %c%c\n", fromXChar, fromYChar, toXChar, toYChar);
+		if (out == null) {
+			// We couldn't open the file, so complain 
+			printf("Unable to open output file! Error %d.\n", errno);
+			printf("%c%d %c%d\n", fromXChar, fromY + 1, toXChar, toY + 1);
 		} else {
-			// They want our output put into a file, so we'll have to do that.
-			FILE *out = null;
-	
-			out = fopen(argv[2], "w");
-	
-			if (out == null) {
-				// We couldn't open the file, so complain 
-				printf("Unable to open output file! Error %d.\n", errno);
-				printf("%c%c %c%c\n", fromXChar, fromYChar, toXChar, toYChar);
-			} else {
-				// We opened the file, write out stuff and quit.
-				fprintf(out, "%c%c %c%c\n", fromXChar, fromYChar, toXChar, toYChar);
-				fclose(out);
-			}
+			// We opened the file, write out stuff and quit.
+			fprintf(out, "%c%d %c%d\n", fromXChar, fromY + 1, toXChar, toY + 1);
+			fclose(out);
 		}
 	}
 
 	if (DEBUG) {
 		printBoard(gameBoard);
-		printf("%c%c %c%c\n", fromXChar, fromYChar, toXChar, toYChar);
+		printf("%c%d %c%d\n", fromXChar, fromY + 1, toXChar, toY + 1);
 	}
 
 	// Clean up the possible move list
 
-	if (possibleMovesFound > 0) {
-		int i;
-		
-		for (i = 0; i < possibleMovesFound; i++) {
-			free(possibleMoves[i]);
-		}
-	}
-
-	// Detatch from the shared memory if we are using it
-
-	if (useIPC) {
-		shmdt(ipc);
-	}
+	clearPossibleMoves();
 
 	// Now return
 
 	return 0;
 
 }
+
+#endif
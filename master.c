@@ -1,25 +1,78 @@
 //------------------------------- Includes -------------------------------
 
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
-#include <sys/timeb.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 //------------------------------- Defines -------------------------------
 
 #define MUTATION_RATE			0.1
+#define GENE_LIMIT				6.0		// Mutation keeps genes between -6 and 6
+
+#define STREAM_SETUP			0		// Random stream for the start board and making DNA
+#define STREAM_BREEDING			1		// Random stream for breeding
+#define STREAM_GAMES			1024	// Game n of a tourney uses stream STREAM_GAMES + n
+
+#define GAME_LOG_NAME			"games-%d.log"	// Each worker logs its games to its own file
+#define GAME_INDEX_NAME			"games-%d.idx"	// Where each game in the log starts, one uint64_t per game
+#define GAME_LOG_MAGIC			"LBGL"
+#define GAME_LOG_VERSION		3		// 2 has 32 bit moves and a 16 bit move count, 3 has gene array DNA
+#define GAME_LOG_BUFFER			(256 * 1024)	// How much of the log we collect before writing it out
+
+#define RESULTS_NAME			"results.bin"	// Every finished game, added as it finishes
+#define RESULTS_MAGIC			"LBRS"
+#define RESULTS_VERSION			1
+#define RESULT_QUEUE_SIZE		4096	// Finished games the writer can fall behind by, a power of two
+#define RESULT_WAIT_MS			1000	// The writer looks for results at least this often
+#define HTML_TABLE_LIMIT		100		// Bigger tourneys only get the totals in results.html
+
+#define CHECKPOINT_NAME			"tourney.ckpt"	// Enough to pick a tourney up where it left off
+#define CHECKPOINT_TEMP_NAME	"tourney.ckpt.tmp"	// Written first, then renamed over the checkpoint
+#define CHECKPOINT_MAGIC		"LBCK"
+#define CHECKPOINT_VERSION		3		// 2 has where the game log and index end, 3 where the tourney starts in them
+#define CHECKPOINT_SECONDS		30		// How often the results writer saves a checkpoint
+
+#define MAX_WORKERS				64		// The most lab processes we'll start
+#define WORKER_CHECK_MS			1000	// How often we make sure the workers are still alive while we wait
+
+#define SEGMENT_MAGIC			"LBSM"
+#define SEGMENT_NAME			"/lines-boxes-%d-%d"	// Only used when there's no memfd, the pid makes it ours
+#define MAX_SEGMENTS			8		// Shared memory segments we can have at once
+#define IPC_VERSION				4		// Bump whenever anything in the shared memory changes, lab checks it
 
 //------------------------------- Constants -------------------------------
 
-#define MAX_POSSIBLE_MOVES		((9 + 9) * 36)
-
 #define MIN_BOARD_SIDE			3
-#define MAX_BOARD_SIDE			8
+#define MAX_BOARD_SIDE			32
+#define RANDOM_BOARD_SIDE		8		// Tourneys pick a size up to this unless they're given one
+#define MAX_GAME_MOVES			(2 * MAX_BOARD_SIDE * (MAX_BOARD_SIDE + 1))	// Every move draws at least one segment
+#define NO_MOVE					0		// A packed move that can't be real, it has no length
+#define MOVE_VERTICAL			0x40000	// Set in packed moves that run up and down
+#define MOVE_FIELD_BITS			6		// Bits for each coordinate in a packed move
+#define MOVE_FIELD_MASK			0x3F
+
+#define MAX_GENES				16		// Room in the DNA, must match lab
+#define BASE_GENES				6		// Every DNA file has at least the original six
+#define STEPS_MARKER			"steps"	// Bred DNA files have mutation step sizes after this line
+
+#define RING_SLOTS				16		// The most games we keep going at once
+#define SLOT_HEADER_SIZE		((sizeof(ipc_slot) + 7) & ~7)	// Where the edge bitset starts in a slot
+
+#define SLOT_FREE				0		// Nothing in the slot
+#define SLOT_REQUEST			1		// We put a position in the slot for a worker to move in
+#define SLOT_WORKING			2		// A worker has claimed the position
+#define SLOT_DONE				3		// The worker has put its move in the slot
 
 #define NO_WINNER_YET			0
 
@@ -60,40 +113,163 @@
 
 //------------------------------- Structs -------------------------------
 
-typedef struct {				// Used to hold the coords of a move
-	int from_x;
-	int to_x;
-	int from_y;
-	int to_y;
-	double score;				// Used in figuring out which move is best
-} move;
-
-typedef struct {				// Used in our scoring function
-	double noBasePair;
-	double oneBasePair;
-	double twoBasePair;
-	double threeBasePair;
-	double lineLengthBasePair;
-	double currentMarginBasePair;
+typedef uint32_t packed_move;	// A whole move in 19 bits, see packMove for the layout
+
+typedef struct {				// Used in lab's scoring function, gene i weighs lab's feature i. Must match lab
+	uint32_t geneCount;			// How many genes the DNA file had, the rest are 0
+	uint32_t unused;
+	double genes[MAX_GENES];
 } dna;
 
-typedef struct {				// Used to pass stuff between the parrent process and me
-	dna theDNA;
-	int gameBoard[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
-	move chosenMove;
+typedef struct {				// Starts every game log file
+	char magic[4];				// Always GAME_LOG_MAGIC
+	uint32_t version;
+} game_log_header;
+
+typedef struct {				// Starts each game in a game log. The start board (a byte per box) and the moves follow
+	uint64_t seed;				// The master seed and stream the game was played with, so it can be replayed
+	uint32_t stream;
+	int32_t playerOneNumber;	// Which DNA files the players came from
+	int32_t playerTwoNumber;
+	uint16_t moveCount;
+	uint8_t width;
+	uint8_t height;
+	uint8_t winner;
+	uint8_t unused[7];			// Keeps the DNA on an 8 byte boundary
+	dna playerOne;
+	dna playerTwo;
+} game_record;
+
+typedef struct {				// State for one xoshiro256** random number stream
+	uint64_t s[4];
+} rng_state;
+
+typedef struct {				// Starts the results stream, a game_result for each finished game follows
+	char magic[4];				// Always RESULTS_MAGIC
+	uint32_t version;
+	uint64_t seed;
+	int32_t count;				// How many DNA are in the tourney
+	int32_t startNum;			// The first one's number
+	uint8_t width;
+	uint8_t height;
+	uint8_t unused[6];
+} results_header;
+
+typedef struct {				// One finished game in the results stream
+	uint32_t number;			// Games 2n and 2n + 1 are pair n, in results table order
+	uint32_t winner;
+	double timeOne;				// Time each player used
+	double timeTwo;
+} game_result;
+
+typedef struct {				// Every result of a tourney, filled in as games finish. The reports come from this
+	uint64_t seed;
+	int count;
+	int startNum;
 	int width;
 	int height;
-	int player;
+	int pairCount;
+	uint8_t *winners;			// Two per pair, NO_WINNER_YET until the game is played
+	double *times;				// Two per game, player one's then player two's
+} results_matrix;
+
+typedef struct {				// Finished games on their way to the results stream. Only the tourney puts
+	game_result items[RESULT_QUEUE_SIZE];	// them in and only the writer takes them out, so it needs no lock
+	uint32_t head;				// Next item to fill, only the tourney moves it
+	uint32_t tail;				// Next item to write, only the writer moves it
+	uint32_t bell;				// Rung when a result goes in or the tourney is over
+	uint32_t space;				// Rung when the writer has made room
+	uint32_t done;				// Set when there are no more results coming
+	FILE *out;
+	uint64_t logEnds[RESULT_QUEUE_SIZE];	// Where the game log and index ended once each item's
+	uint64_t indexEnds[RESULT_QUEUE_SIZE];	// game was logged
+
+	results_matrix saved;		// The writer's own copy of the results, for checkpoints
+	rng_state setupRNG;			// The rest of what a checkpoint needs
+	uint8_t board[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	uint64_t logEnd;			// Where the game log and index end after the last game in saved
+	uint64_t indexEnd;
+	time_t lastCheckpoint;
+} result_queue;
+
+typedef struct {				// Starts every shared memory segment, so workers can check it's what they expect
+	char magic[4];				// Always SEGMENT_MAGIC
+	uint32_t version;			// IPC_VERSION
+	uint64_t size;				// The whole segment, header and all
+	uint32_t attached;			// How many workers have mapped it, they ring it as a bell too
+	uint32_t unused;
+} segment_header;
+
+typedef struct {				// A shared memory segment we made
+	void *memory;				// Starts with a segment_header
+	size_t size;
+	int fd;
+	char name[64];				// What workers are told to open, "fd:N" for a memfd or the shm_open name
+	int named;					// If there's still a name to shm_unlink
+} shared_segment;
+
+typedef struct {				// One game in the ring. The start board's edge bitset and the moves so far follow it
+	uint32_t state;				// SLOT_FREE and friends, only touched with atomics
+	uint32_t moveCount;			// Moves made so far, we add one each turn
+	double seconds;				// How long the worker took to move
+
+	dna players[2];				// Set once a game, player one's DNA then player two's
+
+	int player;					// Set each move
 	int pOneScore;
 	int pTwoScore;
 	double pOneTime;
 	double pTwoTime;
-} ipc_memory;
+	uint64_t seed;				// Seed for the player's random stream, so each move can be replayed
+
+	packed_move chosenMove;		// The worker's answer
+} ipc_slot;
+
+typedef struct {				// The shared memory we hand to our resident lab workers. The slots follow it
+	uint32_t slotCount;
+	uint32_t slotSize;			// Bytes from one slot to the next, it depends on the board size
+	uint32_t width;				// Every game in a tourney is on the same size board
+	uint32_t height;
+	uint32_t stop;				// Set when the workers should quit
+	uint32_t requestBell;		// Bumped each time we post a position, idle workers sleep on it
+	uint32_t responseBell;		// Bumped each time a worker finishes one, we sleep on it
+	uint32_t unused;
+} ipc_ring;
+
+typedef struct {				// Starts a checkpoint. The start board (a byte per box) follows, then the
+	char magic[4];				// results matrix's winners and times
+	uint32_t version;			// Always CHECKPOINT_MAGIC and CHECKPOINT_VERSION
+	uint64_t seed;
+	rng_state setupRNG;			// masterRNG once the start board was made
+	int32_t count;
+	int32_t startNum;
+	uint8_t width;
+	uint8_t height;
+	uint8_t unused[2];
+	uint32_t nextGame;			// Every game before this one is finished
+	uint32_t finished;			// Games finished, counting any past nextGame
+	uint32_t unused2;
+	uint64_t logEnd;			// Where games-0.log and games-0.idx end with only these games in them,
+	uint64_t indexEnd;			// anything after that is cut off when we resume
+	uint64_t logStart;			// Where they ended before the tourney logged anything. A new tourney
+	uint64_t indexStart;		// cuts back to here if this one never finished
+} checkpoint_header;
+
+typedef struct {				// A tourney game being played through the ring
+	int active;
+	int number;					// Games 2n and 2n + 1 are the two games of pair n
+	int playerOne;				// Indexes into the DNA array
+	int playerTwo;
+	uint32_t stream;
+	int turn;
+	double timeOne;				// Time each player has used so far
+	double timeTwo;
+	rng_state rng;
+	int board[MAX_BOARD_SIDE * MAX_BOARD_SIDE];	// The moves are kept in the game's slot
+} tourney_game;
 
 //------------------------------- Global Variables -------------------------------
 
-move tempMove;			// A move structure we'll use
-
 int moveNum;			// The number of the next move
 int turn;
 
@@ -102,16 +278,35 @@ double playerOneTimeLeft = 60.0, playerTwoTimeLeft = 60.0;	// Time left for the
 
 int boardWidth;
 int boardHeight;
-int *gameBoard;
 int *startBoard;
 
 int *winsArray;
 int *lossesArray;
 int *tiesArray;
 double *timeArray;
-ipc_memory *ipc;
 
-move *moveList[136];
+shared_segment segments[MAX_SEGMENTS];		// Every shared memory segment we have
+int segmentCount = 0;
+
+shared_segment *ringSegment = null;	// The segment the ring lives in
+ipc_ring *ring = null;			// Shared with the lab workers
+pid_t workerPids[MAX_WORKERS];
+int workerCount = 0;
+
+packed_move moveList[MAX_GAME_MOVES + 1];	// Every move made so far this game, from 1 up
+
+uint64_t masterSeed;			// Every random stream is derived from this, so runs can be repeated
+rng_state masterRNG;			// Stream for the start board and making DNA
+
+result_queue resultQueue;		// Between the tourney and the results writer
+pthread_t resultThread;
+
+FILE *gameLog = null;			// Every game we play goes in here, see logGame
+FILE *gameIndex = null;			// Where each game starts in gameLog
+uint64_t gameLogOffset;			// How far into gameLog the next game will go
+uint64_t gameIndexOffset;		// And how far into gameIndex its offset will go
+uint64_t gameLogStart;			// Where this tourney's games start in gameLog
+uint64_t gameIndexStart;		// And in gameIndex
 
 // Function prototypes
 
@@ -123,41 +318,152 @@ char columnToChar(int x);
 int countLines(int *board, int x, int y);
 inline int xyToIndex(int x, int y);
 void copyBoard(int *s, int *d);
-move *makeMove(int x_start, int y_start, int x_end, int y_end);
-void runMoveWithStruct(int player, move *theMove, int *theBoard);
+packed_move packMove(int from_x, int from_y, int to_x, int to_y);
+void unpackMove(packed_move theMove, int *from_x, int *from_y, int *to_x, int *to_y);
+void runPackedMove(int player, packed_move theMove, int *theBoard);
 void loadDNA(char *path, dna *dest);
 void copyDNA(dna *s, dna *d);
 int gameIsOver(int *board);
 void writeGame(char *fileName);
-move *readLastMove(char *fileName);
-void clearMoves();
-void copyMove(volatile move *s, move *d);
-dna *haveSex(dna *a, dna *b);
-void setupStartBoard(int *startBoard);
+dna *haveSex(dna *a, dna *b, rng_state *rng);
+void setupStartBoard(int *startBoard, rng_state *rng);
+uint64_t mixBits(uint64_t z);
+uint64_t splitMix(uint64_t *x);
+void seedRNG(rng_state *r, uint64_t seed, uint64_t stream);
+uint64_t nextRandom(rng_state *r);
+double randomDouble(rng_state *r);
+int randomInt(rng_state *r, int n);
+void openGameLog(int worker);
+void logGame(uint32_t stream, int playerOneNumber, dna *playerOne, int playerTwoNumber, dna *playerTwo, int winner,
+				packed_move *moves, int moveCount);
+void closeGameLog();
+void trimGameLog(uint64_t logEnd, uint64_t indexEnd);
+void dropUnfinishedTourney();
+shared_segment *createSegment(size_t size);
+void *segmentData(shared_segment *s);
+void unlinkSegment(shared_segment *s);
+void destroySegment(shared_segment *s);
+void destroySegments();
+void ringWait(uint32_t *bell, uint32_t seen, int ms);
+void ringBell(uint32_t *bell, int sleepers);
+int edgeCount(int width, int height);
+uint32_t ringSlotSize(int width, int height);
+ipc_slot *ringSlot(ipc_ring *r, int i);
+uint64_t *slotEdges(ipc_slot *slot);
+packed_move *slotMoves(ipc_slot *slot, int width, int height);
+void packEdges(int *board, uint64_t *edges);
+void startWorkers(char *labPath, int workers, int slots);
+void checkWorkers();
+void stopWorkers();
+void startGame(int slot, tourney_game *g, int number, int playerOne, int playerTwo, uint32_t stream, dna *dnaArray);
+void postMove(int slot, tourney_game *g);
+void takeMove(int slot, tourney_game *g);
+void playGames(int *pairA, int *pairB, int pairCount, int theCount, int startNum, dna *dnaArray,
+					results_matrix *results);
+void runTourney(char *labPath, int theCount, int startNum, int workers, int width, int height, int resume);
+void makeResults(results_matrix *r, int theCount, int startNum);
+void freeResults(results_matrix *r);
+void recordResult(results_matrix *r, game_result *g);
+void openResults(results_matrix *r);
+void queueResult(game_result *g);
+void *resultWriter(void *arg);
+void closeResults();
+void saveCheckpoint(result_queue *q);
+void readCheckpoint(char *path, results_matrix *r, uint64_t *logEnd, uint64_t *indexEnd);
+void readResults(char *path, results_matrix *r);
+void tallyResults(results_matrix *r);
+void writeReports(results_matrix *r);
+void writeResultsHTML(results_matrix *r);
+void writeResultsCSV(results_matrix *r);
+void writeResultsJSON(results_matrix *r);
 
 //------------------------------- Function definitions -------------------------------
 
+// Scramble the bits of a number, the finishing step of splitmix64
+
+uint64_t mixBits(uint64_t z) {
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+}
+
+// Step a splitmix64 counter, which we only use to fill in xoshiro state
+
+uint64_t splitMix(uint64_t *x) {
+	*x += 0x9E3779B97F4A7C15ULL;
+
+	return mixBits(*x);
+}
+
+// Seed a random stream. Different stream numbers give unrelated sequences from the same seed
+
+void seedRNG(rng_state *r, uint64_t seed, uint64_t stream) {
+	uint64_t x;
+	int i;
+
+	x = mixBits(seed) ^ mixBits(stream + 0x9E3779B97F4A7C15ULL);
+
+	for (i = 0; i < 4; i++) {
+		r->s[i] = splitMix(&x);
+	}
+}
+
+// Get the next 64 random bits from a stream (xoshiro256**)
+
+uint64_t nextRandom(rng_state *r) {
+	uint64_t *s = r->s;
+	uint64_t result, t;
+
+	result = s[1] * 5;
+	result = ((result << 7) | (result >> 57)) * 9;
+
+	t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+
+	s[2] ^= t;
+	s[3] = (s[3] << 45) | (s[3] >> 19);
+
+	return result;
+}
+
+// A random number from 0 up to (but not including) 1
+
+double randomDouble(rng_state *r) {
+	return (nextRandom(r) >> 11) * (1.0 / 9007199254740992.0);	// 53 bits, all a double can hold
+}
+
+// A random number from 0 to n - 1
+
+int randomInt(rng_state *r, int n) {
+	return (int) (((nextRandom(r) >> 32) * (uint64_t) n) >> 32);
+}
+
 // Prepare the start board with some random moves on it
 
-void setupStartBoard(int *startBorad) {
+void setupStartBoard(int *startBorad, rng_state *rng) {
 	// OK, first things first, do we want the board empty or filled?
 
-	if (rand() >= (RAND_MAX / 2)) {
+	if (randomDouble(rng) >= 0.5) {
 		// It should have initial moves
 		// How many lines do we want to make?
 
-		int c = rand() % 15 + 1;	// Up to 15 lines
+		int c = randomInt(rng, 15) + 1;	// Up to 15 lines
 
 		int i, sx, sy, ex, ey;
 
 		for (i = 0; i <= c; i++) {
-			if (rand() % 2 == 1) {
+			if (randomInt(rng, 2) == 1) {
 				// Virticle line
-				sx = rand() % (boardWidth + 1);
+				sx = randomInt(rng, boardWidth + 1);
 				ex = sx;
 
-				sy = rand() % (boardHeight + 1);
-				ey = rand() % (boardHeight + 1);
+				sy = randomInt(rng, boardHeight + 1);
+				ey = randomInt(rng, boardHeight + 1);
 
 				if (sy > ey) {
 					int t = sy;
@@ -166,11 +472,11 @@ void setupStartBoard(int *startBorad) {
 				}
 			} else {
 				// Horizontal line
-				sy = rand() % (boardHeight + 1);
+				sy = randomInt(rng, boardHeight + 1);
 				ey = sy;
 
-				sx = rand() % (boardWidth + 1);
-				ex = rand() % (boardWidth + 1);
+				sx = randomInt(rng, boardWidth + 1);
+				ex = randomInt(rng, boardWidth + 1);
 
 				if (sx > ex) {
 					int t = sx;
@@ -193,7 +499,10 @@ void setupStartBoard(int *startBorad) {
 
 // Simulate sexual reproduction between two parent DNAs with mutation
 
-dna *haveSex(dna *a, dna *b) {
+dna *haveSex(dna *a, dna *b, rng_state *rng) {
+	double d;
+	int i;
+
 	// First, allocate a new DNA structure for the child
 
 	dna *c = malloc(sizeof(dna));
@@ -207,268 +516,193 @@ dna *haveSex(dna *a, dna *b) {
 
 	copyDNA(a, c);
 
-	// Now we go through and randomly replace A's genes with B's
+	if (b->geneCount > c->geneCount)
+		c->geneCount = b->geneCount;	// A's missing genes are 0, B's can still win
 
-	double r = (((double) rand()) / ((double) RAND_MAX));
+	// Now we go through and randomly replace A's genes with B's
 
-	if (r >= 0.5) {
-		c->noBasePair = b->noBasePair;
+	for (i = 0; i < (int) c->geneCount; i++) {
+		if (randomDouble(rng) >= 0.5)
+			c->genes[i] = b->genes[i];
 	}
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+	// Now that that's done, let's do some mutation. Each gene has its own window, so one changes
 
-	if (r >= 0.5) {
-		c->oneBasePair = b->oneBasePair;
-	}
+	if (randomDouble(rng) <= MUTATION_RATE) {
+		// 'Twill be a mutant, it will.
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+		i = randomInt(rng, c->geneCount);
 
-	if (r >= 0.5) {
-		c->twoBasePair = b->twoBasePair;
-	}
+		d = randomDouble(rng) * c->genes[i];	// 0-100% of base pair
+
+		if (randomDouble(rng) >= 0.5) {
+			d = d * -1.0;	// Make it negative
+		}
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+		c->genes[i] = c->genes[i] + d;	// Do the mutation
 
-	if (r >= 0.5) {
-		c->threeBasePair = b->threeBasePair;
+		if (c->genes[i] < -GENE_LIMIT) {	// Check the bounds
+			c->genes[i] = -GENE_LIMIT;
+		} else if (c->genes[i] > GENE_LIMIT) {
+			c->genes[i] = GENE_LIMIT;
+		}
 	}
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+	// That's it, return the child.
+	
+	return c;
+}
 
-	if (r >= 0.5) {
-		c->lineLengthBasePair = b->lineLengthBasePair;
-	}
+// Copy DNA from one memory location to another
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+void copyDNA(dna *s, dna *d) {
+	memcpy(d, s, sizeof(dna));
+}
 
-	if (r >= 0.5) {
-		c->currentMarginBasePair = b->currentMarginBasePair;
-	}
+// Open the game log and its index for a worker. We add on to them if they are already there
 
-	// Now that that's done, let's do some mutation
+void openGameLog(int worker) {
+	char name[80];
+	game_log_header header;
 
-	double d;
+	sprintf(name, GAME_LOG_NAME, worker);
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+	gameLog = fopen(name, "ab");
 
-	if (r <= MUTATION_RATE) {
-		// 'Twill be a mutant, it will.
+	if (gameLog == null) {
+		printf("Unable to open the game log '%s': error %d.\n", name, errno);
+		exit(1);
+	}
 
-		r = (((double) rand()) / ((double) RAND_MAX));
+	sprintf(name, GAME_INDEX_NAME, worker);
 
-		if (r <= (1.0 / 6.0)) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->noBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
-			}
-	
-			c->noBasePair = c->noBasePair + d;	// Do the mutation
-	
-			if ((c->noBasePair < -6.0) || (c->noBasePair > 6.0)) {
-				// Check the bounds
-	
-				if (c->noBasePair < -6.0) {
-					c->noBasePair = -6.0;
-				} else {
-					c->noBasePair = 6.0;
-				}
-			}
-		}
+	gameIndex = fopen(name, "ab");
 
-		if ((r > (1.0 / 6.0)) && (r <= (2.0 / 6.0))) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->oneBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
-			}
-	
-			c->oneBasePair = c->oneBasePair + d;	// Do the mutation
-	
-			if ((c->oneBasePair < -6.0) || (c->oneBasePair > 6.0)) {
-				// Check the bounds
-	
-				if (c->oneBasePair < -6.0) {
-					c->oneBasePair = -6.0;
-				} else {
-					c->oneBasePair = 6.0;
-				}
-			}
-		}
-	
-		if ((r > (1.0 / 6.0)) && (r <= (2.0 / 6.0))) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->twoBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
-			}
-	
-			c->twoBasePair = c->twoBasePair + d;	// Do the mutation
-	
-			if ((c->twoBasePair < -6.0) || (c->twoBasePair > 6.0)) {
-				// Check the bounds
-	
-				if (c->twoBasePair < -6.0) {
-					c->twoBasePair = -6.0;
-				} else {
-					c->twoBasePair = 6.0;
-				}
-			}
-		}
-	
-		r = (((double) rand()) / ((double) RAND_MAX));
-	
-		if (r <= MUTATION_RATE) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->threeBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
-			}
-	
-			c->threeBasePair = c->threeBasePair + d;	// Do the mutation
-	
-			if ((c->threeBasePair < -6.0) || (c->threeBasePair > 6.0)) {
-				// Check the bounds
-	
-				if (c->threeBasePair < -6.0) {
-					c->threeBasePair = -6.0;
-				} else {
-					c->threeBasePair = 6.0;
-				}
-			}
-		}
-	
-		r = (((double) rand()) / ((double) RAND_MAX));
-	
-		if (r <= MUTATION_RATE) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->lineLengthBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
-			}
-	
-			c->lineLengthBasePair = c->lineLengthBasePair + d;	// Do the mutation
-	
-			if ((c->lineLengthBasePair < -6.0) || (c->lineLengthBasePair > 6.0)) {
-				// Check the bounds
-	
-				if (c->lineLengthBasePair < -6.0) {
-					c->lineLengthBasePair = -6.0;
-				} else {
-					c->lineLengthBasePair = 6.0;
-				}
-			}
-		}
-	
-		r = (((double) rand()) / ((double) RAND_MAX));
-	
-		if (r <= MUTATION_RATE) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->currentMarginBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
-			}
-	
-			c->currentMarginBasePair = c->currentMarginBasePair + d;	// Do the mutation
-	
-			if ((c->currentMarginBasePair < -6.0) || (c->currentMarginBasePair > 6.0)) {
-				// Check the bounds
-	
-				if (c->currentMarginBasePair < -6.0) {
-					c->currentMarginBasePair = -6.0;
-				} else {
-					c->currentMarginBasePair = 6.0;
-				}
-			}
-		}
+	if (gameIndex == null) {
+		printf("Unable to open the game index '%s': error %d.\n", name, errno);
+		exit(1);
 	}
 
-	// That's it, return the child.
-	
-	return c;
-}
+	// Games are small, so we let them pile up and write them out in big chunks
 
-// Copy a move from one memory location to another
+	setvbuf(gameLog, null, _IOFBF, GAME_LOG_BUFFER);
+	setvbuf(gameIndex, null, _IOFBF, GAME_LOG_BUFFER / 16);
 
-void copyMove(volatile move *s, move *d) {
-	d->from_x = s->from_x;
-	d->from_y = s->from_y;
-	d->to_x = s->to_x;
-	d->to_y = s->to_y;
-	d->score = s->score;
-}
+	// Only a brand new log needs a header
 
-// Copy DNA from one memory location to another
+	fseek(gameIndex, 0, SEEK_END);
+	gameIndexOffset = ftell(gameIndex);
 
-void copyDNA(dna *s, dna *d) {
-	d->noBasePair = s->noBasePair;
-	d->oneBasePair = s->oneBasePair;
-	d->twoBasePair = s->twoBasePair;
-	d->threeBasePair = s->threeBasePair;
-	d->lineLengthBasePair = s->lineLengthBasePair;
-	d->currentMarginBasePair = s->currentMarginBasePair;
+	fseek(gameLog, 0, SEEK_END);
+	gameLogOffset = ftell(gameLog);
+
+	if (gameLogOffset == 0) {
+		memcpy(header.magic, GAME_LOG_MAGIC, 4);
+		header.version = GAME_LOG_VERSION;
+
+		if (fwrite(&header, sizeof(game_log_header), 1, gameLog) != 1) {
+			printf("Unable to write the game log header: error %d.\n", errno);
+			exit(1);
+		}
+
+		gameLogOffset = sizeof(game_log_header);
+	}
 }
 
-// A function to clear the list of moves
+// Add a game that was just played (from startBoard and its moves) to the game log
 
-void clearMoves() {
-	if (moveNum > 1) {
-		int i;
+void logGame(uint32_t stream, int playerOneNumber, dna *playerOne, int playerTwoNumber, dna *playerTwo, int winner,
+				packed_move *moves, int moveCount) {
+	game_record r;
+	uint8_t cells[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	int i;
 
-		for (i = 0; i < moveNum - 1; i++) {
-			free(moveList[i]);
-			moveList[i] = null;
-		}
+	memset(&r, 0, sizeof(game_record));	// So no stray padding ends up in the file
+
+	r.seed = masterSeed;
+	r.stream = stream;
+	r.playerOneNumber = playerOneNumber;
+	r.playerTwoNumber = playerTwoNumber;
+	copyDNA(playerOne, &(r.playerOne));
+	copyDNA(playerTwo, &(r.playerTwo));
+	r.width = boardWidth;
+	r.height = boardHeight;
+	r.winner = winner;
+	r.moveCount = moveCount;
+
+	for (i = 0; i < boardWidth * boardHeight; i++) {
+		cells[i] = startBoard[i];
 	}
 
-	moveNum = 1;
+	if ((fwrite(&gameLogOffset, sizeof(uint64_t), 1, gameIndex) != 1) ||
+			(fwrite(&r, sizeof(game_record), 1, gameLog) != 1) ||
+			(fwrite(cells, 1, boardWidth * boardHeight, gameLog) != (size_t) (boardWidth * boardHeight)) ||
+			(fwrite(moves, sizeof(packed_move), r.moveCount, gameLog) != r.moveCount)) {
+		printf("Unable to write to the game log: error %d.\n", errno);
+		exit(1);
+	}
+
+	gameLogOffset += sizeof(game_record) + boardWidth * boardHeight + r.moveCount * sizeof(packed_move);
+	gameIndexOffset += sizeof(uint64_t);
 }
 
-// A function to read the last move in from a file
+// Write out anything still buffered and close the game log
 
-move *readLastMove(char *fileName) {
-	FILE *temp = null;
+void closeGameLog() {
+	if (gameLog != null)
+		fclose(gameLog);
 
-	temp = fopen(fileName, "r");
+	if (gameIndex != null)
+		fclose(gameIndex);
 
-	if (temp == null) {
-		printf("Unable to open file '%s': error %d.\n", fileName, errno);
+	gameLog = null;
+	gameIndex = null;
+}
+
+// Cut the game log and index back to where they ended at a checkpoint. The games after that are
+// played again, and if we were killed while writing one its record is only partly there
+
+void trimGameLog(uint64_t logEnd, uint64_t indexEnd) {
+	if ((logEnd > gameLogOffset) || (indexEnd > gameIndexOffset)) {
+		printf("The game log is shorter than the checkpoint says it should be.\n");
 		exit(1);
 	}
 
-	char buffer[80];
-
-	if (fgets(buffer, 80, temp) == null) {
-		fclose(temp);
-		printf("Unable to read from the file: %d.\n", errno);
+	if ((fflush(gameLog) != 0) || (fflush(gameIndex) != 0) ||
+			(ftruncate(fileno(gameLog), logEnd) != 0) || (ftruncate(fileno(gameIndex), indexEnd) != 0)) {
+		printf("Unable to trim the game log: error %d.\n", errno);
 		exit(1);
 	}
 
-	fclose(temp);
-/*
-	move *tempM = makeMove(charToColumn(buffer[0]), buffer[1] - '1', charToColumn(buffer[3]), buffer[4] - '1');
-	
-	buffer[5] = '\0';
+	gameLogOffset = logEnd;
+	gameIndexOffset = indexEnd;
+}
 
-	char fx, tx, fy, ty;
+// A checkpoint that's still there when a new tourney starts is from one that never finished,
+// finished tourneys remove theirs. Cut its games back out of the game log, so the log only
+// ever has whole tourneys in it, and forget about it
 
-	fx = columnToChar(tempM->from_x);
-	tx = columnToChar(tempM->to_x);
-	
-	fy = '0' + tempM->from_y;
-	ty = '0' + tempM->to_y;
+void dropUnfinishedTourney() {
+	checkpoint_header header;
+	FILE *in = null;
 
-	printf("Read: '%s', see as '%c%c %c%c'\n", buffer, fx, fy, tx, ty);
+	in = fopen(CHECKPOINT_NAME, "rb");
 
-	return tempM;
-*/
-	return makeMove(charToColumn(buffer[0]), buffer[1] - '1', charToColumn(buffer[3]), buffer[4] - '1');
+	if (in == null)
+		return;		// The last tourney finished
+
+	if ((fread(&header, sizeof(checkpoint_header), 1, in) != 1) || (memcmp(header.magic, CHECKPOINT_MAGIC, 4) != 0) ||
+				(header.version != CHECKPOINT_VERSION) || (header.logStart > gameLogOffset) ||
+				(header.indexStart > gameIndexOffset)) {
+		printf("'%s' is from a tourney that never finished, but it doesn't fit the game log. Its games stay in the log.\n",
+					CHECKPOINT_NAME);
+	} else {
+		printf("Dropping the games of the unfinished tourney in '%s' from the game log.\n", CHECKPOINT_NAME);
+		trimGameLog(header.logStart, header.indexStart);
+	}
+
+	fclose(in);
+	unlink(CHECKPOINT_NAME);
 }
 
 // A function to write the game out to the given file name
@@ -476,14 +710,14 @@ move *readLastMove(char *fileName) {
 void writeGame(char *fileName) {
 	FILE *temp = null;
 
-	if (moveNum >= 136) {
+	if (moveNum > MAX_GAME_MOVES + 1) {
 		printf("Ran out of moves! Something has gone wrong!\n");
 		exit(1);
 	}
 
 	temp = fopen(fileName, "w");
 
-	char fromXChar, toXChar, fromYChar, toYChar;
+	char fromXChar, toXChar;
 
 	if (temp == null) {
 		printf("Unable to open file '%s': error %d.\n", fileName, errno);
@@ -495,13 +729,13 @@ void writeGame(char *fileName) {
 	fprintf(temp, "2 %d %f\n", playerTwoScore, playerTwoTimeLeft);
 
 	int i, p;
+	int fromX, fromY, toX, toY;
 
 	for (i = 1; i < moveNum - 1; i++) {
-		fromXChar = columnToChar(moveList[i]->from_x);
-		toXChar = columnToChar(moveList[i]->to_x);
-	
-		fromYChar = '1' + moveList[i]->from_y;
-		toYChar = '1' + moveList[i]->to_y;
+		unpackMove(moveList[i], &fromX, &fromY, &toX, &toY);
+
+		fromXChar = columnToChar(fromX);
+		toXChar = columnToChar(toX);
 
 		if (i % 2 == 1) {
 			p = 1;
@@ -509,7 +743,7 @@ void writeGame(char *fileName) {
 			p = 2;
 		}
 
-		fprintf(temp, "%d %c%c %c%c\n", p, fromXChar, fromYChar, toXChar, toYChar);
+		fprintf(temp, "%d %c%d %c%d\n", p, fromXChar, fromY + 1, toXChar, toY + 1);
 	}
 
 	fclose(temp);
@@ -525,12 +759,12 @@ int gameIsOver(int *board) {
 
 	for (y = 0; y < boardHeight; y++) {
 		for (x = 0; x < boardWidth; x++) {
-			if ((gameBoard[xyToIndex(x, y)] & FULL_BOX) != FULL_BOX) {
+			if ((board[xyToIndex(x, y)] & FULL_BOX) != FULL_BOX) {
 				return NO_WINNER_YET;
 			} else {
-				if ((gameBoard[xyToIndex(x, y)] & OWNER_MASK) == OWNED_BY_PLAYER_ONE) {
+				if ((board[xyToIndex(x, y)] & OWNER_MASK) == OWNED_BY_PLAYER_ONE) {
 					pOne++;
-				} else if ((gameBoard[xyToIndex(x, y)] & OWNER_MASK) == OWNED_BY_PLAYER_TWO) {
+				} else if ((board[xyToIndex(x, y)] & OWNER_MASK) == OWNED_BY_PLAYER_TWO) {
 					pTwo++;
 				}
 			}
@@ -547,7 +781,7 @@ int gameIsOver(int *board) {
 		return PLAYER_TIE;
 }
 
-// A function to load DNA from a file
+// A function to load DNA from a file, one gene a line
 
 void loadDNA(char *path, dna *dest) {
 	// Stuff we'll need
@@ -568,127 +802,72 @@ void loadDNA(char *path, dna *dest) {
 
 	// Now that the file is open, we'll read it
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the first base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
-	}
-
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the first base pair.\n");
-		fclose(in);
-		exit(1);
-	}
-
-	dest->noBasePair = temp;
-
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the second base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
-	}
-
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the second base pair.\n");
-		fclose(in);
-		exit(1);
-	}
-
-	dest->oneBasePair = temp;
-
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the third base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
-	}
-
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the third base pair.\n");
-		fclose(in);
-		exit(1);
-	}
-
-	dest->twoBasePair = temp;
-
-
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the fourth base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
-	}
-
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the fourth base pair.\n");
-		fclose(in);
-		exit(1);
-	}
-
-	dest->threeBasePair = temp;
-
-
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the fifth base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
-	}
-
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the fifth base pair.\n");
-		fclose(in);
-		exit(1);
-	}
+	memset(dest, 0, sizeof(dna));
 
-	dest->lineLengthBasePair = temp;
+	while ((dest->geneCount < MAX_GENES) && (fgets(buffer, 80, in) != null)) {
+		if (strncmp(buffer, STEPS_MARKER, strlen(STEPS_MARKER)) == 0)
+			break;	// Only breeding needs the step sizes
 
+		if (sscanf(buffer, "%lf", &temp) != 1) {
+			printf("Unable to interpret base pair %d of '%s'.\n", dest->geneCount + 1, path);
+			fclose(in);
+			exit(1);
+		}
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the sixth base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
+		dest->genes[dest->geneCount++] = temp;
 	}
 
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the sixth base pair.\n");
+	if (dest->geneCount < BASE_GENES) {
+		printf("'%s' only has %d base pairs, DNA needs at least %d.\n", path, dest->geneCount, BASE_GENES);
 		fclose(in);
 		exit(1);
 	}
 
-	dest->currentMarginBasePair = temp;
-
 	// We're done
 
 	fclose(in);
-
-	// A debug check
 }
 
-void runMoveWithStruct(int player, move *theMove, int *theBoard) {
-//	printf("Before...\n");
-//	printBoard(gameBoard);
-	runMove(player, theMove->from_x, theMove->from_y, theMove->to_x, theMove->to_y, false, theBoard);
-//	printf("After...\n");
-//	printBoard(gameBoard);
-//	printf("-------------");
+// Pack a move into 19 bits. From the top down that's 1 bit saying the line is virticle,
+// 6 bits for the row or column it is on, then 6 bits each for where it starts and ends
+
+packed_move packMove(int from_x, int from_y, int to_x, int to_y) {
+	if (from_x == to_x)
+		return MOVE_VERTICAL | (from_x << (2 * MOVE_FIELD_BITS)) | (from_y << MOVE_FIELD_BITS) | to_y;
+	else
+		return (from_y << (2 * MOVE_FIELD_BITS)) | (from_x << MOVE_FIELD_BITS) | to_x;
 }
 
-// A function to allocate a move for us
+// Get the coordinates back out of a packed move
 
-move *makeMove(int x_start, int y_start, int x_end, int y_end) {
-	move *temp = malloc(sizeof(move));
+void unpackMove(packed_move theMove, int *from_x, int *from_y, int *to_x, int *to_y) {
+	int line, start, end;
 
-	if (temp == null) {
-		printf("Unable to allocate a new move structure!\n");
-		exit(1);
+	line = (theMove >> (2 * MOVE_FIELD_BITS)) & MOVE_FIELD_MASK;
+	start = (theMove >> MOVE_FIELD_BITS) & MOVE_FIELD_MASK;
+	end = theMove & MOVE_FIELD_MASK;
+
+	if (theMove & MOVE_VERTICAL) {
+		*from_x = line;
+		*to_x = line;
+		*from_y = start;
+		*to_y = end;
+	} else {
+		*from_y = line;
+		*to_y = line;
+		*from_x = start;
+		*to_x = end;
 	}
+}
+
+// Call runMove using a packed move
 
-	temp->from_x = x_start;
-	temp->from_y = y_start;
-	temp->to_x = x_end;
-	temp->to_y = y_end;
+void runPackedMove(int player, packed_move theMove, int *theBoard) {
+	int from_x, from_y, to_x, to_y;
 
-	temp->score = 0.0;
+	unpackMove(theMove, &from_x, &from_y, &to_x, &to_y);
 
-	return temp;	// The caller must free the structure, it's their job now.
+	runMove(player, from_x, from_y, to_x, to_y, false, theBoard);
 }
 
 // A function to copy a board to another
@@ -746,15 +925,21 @@ int countLines(int *board, int x, int y) {
 	}
 }
 
-// A function to turn a char column specifier into a number we can use
+// A function to turn a char column specifier into a number we can use. Columns go A to Z, then a to z
 
 int charToColumn(char c) {
+	if ((c >= 'a') && (c <= 'z'))
+		return (((int) c) - ((int) 'a')) + 26;
+
 	return (((int) c) - ((int) 'A'));
 }
 
 // A function to turn a column number we use into a column character that is expected as input
 
 char columnToChar(int x) {
+	if (x >= 26)
+		return (char) (x - 26 + (int) 'a');
+
 	return (char) (x + (int) 'A');
 }
 
@@ -978,676 +1163,1479 @@ void printBoard(int *board) {
 	printf("\n");
 }
 
-// The main function. All hail main!
+// Make a new shared memory segment with room for size bytes after its header. We use an anonymous memfd
+// that workers inherit when we can, so nothing is left behind if we crash. Otherwise we fall back to
+// shm_open with a name no other run will use
 
-int main(int argc, char** argv) {
+shared_segment *createSegment(size_t size) {
+	shared_segment *s;
+	segment_header *h;
+	static int registered = false;
+	static int made = 0;
 
-	// Seed the RNG
+	if (segmentCount >= MAX_SEGMENTS) {
+		printf("Too many shared memory segments, we only allow %d.\n", MAX_SEGMENTS);
+		exit(1);
+	}
 
-	srand((unsigned) time(NULL));
+	s = &(segments[segmentCount]);
 
-	// Based on argv, we have to figure out what we want to do
+	memset(s, 0, sizeof(shared_segment));
 
-	if (argc == 1) {
-		printf("\nPlease call like: /path/to/master /path/to/lab [m c s]|[i c s]\n\n");
-		printf("m - Make DNA, c is the number of DNA files, s is start num\n");
-		printf("i - Run a tourney with IPC, using dna numbers starting at s, count c\n\n");
-		printf("DNA files are text and end in .DNA\n");
-		printf("Tourneys place the starting board in startingBoard.txt,\n");
-		printf("\tand a results file in results.html.\n");
-		printf("\n");
-		
-		return 0;
-	} else if (argc != 5) {
-		printf("Not enough arguments, call the program with no arguments for instructions.\n");
-		return 0;
+	s->size = sizeof(segment_header) + size;
+	s->fd = syscall(SYS_memfd_create, "lab-ipc", 0);	// No MFD_CLOEXEC, the workers need it
+
+	if (s->fd >= 0) {
+		sprintf(s->name, "fd:%d", s->fd);
+	} else {
+		do {
+			sprintf(s->name, SEGMENT_NAME, (int) getpid(), made++);
+			s->fd = shm_open(s->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		} while ((s->fd < 0) && (errno == EEXIST));
+
+		if (s->fd < 0) {
+			printf("Unable to ask for shared memory: error %d.\n", errno);
+			exit(1);
+		}
+
+		s->named = true;
 	}
 
-	// So, now we have to figure out which thing they want to do
+	if (!registered) {
+		atexit(destroySegments);	// However we quit, the memory goes with us
+		registered = true;
+	}
 
-	if (argv[2][0] == 'm') {
-		// They want to make DNA
+	segmentCount++;
 
-		int startNum, theCount;
-		int got;
-		double tempNum;
+	if (ftruncate(s->fd, s->size) != 0) {
+		printf("Unable to size the shared memory: error %d.\n", errno);
+		exit(1);
+	}
 
-		// We need to parse some things
+	s->memory = mmap(null, s->size, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
 
-		got = sscanf(argv[3], "%d", &theCount);
+	if (s->memory == MAP_FAILED) {
+		printf("Unable to map the shared memory: error %d.\n", errno);
+		s->memory = null;
+		exit(1);
+	}
 
-		if (got == -1) {
-			printf("Unable to read 'c'.\n");
-			return 1;
-		}
+	memset(s->memory, 0, s->size);
 
-		if (theCount <= 0) {
-			printf("The count needs to be greater than 0.\n");
-			return 1;
-		}
+	h = (segment_header *) s->memory;
 
-		got = sscanf(argv[4], "%d", &startNum);
+	memcpy(h->magic, SEGMENT_MAGIC, 4);
+	h->version = IPC_VERSION;
+	h->size = s->size;
 
-		if (got == -1) {
-			printf("Unable to read 's'.\n");
-			return 1;
-		}
+	return s;
+}
 
-		if (startNum <= 0) {
-			printf("The start needs to be greater than 0.\n");
-			return 1;
-		}
+// Where the caller's part of a segment starts
 
-		// Now that we've got that, let's do our work
+void *segmentData(shared_segment *s) {
+	return (char *) s->memory + sizeof(segment_header);
+}
 
-		printf("Starting DNA output...\n");
+// Take the name of a segment away once everyone who needs it has it open
 
-		char buffer[80];
-		FILE *theFile;
-		int i, j;
+void unlinkSegment(shared_segment *s) {
+	if (s->named)
+		shm_unlink(s->name);
 
-		for (i = startNum; i < startNum + theCount; i++) {
-			// First, generate the file name that we'll be using
+	s->named = false;
+}
 
-			sprintf(buffer, "%d.dna\0", i);
+// Let go of a segment, it disappears once the workers let go too
 
-			// Now, open the file
+void destroySegment(shared_segment *s) {
+	if (s->memory != null)
+		munmap(s->memory, s->size);
 
-			theFile = null;
-			theFile = fopen(buffer, "w");
+	if (s->fd >= 0)
+		close(s->fd);
 
-			if (theFile == null) {
-				printf("Unable to open '%s' for writing DNA: error %d.\n", buffer, errno);
-				return 1;
-			}
-			
-			// Now, do the work
+	unlinkSegment(s);
 
-			for (j = 0; j < 6; j++) {
-				tempNum = ((double) rand()) / ((double) RAND_MAX);	// Number from 0 ot 1
-				tempNum = tempNum * 2.0;							// Number from 0 to 2
-				tempNum = tempNum - 1.0;							// Number from -1 to 1
-				fprintf(theFile, "%f\n", tempNum);
-			}
+	s->memory = null;
+	s->fd = -1;
+}
 
-			// Close the file
+// Get rid of every segment we made
 
-			fclose(theFile);
+void destroySegments() {
+	int i;
 
-			printf("Wrote number %d...\r", i);
-		}
+	for (i = 0; i < segmentCount; i++) {
+		destroySegment(&(segments[i]));
+	}
 
-		// Done doing that
+	segmentCount = 0;
+}
 
-		printf("Done writing DNA.\n\n");
+// Sleep until someone rings the bell (it stops being seen), or ms go by
 
-	} else if (argv[2][0] == 'i') {
-		// They want to run a tourney with IPC
+void ringWait(uint32_t *bell, uint32_t seen, int ms) {
+	struct timespec t;
 
-		int startNum, theCount;
-		int got;
-		int useIPC = 0;
+	t.tv_sec = ms / 1000;
+	t.tv_nsec = (ms % 1000) * 1000000L;
 
-		// We need to parse some things
+	syscall(SYS_futex, bell, FUTEX_WAIT, seen, &t, null, 0);
+}
 
-		got = sscanf(argv[3], "%d", &theCount);
+// Ring a bell, waking up to sleepers processes waiting on it
 
-		if (got == -1) {
-			printf("Unable to read 'c'.\n");
-			return 1;
-		}
+void ringBell(uint32_t *bell, int sleepers) {
+	__atomic_add_fetch(bell, 1, __ATOMIC_RELEASE);
 
-		if (theCount <= 0) {
-			printf("The count needs to be greater than 0.\n");
-			return 1;
-		}
+	syscall(SYS_futex, bell, FUTEX_WAKE, sleepers, null, null, 0);
+}
 
-		got = sscanf(argv[4], "%d", &startNum);
+// How many lines a board has. Edge bitsets have a bit for each, the horizontal lines
+// a row at a time starting from the top, then the vertical ones the same way
 
-		if (got == -1) {
-			printf("Unable to read 's'.\n");
-			return 1;
-		}
+int edgeCount(int width, int height) {
+	return width * (height + 1) + (width + 1) * height;
+}
 
-		if (startNum <= 0) {
-			printf("The start needs to be greater than 0.\n");
-			return 1;
-		}
+// How much room a ring slot needs for a board this size. A game can't have more moves than the
+// board has lines, so that's how many we leave room for. Kept a multiple of 8 so slots line up
 
-		// Prepare the arrays
+uint32_t ringSlotSize(int width, int height) {
+	size_t size;
 
-		winsArray = null;
-		lossesArray = null;
-		tiesArray = null;
+	size = SLOT_HEADER_SIZE;
+	size += ((edgeCount(width, height) + 63) / 64) * sizeof(uint64_t);
+	size += edgeCount(width, height) * sizeof(packed_move);
 
-		winsArray = malloc(sizeof(int) * theCount);
+	return (size + 7) & ~7;
+}
 
-		if (winsArray == null) {
-			printf("Unable to allocate wins array.\n");
-			exit(1);
-		} else {
-			memset(winsArray, 0, sizeof(int) * theCount);
-		}
+// Find slot i of the ring
 
-		lossesArray = malloc(sizeof(int) * theCount);
+ipc_slot *ringSlot(ipc_ring *r, int i) {
+	return (ipc_slot *) ((char *) r + sizeof(ipc_ring) + (size_t) i * r->slotSize);
+}
 
-		if (lossesArray == null) {
-			printf("Unable to allocate losses array.\n");
-			exit(1);
-		} else {
-			memset(lossesArray, 0, sizeof(int) * theCount);
-		}
-		
-		tiesArray = malloc(sizeof(int) * theCount);
+// The start board of the game in a slot, as an edge bitset
 
-		if (tiesArray == null) {
-			printf("Unable to allocate ties array.\n");
-			exit(1);
-		} else {
-			memset(tiesArray, 0, sizeof(int) * theCount);
-		}
+uint64_t *slotEdges(ipc_slot *slot) {
+	return (uint64_t *) ((char *) slot + SLOT_HEADER_SIZE);
+}
 
-		timeArray = malloc(sizeof(double) * theCount);
+// The moves made so far in the game in a slot
 
-		if (timeArray == null) {
-			printf("Unable to allocate time array.\n");
-			exit(1);
-		} else {
-			memset(timeArray, 0, sizeof(double) * theCount);
-		}
+packed_move *slotMoves(ipc_slot *slot, int width, int height) {
+	return (packed_move *) (slotEdges(slot) + (edgeCount(width, height) + 63) / 64);
+}
 
-		// Now, get the IPC memory
+// Turn the lines on a board into an edge bitset, see edgeCount for the order
 
-		key_t key = ftok("/tmp", 'I');	// Get a key
-		useIPC = shmget(key, sizeof(ipc_memory), 0664 | IPC_CREAT);	// Ask for the memory
+void packEdges(int *board, uint64_t *edges) {
+	int x, y, e, drawn;
 
-		if (useIPC <= 0) {
-			printf("Unable to ask for shared memory: error %d.\n", errno);
-			exit(1);
+	memset(edges, 0, ((edgeCount(boardWidth, boardHeight) + 63) / 64) * sizeof(uint64_t));
+
+	e = 0;
+
+	for (y = 0; y <= boardHeight; y++) {
+		for (x = 0; x < boardWidth; x++, e++) {
+			if (y < boardHeight)
+				drawn = board[xyToIndex(x, y)] & TOP_LINE;
+			else
+				drawn = board[xyToIndex(x, y - 1)] & BOTTOM_LINE;
+
+			if (drawn)
+				edges[e / 64] |= 1ULL << (e % 64);
 		}
+	}
 
-		ipc = (ipc_memory *) shmat(useIPC, 0, 0);	// Attach to the memory
+	for (y = 0; y < boardHeight; y++) {
+		for (x = 0; x <= boardWidth; x++, e++) {
+			if (x < boardWidth)
+				drawn = board[xyToIndex(x, y)] & LEFT_LINE;
+			else
+				drawn = board[xyToIndex(x - 1, y)] & RIGHT_LINE;
 
-		if (ipc == null) {
-			printf("Unable to attach to the IPC memory: error %d.\n", errno);
-			shmctl(useIPC, IPC_RMID, null);
-			exit(1);
+			if (drawn)
+				edges[e / 64] |= 1ULL << (e % 64);
 		}
+	}
+}
 
-		char keyPointer[80];
+// Put the ring in shared memory and start the lab processes that will serve it
 
-		sprintf(keyPointer, "%d", useIPC);	// The key we'll be passing
+void startWorkers(char *labPath, int workers, int slots) {
+	segment_header *header;
+	uint32_t seen;
+	int i, pid;
 
-		// First, we'll need an opening board, we'll generate a random size
+	ringSegment = createSegment(sizeof(ipc_ring) + (size_t) slots * ringSlotSize(boardWidth, boardHeight));
+	header = (segment_header *) ringSegment->memory;
+	ring = (ipc_ring *) segmentData(ringSegment);
 
-		boardWidth = rand() % 6 + 3;
-		boardHeight = rand() % 6 + 3;
+	ring->slotCount = slots;
+	ring->slotSize = ringSlotSize(boardWidth, boardHeight);
+	ring->width = boardWidth;
+	ring->height = boardHeight;
 
-		startBoard = malloc(boardWidth * boardHeight * sizeof(int));
+	atexit(stopWorkers);	// However we quit, the workers go with us (before the memory does)
 
-		if (startBoard == null) {
-			printf("Unable to allocate memory for the starting board.\n");
-			shmdt(ipc);
-			shmctl(useIPC, IPC_RMID, null);
+	fflush(stdout);		// So the workers don't inherit anything we haven't printed yet
+
+	for (i = 0; i < workers; i++) {
+		pid = fork();
+
+		if (pid < 0) {
+			printf("Unable to fork!\n");
 			exit(1);
+		} else if (pid == 0) {
+			// We are the child, run the program
+			execl(labPath, "lab", "--ipc", ringSegment->name, (char *) null);
+			printf("Unable to run '%s': error %d.\n", labPath, errno);
+			_exit(1);	// Not exit, that would tear down the ring under the real workers
 		}
 
-		memset(startBoard, 0, boardWidth * boardHeight * sizeof(int));
+		workerPids[workerCount++] = pid;
+	}
 
-		gameBoard = (int *) &(ipc->gameBoard);
+	// Once they all have it mapped, nobody else needs to find it
 
-		memset(gameBoard, 0, boardWidth * boardHeight * sizeof(int));
+	while ((seen = __atomic_load_n(&(header->attached), __ATOMIC_ACQUIRE)) < (uint32_t) workers) {
+		ringWait(&(header->attached), seen, WORKER_CHECK_MS);
+		checkWorkers();
+	}
 
-		printf("Board will be %d rows, %d columns\n", boardHeight, boardWidth);
+	unlinkSegment(ringSegment);
+}
 
-		setupStartBoard(startBoard);
+// Make sure none of the workers has died on us
 
-//		printBoard(startBoard);
+void checkWorkers() {
+	int status;
+	pid_t pid;
 
-		// Set up the IPC memory
+	pid = waitpid(-1, &status, WNOHANG);
 
-		ipc->width = boardWidth;
-		ipc->height = boardHeight;
+	if (pid > 0) {
+		if (WIFSIGNALED(status))
+			printf("Lab worker %d was killed in the middle of the tourney by signal %d.\n", pid, WTERMSIG(status));
+		else
+			printf("Lab worker %d quit in the middle of the tourney, status %d.\n", pid, WEXITSTATUS(status));
 
-		// Write out the board to our temp file, and to our starting board file
+		exit(1);
+	}
+}
 
-		writeGame("startingBoard.txt");
+// Tell the workers to quit, wait for them, and let go of the ring
 
-		// Prepare the HTML file
+void stopWorkers() {
+	int i, status;
 
-		FILE *html = null;
+	if (ring == null)
+		return;
 
-		html = fopen("results.html", "w");
+	__atomic_store_n(&ring->stop, true, __ATOMIC_RELEASE);
 
-		if (html == null) {
-			printf("Unable to open results file: %d\n", errno);
-			shmdt(ipc);
-			shmctl(useIPC, IPC_RMID, null);
-			return 1;
-		}
+	ringBell(&ring->requestBell, INT_MAX);
 
-		fprintf(html, "<html><head><title>Tourney!</title></head><body>\n");
-		fprintf(html, "<table border=1>\n");
-		fprintf(html, "<tr><td>DNA</td>");
+	for (i = 0; i < workerCount; i++) {
+		waitpid(workerPids[i], &status, 0);
+	}
 
-		int i, j, k;
+	workerCount = 0;
 
-		for (i = startNum; i < startNum + theCount; i++) {
-			fprintf(html, "<td>%d</td>", i);
-		}
+	destroySegment(ringSegment);
 
-		fprintf(html, "<td>Totals</td><td>Points</td><td>Average Game Time</td></tr>\n");
+	ring = null;
+}
 
-		// Load up all the DNA we'll be needing
+// Set up a game to be played through the ring. Everything that doesn't change during the game
+// (the DNA and start board) goes in its slot now, so each move only has to add a little
 
-		printf("Loading DNA...");
+void startGame(int slot, tourney_game *g, int number, int playerOne, int playerTwo, uint32_t stream, dna *dnaArray) {
+	ipc_slot *s = ringSlot(ring, slot);
 
-		dna *dnaArray = malloc(sizeof(dna) * theCount);
+	g->active = true;
+	g->number = number;
+	g->playerOne = playerOne;
+	g->playerTwo = playerTwo;
+	g->stream = stream;
+	g->turn = PLAYER_ONE;
+	g->timeOne = 0.0;
+	g->timeTwo = 0.0;
 
-		if (dnaArray == null) {
-			printf("Unable to allocate space for the DNA array. Error %d.\n", errno);
-			shmdt(ipc);
-			shmctl(useIPC, IPC_RMID, null);
-			exit(1);
-		}
+	copyBoard(startBoard, g->board);
 
-		char a[80];
+	seedRNG(&(g->rng), masterSeed, stream);	// Each game gets its own random stream, so any one game can be replayed
 
-		for (i = 0; i < theCount; i++) {
-			sprintf(a, "%d.dna", i + startNum);
-			loadDNA(a, &(dnaArray[i]));
-		}
+	copyDNA(&(dnaArray[playerOne]), &(s->players[0]));
+	copyDNA(&(dnaArray[playerTwo]), &(s->players[1]));
 
-		printf(" OK\n");
+	packEdges(startBoard, slotEdges(s));
 
-		// Do it!
+	s->moveCount = 0;
+}
 
-		struct timeb s, e;
-		double timeDiff;
-		int tempPid;
+// Post the position in a game to its slot, so one of the workers makes the next move
 
-		for (i = startNum; i < startNum + theCount; i++) {
-			fprintf(html, "<tr><td>%d</td>", i);
+void postMove(int slot, tourney_game *g) {
+	ipc_slot *s = ringSlot(ring, slot);
 
-			for (j = startNum; j < i; j++) {
-				fprintf(html, "<td>&nbsp;</td>");
-			}
+	s->pOneScore = playerOneScore;
+	s->pTwoScore = playerTwoScore;
+	s->pOneTime = 60.0 - g->timeOne;
+	s->pTwoTime = 60.0 - g->timeTwo;
+	s->player = g->turn;
+	s->seed = nextRandom(&(g->rng));
 
-			for (j = i; j < startNum + theCount; j++) {
+	// Release, so whoever claims the slot sees everything we just wrote
 
-				// Prepare things
+	__atomic_store_n(&(s->state), SLOT_REQUEST, __ATOMIC_RELEASE);
 
-				int dnaAWins, dnaBWins, ties;
+	ringBell(&ring->requestBell, 1);
+}
 
-				dnaAWins = 0;
-				dnaBWins = 0;
-				ties = 0;
+// Take the move a worker made in a game, add it to the game's moves, and run it
 
-				playerOneScore = 0;
-				playerTwoScore = 0;
-				playerOneTimeLeft = 60.0;
-				playerTwoTimeLeft = 60.0;
+void takeMove(int slot, tourney_game *g) {
+	ipc_slot *s = ringSlot(ring, slot);
+	packed_move lastMove = s->chosenMove;
 
-				double totalATime = 0.0;
-				double totalBTime = 0.0;
+	if ((int) s->moveCount >= edgeCount(boardWidth, boardHeight)) {
+		printf("Ran out of moves! Something has gone wrong!\n");
+		exit(1);
+	}
 
-				moveNum = 1;
-				turn = PLAYER_ONE;
+	slotMoves(s, boardWidth, boardHeight)[s->moveCount++] = lastMove;
 
-				// OK, time to do it
+	if (g->turn == PLAYER_ONE) {
+		g->timeOne += s->seconds;
+	} else {
+		g->timeTwo += s->seconds;
+	}
 
-				copyBoard(startBoard, gameBoard);
+	runPackedMove(g->turn, lastMove, g->board);
 
-				clearMoves();
+	// Change turns
 
-//				printf("Running first game between %d and %d... ", i, j);
+	if (g->turn == PLAYER_ONE) {
+		g->turn = PLAYER_TWO;
+	} else {
+		g->turn = PLAYER_ONE;
+	}
+}
 
-//				printBoard(gameBoard);
+// Play every game of the tourney through the ring. Games are numbered so that games 2n and 2n + 1
+// are pair n, with the players swapped for the second one. Each result goes in results and the results stream
 
-				// First, A is 1, B is 2
+void playGames(int *pairA, int *pairB, int pairCount, int theCount, int startNum, dna *dnaArray,
+					results_matrix *results) {
+	tourney_game *games;
+	tourney_game *g;
+	game_result result;
+	int totalGames, nextGame, finished;
+	int slots, s, a, b, progress, winner;
+	uint32_t seen;
 
-				while(gameIsOver(gameBoard) == NO_WINNER_YET) {
+	totalGames = pairCount * 2;
+	slots = ring->slotCount;
 
-//					printf("Player %d's turn\n", turn);
-//					printf("----------------\n");
+	games = malloc(slots * sizeof(tourney_game));
 
-//					printBoard(gameBoard);
+	if (games == null) {
+		printf("Unable to allocate the games in progress.\n");
+		exit(1);
+	}
 
-					// Write out the way things are now
+	memset(games, 0, slots * sizeof(tourney_game));
 
-					ipc->pOneScore = playerOneScore;
-					ipc->pTwoScore = playerTwoScore;
-					ipc->pOneTime = playerOneTimeLeft;
-					ipc->pTwoTime = playerTwoTimeLeft;
-					ipc->player = turn;
+	// Games from before a resume are already in the results
 
-					if (turn == PLAYER_ONE) {
-						copyDNA(&(dnaArray[i - startNum]), &(ipc->theDNA));
-					} else {
-						copyDNA(&(dnaArray[j - startNum]), &(ipc->theDNA));
-					}
+	nextGame = 0;
+	finished = 0;
 
-					// Now, run the program, with appropriate inputs
+	for (s = 0; s < totalGames; s++) {
+		if (results->winners[s] != NO_WINNER_YET)
+			finished++;
+	}
 
-					ftime(&s);
+	while (finished < totalGames) {
+		// Note the bell before looking, so an answer that comes in while we look still wakes us
 
-					int forkResult = fork();
+		seen = __atomic_load_n(&ring->responseBell, __ATOMIC_ACQUIRE);
 
-					if (forkResult < 0) {
-						// Something went wrong
-						printf("Unable to fork!\n");
-						shmdt(ipc);
-						shmctl(useIPC, IPC_RMID, null);
-						exit(1);
-					} else if (forkResult == 0) {
-						// We are the child, run the program
-						execl(argv[1], "lab", "--ipc", keyPointer);
-						printf("Should never get here!\n");
-						shmdt(ipc);
-						shmctl(useIPC, IPC_RMID, null);
-						exit(1);
-					} else {
-						// We are the parrent, wait for the child
-						wait(&tempPid);
-						
-						if (WEXITSTATUS(tempPid)) {
-							printf("The forked process returned %d.\n", WEXITSTATUS(tempPid));
-							shmdt(ipc);
-							shmctl(useIPC, IPC_RMID, null);
-							exit(1);
-						}
-					}
+		progress = false;
 
-					ftime(&e);
+		for (s = 0; s < slots; s++) {
+			g = &(games[s]);
 
-					// Things have run, figure out how long it took
+			if (g->active) {
+				if (__atomic_load_n(&(ringSlot(ring, s)->state), __ATOMIC_ACQUIRE) != SLOT_DONE)
+					continue;
 
-					timeDiff = (e.time - s.time) + ((e.millitm - s.millitm) / 1000.0);
+				takeMove(s, g);
+				progress = true;
+			} else if (nextGame < totalGames) {
+				// A free slot, start the next game in it
 
-					if (turn == PLAYER_ONE) {
-						playerOneTimeLeft -= timeDiff;
-						totalATime += timeDiff;
-					} else {
-						playerTwoTimeLeft -= timeDiff;
-						totalBTime += timeDiff;
-					}
+				if (results->winners[nextGame] != NO_WINNER_YET) {
+					nextGame++;		// Finished before we resumed
+					s--;
+					continue;
+				}
 
-					// Get the move, save it, and run it
+				a = pairA[nextGame / 2];
+				b = pairB[nextGame / 2];
 
-					volatile move *tempMove = &(ipc->chosenMove);
+				if (nextGame % 2 == 0)
+					startGame(s, g, nextGame, a, b, STREAM_GAMES + 2 * (a * theCount + b), dnaArray);
+				else
+					startGame(s, g, nextGame, b, a, STREAM_GAMES + 2 * (a * theCount + b) + 1, dnaArray);
 
-					int index = moveNum - 1;
+				nextGame++;
+				progress = true;
+			} else {
+				continue;
+			}
 
-					moveNum++;
+			// Either move again or wrap the game up
 
-					move *lastMove = malloc(sizeof(move));
+			winner = gameIsOver(g->board);
 
-					if (lastMove == null) {
-						printf("Unable to allocate a temporary move. Error %d.\n", errno);
-						shmdt(ipc);
-						shmctl(useIPC, IPC_RMID, null);
-						exit(1);
-					}
+			if (winner == NO_WINNER_YET) {
+				postMove(s, g);
+				continue;
+			}
 
-					copyMove(tempMove, lastMove);
+			logGame(g->stream, g->playerOne + startNum, &(dnaArray[g->playerOne]),
+						g->playerTwo + startNum, &(dnaArray[g->playerTwo]), winner,
+						slotMoves(ringSlot(ring, s), boardWidth, boardHeight), ringSlot(ring, s)->moveCount);
 
-					moveList[index] = lastMove;
+			result.number = g->number;
+			result.winner = winner;
+			result.timeOne = g->timeOne;
+			result.timeTwo = g->timeTwo;
 
-//					printf("Wants (%d, %d) to (%d, %d) for move %d\n\n", lastMove->from_x,
-//												lastMove->from_y, lastMove->to_x, lastMove->to_y, moveNum);
+			recordResult(results, &result);
+			queueResult(&result);	// Never waits on the disk unless it's thousands of games behind
 
-					runMoveWithStruct(turn, lastMove, gameBoard);
+			g->active = false;
+			__atomic_store_n(&(ringSlot(ring, s)->state), SLOT_FREE, __ATOMIC_RELAXED);
 
-//					printBoard(gameBoard);
+			finished++;
+			s--;	// Look at the slot again, so a new game can go in it
+		}
 
-					// Change turns
+		if (!progress) {
+			ringWait(&ring->responseBell, seen, WORKER_CHECK_MS);
+			checkWorkers();
+		}
+	}
 
-					if (turn == PLAYER_ONE) {
-						turn = PLAYER_TWO;
-					} else {
-						turn = PLAYER_ONE;
-					}
-				}
+	free(games);
+}
 
-//				printBoard(gameBoard);
+// Run a tourney between DNA startNum to startNum + theCount - 1, every one playing every other one
+// (and itself) twice, once going first. workers is how many lab processes play the games. With
+// resume everything but the workers comes from the checkpoint, and only unfinished games are played
 
-				int tempIndex;
+void runTourney(char *labPath, int theCount, int startNum, int workers, int width, int height, int resume) {
+	results_matrix results;
+	uint64_t logEnd, indexEnd;
+	int *pairA, *pairB;
+	int pairCount, pair;
+	int i, j, slots;
 
-				for (tempIndex = 0; tempIndex < moveNum - 2; tempIndex++) {
-					free(moveList[tempIndex]);
-				}
+	if (resume) {
+		readCheckpoint(CHECKPOINT_NAME, &results, &logEnd, &indexEnd);
 
-				// OK, that game is over. who won?
-				
-				int winner = gameIsOver(gameBoard);
-
-				if (winner == PLAYER_ONE) {
-//					printf("a wins\n");
-					dnaAWins++;
-					winsArray[i - startNum]++;
-					lossesArray[j - startNum]++;
-				} else if (winner == PLAYER_TWO) {
-//					printf("b wins\n");
-					dnaBWins++;
-					winsArray[j - startNum]++;
-					lossesArray[i - startNum]++;
-				} else {
-//					printf("tie\n");
-					ties++;
-					tiesArray[i - startNum]++;
-					tiesArray[j - startNum]++;
-				}
+		theCount = results.count;
+		startNum = results.startNum;
+	} else {
+		makeResults(&results, theCount, startNum);
+	}
 
-//				printBoard(gameBoard);
+	// Every pair plays, in the order they go in the results table
 
-				// Now, reverse A and B and run again
+	pairCount = results.pairCount;
 
-				playerOneScore = 0;
-				playerTwoScore = 0;
-				playerOneTimeLeft = 60.0;
-				playerTwoTimeLeft = 60.0;
+	pairA = malloc(sizeof(int) * pairCount);
+	pairB = malloc(sizeof(int) * pairCount);
 
-				moveNum = 1;
-				turn = PLAYER_ONE;
+	if ((pairA == null) || (pairB == null)) {
+		printf("Unable to allocate the pairings.\n");
+		exit(1);
+	}
 
-				// OK, time to do it
+	pair = 0;
 
-				copyBoard(startBoard, gameBoard);
+	for (i = 0; i < theCount; i++) {
+		for (j = i; j < theCount; j++) {
+			pairA[pair] = i;
+			pairB[pair] = j;
+			pair++;
+		}
+	}
 
-				clearMoves();
+	// First, we'll need an opening board, we'll generate a random size. The size is always drawn
+	// so a given seed sets up the same board whether or not the size was picked for us
 
-//				printf("Running second game between %d and %d... ", i, j);
+	if (!resume) {
+		boardWidth = randomInt(&masterRNG, RANDOM_BOARD_SIDE - MIN_BOARD_SIDE + 1) + MIN_BOARD_SIDE;
+		boardHeight = randomInt(&masterRNG, RANDOM_BOARD_SIDE - MIN_BOARD_SIDE + 1) + MIN_BOARD_SIDE;
 
-				// Now A is 2 and B is 1
+		if (width != 0) {
+			boardWidth = width;
+			boardHeight = height;
+		}
 
-				while(gameIsOver(gameBoard) == NO_WINNER_YET) {
+		results.width = boardWidth;
+		results.height = boardHeight;
 
-//					printf("Player %d's turn\n", turn);
-//					printf("----------------\n");
+		startBoard = malloc(boardWidth * boardHeight * sizeof(int));
 
-//					printBoard(gameBoard);
+		if (startBoard == null) {
+			printf("Unable to allocate memory for the starting board.\n");
+			exit(1);
+		}
 
-					// Write out the way things are now
+		memset(startBoard, 0, boardWidth * boardHeight * sizeof(int));
 
-					ipc->pOneScore = playerOneScore;
-					ipc->pTwoScore = playerTwoScore;
-					ipc->pOneTime = playerOneTimeLeft;
-					ipc->pTwoTime = playerTwoTimeLeft;
-					ipc->player = turn;
+		printf("Board will be %d rows, %d columns\n", boardHeight, boardWidth);
 
-					if (turn == PLAYER_TWO) {
-						copyDNA(&(dnaArray[i - startNum]), &(ipc->theDNA));
-					} else {
-						copyDNA(&(dnaArray[j - startNum]), &(ipc->theDNA));
-					}
+		setupStartBoard(startBoard, &masterRNG);
 
-					// Now, run the program, with appropriate inputs
+		// Write out the board to our starting board file
 
-					ftime(&s);
+		writeGame("startingBoard.txt");
+	}
 
-					int forkResult = fork();
+	// Load up all the DNA we'll be needing
 
-					if (forkResult < 0) {
-						// Something went wrong
-						printf("Unable to fork!\n");
-						shmdt(ipc);
-						shmctl(useIPC, IPC_RMID, null);
-						exit(1);
-					} else if (forkResult == 0) {
-						// We are the child, run the program
-						execl(argv[1], "lab", "--ipc", keyPointer);
-						printf("Should never get here!\n");
-						shmdt(ipc);
-						shmctl(useIPC, IPC_RMID, null);
-						exit(1);
-					} else {
-						// We are the parrent, wait for the child
-						wait(&tempPid);
-						
-						if (WEXITSTATUS(tempPid)) {
-							printf("The forked process returned %d.\n", WEXITSTATUS(tempPid));
-							shmdt(ipc);
-							shmctl(useIPC, IPC_RMID, null);
-							exit(1);
-						}
-					}
+	printf("Loading DNA...");
 
-					ftime(&e);
+	dna *dnaArray = malloc(sizeof(dna) * theCount);
 
-					// Things have run, figure out how long it took
+	if (dnaArray == null) {
+		printf("Unable to allocate space for the DNA array. Error %d.\n", errno);
+		exit(1);
+	}
 
-					timeDiff = (e.time - s.time) + ((e.millitm - s.millitm) / 1000.0);
+	char a[80];
 
-					if (turn == PLAYER_ONE) {
-						playerOneTimeLeft -= timeDiff;
-						totalBTime += timeDiff;
-					} else {
-						playerTwoTimeLeft -= timeDiff;
-						totalATime += timeDiff;
-					}
+	for (i = 0; i < theCount; i++) {
+		sprintf(a, "%d.dna", i + startNum);
+		loadDNA(a, &(dnaArray[i]));
+	}
 
-					// Get the move, save it, and run it
+	printf(" OK\n");
 
-					volatile move *tempMove = &(ipc->chosenMove);
+	// Do it! Keep a few more games going than there are workers, so none of them sit idle
 
-					int index = moveNum - 1;
+	slots = workers * 2;
 
-					moveNum++;
+	if (slots > RING_SLOTS)
+		slots = RING_SLOTS;
 
-					move *lastMove = malloc(sizeof(move));
+	if (slots > pairCount * 2)
+		slots = pairCount * 2;
 
-					if (lastMove == null) {
-						printf("Unable to allocate a temporary move. Error %d.\n", errno);
-						shmdt(ipc);
-						shmctl(useIPC, IPC_RMID, null);
-						exit(1);
-					}
+	printf("Playing %d games with %d workers...\n", pairCount * 2, workers);
 
-					copyMove(tempMove, lastMove);
+	if (resume)
+		printf("Resuming from '%s'.\n", CHECKPOINT_NAME);
 
-					moveList[index] = lastMove;
+	openGameLog(0);	// There is only the one master writing games so far
 
-					runMoveWithStruct(turn, lastMove, gameBoard);
+	if (resume) {
+		trimGameLog(logEnd, indexEnd);
+	} else {
+		dropUnfinishedTourney();
 
-					// Change turns
+		gameLogStart = gameLogOffset;
+		gameIndexStart = gameIndexOffset;
+	}
 
-					if (turn == PLAYER_ONE) {
-						turn = PLAYER_TWO;
-					} else {
-						turn = PLAYER_ONE;
-					}
-				}
+	openResults(&results);
 
-				for (tempIndex = 0; tempIndex < moveNum - 2; tempIndex++) {
-					free(moveList[tempIndex]);
-				}
+	startWorkers(labPath, workers, slots);
 
-				// OK, that game is over. who won?
-				
-				winner = gameIsOver(gameBoard);
-
-				if (winner == PLAYER_ONE) {
-//					printf("b wins\n");
-					dnaBWins++;
-					winsArray[j - startNum]++;
-					lossesArray[i - startNum]++;
-				} else if (winner == PLAYER_TWO) {
-//					printf("a wins\n");
-					dnaAWins++;
-					winsArray[i - startNum]++;
-					lossesArray[j - startNum]++;
-				} else {
-//					printf("tie\n");
-					ties++;
-					tiesArray[i - startNum]++;
-					tiesArray[j - startNum]++;
-				}
+	playGames(pairA, pairB, pairCount, theCount, startNum, dnaArray, &results);
 
-//				printBoard(gameBoard);
+	stopWorkers();
 
-				// That's it! We know the result. Print it out to the result file
+	closeResults();
 
-				int res = 2 * dnaAWins + ties;
+	// Now we know every result, write out the reports
 
-				switch (res) {
-					case 4:
-						fprintf(html, "<td bgcolor=\"#00FF00\">%d</td>", res);
-						break;
-					case 3:
-						fprintf(html, "<td bgcolor=\"#66FF66\">%d</td>", res);
-						break;
-					case 2:
-						fprintf(html, "<td bgcolor=\"#CCFF66\">%d</td>", res);
-						break;
-					case 1:
-						fprintf(html, "<td bgcolor=\"#FF9933\">%d</td>", res);
-						break;
-					case 0:
-						fprintf(html, "<td bgcolor=\"#FF0000\">%d</td>", res);
-						break;
-					default:
-						break;
-				}
+	writeReports(&results);
 
-				timeArray[i - startNum] += totalATime;
-				timeArray[j - startNum] += totalBTime;
-			}
+	// Clean up
 
-			fprintf(html, "<td>%d/%d/%d</td>", winsArray[i - startNum], tiesArray[i - startNum], lossesArray[i - startNum]);
-			fprintf(html, "<td>%d</td>", winsArray[i - startNum] * 2 + tiesArray[i - startNum]);
-			fprintf(html, "<td>%f</td>", timeArray[i - startNum] / ((((double) theCount) + 1.0) * 2.0));
-			fprintf(html, "</tr>\n");
-		}
+	closeGameLog();
 
-		fprintf(html, "</table>\n");
-		fprintf(html, "</body></html>\n");
+	unlink(CHECKPOINT_NAME);	// Every game is in the log and the results, there's nothing left to resume
 
-		fclose(html);
+	freeResults(&results);
+	free(dnaArray);
+	free(pairA);
+	free(pairB);
+}
 
-		// Now, we're going to write out the CSV file
+// Get an empty results matrix ready for a tourney between theCount DNA
 
-		html = fopen("results.csv", "w");
+void makeResults(results_matrix *r, int theCount, int startNum) {
+	memset(r, 0, sizeof(results_matrix));
 
-		if (html == null) {
-			printf("Unable to write out the CSV file: error %d.\n", errno);
-		} else {
-			fprintf(html, "DNA,Wins,Ties,Losses,Points\n");
+	r->seed = masterSeed;
+	r->count = theCount;
+	r->startNum = startNum;
+	r->pairCount = theCount * (theCount + 1) / 2;
 
-			int d;
+	r->winners = calloc(r->pairCount * 2, sizeof(uint8_t));
+	r->times = calloc(r->pairCount * 4, sizeof(double));
 
-			for (d = startNum; d < startNum + theCount; d++) {
-				fprintf(html, "%d,%d,%d,%d,%d\n", d, winsArray[d - startNum], tiesArray[d - startNum],
-						lossesArray[d - startNum], winsArray[d - startNum] * 2 + tiesArray[d - startNum]);
-			}
+	if ((r->winners == null) || (r->times == null)) {
+		printf("Unable to allocate the results for %d DNA.\n", theCount);
+		exit(1);
+	}
+}
+
+// Give back a results matrix's memory
+
+void freeResults(results_matrix *r) {
+	free(r->winners);
+	free(r->times);
+}
+
+// Put a finished game in the results matrix
+
+void recordResult(results_matrix *r, game_result *g) {
+	if (g->number >= (uint32_t) (r->pairCount * 2)) {
+		printf("Game %u isn't part of a tourney between %d DNA.\n", g->number, r->count);
+		exit(1);
+	}
+
+	r->winners[g->number] = g->winner;
+	r->times[g->number * 2] = g->timeOne;
+	r->times[g->number * 2 + 1] = g->timeTwo;
+}
+
+// Start the results stream and the thread that writes it. If we die part way through, the
+// games that finished are still in it and "master - r" can make the reports from them. Games
+// already in r, from before a resume, go in first. The writer saves checkpoints from its own
+// copy of the results, so it never has to look at ours. The first one is saved before any game
+// is played, so a tourney killed straight away can still be resumed or dropped
+
+void openResults(results_matrix *r) {
+	results_header header;
+	game_result result;
+	int i;
+
+	memset(&resultQueue, 0, sizeof(result_queue));
+
+	makeResults(&resultQueue.saved, r->count, r->startNum);
+
+	resultQueue.saved.width = r->width;
+	resultQueue.saved.height = r->height;
+	resultQueue.setupRNG = masterRNG;
+	resultQueue.logEnd = gameLogOffset;
+	resultQueue.indexEnd = gameIndexOffset;
+	resultQueue.lastCheckpoint = time(NULL);
+
+	for (i = 0; i < r->width * r->height; i++)
+		resultQueue.board[i] = startBoard[i];
+
+	resultQueue.out = fopen(RESULTS_NAME, "wb");
+
+	if (resultQueue.out == null) {
+		printf("Unable to open the results stream '%s': error %d.\n", RESULTS_NAME, errno);
+		exit(1);
+	}
+
+	memset(&header, 0, sizeof(results_header));
+	memcpy(header.magic, RESULTS_MAGIC, 4);
+	header.version = RESULTS_VERSION;
+	header.seed = r->seed;
+	header.count = r->count;
+	header.startNum = r->startNum;
+	header.width = r->width;
+	header.height = r->height;
+
+	if (fwrite(&header, sizeof(results_header), 1, resultQueue.out) != 1) {
+		printf("Unable to write to the results stream: error %d.\n", errno);
+		exit(1);
+	}
 
-			fclose(html);
+	for (i = 0; i < r->pairCount * 2; i++) {
+		if (r->winners[i] == NO_WINNER_YET)
+			continue;
+
+		result.number = i;
+		result.winner = r->winners[i];
+		result.timeOne = r->times[i * 2];
+		result.timeTwo = r->times[i * 2 + 1];
+
+		recordResult(&resultQueue.saved, &result);
+
+		if (fwrite(&result, sizeof(game_result), 1, resultQueue.out) != 1) {
+			printf("Unable to write to the results stream: error %d.\n", errno);
+			exit(1);
 		}
+	}
+
+	if (fflush(resultQueue.out) != 0) {
+		printf("Unable to write to the results stream: error %d.\n", errno);
+		exit(1);
+	}
+
+	saveCheckpoint(&resultQueue);
+
+	if (pthread_create(&resultThread, null, resultWriter, null) != 0) {
+		printf("Unable to start the results writer: error %d.\n", errno);
+		exit(1);
+	}
+}
+
+// Hand a finished game to the results writer. We only wait if the queue is full, which means
+// the disk is thousands of games behind
+
+void queueResult(game_result *g) {
+	result_queue *q = &resultQueue;
+	uint32_t head, seen;
+
+	head = q->head;		// Only we change it
 
-		// Clean up
+	while (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == RESULT_QUEUE_SIZE) {
+		seen = __atomic_load_n(&q->space, __ATOMIC_ACQUIRE);
+
+		if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == RESULT_QUEUE_SIZE)
+			ringWait(&q->space, seen, RESULT_WAIT_MS);
+	}
+
+	q->items[head & (RESULT_QUEUE_SIZE - 1)] = *g;
+	q->logEnds[head & (RESULT_QUEUE_SIZE - 1)] = gameLogOffset;		// The game is already logged
+	q->indexEnds[head & (RESULT_QUEUE_SIZE - 1)] = gameIndexOffset;
+
+	__atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+
+	ringBell(&q->bell, 1);
+}
+
+// The results writer. Writes out whatever has finished and flushes it, so a result is on its
+// way to the disk as soon as the game is over, then sleeps until there is more. Every so often
+// it saves a checkpoint
+
+void *resultWriter(void *arg) {
+	result_queue *q = &resultQueue;
+	uint32_t tail, head, seen;
+
+	(void) arg;			// pthread wants it, we only have the one queue
+
+	tail = q->tail;		// Only we change it
+
+	while (true) {
+		seen = __atomic_load_n(&q->bell, __ATOMIC_ACQUIRE);
+		head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+
+		if (tail != head) {
+			for (; tail != head; tail++) {
+				if (fwrite(&(q->items[tail & (RESULT_QUEUE_SIZE - 1)]), sizeof(game_result), 1, q->out) != 1) {
+					printf("Unable to write to the results stream: error %d.\n", errno);
+					exit(1);
+				}
+
+				recordResult(&q->saved, &(q->items[tail & (RESULT_QUEUE_SIZE - 1)]));
+
+				q->logEnd = q->logEnds[tail & (RESULT_QUEUE_SIZE - 1)];
+				q->indexEnd = q->indexEnds[tail & (RESULT_QUEUE_SIZE - 1)];
+			}
+
+			if (fflush(q->out) != 0) {
+				printf("Unable to write to the results stream: error %d.\n", errno);
+				exit(1);
+			}
+
+			__atomic_store_n(&q->tail, tail, __ATOMIC_RELEASE);
+			ringBell(&q->space, 1);
+
+			if (time(NULL) - q->lastCheckpoint >= CHECKPOINT_SECONDS)
+				saveCheckpoint(q);
+
+			continue;
+		}
+
+		if (__atomic_load_n(&q->done, __ATOMIC_ACQUIRE))
+			break;	// Everything's written and nothing more is coming
+
+		ringWait(&q->bell, seen, RESULT_WAIT_MS);
+	}
+
+	return null;
+}
+
+// Wait for every result to be written, then close the results stream
+
+void closeResults() {
+	__atomic_store_n(&resultQueue.done, true, __ATOMIC_RELEASE);
+	ringBell(&resultQueue.bell, 1);
+
+	pthread_join(resultThread, null);
+
+	fclose(resultQueue.out);
+	freeResults(&resultQueue.saved);
+}
+
+// Save the writer's results, the start board and the random state. It's written to a new file
+// that is renamed over the old one once it's safely on the disk, so if we die while saving the
+// last checkpoint is still there. A checkpoint we can't save isn't worth stopping the tourney for
+
+void saveCheckpoint(result_queue *q) {
+	checkpoint_header header;
+	results_matrix *r = &q->saved;
+	FILE *out = null;
+	int i, ok;
+
+	q->lastCheckpoint = time(NULL);
+
+	// Every game in saved has to be in the game log on the disk before the checkpoint says so.
+	// The tourney may have logged more since, resuming cuts those off
+
+	if ((fflush(gameLog) != 0) || (fflush(gameIndex) != 0) ||
+			(fsync(fileno(gameLog)) != 0) || (fsync(fileno(gameIndex)) != 0)) {
+		printf("Unable to save a checkpoint, the game log won't write: error %d.\n", errno);
+		return;
+	}
+
+	memset(&header, 0, sizeof(checkpoint_header));
+	memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+	header.version = CHECKPOINT_VERSION;
+	header.seed = r->seed;
+	header.setupRNG = q->setupRNG;
+	header.count = r->count;
+	header.startNum = r->startNum;
+	header.width = r->width;
+	header.height = r->height;
+	header.logEnd = q->logEnd;
+	header.indexEnd = q->indexEnd;
+	header.logStart = gameLogStart;
+	header.indexStart = gameIndexStart;
+
+	for (header.nextGame = 0; header.nextGame < (uint32_t) (r->pairCount * 2); header.nextGame++) {
+		if (r->winners[header.nextGame] == NO_WINNER_YET)
+			break;
+	}
+
+	for (i = header.nextGame; i < r->pairCount * 2; i++) {
+		if (r->winners[i] != NO_WINNER_YET)
+			header.finished++;
+	}
+
+	header.finished += header.nextGame;
+
+	out = fopen(CHECKPOINT_TEMP_NAME, "wb");
+
+	if (out == null) {
+		printf("Unable to save a checkpoint: error %d.\n", errno);
+		return;
+	}
+
+	ok = (fwrite(&header, sizeof(checkpoint_header), 1, out) == 1);
+	ok = ok && (fwrite(q->board, r->width * r->height, 1, out) == 1);
+	ok = ok && (fwrite(r->winners, r->pairCount * 2, 1, out) == 1);
+	ok = ok && (fwrite(r->times, sizeof(double) * r->pairCount * 4, 1, out) == 1);
+	ok = ok && (fflush(out) == 0) && (fsync(fileno(out)) == 0);
+	ok = (fclose(out) == 0) && ok;
+
+	if (!ok || (rename(CHECKPOINT_TEMP_NAME, CHECKPOINT_NAME) != 0)) {
+		printf("Unable to save a checkpoint: error %d.\n", errno);
+		unlink(CHECKPOINT_TEMP_NAME);
+	}
+}
+
+// Load a checkpoint to resume a tourney. Sets up the seed, random state and start board the
+// tourney had, fills in r with the games it finished, and says where the game log ended then
+
+void readCheckpoint(char *path, results_matrix *r, uint64_t *logEnd, uint64_t *indexEnd) {
+	checkpoint_header header;
+	uint8_t board[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	FILE *in = null;
+	int i, ok;
+
+	in = fopen(path, "rb");
+
+	if (in == null) {
+		printf("Unable to open the checkpoint '%s': error %d.\n", path, errno);
+		exit(1);
+	}
+
+	if ((fread(&header, sizeof(checkpoint_header), 1, in) != 1) || (memcmp(header.magic, CHECKPOINT_MAGIC, 4) != 0) ||
+				(header.version != CHECKPOINT_VERSION)) {
+		printf("'%s' is not a checkpoint we can read.\n", path);
+		fclose(in);
+		exit(1);
+	}
+
+	if ((header.count <= 0) || (header.width < MIN_BOARD_SIDE) || (header.width > MAX_BOARD_SIDE) ||
+				(header.height < MIN_BOARD_SIDE) || (header.height > MAX_BOARD_SIDE)) {
+		printf("'%s' has a %dx%d tourney of %d DNA, which can't be right.\n", path, header.width, header.height,
+					header.count);
+		fclose(in);
+		exit(1);
+	}
+
+	masterSeed = header.seed;
+	masterRNG = header.setupRNG;
+
+	*logEnd = header.logEnd;
+	*indexEnd = header.indexEnd;
+	gameLogStart = header.logStart;
+	gameIndexStart = header.indexStart;
+
+	makeResults(r, header.count, header.startNum);
+
+	boardWidth = header.width;
+	boardHeight = header.height;
+	r->width = boardWidth;
+	r->height = boardHeight;
+
+	ok = (fread(board, boardWidth * boardHeight, 1, in) == 1);
+	ok = ok && (fread(r->winners, r->pairCount * 2, 1, in) == 1);
+	ok = ok && (fread(r->times, sizeof(double) * r->pairCount * 4, 1, in) == 1);
+
+	fclose(in);
+
+	if (!ok) {
+		printf("'%s' ends early.\n", path);
+		exit(1);
+	}
+
+	startBoard = malloc(boardWidth * boardHeight * sizeof(int));
+
+	if (startBoard == null) {
+		printf("Unable to allocate memory for the starting board.\n");
+		exit(1);
+	}
+
+	for (i = 0; i < boardWidth * boardHeight; i++)
+		startBoard[i] = board[i];
+
+	printf("Seed %llu, %d DNA from %d on a %dx%d board, %u of %d games finished.\n",
+				(unsigned long long) masterSeed, r->count, r->startNum, boardWidth, boardHeight, header.finished,
+				r->pairCount * 2);
+}
+
+// Read a results stream back into a results matrix. Games that never finished stay unplayed
+
+void readResults(char *path, results_matrix *r) {
+	results_header header;
+	game_result result;
+	FILE *in = null;
+	long games;
+
+	in = fopen(path, "rb");
+
+	if (in == null) {
+		printf("Unable to open the results stream '%s': error %d.\n", path, errno);
+		exit(1);
+	}
+
+	if ((fread(&header, sizeof(results_header), 1, in) != 1) || (memcmp(header.magic, RESULTS_MAGIC, 4) != 0)) {
+		printf("'%s' is not a results stream.\n", path);
+		fclose(in);
+		exit(1);
+	}
+
+	if (header.version != RESULTS_VERSION) {
+		printf("'%s' is version %u, we only know version %d.\n", path, header.version, RESULTS_VERSION);
+		fclose(in);
+		exit(1);
+	}
+
+	if (header.count <= 0) {
+		printf("'%s' has a tourney of %d DNA.\n", path, header.count);
+		fclose(in);
+		exit(1);
+	}
+
+	masterSeed = header.seed;
+
+	makeResults(r, header.count, header.startNum);
+
+	r->width = header.width;
+	r->height = header.height;
+
+	games = 0;
+
+	while (fread(&result, sizeof(game_result), 1, in) == 1) {
+		recordResult(r, &result);
+		games++;
+	}
+
+	fclose(in);
+
+	printf("Read %ld of %d games from '%s'.\n", games, r->pairCount * 2, path);
+}
+
+// Add up each DNA's wins, ties, losses and time from the games that were played
+
+void tallyResults(results_matrix *r) {
+	int i, j, pair;
+
+	free(winsArray);
+	free(lossesArray);
+	free(tiesArray);
+	free(timeArray);
+
+	winsArray = calloc(r->count, sizeof(int));
+	lossesArray = calloc(r->count, sizeof(int));
+	tiesArray = calloc(r->count, sizeof(int));
+	timeArray = calloc(r->count, sizeof(double));
+
+	if ((winsArray == null) || (lossesArray == null) || (tiesArray == null) || (timeArray == null)) {
+		printf("Unable to allocate the totals.\n");
+		exit(1);
+	}
+
+	pair = 0;
+
+	for (i = 0; i < r->count; i++) {
+		for (j = i; j < r->count; j++) {
+			// First, A is 1, B is 2
+
+			if (r->winners[pair * 2] == PLAYER_ONE) {
+				winsArray[i]++;
+				lossesArray[j]++;
+			} else if (r->winners[pair * 2] == PLAYER_TWO) {
+				winsArray[j]++;
+				lossesArray[i]++;
+			} else if (r->winners[pair * 2] != NO_WINNER_YET) {
+				tiesArray[i]++;
+				tiesArray[j]++;
+			}
+
+			// Then A is 2 and B is 1
+
+			if (r->winners[pair * 2 + 1] == PLAYER_ONE) {
+				winsArray[j]++;
+				lossesArray[i]++;
+			} else if (r->winners[pair * 2 + 1] == PLAYER_TWO) {
+				winsArray[i]++;
+				lossesArray[j]++;
+			} else if (r->winners[pair * 2 + 1] != NO_WINNER_YET) {
+				tiesArray[i]++;
+				tiesArray[j]++;
+			}
+
+			timeArray[i] += r->times[pair * 4] + r->times[pair * 4 + 3];
+			timeArray[j] += r->times[pair * 4 + 1] + r->times[pair * 4 + 2];
+
+			pair++;
+		}
+	}
+}
+
+// Write results.html, results.csv and results.json from a results matrix
+
+void writeReports(results_matrix *r) {
+	tallyResults(r);
+
+	writeResultsHTML(r);
+	writeResultsCSV(r);
+	writeResultsJSON(r);
+}
+
+// The results table, a cell for every pair, colored by how A did. Big tourneys just get the totals
+
+void writeResultsHTML(results_matrix *r) {
+	FILE *html = null;
+	int i, j, pair, table;
+
+	html = fopen("results.html", "w");
+
+	if (html == null) {
+		printf("Unable to open results file: %d\n", errno);
+		exit(1);
+	}
+
+	table = (r->count <= HTML_TABLE_LIMIT);
+
+	fprintf(html, "<html><head><title>Tourney!</title></head><body>\n");
+	fprintf(html, "<table border=1>\n");
+	fprintf(html, "<tr><td>DNA</td>");
+
+	for (i = r->startNum; (i < r->startNum + r->count) && table; i++) {
+		fprintf(html, "<td>%d</td>", i);
+	}
+
+	fprintf(html, "<td>Totals</td><td>Points</td><td>Average Game Time</td></tr>\n");
+
+	pair = 0;
+
+	for (i = 0; i < r->count; i++) {
+		fprintf(html, "<tr><td>%d</td>", i + r->startNum);
+
+		for (j = 0; (j < i) && table; j++) {
+			fprintf(html, "<td>&nbsp;</td>");
+		}
+
+		for (j = i; (j < r->count) && table; j++) {
+			int first = r->winners[pair * 2], second = r->winners[pair * 2 + 1];
+			int res = 0;
+
+			pair++;
+
+			if ((first == NO_WINNER_YET) || (second == NO_WINNER_YET)) {
+				fprintf(html, "<td>&nbsp;</td>");	// Not played yet
+				continue;
+			}
+
+			// Two points for each of A's wins, one for a tie
+
+			if (first == PLAYER_ONE)
+				res += 2;
+			else if (first != PLAYER_TWO)
+				res++;
+
+			if (second == PLAYER_TWO)
+				res += 2;
+			else if (second != PLAYER_ONE)
+				res++;
+
+			switch (res) {
+				case 4:
+					fprintf(html, "<td bgcolor=\"#00FF00\">%d</td>", res);
+					break;
+				case 3:
+					fprintf(html, "<td bgcolor=\"#66FF66\">%d</td>", res);
+					break;
+				case 2:
+					fprintf(html, "<td bgcolor=\"#CCFF66\">%d</td>", res);
+					break;
+				case 1:
+					fprintf(html, "<td bgcolor=\"#FF9933\">%d</td>", res);
+					break;
+				case 0:
+					fprintf(html, "<td bgcolor=\"#FF0000\">%d</td>", res);
+					break;
+				default:
+					break;
+			}
+		}
+
+		fprintf(html, "<td>%d/%d/%d</td>", winsArray[i], tiesArray[i], lossesArray[i]);
+		fprintf(html, "<td>%d</td>", winsArray[i] * 2 + tiesArray[i]);
+		fprintf(html, "<td>%f</td>", timeArray[i] / ((((double) r->count) + 1.0) * 2.0));
+		fprintf(html, "</tr>\n");
+	}
+
+	fprintf(html, "</table>\n");
+	fprintf(html, "</body></html>\n");
+
+	fclose(html);
+}
+
+// The totals for each DNA, which is what breeding reads
+
+void writeResultsCSV(results_matrix *r) {
+	FILE *csv = null;
+	int d;
+
+	csv = fopen("results.csv", "w");
+
+	if (csv == null) {
+		printf("Unable to write out the CSV file: error %d.\n", errno);
+		return;
+	}
+
+	fprintf(csv, "DNA,Wins,Ties,Losses,Points\n");
+
+	for (d = 0; d < r->count; d++) {
+		fprintf(csv, "%d,%d,%d,%d,%d\n", d + r->startNum, winsArray[d], tiesArray[d], lossesArray[d],
+					winsArray[d] * 2 + tiesArray[d]);
+	}
+
+	fclose(csv);
+}
+
+// Everything, for other programs. Each DNA's totals, then every game that was played
+
+void writeResultsJSON(results_matrix *r) {
+	FILE *json = null;
+	int d, i, j, k, game, comma;
+
+	json = fopen("results.json", "w");
+
+	if (json == null) {
+		printf("Unable to write out the JSON file: error %d.\n", errno);
+		return;
+	}
+
+	fprintf(json, "{\"seed\": %llu, \"width\": %d, \"height\": %d, \"startNum\": %d, \"count\": %d,\n",
+				(unsigned long long) r->seed, r->width, r->height, r->startNum, r->count);
+
+	fprintf(json, "\"dna\": [\n");
+
+	for (d = 0; d < r->count; d++) {
+		fprintf(json, "\t{\"dna\": %d, \"wins\": %d, \"ties\": %d, \"losses\": %d, \"points\": %d, \"averageTime\": %f}%s\n",
+					d + r->startNum, winsArray[d], tiesArray[d], lossesArray[d], winsArray[d] * 2 + tiesArray[d],
+					timeArray[d] / ((((double) r->count) + 1.0) * 2.0), (d + 1 < r->count) ? "," : "");
+	}
+
+	fprintf(json, "],\n\"games\": [\n");
+
+	comma = false;
+	game = 0;
+
+	for (i = 0; i < r->count; i++) {
+		for (j = i; j < r->count; j++) {
+			for (k = 0; k < 2; k++, game++) {	// A goes first, then B
+				if (r->winners[game] == NO_WINNER_YET)
+					continue;
+
+				fprintf(json, "%s\t{\"game\": %d, \"playerOne\": %d, \"playerTwo\": %d, \"winner\": %d, "
+							"\"timeOne\": %f, \"timeTwo\": %f}", comma ? ",\n" : "", game,
+							((k == 0) ? i : j) + r->startNum, ((k == 0) ? j : i) + r->startNum, r->winners[game],
+							r->times[game * 2], r->times[game * 2 + 1]);
+
+				comma = true;
+			}
+		}
+	}
+
+	fprintf(json, "\n]}\n");
+
+	fclose(json);
+}
+
+// The main function. All hail main!
+
+int main(int argc, char** argv) {
+
+	// Based on argv, we have to figure out what we want to do
+
+	if (argc == 1) {
+		printf("\nPlease call like: /path/to/master /path/to/lab [m c s]|[i c s] [seed [w [WxH]]]\n");
+		printf("                 or /path/to/master /path/to/lab c [w]\n\n");
+		printf("m - Make DNA, c is the number of DNA files, s is start num\n");
+		printf("i - Run a tourney with IPC, using dna numbers starting at s, count c\n");
+		printf("\tw lab workers play the games, by default one per CPU\n");
+		printf("\tWxH sets the board size, up to %dx%d, otherwise it's random up to %dx%d\n",
+					MAX_BOARD_SIDE, MAX_BOARD_SIDE, RANDOM_BOARD_SIDE, RANDOM_BOARD_SIDE);
+		printf("\tA checkpoint is saved in %s every %d seconds, and removed when the tourney is over\n",
+					CHECKPOINT_NAME, CHECKPOINT_SECONDS);
+		printf("c - Continue the tourney in %s, playing only the games it hadn't finished\n\n", CHECKPOINT_NAME);
+		printf("Giving the same seed again repeats a run exactly, whatever w is\n");
+		printf("DNA files are text and end in .DNA\n");
+		printf("Tourneys place the starting board in startingBoard.txt,\n");
+		printf("\tand results in results.html, results.csv and results.json.\n");
+		printf("Each game's result goes in %s as soon as it's over, and\n", RESULTS_NAME);
+		printf("\t/path/to/master - r %s writes the results files from it again.\n", RESULTS_NAME);
+		printf("Every game played is added to games-0.log, indexed by games-0.idx.\n");
+		printf("\n");
+		
+		return 0;
+	} else if ((argc == 4) && (argv[2][0] == 'r')) {
+		// They want the reports from a results stream, which doesn't need lab or a seed
+
+		results_matrix results;
+
+		readResults(argv[3], &results);
+		writeReports(&results);
+		freeResults(&results);
+
+		return 0;
+	} else if (((argc == 3) || (argc == 4)) && (argv[2][0] == 'c')) {
+		// They want to pick a tourney up where its checkpoint left off, the checkpoint has the rest
+
+		int workers;
+
+		workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+		if ((argc == 4) && (sscanf(argv[3], "%d", &workers) != 1)) {
+			printf("Unable to read 'w'.\n");
+			return 1;
+		}
+
+		if (workers <= 0) {
+			workers = 1;
+		} else if (workers > MAX_WORKERS) {
+			workers = MAX_WORKERS;
+		}
+
+		runTourney(argv[1], 0, 0, workers, 0, 0, true);
+
+		printf("Done running tourney.\n");
+
+		return 0;
+	} else if ((argc < 5) || (argc > 8)) {
+		printf("Not enough arguments, call the program with no arguments for instructions.\n");
+		return 0;
+	}
+
+	// Seed the RNG, every other stream comes from this one seed
+
+	if (argc >= 6) {
+		unsigned long long seed;
+
+		if (sscanf(argv[5], "%llu", &seed) != 1) {
+			printf("Unable to read the seed.\n");
+			return 1;
+		}
+
+		masterSeed = (uint64_t) seed;
+	} else {
+		masterSeed = (uint64_t) time(NULL);
+	}
+
+	printf("Using seed %llu\n", (unsigned long long) masterSeed);
+
+	seedRNG(&masterRNG, masterSeed, STREAM_SETUP);
+
+	// So, now we have to figure out which thing they want to do
+
+	if (argv[2][0] == 'm') {
+		// They want to make DNA
+
+		int startNum, theCount;
+		int got;
+		double tempNum;
+
+		// We need to parse some things
+
+		got = sscanf(argv[3], "%d", &theCount);
+
+		if (got == -1) {
+			printf("Unable to read 'c'.\n");
+			return 1;
+		}
+
+		if (theCount <= 0) {
+			printf("The count needs to be greater than 0.\n");
+			return 1;
+		}
+
+		got = sscanf(argv[4], "%d", &startNum);
+
+		if (got == -1) {
+			printf("Unable to read 's'.\n");
+			return 1;
+		}
+
+		if (startNum <= 0) {
+			printf("The start needs to be greater than 0.\n");
+			return 1;
+		}
+
+		// Now that we've got that, let's do our work
+
+		printf("Starting DNA output...\n");
+
+		char buffer[80];
+		FILE *theFile;
+		int i, j;
+
+		for (i = startNum; i < startNum + theCount; i++) {
+			// First, generate the file name that we'll be using
+
+			sprintf(buffer, "%d.dna", i);
+
+			// Now, open the file
+
+			theFile = null;
+			theFile = fopen(buffer, "w");
+
+			if (theFile == null) {
+				printf("Unable to open '%s' for writing DNA: error %d.\n", buffer, errno);
+				return 1;
+			}
+			
+			// Now, do the work
+
+			for (j = 0; j < 6; j++) {
+				tempNum = randomDouble(&masterRNG);	// Number from 0 ot 1
+				tempNum = tempNum * 2.0;							// Number from 0 to 2
+				tempNum = tempNum - 1.0;							// Number from -1 to 1
+				fprintf(theFile, "%f\n", tempNum);
+			}
+
+			// Close the file
+
+			fclose(theFile);
+
+			printf("Wrote number %d...\r", i);
+		}
+
+		// Done doing that
+
+		printf("Done writing DNA.\n\n");
+
+	} else if (argv[2][0] == 'i') {
+		// They want to run a tourney with IPC
+
+		int startNum, theCount, workers, width, height;
+		int got;
+
+		// We need to parse some things
+
+		got = sscanf(argv[3], "%d", &theCount);
+
+		if (got == -1) {
+			printf("Unable to read 'c'.\n");
+			return 1;
+		}
+
+		if (theCount <= 0) {
+			printf("The count needs to be greater than 0.\n");
+			return 1;
+		}
+
+		got = sscanf(argv[4], "%d", &startNum);
+
+		if (got == -1) {
+			printf("Unable to read 's'.\n");
+			return 1;
+		}
+
+		if (startNum <= 0) {
+			printf("The start needs to be greater than 0.\n");
+			return 1;
+		}
+
+		workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+		if ((argc >= 7) && (sscanf(argv[6], "%d", &workers) != 1)) {
+			printf("Unable to read 'w'.\n");
+			return 1;
+		}
+
+		if (workers <= 0) {
+			workers = 1;
+		} else if (workers > MAX_WORKERS) {
+			workers = MAX_WORKERS;
+		}
+
+		width = 0;		// Random
+		height = 0;
+
+		if (argc == 8) {
+			if (sscanf(argv[7], "%dx%d", &width, &height) != 2) {
+				printf("Unable to read the board size, it should look like 12x10.\n");
+				return 1;
+			}
+
+			if ((width < MIN_BOARD_SIDE) || (width > MAX_BOARD_SIDE) ||
+						(height < MIN_BOARD_SIDE) || (height > MAX_BOARD_SIDE)) {
+				printf("Boards have to be from %dx%d to %dx%d.\n", MIN_BOARD_SIDE, MIN_BOARD_SIDE,
+							MAX_BOARD_SIDE, MAX_BOARD_SIDE);
+				return 1;
+			}
+		}
 
-		free(dnaArray);
-		shmdt(ipc);
-		shmctl(useIPC, IPC_RMID, null);
+		runTourney(argv[1], theCount, startNum, workers, width, height, false);
 
 		// That's it
 
@@ -1,16 +1,60 @@
 //------------------------------- Includes -------------------------------
 
 #include <errno.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include <sys/timeb.h>
 #include <unistd.h>
 
 //------------------------------- Defines -------------------------------
 
-#define MUTATION_RATE			0.1
+#define MUTATION_RATE			0.1		// The default chance a child is a mutant
+#define GENE_LIMIT				6.0		// Mutation keeps genes between -6 and 6
+#define STEP_START				0.2		// Mutation step size for genes that don't have one yet
+#define STEP_MIN				0.001	// Step sizes never get smaller, so every gene can still move
+#define STEPS_MARKER			"steps"	// Step sizes follow this line in a DNA file, after the genes
+#define DIVERSITY_NAME			"diversity.csv"	// A line for every generation bred
+
+#define ELITE_SHARE				0.1		// The default breeding plan, as shares of the population: the best
+#define LUCKY_SHARE				0.1		// copied over, others copied over at random, and new random DNA.
+#define FRESH_SHARE				0.2		// Children fill the rest
+#define TOURNAMENT_SIZE			3		// DNA in each tournament, by default
+#define BEST_SHOWN				10		// How many of the best we print, they're always ranked
+#define BREEDING_PLAN_NAME		"breeding.txt"	// Changes the breeding plan when it's there
+#define MAX_BREED_THREADS		64
+
+#define STREAM_SETUP			0		// Random stream for the start board and making DNA
+#define STREAM_BREEDING			1		// Random stream for breeding
+#define STREAM_GAMES			1024	// Game n of a tourney uses stream STREAM_GAMES + n
+#define STREAM_CHILDREN			(1ULL << 40)	// Child n of a generation uses stream STREAM_CHILDREN + n
+
+#define GAME_LOG_NAME			"games-%d.log"	// Each worker logs its games to its own file
+#define GAME_INDEX_NAME			"games-%d.idx"	// Where each game in the log starts, one uint64_t per game
+#define GAME_LOG_MAGIC			"LBGL"
+#define GAME_LOG_VERSION		3		// 2 has 32 bit moves and a 16 bit move count, 3 has gene array DNA
+#define GAME_LOG_BUFFER			(256 * 1024)	// How much of the log we collect before writing it out
+
+#define RESULTS_NAME			"results.bin"	// Every finished game, added as it finishes
+#define RESULTS_MAGIC			"LBRS"
+#define RESULTS_VERSION			1
+#define RESULT_QUEUE_SIZE		4096	// Finished games the writer can fall behind by, a power of two
+#define RESULT_WAIT_MS			1000	// The writer looks for results at least this often
+#define HTML_TABLE_LIMIT		100		// Bigger tourneys only get the totals in results.html
+
+#define MAX_WORKERS				64		// The most lab processes we'll start
+#define WORKER_CHECK_MS			1000	// How often we make sure the workers are still alive while we wait
+
+#define SEGMENT_MAGIC			"LBSM"
+#define SEGMENT_NAME			"/lines-boxes-%d-%d"	// Only used when there's no memfd, the pid makes it ours
+#define MAX_SEGMENTS			8		// Shared memory segments we can have at once
+#define IPC_VERSION				4		// Bump whenever anything in the shared memory changes, lab checks it
 
 #ifndef DEBUG
 	#define DEBUG 0
@@ -18,6 +62,12 @@
 	#define DEBUG 1
 #endif
 
+#ifndef TIMING
+	#define TIMING 0
+#else
+	#define TIMING 1
+#endif
+
 
 //------------------------------- Constants -------------------------------
 
@@ -25,6 +75,36 @@
 
 #define MIN_BOARD_SIDE			3
 #define MAX_BOARD_SIDE			8
+#define MAX_GAME_MOVES			(2 * MAX_BOARD_SIDE * (MAX_BOARD_SIDE + 1))	// Every move draws at least one segment
+#define NO_MOVE					0		// A packed move that can't be real, it has no length
+#define MOVE_VERTICAL			0x40000	// Set in packed moves that run up and down, same layout as lab
+#define MOVE_FIELD_BITS			6		// Bits for each coordinate in a packed move
+#define MOVE_FIELD_MASK			0x3F
+
+#define MAX_GENES				16		// Room in the DNA, the same as lab
+#define BASE_GENES				6		// Every DNA file has at least the original six
+
+#define FEATURE_NO_SIDES		0		// Features, in the order of the genes that weigh them. Lab has
+#define FEATURE_ONE_SIDE		1		// more, their genes are carried along but not used here
+#define FEATURE_TWO_SIDES		2
+#define FEATURE_THREE_SIDES		3
+#define FEATURE_LINE_LENGTH		4
+#define FEATURE_MARGIN			5
+#define FEATURE_COUNT			6
+
+#define ARENA_BLOCK_SIZE		(64 * 1024)	// Arenas grab memory in blocks at least this big
+
+#define HISTOGRAM_SUB_BITS		4		// Each power of two is split 16 ways, so timings are within 6.25%
+#define HISTOGRAM_SUB_COUNT		(1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS		(64 * HISTOGRAM_SUB_COUNT)
+
+#define STAGE_GENERATE			0		// Generating the list of possible moves
+#define STAGE_CANDIDATE			1		// Trying and scoring one possible move
+#define STAGE_SELECT			2		// Scoring all possible moves and choosing one
+#define STAGE_MOVE				3		// The whole turn
+#define TIMING_STAGES			4
+
+#define TIMING_FILE				"timing.csv"
 
 #define NO_WINNER_YET			0
 
@@ -59,19 +139,26 @@
 
 #define FULL_BOX				(TOP_LINE | RIGHT_LINE | BOTTOM_LINE | LEFT_LINE)
 
+#define SELECT_TRUNCATION		0		// Both parents from the elite, any of them equally
+#define SELECT_TOURNAMENT		1		// The best of a few DNA picked at random
+#define SELECT_RANK				2		// Odds falling off in a straight line from the best to the worst
+#define SELECT_FITNESS			3		// Odds in proportion to points, plus one so no one is left out
+
+#define CROSS_UNIFORM			0		// Each gene from either parent
+#define CROSS_POINT				1		// Genes up to a random point from one parent, the rest from the other
+#define CROSS_BLEND				2		// Each gene somewhere on the line through both parents' genes
+
+#define MUTATE_SCALE			0		// One gene moves by up to 100% of itself
+#define MUTATE_RESET			1		// One gene is replaced with a new random one
+#define MUTATE_ADAPTIVE			2		// Every gene's step size changes, then every gene takes a normal step of its size
+
 #define true					1	// When will C finally get a built in true and false?
 #define false					0
 #define null					0	// And what about null?
 
 //------------------------------- Structs -------------------------------
 
-typedef struct {				// Used to hold the coords of a move
-	int from_x;
-	int to_x;
-	int from_y;
-	int to_y;
-	double score;				// Used in figuring out which move is best
-} move;
+typedef uint32_t packed_move;	// A whole move in 19 bits, see packMove for the layout
 
 typedef struct {				// Used to hold evaluation results
 	int noSides;
@@ -85,19 +172,16 @@ typedef struct {				// Used to hold evaluation results
 	int moveLength;
 } boardEvaluation;
 
-typedef struct {				// Used in our scoring function
-	double noBasePair;
-	double oneBasePair;
-	double twoBasePair;
-	double threeBasePair;
-	double lineLengthBasePair;
-	double currentMarginBasePair;
+typedef struct {				// Used in our scoring function, gene i weighs feature i. The same layout as lab
+	uint32_t geneCount;			// How many genes the DNA file had, the rest are 0
+	uint32_t unused;
+	double genes[MAX_GENES];
 } dna;
 
 typedef struct {				// Used to pass stuff between the parrent process and me
 	dna theDNA;
 	int gameBoard[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
-	move chosenMove;
+	packed_move chosenMove;
 	int width;
 	int height;
 	int player;
@@ -105,11 +189,128 @@ typedef struct {				// Used to pass stuff between the parrent process and me
 	int pTwoScore;
 	double pOneTime;
 	double pTwoTime;
+	uint64_t seed;				// Seed for the player's random stream, so each move can be replayed
 } ipc_memory;
 
-//------------------------------- Global Variables -------------------------------
+typedef struct {				// Starts every game log file
+	char magic[4];				// Always GAME_LOG_MAGIC
+	uint32_t version;
+} game_log_header;
+
+typedef struct {				// Starts each game in a game log. The start board (a byte per box) and the moves follow
+	uint64_t seed;				// The master seed and stream the game was played with, so it can be replayed
+	uint32_t stream;
+	int32_t playerOneNumber;	// Which DNA files the players came from
+	int32_t playerTwoNumber;
+	uint16_t moveCount;
+	uint8_t width;
+	uint8_t height;
+	uint8_t winner;
+	uint8_t unused[7];			// Keeps the DNA on an 8 byte boundary
+	dna playerOne;
+	dna playerTwo;
+} game_record;
+
+typedef struct {				// Starts the results stream, a game_result for each finished game follows
+	char magic[4];				// Always RESULTS_MAGIC
+	uint32_t version;
+	uint64_t seed;
+	int32_t count;				// How many DNA are in the tourney
+	int32_t startNum;			// The first one's number
+	uint8_t width;
+	uint8_t height;
+	uint8_t unused[6];
+} results_header;
+
+typedef struct {				// One finished game in the results stream
+	uint32_t number;			// Games 2n and 2n + 1 are pair n, in results table order
+	uint32_t winner;
+	double timeOne;				// Time each player used
+	double timeTwo;
+} game_result;
+
+typedef struct {				// Every result of a tourney, filled in as games finish. The reports come from this
+	uint64_t seed;
+	int count;
+	int startNum;
+	int width;
+	int height;
+	int pairCount;
+	uint8_t *winners;			// Two per pair, NO_WINNER_YET until the game is played
+	double *times;				// Two per game, player one's then player two's
+} results_matrix;
+
+typedef struct {				// Finished games on their way to the results stream. Only the tourney puts
+	game_result items[RESULT_QUEUE_SIZE];	// them in and only the writer takes them out, so it needs no lock
+	uint32_t head;				// Next item to fill, only the tourney moves it
+	uint32_t tail;				// Next item to write, only the writer moves it
+	uint32_t bell;				// Rung when a result goes in or the tourney is over
+	uint32_t space;				// Rung when the writer has made room
+	uint32_t done;				// Set when there are no more results coming
+	FILE *out;
+} result_queue;
+
+typedef struct {				// What DNA are ranked by: points, then head to head, then less time, then number
+	int count;
+	int *points;				// Two for a win and one for a tie, from results.csv
+	int *headToHead;			// Points won against DNA with the same points, from results.bin if we have it
+	double *time;				// Time used, also from results.bin
+} rank_keys;
+
+typedef struct {				// How far each gene moves when it mutates. Kept in the DNA file after the genes,
+	double steps[MAX_GENES];	// so good step sizes are bred along with good genes
+} gene_steps;
+
+typedef struct {				// How a generation is bred, the defaults can be changed with breeding.txt
+	double elite;				// Shares of the population: the best copied over, others copied over at
+	double lucky;				// random, and new random DNA. Children fill the rest
+	double fresh;
+	int selection;				// SELECT_TRUNCATION and friends
+	int tournamentSize;
+	int crossover;				// CROSS_UNIFORM and friends
+	int mutation;				// MUTATE_SCALE and friends
+	double mutationRate;
+	int threads;				// Breeding threads, by default one per CPU
+} breeding_plan;
+
+typedef struct {				// What the breeding threads share
+	breeding_plan *plan;
+	rank_keys *keys;
+	int *order;					// DNA numbers best first, only the elite are in order unless it's rank selection
+	double *weights;			// Running total of the odds, by rank or number, for rank and fitness selection
+	int eliteCount;
+	dna *parents;
+	gene_steps *parentSteps;
+	dna *children;				// Where the first child goes
+	gene_steps *childSteps;
+	int childCount;
+	int nextChild;				// The next child that needs breeding, only touched with atomics
+} breeding_work;
+
+typedef struct {				// State for one xoshiro256** random number stream
+	uint64_t s[4];
+} rng_state;
+
+typedef struct arena_block {	// One chunk of memory owned by an arena
+	struct arena_block *next;
+	size_t size;
+	size_t used;
+	char data[];
+} arena_block;
+
+typedef struct {				// A bump pointer allocator. Nothing in it is freed alone, arenaReset frees it all
+	arena_block *first;
+	arena_block *current;
+} arena;
+
+typedef struct {				// A log/linear histogram of timings in nanoseconds
+	uint64_t counts[HISTOGRAM_BUCKETS];
+	uint64_t total;
+	uint64_t sum;
+	uint64_t max;
+} latency_histogram;
 
-move tempMove;			// A move structure we'll use
+//------------------------------- Global Variables -------------------------------
 
 int moveNum;			// The number of the next move
 int turn;
@@ -128,12 +329,23 @@ int *tiesArray;
 double *timeArray;
 ipc_memory *ipc;
 
-move *moveList[136];
+packed_move moveList[MAX_GAME_MOVES + 1];	// Every move made so far this game, from 1 up
+
+uint64_t masterSeed;			// Every random stream is derived from this, so runs can be repeated
+rng_state masterRNG;			// Stream for the start board and making DNA
+rng_state gameRNG;				// Stream for the game currently being played
+
+result_queue resultQueue;		// Between the tourney and the results writer
+pthread_t resultThread;
+
+FILE *gameLog = null;			// Every game we play goes in here, see logGame
+FILE *gameIndex = null;			// Where each game starts in gameLog
+uint64_t gameLogOffset;			// How far into gameLog the next game will go
 
 int me = 0;		// Which player we are, one or two
 int him = 0;	// Which player they are, one or two
 
-move finalMove;
+packed_move finalMove;
 
 int nextMoveNum = 0;	// The number of the next move
 
@@ -142,8 +354,16 @@ double *ourTime, *hisTime;						// Pointers to time left for quick reference
 
 dna *myDNA;
 
+rng_state moveRNG;				// The player's random stream, only used to break ties between moves
+
+latency_histogram *moveTimings[MAX_BOARD_SIDE + 1][MAX_BOARD_SIDE + 1];	// TIMING_STAGES for each board size
+const char *stageNames[TIMING_STAGES] = {"generate", "candidate", "select", "move"};
+
 int possibleMovesFound;
-move *possibleMoves[MAX_POSSIBLE_MOVES];		// An array to hold all possible moves we find
+packed_move possibleMoves[MAX_POSSIBLE_MOVES];	// An array to hold all possible moves we find
+double possibleScores[MAX_POSSIBLE_MOVES];		// And the score of each one, once selectMove works it out
+
+arena evalArena;				// Holds scratch boards and evaluations, reset every time we select a move
 
 // Function prototypes
 
@@ -155,122 +375,541 @@ char columnToChar(int x);
 int countLines(int *board, int x, int y);
 inline int xyToIndex(int x, int y);
 void copyBoard(int *s, int *d);
-move *makeMove(int x_start, int y_start, int x_end, int y_end);
-void runMoveWithStruct(int player, move *theMove, int *theBoard);
-void loadDNA(char *path, dna *dest);
-void saveDNA(char *path, dna *source);
+packed_move packMove(int from_x, int from_y, int to_x, int to_y);
+void unpackMove(packed_move theMove, int *from_x, int *from_y, int *to_x, int *to_y);
+void runPackedMove(int player, packed_move theMove, int *theBoard);
+void loadDNA(char *path, dna *dest, gene_steps *steps);
+void saveDNA(char *path, dna *source, gene_steps *steps);
 void copyDNA(dna *s, dna *d);
 int gameIsOver(int *board);
 void writeGame(char *fileName);
-move *readLastMove(char *fileName);
+packed_move readLastMove(char *fileName);
 void clearMoves();
-void copyMove(volatile move *s, move *d);
-dna *haveSex(dna *a, dna *b, dna *dest);
-void setupStartBoard(int *startBoard);
+dna *haveSex(dna *a, gene_steps *aSteps, dna *b, gene_steps *bSteps, dna *dest, gene_steps *steps,
+				breeding_plan *plan, rng_state *rng);
+void crossDNA(int kind, dna *a, dna *b, dna *c, rng_state *rng);
+void mutateDNA(breeding_plan *plan, dna *c, gene_steps *steps, rng_state *rng);
+void setupStartBoard(int *startBoard, rng_state *rng);
+uint64_t mixBits(uint64_t z);
+uint64_t splitMix(uint64_t *x);
+void seedRNG(rng_state *r, uint64_t seed, uint64_t stream);
+uint64_t nextRandom(rng_state *r);
+double randomDouble(rng_state *r);
+double randomNormal(rng_state *r);
+int randomInt(rng_state *r, int n);
+void openGameLog(int worker);
+void logGame(uint32_t stream, int playerOneNumber, dna *playerOne, int playerTwoNumber, dna *playerTwo, int winner,
+				packed_move *moves, int moveCount);
+void closeGameLog();
+void *arenaAlloc(arena *a, size_t size);
+void arenaReset(arena *a);
+uint64_t nanoTime();
+int histogramBucket(uint64_t ns);
+uint64_t bucketValue(int bucket);
+uint64_t histogramValueAt(latency_histogram *h, double fraction);
+void recordTiming(int stage, uint64_t ns);
+void writeTimings();
 void selectMove();
-boardEvaluation *evaluateBoard(int *board, move *theMove);
+boardEvaluation *evaluateBoard(int *board, packed_move theMove);
 void generateMoveList();
+void clearPossibleMoves();
 void addPossibleMove(int from_x, int from_y, int to_x, int to_y);
 double scoreEvaluation(boardEvaluation *e);
 void playHalf();
 void makeDNA(int theCount, int startNum);
 void runTourney(int theCount, int startNum);
+void ringWait(uint32_t *bell, uint32_t seen, int ms);
+void ringBell(uint32_t *bell, int sleepers);
+void makeResults(results_matrix *r, int theCount, int startNum);
+void freeResults(results_matrix *r);
+void recordResult(results_matrix *r, game_result *g);
+void openResults(results_matrix *r);
+void queueResult(game_result *g);
+void *resultWriter(void *arg);
+void closeResults();
+void readResults(char *path, results_matrix *r);
+void tallyResults(results_matrix *r);
+void writeReports(results_matrix *r);
+void writeResultsHTML(results_matrix *r);
+void writeResultsCSV(results_matrix *r);
+void writeResultsJSON(results_matrix *r);
 void breedingProgram(int theCount, int startNum);
-void swapDNA(dna *one, dna *two);
-void swapInt(int *one, int *two);
-void sortDNAByScore(dna dnaArray[], int dnaScores[], int dnaNumbers[], int theCount);
-void makeRandomDNA(dna *dest);
+void makeRankKeys(rank_keys *k, int theCount);
+void freeRankKeys(rank_keys *k);
+void addHeadToHead(rank_keys *k, results_matrix *r);
+int ranksBefore(rank_keys *k, int a, int b);
+void siftRanks(rank_keys *k, int heap[], int top, int i);
+void sortRanks(rank_keys *k, int order[], int scratch[], int n);
+void rankDNA(rank_keys *k, int order[], int top);
+void defaultBreedingPlan(breeding_plan *plan);
+void readBreedingPlan(char *path, breeding_plan *plan);
+void printBreedingPlan(breeding_plan *plan);
+int pickWeighted(double *weights, int count, rng_state *rng);
+int selectParent(breeding_work *w, rng_state *rng);
+void *breedChildren(void *arg);
+void resetSteps(gene_steps *steps);
+int currentGeneration();
+int compareGenes(const void *a, const void *b);
+void logDiversity(dna dnaArray[], gene_steps steps[], rank_keys *k, int theCount);
+void makeRandomDNA(dna *dest, rng_state *rng);
 
 //------------------------------- Function definitions -------------------------------
 
-// Put random genes into DNA
+// Get memory from an arena, it lives until the arena is reset
 
-void makeRandomDNA(dna *dest) {
+void *arenaAlloc(arena *a, size_t size) {
+	arena_block *b;
+	size_t blockSize;
+	void *result;
 
-	double tempNum;
-	
-	tempNum = ((double) rand()) / ((double) RAND_MAX);	// Number from 0 ot 1
-	tempNum = tempNum * 2.0;							// Number from 0 to 2
-	tempNum = tempNum - 1.0;							// Number from -1 to 1
+	size = (size + 7) & ~((size_t) 7);	// Keep everything lined up for doubles
 
-	dest->noBasePair = tempNum;
-	
-	tempNum = ((double) rand()) / ((double) RAND_MAX);	// Number from 0 ot 1
-	tempNum = tempNum * 2.0;							// Number from 0 to 2
-	tempNum = tempNum - 1.0;							// Number from -1 to 1
+	// Move on to blocks we already have if this one is full
 
-	dest->oneBasePair = tempNum;
-	
-	tempNum = ((double) rand()) / ((double) RAND_MAX);	// Number from 0 ot 1
-	tempNum = tempNum * 2.0;							// Number from 0 to 2
-	tempNum = tempNum - 1.0;							// Number from -1 to 1
+	while ((a->current != null) && (a->current->used + size > a->current->size) && (a->current->next != null)) {
+		a->current = a->current->next;
+	}
 
-	dest->twoBasePair = tempNum;
-	
-	tempNum = ((double) rand()) / ((double) RAND_MAX);	// Number from 0 ot 1
-	tempNum = tempNum * 2.0;							// Number from 0 to 2
-	tempNum = tempNum - 1.0;							// Number from -1 to 1
+	if ((a->current == null) || (a->current->used + size > a->current->size)) {
+		// Out of room, so we need a new block
 
-	dest->threeBasePair = tempNum;
-	
-	tempNum = ((double) rand()) / ((double) RAND_MAX);	// Number from 0 ot 1
-	tempNum = tempNum * 2.0;							// Number from 0 to 2
-	tempNum = tempNum - 1.0;							// Number from -1 to 1
+		blockSize = ARENA_BLOCK_SIZE;
 
-	dest->lineLengthBasePair = tempNum;
-	
-	tempNum = ((double) rand()) / ((double) RAND_MAX);	// Number from 0 ot 1
-	tempNum = tempNum * 2.0;							// Number from 0 to 2
-	tempNum = tempNum - 1.0;							// Number from -1 to 1
+		if (size > blockSize)
+			blockSize = size;
+
+		b = malloc(sizeof(arena_block) + blockSize);
+
+		if (b == null) {
+			printf("Unable to allocate arena memory: error %d.\n", errno);
+			exit(1);
+		}
+
+		b->next = null;
+		b->size = blockSize;
+		b->used = 0;
+
+		if (a->current == null)
+			a->first = b;
+		else
+			a->current->next = b;
+
+		a->current = b;
+	}
+
+	result = a->current->data + a->current->used;
+	a->current->used += size;
 
-	dest->currentMarginBasePair = tempNum;
+	return result;
 }
 
-// Sort a bunch of DNA decending by score
+// Throw away everything in an arena at once. The memory is kept for next time
 
-void sortDNAByScore(dna dnaArray[], int dnaScores[], int dnaNumbers[], int theCount) {
-	// Use bubble sort
+void arenaReset(arena *a) {
+	arena_block *b;
 
-	int i, j;
-	int swapHappened;
+	for (b = a->first; b != null; b = b->next) {
+		b->used = 0;
+	}
+
+	a->current = a->first;
+}
+
+// Scramble the bits of a number, the finishing step of splitmix64
+
+uint64_t mixBits(uint64_t z) {
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+}
+
+// Step a splitmix64 counter, which we only use to fill in xoshiro state
+
+uint64_t splitMix(uint64_t *x) {
+	*x += 0x9E3779B97F4A7C15ULL;
+
+	return mixBits(*x);
+}
+
+// Seed a random stream. Different stream numbers give unrelated sequences from the same seed
+
+void seedRNG(rng_state *r, uint64_t seed, uint64_t stream) {
+	uint64_t x;
+	int i;
+
+	x = mixBits(seed) ^ mixBits(stream + 0x9E3779B97F4A7C15ULL);
+
+	for (i = 0; i < 4; i++) {
+		r->s[i] = splitMix(&x);
+	}
+}
+
+// Get the next 64 random bits from a stream (xoshiro256**)
+
+uint64_t nextRandom(rng_state *r) {
+	uint64_t *s = r->s;
+	uint64_t result, t;
+
+	result = s[1] * 5;
+	result = ((result << 7) | (result >> 57)) * 9;
+
+	t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
 
-	for (i = 0; i < theCount - 1; i++) {
-		swapHappened = false;	// For checking if a swap occured
+	s[2] ^= t;
+	s[3] = (s[3] << 45) | (s[3] >> 19);
 
-		for (j = 0; j < theCount - i - 1; j++) {
-			if (dnaScores[j] < dnaScores[j + 1]) {
-				// They need to be swapped
+	return result;
+}
+
+// A random number from 0 up to (but not including) 1
+
+double randomDouble(rng_state *r) {
+	return (nextRandom(r) >> 11) * (1.0 / 9007199254740992.0);	// 53 bits, all a double can hold
+}
+
+// A normally distributed random number with a mean of 0 and a standard deviation of 1 (Box-Muller)
+
+double randomNormal(rng_state *r) {
+	double u = 1.0 - randomDouble(r);	// Never 0, so we can take the log
+	double v = randomDouble(r);
+
+	return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+// A random number from 0 to n - 1
+
+int randomInt(rng_state *r, int n) {
+	return (int) (((nextRandom(r) >> 32) * (uint64_t) n) >> 32);
+}
+
+// Get a timestamp in nanoseconds, only good for measuring differences
+
+uint64_t nanoTime() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return ((uint64_t) t.tv_sec) * 1000000000ULL + (uint64_t) t.tv_nsec;
+}
+
+// Figure out which histogram bucket a timing goes in
+
+int histogramBucket(uint64_t ns) {
+	int top;
+
+	if (ns < HISTOGRAM_SUB_COUNT)
+		return (int) ns;	// Small values get a bucket each
+
+	top = 63 - __builtin_clzll(ns);	// The highest bit set
+
+	return (top - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT +
+				(int) ((ns >> (top - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_COUNT - 1));
+}
+
+// The smallest timing that goes into a bucket
+
+uint64_t bucketValue(int bucket) {
+	if (bucket < HISTOGRAM_SUB_COUNT)
+		return (uint64_t) bucket;
+
+	return ((uint64_t) (HISTOGRAM_SUB_COUNT + bucket % HISTOGRAM_SUB_COUNT)) << (bucket / HISTOGRAM_SUB_COUNT - 1);
+}
+
+// Find the timing that the given fraction of samples are at or under (0.5 is the median)
+
+uint64_t histogramValueAt(latency_histogram *h, double fraction) {
+	uint64_t wanted, seen;
+	int i;
+
+	wanted = (uint64_t) (fraction * h->total + 0.5);
+
+	if (wanted < 1)
+		wanted = 1;
+
+	seen = 0;
 
-				swapHappened = true;	// Mark that we swapped
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += h->counts[i];
 
-				swapDNA(&dnaArray[j], &dnaArray[j + 1]);
-				swapInt(&dnaScores[j], &dnaScores[j + 1]);
-				swapInt(&dnaNumbers[j], &dnaNumbers[j + 1]);
+		if (seen >= wanted) {
+			if (bucketValue(i) > h->max)
+				return h->max;	// The top bucket can be wider than what we actually saw
+			return bucketValue(i);
+		}
+	}
+
+	return h->max;
+}
+
+// Add a timing for the current board size
+
+void recordTiming(int stage, uint64_t ns) {
+	latency_histogram *h;
+
+	if (moveTimings[boardHeight][boardWidth] == null) {
+		moveTimings[boardHeight][boardWidth] = calloc(TIMING_STAGES, sizeof(latency_histogram));
+
+		if (moveTimings[boardHeight][boardWidth] == null) {
+			printf("Unable to allocate timing histograms.\n");
+			exit(1);
+		}
+	}
+
+	h = &(moveTimings[boardHeight][boardWidth][stage]);
+
+	h->counts[histogramBucket(ns)]++;
+	h->total++;
+	h->sum += ns;
+
+	if (ns > h->max)
+		h->max = ns;
+}
+
+// Write a summary of our timings to the timing file, run at exit
+
+void writeTimings() {
+	FILE *out = null;
+	latency_histogram *h;
+	int x, y, stage;
+
+	out = fopen(TIMING_FILE, "a");	// We add on, so many runs can go in one file
+
+	if (out == null) {
+		printf("Unable to open the timing file: error %d.\n", errno);
+		return;
+	}
+
+	if (ftell(out) == 0) {
+		fprintf(out, "Width,Height,Stage,Count,Mean_ns,P50_ns,P90_ns,P99_ns,Max_ns,Per_second\n");
+	}
+
+	for (y = MIN_BOARD_SIDE; y <= MAX_BOARD_SIDE; y++) {
+		for (x = MIN_BOARD_SIDE; x <= MAX_BOARD_SIDE; x++) {
+			if (moveTimings[y][x] == null)
+				continue;
+
+			for (stage = 0; stage < TIMING_STAGES; stage++) {
+				h = &(moveTimings[y][x][stage]);
+
+				if (h->total == 0)
+					continue;
+
+				fprintf(out, "%d,%d,%s,%llu,%llu,%llu,%llu,%llu,%llu,%.1f\n", x, y, stageNames[stage],
+						(unsigned long long) h->total, (unsigned long long) (h->sum / h->total),
+						(unsigned long long) histogramValueAt(h, 0.5), (unsigned long long) histogramValueAt(h, 0.9),
+						(unsigned long long) histogramValueAt(h, 0.99), (unsigned long long) h->max,
+						h->sum ? (h->total * 1000000000.0) / h->sum : 0.0);
 			}
 		}
+	}
+
+	fclose(out);
+}
 
-		if (swapHappened == false) {
-			break;	// We're done since there were no swaps, so exit
+// Put random genes into DNA, one for each feature we know
+
+void makeRandomDNA(dna *dest, rng_state *rng) {
+	int i;
+
+	memset(dest, 0, sizeof(dna));
+
+	dest->geneCount = FEATURE_COUNT;
+
+	for (i = 0; i < FEATURE_COUNT; i++)
+		dest->genes[i] = randomDouble(rng) * 2.0 - 1.0;	// Number from -1 to 1
+}
+
+// Get empty rank keys ready for theCount DNA
+
+void makeRankKeys(rank_keys *k, int theCount) {
+	k->count = theCount;
+	k->points = calloc(theCount, sizeof(int));
+	k->headToHead = calloc(theCount, sizeof(int));
+	k->time = calloc(theCount, sizeof(double));
+
+	if ((k->points == null) || (k->headToHead == null) || (k->time == null)) {
+		printf("Unable to allocate rank keys for %d DNA.\n", theCount);
+		exit(1);
+	}
+}
+
+// Give back the rank keys' memory
+
+void freeRankKeys(rank_keys *k) {
+	free(k->points);
+	free(k->headToHead);
+	free(k->time);
+}
+
+// Fill in the tie breakers from the games of a tourney. Head to head only counts games between DNA
+// with the same points, so it's one pass over the games instead of a table for every tie
+
+void addHeadToHead(rank_keys *k, results_matrix *r) {
+	int i, j, game, pair;
+
+	pair = 0;
+
+	for (i = 0; i < r->count; i++) {
+		for (j = i; j < r->count; j++) {
+			for (game = pair * 2; game < pair * 2 + 2; game++) {
+				// In the first game i is player one, in the second it's j
+
+				int one = (game == pair * 2) ? i : j;
+				int two = (game == pair * 2) ? j : i;
+
+				k->time[one] += r->times[game * 2];
+				k->time[two] += r->times[game * 2 + 1];
+
+				if ((i == j) || (k->points[i] != k->points[j]))
+					continue;
+
+				if (r->winners[game] == PLAYER_ONE) {
+					k->headToHead[one] += 2;
+				} else if (r->winners[game] == PLAYER_TWO) {
+					k->headToHead[two] += 2;
+				} else if (r->winners[game] != NO_WINNER_YET) {
+					k->headToHead[one]++;
+					k->headToHead[two]++;
+				}
+			}
+
+			pair++;
 		}
 	}
 }
 
-// Swap two DNA bits
+// If DNA a ranks ahead of DNA b. The number is the last tie breaker, so no two DNA ever tie
+
+int ranksBefore(rank_keys *k, int a, int b) {
+	if (k->points[a] != k->points[b])
+		return k->points[a] > k->points[b];
+
+	if (k->headToHead[a] != k->headToHead[b])
+		return k->headToHead[a] > k->headToHead[b];
+
+	if (k->time[a] != k->time[b])
+		return k->time[a] < k->time[b];
+
+	return a < b;
+}
+
+// Move heap[i] down until the heap is in order again. The worst DNA in it is at the top
+
+void siftRanks(rank_keys *k, int heap[], int top, int i) {
+	int child, temp;
+
+	while (true) {
+		child = i * 2 + 1;
+
+		if (child >= top)
+			break;
+
+		if ((child + 1 < top) && ranksBefore(k, heap[child], heap[child + 1]))
+			child++;	// The worse of the two children
+
+		if (ranksBefore(k, heap[child], heap[i]))
+			break;
+
+		temp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = temp;
+
+		i = child;
+	}
+}
+
+// Sort DNA numbers best first, a bottom up merge sort using scratch as the other buffer
+
+void sortRanks(rank_keys *k, int order[], int scratch[], int n) {
+	int *from = order;
+	int *to = scratch;
+	int *temp;
+	int width, left, mid, right, a, b, out;
+
+	for (width = 1; width < n; width *= 2) {
+		for (left = 0; left < n; left += width * 2) {
+			mid = (left + width < n) ? left + width : n;
+			right = (left + width * 2 < n) ? left + width * 2 : n;
+
+			a = left;
+			b = mid;
+
+			for (out = left; out < right; out++) {
+				if ((a < mid) && ((b >= right) || !ranksBefore(k, from[b], from[a]))) {
+					to[out] = from[a++];
+				} else {
+					to[out] = from[b++];
+				}
+			}
+		}
 
-void swapDNA(dna *one, dna *two) {
-	dna temp;
+		temp = from;
+		from = to;
+		to = temp;
+	}
 
-	copyDNA(one, &temp);
-	copyDNA(two, one);
-	copyDNA(&temp, two);
+	if (from != order)
+		memcpy(order, from, n * sizeof(int));
 }
 
-void swapInt(int *one, int *two) {
-	int temp;
+// Put the numbers of the best top DNA in order[0] on, best first, and the rest after them by number.
+// Only the numbers move, the DNA never does. Picking the top with a heap is n log top, so a big
+// population only pays for sorting the DNA that get used
+
+void rankDNA(rank_keys *k, int order[], int top) {
+	int *scratch = null;
+	uint8_t *picked = null;
+	int i, out;
+
+	if (top > k->count)
+		top = k->count;
+
+	scratch = malloc(k->count * sizeof(int));
+	picked = calloc(k->count, sizeof(uint8_t));
+
+	if ((scratch == null) || (picked == null)) {
+		printf("Unable to allocate memory to rank %d DNA.\n", k->count);
+		exit(1);
+	}
+
+	// Keep the best top we've seen in a heap with the worst of them on top
+
+	for (i = 0; i < k->count; i++) {
+		if (i < top) {
+			order[i] = i;
+
+			if (i == top - 1) {
+				for (out = top / 2 - 1; out >= 0; out--)
+					siftRanks(k, order, top, out);
+			}
+		} else if ((top > 0) && ranksBefore(k, i, order[0])) {
+			order[0] = i;
+			siftRanks(k, order, top, 0);
+		}
+	}
+
+	sortRanks(k, order, scratch, top);
+
+	// Everyone else goes after them
+
+	for (i = 0; i < top; i++)
+		picked[order[i]] = true;
 
-	temp = *one;
-	*one = *two;
-	*two = temp;
+	out = top;
+
+	for (i = 0; i < k->count; i++) {
+		if (!picked[i])
+			order[out++] = i;
+	}
+
+	free(scratch);
+	free(picked);
 }
 
 // Using our magic DNA
@@ -278,10 +917,10 @@ void swapInt(int *one, int *two) {
 double scoreEvaluation(boardEvaluation *e) {
 	// First, some variables we'll need
 
+	double features[FEATURE_COUNT];
 	double squareCount;
-	double temp;
-	int margin;
 	double score;
+	int i;
 
 	// First a quick check to see if we found a winner
 
@@ -293,43 +932,24 @@ double scoreEvaluation(boardEvaluation *e) {
 		}
 	}
 
-	// Initialize things
+	// The features, counts are per box
 
 	squareCount = boardWidth * boardHeight;
-	score = 0.0;
-
-	// Now, we do the calculations
-	// First, look at who is winning and by how much
-
-	margin = *ourScore - *hisScore;
-	temp = ((double) margin) / squareCount;
-
-	score += temp * myDNA->currentMarginBasePair;
-
-	// Now, look at how many squares have no lines on them
-
-	temp = ((double) e->noSides) / squareCount;
-	score += temp * myDNA->noBasePair;
-
-	// Now, look at how many squares have one line on them
-
-	temp = ((double) e->oneSides) / squareCount;
-	score += temp * myDNA->oneBasePair;
 
-	// Now, look at how many squares have two lines on them
+	features[FEATURE_NO_SIDES] = e->noSides / squareCount;
+	features[FEATURE_ONE_SIDE] = e->oneSides / squareCount;
+	features[FEATURE_TWO_SIDES] = e->twoSides / squareCount;
+	features[FEATURE_THREE_SIDES] = e->threeSides / squareCount;
+	features[FEATURE_LINE_LENGTH] = e->moveLength / 9.0;	// 9 segments is the longest possible line
+	features[FEATURE_MARGIN] = (*ourScore - *hisScore) / squareCount;
 
-	temp = ((double) e->twoSides) / squareCount;
-	score += temp * myDNA->twoBasePair;
+	// The score is each gene times its feature, one pass down two flat arrays
 
-	// Now, look at how many squares have three lines on them
+	score = myDNA->genes[FEATURE_MARGIN] * features[FEATURE_MARGIN];	// Margin first, the order it always went in
 
-	temp = ((double) e->threeSides) / squareCount;
-	score += temp * myDNA->threeBasePair;
-
-	// Now, how long was the last move (1 section, 3, 12, etc);
-
-	temp = ((double) e->moveLength) / 9.0;	// 9 segments is the longest possible line
-	score += temp * myDNA->lineLengthBasePair;
+	for (i = 0; i < FEATURE_COUNT; i++)
+		if (i != FEATURE_MARGIN)
+			score += myDNA->genes[i] * features[i];
 
 	// That's it
 
@@ -340,17 +960,16 @@ double scoreEvaluation(boardEvaluation *e) {
 
 void addPossibleMove(int from_x, int from_y, int to_x, int to_y) {
 /*	if (DEBUG) {
-		char fromXChar, fromYChar, toXChar, toYChar;
-		fromXChar = columnToChar(from_x);
-		toXChar = columnToChar(to_x);
-	
-		fromYChar = '1' + from_y;
-		toYChar = '1' + to_y;
-	
-		printf("%c%c %c%c\n", fromXChar, fromYChar, toXChar, toYChar);
+		printf("%c%d %c%d\n", columnToChar(from_x), from_y + 1, columnToChar(to_x), to_y + 1);
 	}
 */
-	possibleMoves[possibleMovesFound++] = makeMove(from_x, from_y, to_x, to_y);
+	possibleMoves[possibleMovesFound++] = packMove(from_x, from_y, to_x, to_y);
+}
+
+// Empty the possible move list
+
+void clearPossibleMoves() {
+	possibleMovesFound = 0;
 }
 
 // A function to generate a list of all legal moves
@@ -360,7 +979,6 @@ void generateMoveList() {
 
 	int x, y, i, j;
 	int start, end;
-	move *temp;
 
 	for (y = 0; y < boardHeight; y++) {
 		end = -1;
@@ -529,15 +1147,16 @@ void generateMoveList() {
 
 // A function to evalue a gameboard
 
-boardEvaluation *evaluateBoard(int *board, move *lastMove) {
+boardEvaluation *evaluateBoard(int *board, packed_move lastMove) {
 	// Variables
 	
 	int x, y, i, o;
+	int from_x, from_y, to_x, to_y;
 	boardEvaluation *temp;
 
 	// Allocate our structure
 	
-	temp = malloc(sizeof(boardEvaluation));
+	temp = arenaAlloc(&evalArena, sizeof(boardEvaluation));
 
 	// Initialize it
 
@@ -613,11 +1232,13 @@ boardEvaluation *evaluateBoard(int *board, move *lastMove) {
 		temp->winner = NO_WINNER_YET;
 	}
 
-	if (lastMove != null) {
-		temp->moveLength = abs(lastMove->from_x - lastMove->to_x) + abs(lastMove->from_y + lastMove->to_y);
+	if (lastMove != NO_MOVE) {
+		unpackMove(lastMove, &from_x, &from_y, &to_x, &to_y);
+
+		temp->moveLength = abs(from_x - to_x) + abs(from_y + to_y);
 	}
 
-	// Return it, note that the caller MUST FREE THE STRUCTURE
+	// Return it, note that it only lives until the evaluation arena is reset
 
 	return temp;
 }
@@ -633,14 +1254,12 @@ void selectMove() {
 	int bestCount;
 	int *tempBoard;
 	boardEvaluation *tempEval;
+	uint64_t selectStart = 0, candidateStart = 0;
 	int goodMoves[MAX_POSSIBLE_MOVES];
 
-	tempBoard = malloc(boardWidth * boardHeight * sizeof(int));
+	arenaReset(&evalArena);	// Throw away the last turn's evaluations
 
-	if (tempBoard == null) {
-		printf("Unable to allocate space for a temporary game board.\n");
-		exit(1);
-	}
+	tempBoard = arenaAlloc(&evalArena, boardWidth * boardHeight * sizeof(int));
 
 	// A sanity check
 
@@ -652,6 +1271,9 @@ void selectMove() {
 
 	// Now the real work
 
+	if (TIMING)
+		selectStart = nanoTime();
+
 	bestScore = -7.0;	// Lower than the lowest possible score
 	bestIndex = -1;
 	bestCount = -1;
@@ -661,36 +1283,38 @@ void selectMove() {
 	for (i = 0; i < possibleMovesFound; i++) {
 		// First, get us a temporary copy of the current game board
 
+		if (TIMING)
+			candidateStart = nanoTime();
+
 		copyBoard(gameBoard, tempBoard);
 
 		// Now, run the trial move on it
 
-		runMoveWithStruct(me, possibleMoves[i], tempBoard);
+		runPackedMove(me, possibleMoves[i], tempBoard);
 
 		// Now, evaluate it
 
 		tempEval = evaluateBoard(tempBoard, possibleMoves[i]);
-		
-		// Now free that evaluation
-
-		free(tempEval);
 
 		// Now, score it
 
-		possibleMoves[i]->score = scoreEvaluation(tempEval);
+		possibleScores[i] = scoreEvaluation(tempEval);
+
+		if (TIMING)
+			recordTiming(STAGE_CANDIDATE, nanoTime() - candidateStart);
 
 		// Now, see if it is the best one we've found
 
-		if (possibleMoves[i]->score == 7.0) {		// We found a winner, no need to score the rest
+		if (possibleScores[i] == 7.0) {		// We found a winner, no need to score the rest
 			bestIndex = i;
 			bestCount = 1;
 			break;
-		} else if (possibleMoves[i]->score > bestScore) {
+		} else if (possibleScores[i] > bestScore) {
 			bestCount = 1;
 			bestIndex = i;
-			bestScore = possibleMoves[i]->score;
+			bestScore = possibleScores[i];
 			goodMoves[bestCount - 1] = i;
-		} else if (possibleMoves[i]->score == bestScore) {	// If the scores are the same...
+		} else if (possibleScores[i] == bestScore) {	// If the scores are the same...
 			bestCount++;									// Make a random choice between them
 			goodMoves[bestCount - 1] = i;
 		}
@@ -699,38 +1323,40 @@ void selectMove() {
 	// If we have many different options, choose one
 
 	if (bestCount > 1) {
-		int which = rand() % bestCount;		// Choose a move
+		int which = randomInt(&moveRNG, bestCount);		// Choose a move
 		bestIndex = goodMoves[which];		// From the indexes with the highest score
 	}
 
 	// Set up the move
 
-	copyMove(possibleMoves[bestIndex], &finalMove);
+	finalMove = possibleMoves[bestIndex];
+
+	if (TIMING)
+		recordTiming(STAGE_SELECT, nanoTime() - selectStart);
 
-	free(tempBoard);
 }
 
 // Prepare the start board with some random moves on it
 
-void setupStartBoard(int *startBorad) {
+void setupStartBoard(int *startBorad, rng_state *rng) {
 	// OK, first things first, do we want the board empty or filled?
 
-	if (rand() >= (RAND_MAX / 2)) {
+	if (randomDouble(rng) >= 0.5) {
 		// It should have initial moves
 		// How many lines do we want to make?
 
-		int c = rand() % 15 + 1;	// Up to 15 lines
+		int c = randomInt(rng, 15) + 1;	// Up to 15 lines
 
 		int i, sx, sy, ex, ey;
 
 		for (i = 0; i <= c; i++) {
-			if (rand() % 2 == 1) {
+			if (randomInt(rng, 2) == 1) {
 				// Virticle line
-				sx = rand() % (boardWidth + 1);
+				sx = randomInt(rng, boardWidth + 1);
 				ex = sx;
 
-				sy = rand() % (boardHeight + 1);
-				ey = rand() % (boardHeight + 1);
+				sy = randomInt(rng, boardHeight + 1);
+				ey = randomInt(rng, boardHeight + 1);
 
 				if (sy > ey) {
 					int t = sy;
@@ -739,11 +1365,11 @@ void setupStartBoard(int *startBorad) {
 				}
 			} else {
 				// Horizontal line
-				sy = rand() % (boardHeight + 1);
+				sy = randomInt(rng, boardHeight + 1);
 				ey = sy;
 
-				sx = rand() % (boardWidth + 1);
-				ex = rand() % (boardWidth + 1);
+				sx = randomInt(rng, boardWidth + 1);
+				ex = randomInt(rng, boardWidth + 1);
 
 				if (sx > ex) {
 					int t = sx;
@@ -766,8 +1392,10 @@ void setupStartBoard(int *startBorad) {
 
 // Simulate sexual reproduction between two parent DNAs with mutation
 
-dna *haveSex(dna *a, dna *b, dna *dest) {
+dna *haveSex(dna *a, gene_steps *aSteps, dna *b, gene_steps *bSteps, dna *dest, gene_steps *steps,
+				breeding_plan *plan, rng_state *rng) {
 	dna *c = null;
+	int i;
 
 	// Did they give us a desintaion?
 
@@ -783,237 +1411,140 @@ dna *haveSex(dna *a, dna *b, dna *dest) {
 		c = dest;
 	}
 
-	// Now, copy parent A's DNA into the child
+	// The child is a mix of both parents. Its step sizes are in between theirs, it's the
+	// size of the change that matters so that's the geometric mean
 
-	copyDNA(a, c);
+	crossDNA(plan->crossover, a, b, c, rng);
 
-	// Now we go through and randomly replace A's genes with B's
+	for (i = 0; i < MAX_GENES; i++)
+		steps->steps[i] = sqrt(aSteps->steps[i] * bSteps->steps[i]);
 
-	double r = (((double) rand()) / ((double) RAND_MAX));
+	// Then maybe a mutant. With adaptive mutation they all are, their step sizes decide how much
 
-	if (r >= 0.5) {
-		c->noBasePair = b->noBasePair;
-	}
+	if ((plan->mutation == MUTATE_ADAPTIVE) || (randomDouble(rng) <= plan->mutationRate))
+		mutateDNA(plan, c, steps, rng);
+
+	// That's it, return the child.
+	
+	return c;
+}
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+// Mix two parents' genes into a child
 
-	if (r >= 0.5) {
-		c->oneBasePair = b->oneBasePair;
-	}
+void crossDNA(int kind, dna *a, dna *b, dna *c, rng_state *rng) {
+	double u;
+	int i, cut;
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+	// Start with parent A, A's missing genes are 0 so B's can still win
 
-	if (r >= 0.5) {
-		c->twoBasePair = b->twoBasePair;
-	}
+	copyDNA(a, c);
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+	if (b->geneCount > c->geneCount)
+		c->geneCount = b->geneCount;
 
-	if (r >= 0.5) {
-		c->threeBasePair = b->threeBasePair;
-	}
+	if (kind == CROSS_POINT) {
+		cut = randomInt(rng, c->geneCount + 1);
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+		for (i = cut; i < (int) c->geneCount; i++)
+			c->genes[i] = b->genes[i];
+	} else if (kind == CROSS_BLEND) {
+		// Anywhere between the parents, or a quarter of the way past either one
 
-	if (r >= 0.5) {
-		c->lineLengthBasePair = b->lineLengthBasePair;
-	}
+		for (i = 0; i < (int) c->geneCount; i++) {
+			u = randomDouble(rng) * 1.5 - 0.25;
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+			c->genes[i] = a->genes[i] + u * (b->genes[i] - a->genes[i]);
 
-	if (r >= 0.5) {
-		c->currentMarginBasePair = b->currentMarginBasePair;
+			if (c->genes[i] < -GENE_LIMIT) {
+				c->genes[i] = -GENE_LIMIT;
+			} else if (c->genes[i] > GENE_LIMIT) {
+				c->genes[i] = GENE_LIMIT;
+			}
+		}
+	} else {
+		for (i = 0; i < (int) c->geneCount; i++) {
+			if (randomDouble(rng) >= 0.5)
+				c->genes[i] = b->genes[i];
+		}
 	}
+}
 
-	// Now that that's done, let's do some mutation
+// 'Twill be a mutant, it will. One gene changes, or with adaptive mutation all of them
 
-	double d;
+void mutateDNA(breeding_plan *plan, dna *c, gene_steps *steps, rng_state *rng) {
+	double d, shared, own;
+	int i;
 
-	r = (((double) rand()) / ((double) RAND_MAX));
+	if (plan->mutation == MUTATE_ADAPTIVE) {
+		// The step sizes change first, by a log normal factor with one part shared by every gene
+		// and one part for each. These are the usual rates for an evolution strategy
 
-	if (r <= MUTATION_RATE) {
-		// 'Twill be a mutant, it will.
+		shared = randomNormal(rng) / sqrt(2.0 * c->geneCount);
+		own = 1.0 / sqrt(2.0 * sqrt(c->geneCount));
 
-		r = (((double) rand()) / ((double) RAND_MAX));
+		for (i = 0; i < (int) c->geneCount; i++) {
+			steps->steps[i] *= exp(shared + own * randomNormal(rng));
 
-		if (r <= (1.0 / 6.0)) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->noBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
+			if (steps->steps[i] < STEP_MIN) {
+				steps->steps[i] = STEP_MIN;
+			} else if (steps->steps[i] > GENE_LIMIT) {
+				steps->steps[i] = GENE_LIMIT;
 			}
-	
-			c->noBasePair = c->noBasePair + d;	// Do the mutation
-	
-			if ((c->noBasePair < -1.0) || (c->noBasePair > 1.0)) {
-				// Check the bounds
-	
-				if (c->noBasePair < -1.0) {
-					c->noBasePair = -1.0;
-				} else {
-					c->noBasePair = 1.0;
-				}
+
+			c->genes[i] += steps->steps[i] * randomNormal(rng);
+
+			if (c->genes[i] < -GENE_LIMIT) {
+				c->genes[i] = -GENE_LIMIT;
+			} else if (c->genes[i] > GENE_LIMIT) {
+				c->genes[i] = GENE_LIMIT;
 			}
 		}
 
-		if ((r > (1.0 / 6.0)) && (r <= (2.0 / 6.0))) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->oneBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
-			}
-	
-			c->oneBasePair = c->oneBasePair + d;	// Do the mutation
-	
-			if ((c->oneBasePair < -1.0) || (c->oneBasePair > 1.0)) {
-				// Check the bounds
-	
-				if (c->oneBasePair < -1.0) {
-					c->oneBasePair = -1.0;
-				} else {
-					c->oneBasePair = 1.0;
-				}
-			}
-		}
-	
-		if ((r > (1.0 / 6.0)) && (r <= (2.0 / 6.0))) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->twoBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
-			}
-	
-			c->twoBasePair = c->twoBasePair + d;	// Do the mutation
-	
-			if ((c->twoBasePair < -1.0) || (c->twoBasePair > 1.0)) {
-				// Check the bounds
-	
-				if (c->twoBasePair < -1.0) {
-					c->twoBasePair = -1.0;
-				} else {
-					c->twoBasePair = 1.0;
-				}
-			}
-		}
-	
-		r = (((double) rand()) / ((double) RAND_MAX));
-	
-		if (r <= MUTATION_RATE) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->threeBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
-			}
-	
-			c->threeBasePair = c->threeBasePair + d;	// Do the mutation
-	
-			if ((c->threeBasePair < -1.0) || (c->threeBasePair > 1.0)) {
-				// Check the bounds
-	
-				if (c->threeBasePair < -1.0) {
-					c->threeBasePair = -1.0;
-				} else {
-					c->threeBasePair = 1.0;
-				}
-			}
-		}
-	
-		r = (((double) rand()) / ((double) RAND_MAX));
-	
-		if (r <= MUTATION_RATE) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->lineLengthBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
-			}
-	
-			c->lineLengthBasePair = c->lineLengthBasePair + d;	// Do the mutation
-	
-			if ((c->lineLengthBasePair < -1.0) || (c->lineLengthBasePair > 1.0)) {
-				// Check the bounds
-	
-				if (c->lineLengthBasePair < -1.0) {
-					c->lineLengthBasePair = -1.0;
-				} else {
-					c->lineLengthBasePair = 1.0;
-				}
-			}
-		}
-	
-		r = (((double) rand()) / ((double) RAND_MAX));
-	
-		if (r <= MUTATION_RATE) {
-			// This base pair is going to mutate
-			d = (((double) rand()) / ((double) RAND_MAX)) * c->currentMarginBasePair;	// 0-100% of base pair
-	
-			if ((((double) rand()) / ((double) RAND_MAX)) >= 0.5) {
-				d = d * -1.0;	// Make it negative
-			}
-	
-			c->currentMarginBasePair = c->currentMarginBasePair + d;	// Do the mutation
-	
-			if ((c->currentMarginBasePair < -1.0) || (c->currentMarginBasePair > 1.0)) {
-				// Check the bounds
-	
-				if (c->currentMarginBasePair < -1.0) {
-					c->currentMarginBasePair = -1.0;
-				} else {
-					c->currentMarginBasePair = 1.0;
-				}
-			}
-		}
+		return;
 	}
 
-	// That's it, return the child.
-	
-	return c;
-}
+	i = randomInt(rng, c->geneCount);
+
+	if (plan->mutation == MUTATE_RESET) {
+		c->genes[i] = randomDouble(rng) * 2.0 - 1.0;	// The same as new random DNA
+		return;
+	}
+
+	d = randomDouble(rng) * c->genes[i];	// 0-100% of base pair
+
+	if (randomDouble(rng) >= 0.5) {
+		d = d * -1.0;	// Make it negative
+	}
 
-// Copy a move from one memory location to another
+	c->genes[i] = c->genes[i] + d;	// Do the mutation
 
-void copyMove(volatile move *s, move *d) {
-	d->from_x = s->from_x;
-	d->from_y = s->from_y;
-	d->to_x = s->to_x;
-	d->to_y = s->to_y;
-	d->score = s->score;
+	if (c->genes[i] < -GENE_LIMIT) {	// Check the bounds
+		c->genes[i] = -GENE_LIMIT;
+	} else if (c->genes[i] > GENE_LIMIT) {
+		c->genes[i] = GENE_LIMIT;
+	}
 }
 
 // Copy DNA from one memory location to another
 
 void copyDNA(dna *s, dna *d) {
-	d->noBasePair = s->noBasePair;
-	d->oneBasePair = s->oneBasePair;
-	d->twoBasePair = s->twoBasePair;
-	d->threeBasePair = s->threeBasePair;
-	d->lineLengthBasePair = s->lineLengthBasePair;
-	d->currentMarginBasePair = s->currentMarginBasePair;
+	memcpy(d, s, sizeof(dna));
 }
 
 // A function to clear the list of moves
 
 void clearMoves() {
-	if (moveNum > 1) {
-		int i;
-
-		for (i = 0; i < moveNum - 1; i++) {
-			free(moveList[i]);
-			moveList[i] = null;
-		}
-	}
+	memset(moveList, 0, sizeof(moveList));
 
 	moveNum = 1;
 }
 
 // A function to read the last move in from a file
 
-move *readLastMove(char *fileName) {
+packed_move readLastMove(char *fileName) {
 	FILE *temp = null;
+	char fromXChar, toXChar;
+	int fromY, toY;
 
 	temp = fopen(fileName, "r");
 
@@ -1048,7 +1579,108 @@ move *readLastMove(char *fileName) {
 
 	return tempM;
 */
-	return makeMove(charToColumn(buffer[0]), buffer[1] - '1', charToColumn(buffer[3]), buffer[4] - '1');
+	if (sscanf(buffer, "%c%d %c%d", &fromXChar, &fromY, &toXChar, &toY) != 4) {
+		printf("Unable to understand the move '%s'.\n", buffer);
+		exit(1);
+	}
+
+	return packMove(charToColumn(fromXChar), fromY - 1, charToColumn(toXChar), toY - 1);
+}
+
+// Open the game log and its index for a worker. We add on to them if they are already there
+
+void openGameLog(int worker) {
+	char name[80];
+	game_log_header header;
+
+	sprintf(name, GAME_LOG_NAME, worker);
+
+	gameLog = fopen(name, "ab");
+
+	if (gameLog == null) {
+		printf("Unable to open the game log '%s': error %d.\n", name, errno);
+		exit(1);
+	}
+
+	sprintf(name, GAME_INDEX_NAME, worker);
+
+	gameIndex = fopen(name, "ab");
+
+	if (gameIndex == null) {
+		printf("Unable to open the game index '%s': error %d.\n", name, errno);
+		exit(1);
+	}
+
+	// Games are small, so we let them pile up and write them out in big chunks
+
+	setvbuf(gameLog, null, _IOFBF, GAME_LOG_BUFFER);
+	setvbuf(gameIndex, null, _IOFBF, GAME_LOG_BUFFER / 16);
+
+	// Only a brand new log needs a header
+
+	fseek(gameLog, 0, SEEK_END);
+	gameLogOffset = ftell(gameLog);
+
+	if (gameLogOffset == 0) {
+		memcpy(header.magic, GAME_LOG_MAGIC, 4);
+		header.version = GAME_LOG_VERSION;
+
+		if (fwrite(&header, sizeof(game_log_header), 1, gameLog) != 1) {
+			printf("Unable to write the game log header: error %d.\n", errno);
+			exit(1);
+		}
+
+		gameLogOffset = sizeof(game_log_header);
+	}
+}
+
+// Add a game that was just played (from startBoard and its moves) to the game log
+
+void logGame(uint32_t stream, int playerOneNumber, dna *playerOne, int playerTwoNumber, dna *playerTwo, int winner,
+				packed_move *moves, int moveCount) {
+	game_record r;
+	uint8_t cells[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	int i;
+
+	memset(&r, 0, sizeof(game_record));	// So no stray padding ends up in the file
+
+	r.seed = masterSeed;
+	r.stream = stream;
+	r.playerOneNumber = playerOneNumber;
+	r.playerTwoNumber = playerTwoNumber;
+	copyDNA(playerOne, &(r.playerOne));
+	copyDNA(playerTwo, &(r.playerTwo));
+	r.width = boardWidth;
+	r.height = boardHeight;
+	r.winner = winner;
+	r.moveCount = moveCount;
+
+	for (i = 0; i < boardWidth * boardHeight; i++) {
+		cells[i] = startBoard[i];
+	}
+
+	if ((fwrite(&gameLogOffset, sizeof(uint64_t), 1, gameIndex) != 1) ||
+			(fwrite(&r, sizeof(game_record), 1, gameLog) != 1) ||
+			(fwrite(cells, 1, boardWidth * boardHeight, gameLog) != (size_t) (boardWidth * boardHeight)) ||
+			(fwrite(moves, sizeof(packed_move), r.moveCount, gameLog) != r.moveCount)) {
+		printf("Unable to write to the game log: error %d.\n", errno);
+		exit(1);
+	}
+
+	gameLogOffset += sizeof(game_record) + boardWidth * boardHeight + r.moveCount * sizeof(packed_move);
+}
+
+// Write out anything still buffered and close the game log
+
+void closeGameLog() {
+	if (gameLog != null)
+		fclose(gameLog);
+
+	if (gameIndex != null)
+		fclose(gameIndex);
+
+	gameLog = null;
+	gameIndex = null;
 }
 
 // A function to write the game out to the given file name
@@ -1056,14 +1688,14 @@ move *readLastMove(char *fileName) {
 void writeGame(char *fileName) {
 	FILE *temp = null;
 
-	if (moveNum >= 136) {
+	if (moveNum > MAX_GAME_MOVES + 1) {
 		printf("Ran out of moves! Something has gone wrong!\n");
 		exit(1);
 	}
 
 	temp = fopen(fileName, "w");
 
-	char fromXChar, toXChar, fromYChar, toYChar;
+	char fromXChar, toXChar;
 
 	if (temp == null) {
 		printf("Unable to open file '%s': error %d.\n", fileName, errno);
@@ -1075,13 +1707,13 @@ void writeGame(char *fileName) {
 	fprintf(temp, "2 %d %f\n", playerTwoScore, playerTwoTimeLeft);
 
 	int i, p;
+	int fromX, fromY, toX, toY;
 
 	for (i = 1; i < moveNum - 1; i++) {
-		fromXChar = columnToChar(moveList[i]->from_x);
-		toXChar = columnToChar(moveList[i]->to_x);
-	
-		fromYChar = '1' + moveList[i]->from_y;
-		toYChar = '1' + moveList[i]->to_y;
+		unpackMove(moveList[i], &fromX, &fromY, &toX, &toY);
+
+		fromXChar = columnToChar(fromX);
+		toXChar = columnToChar(toX);
 
 		if (i % 2 == 1) {
 			p = 1;
@@ -1089,7 +1721,7 @@ void writeGame(char *fileName) {
 			p = 2;
 		}
 
-		fprintf(temp, "%d %c%c %c%c\n", p, fromXChar, fromYChar, toXChar, toYChar);
+		fprintf(temp, "%d %c%d %c%d\n", p, fromXChar, fromY + 1, toXChar, toY + 1);
 	}
 
 	fclose(temp);
@@ -1127,10 +1759,11 @@ int gameIsOver(int *board) {
 		return PLAYER_TIE;
 }
 
-// A function to write out DNA to a file
+// A function to write out DNA to a file, and its step sizes if there are any
 
-void saveDNA(char *path, dna *source) {
+void saveDNA(char *path, dna *source, gene_steps *steps) {
 	FILE *out = null;
+	int i;
 
 	// Open the file
 
@@ -1144,26 +1777,31 @@ void saveDNA(char *path, dna *source) {
 
 	// Write the info
 
-	fprintf(out, "%lf\n", source->noBasePair);
-	fprintf(out, "%lf\n", source->oneBasePair);
-	fprintf(out, "%lf\n", source->twoBasePair);
-	fprintf(out, "%lf\n", source->threeBasePair);
-	fprintf(out, "%lf\n", source->lineLengthBasePair);
-	fprintf(out, "%lf\n", source->currentMarginBasePair);
+	for (i = 0; i < (int) source->geneCount; i++)
+		fprintf(out, "%lf\n", source->genes[i]);
+
+	if (steps != null) {
+		fprintf(out, "%s\n", STEPS_MARKER);
+
+		for (i = 0; i < (int) source->geneCount; i++)
+			fprintf(out, "%lf\n", steps->steps[i]);
+	}
 
 	// Close the file
 
 	fclose(out);
 }
 
-// A function to load DNA from a file
+// A function to load DNA from a file, one gene a line. If there are step sizes after them
+// they go in steps, any it doesn't have are STEP_START. Steps can be null
 
-void loadDNA(char *path, dna *dest) {
+void loadDNA(char *path, dna *dest, gene_steps *steps) {
 	// Stuff we'll need
 
 	FILE *in = null;
 	double temp;
 	char buffer[80];
+	int i, inSteps;
 
 	// Now, the work
 
@@ -1177,127 +1815,93 @@ void loadDNA(char *path, dna *dest) {
 
 	// Now that the file is open, we'll read it
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the first base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
-	}
-
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the first base pair.\n");
-		fclose(in);
-		exit(1);
-	}
-
-	dest->noBasePair = temp;
-
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the second base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
-	}
-
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the second base pair.\n");
-		fclose(in);
-		exit(1);
-	}
-
-	dest->oneBasePair = temp;
-
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the third base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
-	}
-
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the third base pair.\n");
-		fclose(in);
-		exit(1);
-	}
-
-	dest->twoBasePair = temp;
+	memset(dest, 0, sizeof(dna));
 
+	if (steps != null)
+		resetSteps(steps);
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the fourth base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
-	}
-
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the fourth base pair.\n");
-		fclose(in);
-		exit(1);
-	}
+	inSteps = false;
+	i = 0;
 
-	dest->threeBasePair = temp;
+	while (fgets(buffer, 80, in) != null) {
+		if (strncmp(buffer, STEPS_MARKER, strlen(STEPS_MARKER)) == 0) {
+			inSteps = true;
+			break;
+		}
 
+		if (dest->geneCount == MAX_GENES)
+			continue;	// We've no room for any more genes
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the fifth base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
-	}
+		if (sscanf(buffer, "%lf", &temp) != 1) {
+			printf("Unable to interpret base pair %d of '%s'.\n", dest->geneCount + 1, path);
+			fclose(in);
+			exit(1);
+		}
 
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the fifth base pair.\n");
-		fclose(in);
-		exit(1);
+		dest->genes[dest->geneCount++] = temp;
 	}
 
-	dest->lineLengthBasePair = temp;
-
+	while (inSteps && (steps != null) && (i < (int) dest->geneCount) && (fgets(buffer, 80, in) != null)) {
+		if ((sscanf(buffer, "%lf", &temp) != 1) || (temp <= 0.0)) {
+			printf("Unable to interpret step size %d of '%s'.\n", i + 1, path);
+			fclose(in);
+			exit(1);
+		}
 
-	if (fgets(buffer, 80, in) == null) {
-		printf("Unable to read the sixth base pair of our dna: %d.\n", errno);
-		fclose(in);
-		exit(1);
+		steps->steps[i++] = temp;
 	}
 
-	if (sscanf(buffer, "%lf", &temp) != 1) {
-		printf("Unable to interpret the sixth base pair.\n");
+	if (dest->geneCount < BASE_GENES) {
+		printf("'%s' only has %d base pairs, DNA needs at least %d.\n", path, dest->geneCount, BASE_GENES);
 		fclose(in);
 		exit(1);
 	}
 
-	dest->currentMarginBasePair = temp;
-
 	// We're done
 
 	fclose(in);
-
-	// A debug check
 }
 
-void runMoveWithStruct(int player, move *theMove, int *theBoard) {
-//	printf("Before...\n");
-//	printBoard(gameBoard);
-	runMove(player, theMove->from_x, theMove->from_y, theMove->to_x, theMove->to_y, false, theBoard);
-//	printf("After...\n");
-//	printBoard(gameBoard);
-//	printf("-------------");
+// Pack a move into 19 bits. From the top down that's 1 bit saying the line is virticle,
+// 6 bits for the row or column it is on, then 6 bits each for where it starts and ends
+
+packed_move packMove(int from_x, int from_y, int to_x, int to_y) {
+	if (from_x == to_x)
+		return MOVE_VERTICAL | (from_x << (2 * MOVE_FIELD_BITS)) | (from_y << MOVE_FIELD_BITS) | to_y;
+	else
+		return (from_y << (2 * MOVE_FIELD_BITS)) | (from_x << MOVE_FIELD_BITS) | to_x;
 }
 
-// A function to allocate a move for us
+// Get the coordinates back out of a packed move
 
-move *makeMove(int x_start, int y_start, int x_end, int y_end) {
-	move *temp = malloc(sizeof(move));
+void unpackMove(packed_move theMove, int *from_x, int *from_y, int *to_x, int *to_y) {
+	int line, start, end;
 
-	if (temp == null) {
-		printf("Unable to allocate a new move structure!\n");
-		exit(1);
+	line = (theMove >> (2 * MOVE_FIELD_BITS)) & MOVE_FIELD_MASK;
+	start = (theMove >> MOVE_FIELD_BITS) & MOVE_FIELD_MASK;
+	end = theMove & MOVE_FIELD_MASK;
+
+	if (theMove & MOVE_VERTICAL) {
+		*from_x = line;
+		*to_x = line;
+		*from_y = start;
+		*to_y = end;
+	} else {
+		*from_y = line;
+		*to_y = line;
+		*from_x = start;
+		*to_x = end;
 	}
+}
 
-	temp->from_x = x_start;
-	temp->from_y = y_start;
-	temp->to_x = x_end;
-	temp->to_y = y_end;
+// Call runMove using a packed move
 
-	temp->score = 0.0;
+void runPackedMove(int player, packed_move theMove, int *theBoard) {
+	int from_x, from_y, to_x, to_y;
 
-	return temp;	// The caller must free the structure, it's their job now.
+	unpackMove(theMove, &from_x, &from_y, &to_x, &to_y);
+
+	runMove(player, from_x, from_y, to_x, to_y, false, theBoard);
 }
 
 // A function to copy a board to another
@@ -1355,15 +1959,21 @@ int countLines(int *board, int x, int y) {
 	}
 }
 
-// A function to turn a char column specifier into a number we can use
+// A function to turn a char column specifier into a number we can use. Columns go A to Z, then a to z
 
 int charToColumn(char c) {
+	if ((c >= 'a') && (c <= 'z'))
+		return (((int) c) - ((int) 'a')) + 26;
+
 	return (((int) c) - ((int) 'A'));
 }
 
 // A function to turn a column number we use into a column character that is expected as input
 
 char columnToChar(int x) {
+	if (x >= 26)
+		return (char) (x - 26 + (int) 'a');
+
 	return (char) (x + (int) 'A');
 }
 
@@ -1590,6 +2200,7 @@ void printBoard(int *board) {
 // Figure out a move as a DNA person
 
 void playHalf() {
+	uint64_t moveStart = 0;
 
 	// Prepare some basic stuff
 
@@ -1615,31 +2226,32 @@ void playHalf() {
 
 	myDNA = &(ipc->theDNA);
 
+	seedRNG(&moveRNG, ipc->seed, 0);
+
 	// Initialize other stuff
 
-	memset(possibleMoves, 0, MAX_POSSIBLE_MOVES * sizeof(move *));	// Clear out the possible moves array
+	memset(possibleMoves, 0, MAX_POSSIBLE_MOVES * sizeof(packed_move));	// Clear out the possible moves array
 
 	// Generate a list of possible moves
-	
+
+	if (TIMING)
+		moveStart = nanoTime();
+
 	generateMoveList();
 
+	if (TIMING)
+		recordTiming(STAGE_GENERATE, nanoTime() - moveStart);
+
 	// Time to start processing.
 
 	selectMove();	// Figure out our move
 
-	copyMove(&finalMove, &(ipc->chosenMove));
-
-	// Clean up the possible move list
-
-	if (possibleMovesFound > 0) {
-		int i;
+	if (TIMING)
+		recordTiming(STAGE_MOVE, nanoTime() - moveStart);
 
-		for (i = 0; i < possibleMovesFound; i++) {
-			free(possibleMoves[i]);
-		}
-	}
+	ipc->chosenMove = finalMove;
 
-	possibleMovesFound = 0;
+	clearPossibleMoves();
 }
 
 // Make DNA for us
@@ -1670,7 +2282,7 @@ void makeDNA(int theCount, int startNum) {
 		// Now, do the work
 
 		for (j = 0; j < 6; j++) {
-			tempNum = ((double) rand()) / ((double) RAND_MAX);	// Number from 0 ot 1
+			tempNum = randomDouble(&masterRNG);	// Number from 0 ot 1
 			tempNum = tempNum * 2.0;							// Number from 0 to 2
 			tempNum = tempNum - 1.0;							// Number from -1 to 1
 			fprintf(theFile, "%f\n", tempNum);
@@ -1691,47 +2303,13 @@ void makeDNA(int theCount, int startNum) {
 // Run a tournement
 
 void runTourney(int theCount, int startNum) {
-	// Prepare the arrays
-
-	winsArray = null;
-	lossesArray = null;
-	tiesArray = null;
-
-	winsArray = malloc(sizeof(int) * theCount);
-
-	if (winsArray == null) {
-		printf("Unable to allocate wins array.\n");
-		exit(1);
-	} else {
-		memset(winsArray, 0, sizeof(int) * theCount);
-	}
-
-	lossesArray = malloc(sizeof(int) * theCount);
-
-	if (lossesArray == null) {
-		printf("Unable to allocate losses array.\n");
-		exit(1);
-	} else {
-		memset(lossesArray, 0, sizeof(int) * theCount);
-	}
-	
-	tiesArray = malloc(sizeof(int) * theCount);
-
-	if (tiesArray == null) {
-		printf("Unable to allocate ties array.\n");
-		exit(1);
-	} else {
-		memset(tiesArray, 0, sizeof(int) * theCount);
-	}
+	results_matrix results;
+	game_result result;
+	int pair;
 
-	timeArray = malloc(sizeof(double) * theCount);
+	// Prepare the results, they're filled in as the games finish
 
-	if (timeArray == null) {
-		printf("Unable to allocate time array.\n");
-		exit(1);
-	} else {
-		memset(timeArray, 0, sizeof(double) * theCount);
-	}
+	makeResults(&results, theCount, startNum);
 
 	// Now, get the IPC memory
 
@@ -1744,8 +2322,8 @@ void runTourney(int theCount, int startNum) {
 
 	// First, we'll need an opening board, we'll generate a random size
 
-	boardWidth = rand() % 6 + 3;
-	boardHeight = rand() % 6 + 3;
+	boardWidth = randomInt(&masterRNG, 6) + 3;
+	boardHeight = randomInt(&masterRNG, 6) + 3;
 
 	startBoard = malloc(boardWidth * boardHeight * sizeof(int));
 
@@ -1762,7 +2340,10 @@ void runTourney(int theCount, int startNum) {
 
 	printf("Board will be %d rows, %d columns\n", boardHeight, boardWidth);
 
-	setupStartBoard(startBoard);
+	results.width = boardWidth;
+	results.height = boardHeight;
+
+	setupStartBoard(startBoard, &masterRNG);
 
 //	printBoard(startBoard);
 
@@ -1775,28 +2356,7 @@ void runTourney(int theCount, int startNum) {
 
 	writeGame("startingBoard.txt");
 
-	// Prepare the HTML file
-
-	FILE *html = null;
-
-	html = fopen("results.html", "w");
-
-	if (html == null) {
-		printf("Unable to open results file: %d\n", errno);
-		exit(1);
-	}
-
-	fprintf(html, "<html><head><title>Tourney!</title></head><body>\n");
-	fprintf(html, "<table border=\"0\">\n");
-	fprintf(html, "<tr><td>DNA</td>");
-
-	int i, j, k;
-
-	for (i = startNum; i < startNum + theCount; i++) {
-		fprintf(html, "<td>%d<br />%d</td>", i / 10, i % 10);
-	}
-
-	fprintf(html, "<td>Totals</td><td>Points</td><td>Average Game Time</td></tr>\n");
+	int i, j;
 
 	// Load up all the DNA we'll be needing
 
@@ -1813,41 +2373,35 @@ void runTourney(int theCount, int startNum) {
 
 	for (i = 0; i < theCount; i++) {
 		sprintf(a, "%d.dna", i + startNum);
-		loadDNA(a, &(dnaArray[i]));
+		loadDNA(a, &(dnaArray[i]), null);
 	}
 
 	printf(" OK\n");
 
 	// Do it!
 
+	openGameLog(0);	// There is only the one worker so far
+	openResults(&results);
+
 	struct timeb s, e;
+	uint32_t gameStream;
 	double timeDiff;
 	int tempPid;
 
-	for (i = startNum; i < startNum + theCount; i++) {
-		fprintf(html, "<tr><td>%d</td>", i);
-
-		for (j = startNum; j < i; j++) {
-			fprintf(html, "<td>&nbsp;</td>");
-		}
+	pair = 0;
 
+	for (i = startNum; i < startNum + theCount; i++) {
 		for (j = i; j < startNum + theCount; j++) {
 
 			// Prepare things
 
-			int dnaAWins, dnaBWins, ties;
-
-			dnaAWins = 0;
-			dnaBWins = 0;
-			ties = 0;
-
 			playerOneScore = 0;
 			playerTwoScore = 0;
 			playerOneTimeLeft = 60.0;
 			playerTwoTimeLeft = 60.0;
 
-			double totalATime = 0.0;
-			double totalBTime = 0.0;
+			result.timeOne = 0.0;
+			result.timeTwo = 0.0;
 
 			moveNum = 1;
 			turn = PLAYER_ONE;
@@ -1856,6 +2410,12 @@ void runTourney(int theCount, int startNum) {
 
 			copyBoard(startBoard, gameBoard);
 
+			// Each game gets its own random stream, so any one game can be replayed
+
+			gameStream = STREAM_GAMES + 2 * ((i - startNum) * theCount + (j - startNum));
+
+		seedRNG(&gameRNG, masterSeed, gameStream);
+
 			clearMoves();
 
 //			printf("Running first game between %d and %d... ", i, j);
@@ -1878,6 +2438,7 @@ void runTourney(int theCount, int startNum) {
 				ipc->pOneTime = playerOneTimeLeft;
 				ipc->pTwoTime = playerTwoTimeLeft;
 				ipc->player = turn;
+				ipc->seed = nextRandom(&gameRNG);
 
 				if (turn == PLAYER_ONE) {
 					copyDNA(&(dnaArray[i - startNum]), &(ipc->theDNA));
@@ -1899,35 +2460,26 @@ void runTourney(int theCount, int startNum) {
 
 				if (turn == PLAYER_ONE) {
 					playerOneTimeLeft -= timeDiff;
-					totalATime += timeDiff;
+					result.timeOne += timeDiff;
 				} else {
 					playerTwoTimeLeft -= timeDiff;
-					totalBTime += timeDiff;
+					result.timeTwo += timeDiff;
 				}
 
 				// Get the move, save it, and run it
 
-				volatile move *tempMove = &(ipc->chosenMove);
+				packed_move lastMove = ipc->chosenMove;
 
 				int index = moveNum - 1;
 
 				moveNum++;
 
-				move *lastMove = malloc(sizeof(move));
-
-				if (lastMove == null) {
-					printf("Unable to allocate a temporary move. Error %d.\n", errno);
-					exit(1);
-				}
-
-				copyMove(tempMove, lastMove);
-
 				moveList[index] = lastMove;
 
 //				printf("Wants (%d, %d) to (%d, %d) for move %d\n\n", lastMove->from_x,
 //											lastMove->from_y, lastMove->to_x, lastMove->to_y, moveNum);
 
-				runMoveWithStruct(turn, lastMove, gameBoard);
+				runPackedMove(turn, lastMove, gameBoard);
 
 //				printBoard(gameBoard);
 
@@ -1940,34 +2492,19 @@ void runTourney(int theCount, int startNum) {
 				}
 			}
 
-			int tempIndex;
-
-			for (tempIndex = 0; tempIndex < moveNum - 2; tempIndex++) {
-				free(moveList[tempIndex]);
-			}
-
 //			printBoard(gameBoard);
 
 			// OK, that game is over. who won?
 			
 			int winner = gameIsOver(gameBoard);
 
-			if (winner == PLAYER_ONE) {
-//				printf("a wins\n");
-				dnaAWins++;
-				winsArray[i - startNum]++;
-				lossesArray[j - startNum]++;
-			} else if (winner == PLAYER_TWO) {
-//				printf("b wins\n");
-				dnaBWins++;
-				winsArray[j - startNum]++;
-				lossesArray[i - startNum]++;
-			} else {
-//				printf("tie\n");
-				ties++;
-				tiesArray[i - startNum]++;
-				tiesArray[j - startNum]++;
-			}
+		logGame(gameStream, i, &(dnaArray[i - startNum]), j, &(dnaArray[j - startNum]), winner, moveList, moveNum - 1);
+
+			result.number = pair * 2;
+			result.winner = winner;
+
+			recordResult(&results, &result);
+			queueResult(&result);
 
 //			printBoard(gameBoard);
 
@@ -1978,6 +2515,9 @@ void runTourney(int theCount, int startNum) {
 			playerOneTimeLeft = 60.0;
 			playerTwoTimeLeft = 60.0;
 
+			result.timeOne = 0.0;
+			result.timeTwo = 0.0;
+
 			moveNum = 1;
 			turn = PLAYER_ONE;
 
@@ -1985,6 +2525,8 @@ void runTourney(int theCount, int startNum) {
 
 			copyBoard(startBoard, gameBoard);
 
+			seedRNG(&gameRNG, masterSeed, gameStream + 1);
+
 			clearMoves();
 
 //			printf("Running second game between %d and %d... ", i, j);
@@ -2005,6 +2547,7 @@ void runTourney(int theCount, int startNum) {
 				ipc->pOneTime = playerOneTimeLeft;
 				ipc->pTwoTime = playerTwoTimeLeft;
 				ipc->player = turn;
+				ipc->seed = nextRandom(&gameRNG);
 
 				if (turn == PLAYER_TWO) {
 					copyDNA(&(dnaArray[i - startNum]), &(ipc->theDNA));
@@ -2026,32 +2569,23 @@ void runTourney(int theCount, int startNum) {
 
 				if (turn == PLAYER_ONE) {
 					playerOneTimeLeft -= timeDiff;
-					totalBTime += timeDiff;
+					result.timeOne += timeDiff;
 				} else {
 					playerTwoTimeLeft -= timeDiff;
-					totalATime += timeDiff;
+					result.timeTwo += timeDiff;
 				}
 
 				// Get the move, save it, and run it
 
-				volatile move *tempMove = &(ipc->chosenMove);
+				packed_move lastMove = ipc->chosenMove;
 
 				int index = moveNum - 1;
 
 				moveNum++;
 
-				move *lastMove = malloc(sizeof(move));
-
-				if (lastMove == null) {
-					printf("Unable to allocate a temporary move. Error %d.\n", errno);
-					exit(1);
-				}
-
-				copyMove(tempMove, lastMove);
-
 				moveList[index] = lastMove;
 
-				runMoveWithStruct(turn, lastMove, gameBoard);
+				runPackedMove(turn, lastMove, gameBoard);
 
 				// Change turns
 
@@ -2062,36 +2596,387 @@ void runTourney(int theCount, int startNum) {
 				}
 			}
 
-			for (tempIndex = 0; tempIndex < moveNum - 2; tempIndex++) {
-				free(moveList[tempIndex]);
-			}
-
 			// OK, that game is over. who won?
 			
 			winner = gameIsOver(gameBoard);
 
-			if (winner == PLAYER_ONE) {
-//				printf("b wins\n");
-				dnaBWins++;
-				winsArray[j - startNum]++;
-				lossesArray[i - startNum]++;
-			} else if (winner == PLAYER_TWO) {
-//				printf("a wins\n");
-				dnaAWins++;
-				winsArray[i - startNum]++;
-				lossesArray[j - startNum]++;
-			} else {
-//				printf("tie\n");
-				ties++;
-				tiesArray[i - startNum]++;
-				tiesArray[j - startNum]++;
-			}
-
-//			printBoard(gameBoard);
+		logGame(gameStream + 1, j, &(dnaArray[j - startNum]), i, &(dnaArray[i - startNum]), winner, moveList, moveNum - 1);
 
-			// That's it! We know the result. Print it out to the result file
+			result.number = pair * 2 + 1;
+			result.winner = winner;
 
-			int res = 2 * dnaAWins + ties;
+			recordResult(&results, &result);
+			queueResult(&result);
+
+			pair++;
+		}
+	}
+
+	closeResults();
+
+	// Now we know every result, write out the reports
+
+	writeReports(&results);
+
+	// Clean up
+
+	closeGameLog();
+	freeResults(&results);
+	free(dnaArray);
+	free(ipc);
+
+	// That's it
+
+	printf("Done running tourney.\n");
+
+}
+
+// Sleep until someone rings the bell (it stops being seen), or ms go by
+
+void ringWait(uint32_t *bell, uint32_t seen, int ms) {
+	struct timespec t;
+
+	t.tv_sec = ms / 1000;
+	t.tv_nsec = (ms % 1000) * 1000000L;
+
+	syscall(SYS_futex, bell, FUTEX_WAIT, seen, &t, null, 0);
+}
+
+// Ring a bell, waking up to sleepers threads waiting on it
+
+void ringBell(uint32_t *bell, int sleepers) {
+	__atomic_add_fetch(bell, 1, __ATOMIC_RELEASE);
+
+	syscall(SYS_futex, bell, FUTEX_WAKE, sleepers, null, null, 0);
+}
+
+// Get an empty results matrix ready for a tourney between theCount DNA
+
+void makeResults(results_matrix *r, int theCount, int startNum) {
+	memset(r, 0, sizeof(results_matrix));
+
+	r->seed = masterSeed;
+	r->count = theCount;
+	r->startNum = startNum;
+	r->pairCount = theCount * (theCount + 1) / 2;
+
+	r->winners = calloc(r->pairCount * 2, sizeof(uint8_t));
+	r->times = calloc(r->pairCount * 4, sizeof(double));
+
+	if ((r->winners == null) || (r->times == null)) {
+		printf("Unable to allocate the results for %d DNA.\n", theCount);
+		exit(1);
+	}
+}
+
+// Give back a results matrix's memory
+
+void freeResults(results_matrix *r) {
+	free(r->winners);
+	free(r->times);
+}
+
+// Put a finished game in the results matrix
+
+void recordResult(results_matrix *r, game_result *g) {
+	if (g->number >= (uint32_t) (r->pairCount * 2)) {
+		printf("Game %u isn't part of a tourney between %d DNA.\n", g->number, r->count);
+		exit(1);
+	}
+
+	r->winners[g->number] = g->winner;
+	r->times[g->number * 2] = g->timeOne;
+	r->times[g->number * 2 + 1] = g->timeTwo;
+}
+
+// Start the results stream and the thread that writes it. If we die part way through, the
+// games that finished are still in it and "master r" can make the reports from them
+
+void openResults(results_matrix *r) {
+	results_header header;
+
+	memset(&resultQueue, 0, sizeof(result_queue));
+
+	resultQueue.out = fopen(RESULTS_NAME, "wb");
+
+	if (resultQueue.out == null) {
+		printf("Unable to open the results stream '%s': error %d.\n", RESULTS_NAME, errno);
+		exit(1);
+	}
+
+	memset(&header, 0, sizeof(results_header));
+	memcpy(header.magic, RESULTS_MAGIC, 4);
+	header.version = RESULTS_VERSION;
+	header.seed = r->seed;
+	header.count = r->count;
+	header.startNum = r->startNum;
+	header.width = r->width;
+	header.height = r->height;
+
+	if ((fwrite(&header, sizeof(results_header), 1, resultQueue.out) != 1) || (fflush(resultQueue.out) != 0)) {
+		printf("Unable to write to the results stream: error %d.\n", errno);
+		exit(1);
+	}
+
+	if (pthread_create(&resultThread, null, resultWriter, null) != 0) {
+		printf("Unable to start the results writer: error %d.\n", errno);
+		exit(1);
+	}
+}
+
+// Hand a finished game to the results writer. We only wait if the queue is full, which means
+// the disk is thousands of games behind
+
+void queueResult(game_result *g) {
+	result_queue *q = &resultQueue;
+	uint32_t head, seen;
+
+	head = q->head;		// Only we change it
+
+	while (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == RESULT_QUEUE_SIZE) {
+		seen = __atomic_load_n(&q->space, __ATOMIC_ACQUIRE);
+
+		if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == RESULT_QUEUE_SIZE)
+			ringWait(&q->space, seen, RESULT_WAIT_MS);
+	}
+
+	q->items[head & (RESULT_QUEUE_SIZE - 1)] = *g;
+
+	__atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+
+	ringBell(&q->bell, 1);
+}
+
+// The results writer. Writes out whatever has finished and flushes it, so a result is on its
+// way to the disk as soon as the game is over, then sleeps until there is more
+
+void *resultWriter(void *arg) {
+	result_queue *q = &resultQueue;
+	uint32_t tail, head, seen;
+
+	(void) arg;			// pthread wants it, we only have the one queue
+
+	tail = q->tail;		// Only we change it
+
+	while (true) {
+		seen = __atomic_load_n(&q->bell, __ATOMIC_ACQUIRE);
+		head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+
+		if (tail != head) {
+			for (; tail != head; tail++) {
+				if (fwrite(&(q->items[tail & (RESULT_QUEUE_SIZE - 1)]), sizeof(game_result), 1, q->out) != 1) {
+					printf("Unable to write to the results stream: error %d.\n", errno);
+					exit(1);
+				}
+			}
+
+			if (fflush(q->out) != 0) {
+				printf("Unable to write to the results stream: error %d.\n", errno);
+				exit(1);
+			}
+
+			__atomic_store_n(&q->tail, tail, __ATOMIC_RELEASE);
+			ringBell(&q->space, 1);
+
+			continue;
+		}
+
+		if (__atomic_load_n(&q->done, __ATOMIC_ACQUIRE))
+			break;	// Everything's written and nothing more is coming
+
+		ringWait(&q->bell, seen, RESULT_WAIT_MS);
+	}
+
+	return null;
+}
+
+// Wait for every result to be written, then close the results stream
+
+void closeResults() {
+	__atomic_store_n(&resultQueue.done, true, __ATOMIC_RELEASE);
+	ringBell(&resultQueue.bell, 1);
+
+	pthread_join(resultThread, null);
+
+	fclose(resultQueue.out);
+}
+
+// Read a results stream back into a results matrix. Games that never finished stay unplayed
+
+void readResults(char *path, results_matrix *r) {
+	results_header header;
+	game_result result;
+	FILE *in = null;
+	long games;
+
+	in = fopen(path, "rb");
+
+	if (in == null) {
+		printf("Unable to open the results stream '%s': error %d.\n", path, errno);
+		exit(1);
+	}
+
+	if ((fread(&header, sizeof(results_header), 1, in) != 1) || (memcmp(header.magic, RESULTS_MAGIC, 4) != 0)) {
+		printf("'%s' is not a results stream.\n", path);
+		fclose(in);
+		exit(1);
+	}
+
+	if (header.version != RESULTS_VERSION) {
+		printf("'%s' is version %u, we only know version %d.\n", path, header.version, RESULTS_VERSION);
+		fclose(in);
+		exit(1);
+	}
+
+	if (header.count <= 0) {
+		printf("'%s' has a tourney of %d DNA.\n", path, header.count);
+		fclose(in);
+		exit(1);
+	}
+
+	masterSeed = header.seed;
+
+	makeResults(r, header.count, header.startNum);
+
+	r->width = header.width;
+	r->height = header.height;
+
+	games = 0;
+
+	while (fread(&result, sizeof(game_result), 1, in) == 1) {
+		recordResult(r, &result);
+		games++;
+	}
+
+	fclose(in);
+
+	printf("Read %ld of %d games from '%s'.\n", games, r->pairCount * 2, path);
+}
+
+// Add up each DNA's wins, ties, losses and time from the games that were played
+
+void tallyResults(results_matrix *r) {
+	int i, j, pair;
+
+	free(winsArray);
+	free(lossesArray);
+	free(tiesArray);
+	free(timeArray);
+
+	winsArray = calloc(r->count, sizeof(int));
+	lossesArray = calloc(r->count, sizeof(int));
+	tiesArray = calloc(r->count, sizeof(int));
+	timeArray = calloc(r->count, sizeof(double));
+
+	if ((winsArray == null) || (lossesArray == null) || (tiesArray == null) || (timeArray == null)) {
+		printf("Unable to allocate the totals.\n");
+		exit(1);
+	}
+
+	pair = 0;
+
+	for (i = 0; i < r->count; i++) {
+		for (j = i; j < r->count; j++) {
+			// First, A is 1, B is 2
+
+			if (r->winners[pair * 2] == PLAYER_ONE) {
+				winsArray[i]++;
+				lossesArray[j]++;
+			} else if (r->winners[pair * 2] == PLAYER_TWO) {
+				winsArray[j]++;
+				lossesArray[i]++;
+			} else if (r->winners[pair * 2] != NO_WINNER_YET) {
+				tiesArray[i]++;
+				tiesArray[j]++;
+			}
+
+			// Then A is 2 and B is 1
+
+			if (r->winners[pair * 2 + 1] == PLAYER_ONE) {
+				winsArray[j]++;
+				lossesArray[i]++;
+			} else if (r->winners[pair * 2 + 1] == PLAYER_TWO) {
+				winsArray[i]++;
+				lossesArray[j]++;
+			} else if (r->winners[pair * 2 + 1] != NO_WINNER_YET) {
+				tiesArray[i]++;
+				tiesArray[j]++;
+			}
+
+			timeArray[i] += r->times[pair * 4] + r->times[pair * 4 + 3];
+			timeArray[j] += r->times[pair * 4 + 1] + r->times[pair * 4 + 2];
+
+			pair++;
+		}
+	}
+}
+
+// Write results.html, results.csv and results.json from a results matrix
+
+void writeReports(results_matrix *r) {
+	tallyResults(r);
+
+	writeResultsHTML(r);
+	writeResultsCSV(r);
+	writeResultsJSON(r);
+}
+
+// The results table, a cell for every pair, colored by how A did. Big tourneys just get the totals
+
+void writeResultsHTML(results_matrix *r) {
+	FILE *html = null;
+	int i, j, pair, table;
+
+	html = fopen("results.html", "w");
+
+	if (html == null) {
+		printf("Unable to open results file: %d\n", errno);
+		exit(1);
+	}
+
+	table = (r->count <= HTML_TABLE_LIMIT);
+
+	fprintf(html, "<html><head><title>Tourney!</title></head><body>\n");
+	fprintf(html, "<table border=\"0\">\n");
+	fprintf(html, "<tr><td>DNA</td>");
+
+	for (i = r->startNum; (i < r->startNum + r->count) && table; i++) {
+		fprintf(html, "<td>%d<br />%d</td>", i / 10, i % 10);
+	}
+
+	fprintf(html, "<td>Totals</td><td>Points</td><td>Average Game Time</td></tr>\n");
+
+	pair = 0;
+
+	for (i = 0; i < r->count; i++) {
+		fprintf(html, "<tr><td>%d</td>", i + r->startNum);
+
+		for (j = 0; (j < i) && table; j++) {
+			fprintf(html, "<td>&nbsp;</td>");
+		}
+
+		for (j = i; (j < r->count) && table; j++) {
+			int first = r->winners[pair * 2], second = r->winners[pair * 2 + 1];
+			int res = 0;
+
+			pair++;
+
+			if ((first == NO_WINNER_YET) || (second == NO_WINNER_YET)) {
+				fprintf(html, "<td>&nbsp;</td>");	// Not played yet
+				continue;
+			}
+
+			// Two points for each of A's wins, one for a tie
+
+			if (first == PLAYER_ONE)
+				res += 2;
+			else if (first != PLAYER_TWO)
+				res++;
+
+			if (second == PLAYER_TWO)
+				res += 2;
+			else if (second != PLAYER_ONE)
+				res++;
 
 			switch (res) {
 				case 4:
@@ -2112,14 +2997,11 @@ void runTourney(int theCount, int startNum) {
 				default:
 					break;
 			}
-
-			timeArray[i - startNum] += totalATime;
-			timeArray[j - startNum] += totalBTime;
 		}
 
-		fprintf(html, "<td>%d/%d/%d</td>", winsArray[i - startNum], tiesArray[i - startNum], lossesArray[i - startNum]);
-		fprintf(html, "<td>%d</td>", winsArray[i - startNum] * 2 + tiesArray[i - startNum]);
-		fprintf(html, "<td>%f</td>", timeArray[i - startNum] / ((((double) theCount) + 1.0) * 2.0));
+		fprintf(html, "<td>%d/%d/%d</td>", winsArray[i], tiesArray[i], lossesArray[i]);
+		fprintf(html, "<td>%d</td>", winsArray[i] * 2 + tiesArray[i]);
+		fprintf(html, "<td>%f</td>", timeArray[i] / ((((double) r->count) + 1.0) * 2.0));
 		fprintf(html, "</tr>\n");
 	}
 
@@ -2127,39 +3009,427 @@ void runTourney(int theCount, int startNum) {
 	fprintf(html, "</body></html>\n");
 
 	fclose(html);
+}
 
-	// Now, we're going to write out the CSV file
+// The totals for each DNA, which is what breeding reads
 
-	html = fopen("results.csv", "w");
+void writeResultsCSV(results_matrix *r) {
+	FILE *csv = null;
+	int d;
 
-	if (html == null) {
+	csv = fopen("results.csv", "w");
+
+	if (csv == null) {
 		printf("Unable to write out the CSV file: error %d.\n", errno);
-	} else {
-		fprintf(html, "DNA,Wins,Ties,Losses,Points\n");
+		return;
+	}
+
+	fprintf(csv, "DNA,Wins,Ties,Losses,Points\n");
+
+	for (d = 0; d < r->count; d++) {
+		fprintf(csv, "%d,%d,%d,%d,%d\n", d + r->startNum, winsArray[d], tiesArray[d], lossesArray[d],
+					winsArray[d] * 2 + tiesArray[d]);
+	}
+
+	fclose(csv);
+}
+
+// Everything, for other programs. Each DNA's totals, then every game that was played
+
+void writeResultsJSON(results_matrix *r) {
+	FILE *json = null;
+	int d, i, j, k, game, comma;
+
+	json = fopen("results.json", "w");
+
+	if (json == null) {
+		printf("Unable to write out the JSON file: error %d.\n", errno);
+		return;
+	}
+
+	fprintf(json, "{\"seed\": %llu, \"width\": %d, \"height\": %d, \"startNum\": %d, \"count\": %d,\n",
+				(unsigned long long) r->seed, r->width, r->height, r->startNum, r->count);
+
+	fprintf(json, "\"dna\": [\n");
+
+	for (d = 0; d < r->count; d++) {
+		fprintf(json, "\t{\"dna\": %d, \"wins\": %d, \"ties\": %d, \"losses\": %d, \"points\": %d, \"averageTime\": %f}%s\n",
+					d + r->startNum, winsArray[d], tiesArray[d], lossesArray[d], winsArray[d] * 2 + tiesArray[d],
+					timeArray[d] / ((((double) r->count) + 1.0) * 2.0), (d + 1 < r->count) ? "," : "");
+	}
+
+	fprintf(json, "],\n\"games\": [\n");
+
+	comma = false;
+	game = 0;
+
+	for (i = 0; i < r->count; i++) {
+		for (j = i; j < r->count; j++) {
+			for (k = 0; k < 2; k++, game++) {	// A goes first, then B
+				if (r->winners[game] == NO_WINNER_YET)
+					continue;
+
+				fprintf(json, "%s\t{\"game\": %d, \"playerOne\": %d, \"playerTwo\": %d, \"winner\": %d, "
+							"\"timeOne\": %f, \"timeTwo\": %f}", comma ? ",\n" : "", game,
+							((k == 0) ? i : j) + r->startNum, ((k == 0) ? j : i) + r->startNum, r->winners[game],
+							r->times[game * 2], r->times[game * 2 + 1]);
+
+				comma = true;
+			}
+		}
+	}
+
+	fprintf(json, "\n]}\n");
+
+	fclose(json);
+}
+
+// The breeding plan we use when there's no breeding.txt
+
+void defaultBreedingPlan(breeding_plan *plan) {
+	plan->elite = ELITE_SHARE;
+	plan->lucky = LUCKY_SHARE;
+	plan->fresh = FRESH_SHARE;
+	plan->selection = SELECT_TRUNCATION;
+	plan->tournamentSize = TOURNAMENT_SIZE;
+	plan->crossover = CROSS_UNIFORM;
+	plan->mutation = MUTATE_ADAPTIVE;
+	plan->mutationRate = MUTATION_RATE;
+	plan->threads = sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+// Change the breeding plan with a file of "name value" lines. # starts a comment
 
-		int d;
+void readBreedingPlan(char *path, breeding_plan *plan) {
+	FILE *in = null;
+	char buffer[256];
+	char name[64];
+	char value[64];
+	int line, ok;
+
+	in = fopen(path, "r");
+
+	if (in == null) {
+		printf("Unable to open the breeding plan '%s': error %d.\n", path, errno);
+		exit(1);
+	}
 
-		for (d = startNum; d < startNum + theCount; d++) {
-			fprintf(html, "%d,%d,%d,%d,%d\n", d, winsArray[d - startNum], tiesArray[d - startNum],
-					lossesArray[d - startNum], winsArray[d - startNum] * 2 + tiesArray[d - startNum]);
+	line = 0;
+
+	while (fgets(buffer, 256, in) != null) {
+		line++;
+
+		buffer[strcspn(buffer, "#\r\n")] = '\0';
+
+		if (sscanf(buffer, "%63s %63s", name, value) != 2) {
+			if (sscanf(buffer, "%63s", name) == 1) {
+				printf("Line %d of '%s' needs a name and a value.\n", line, path);
+				fclose(in);
+				exit(1);
+			}
+
+			continue;	// Blank
 		}
 
-		fclose(html);
+		ok = true;
+
+		if (strcmp(name, "elite") == 0) {
+			ok = (sscanf(value, "%lf", &plan->elite) == 1) && (plan->elite >= 0.0);
+		} else if (strcmp(name, "lucky") == 0) {
+			ok = (sscanf(value, "%lf", &plan->lucky) == 1) && (plan->lucky >= 0.0);
+		} else if (strcmp(name, "fresh") == 0) {
+			ok = (sscanf(value, "%lf", &plan->fresh) == 1) && (plan->fresh >= 0.0);
+		} else if (strcmp(name, "tournament") == 0) {
+			ok = (sscanf(value, "%d", &plan->tournamentSize) == 1) && (plan->tournamentSize > 0);
+		} else if (strcmp(name, "rate") == 0) {
+			ok = (sscanf(value, "%lf", &plan->mutationRate) == 1) && (plan->mutationRate >= 0.0);
+		} else if (strcmp(name, "threads") == 0) {
+			ok = (sscanf(value, "%d", &plan->threads) == 1) && (plan->threads > 0);
+		} else if (strcmp(name, "selection") == 0) {
+			if (strcmp(value, "truncation") == 0) {
+				plan->selection = SELECT_TRUNCATION;
+			} else if (strcmp(value, "tournament") == 0) {
+				plan->selection = SELECT_TOURNAMENT;
+			} else if (strcmp(value, "rank") == 0) {
+				plan->selection = SELECT_RANK;
+			} else if (strcmp(value, "fitness") == 0) {
+				plan->selection = SELECT_FITNESS;
+			} else {
+				ok = false;
+			}
+		} else if (strcmp(name, "crossover") == 0) {
+			if (strcmp(value, "uniform") == 0) {
+				plan->crossover = CROSS_UNIFORM;
+			} else if (strcmp(value, "point") == 0) {
+				plan->crossover = CROSS_POINT;
+			} else if (strcmp(value, "blend") == 0) {
+				plan->crossover = CROSS_BLEND;
+			} else {
+				ok = false;
+			}
+		} else if (strcmp(name, "mutation") == 0) {
+			if (strcmp(value, "scale") == 0) {
+				plan->mutation = MUTATE_SCALE;
+			} else if (strcmp(value, "reset") == 0) {
+				plan->mutation = MUTATE_RESET;
+			} else if (strcmp(value, "adaptive") == 0) {
+				plan->mutation = MUTATE_ADAPTIVE;
+			} else {
+				ok = false;
+			}
+		} else {
+			printf("Line %d of '%s' has '%s', which isn't part of a breeding plan.\n", line, path, name);
+			fclose(in);
+			exit(1);
+		}
+
+		if (!ok) {
+			printf("Line %d of '%s' has '%s' for %s, which won't work.\n", line, path, value, name);
+			fclose(in);
+			exit(1);
+		}
 	}
 
-	// Clean up
+	fclose(in);
+}
 
-	free(winsArray);
-	free(lossesArray);
-	free(timeArray);
-	free(tiesArray);
-	free(dnaArray);
-	free(ipc);
+// Say what the breeding plan is, the same way breeding.txt would
 
-	// That's it
+void printBreedingPlan(breeding_plan *plan) {
+	const char *selections[] = {"truncation", "tournament", "rank", "fitness"};
+	const char *crossovers[] = {"uniform", "point", "blend"};
+	const char *mutations[] = {"scale", "reset", "adaptive"};
 
-	printf("Done running tourney.\n");
+	printf("The plan: elite %.3f, lucky %.3f, fresh %.3f, selection %s", plan->elite, plan->lucky, plan->fresh,
+				selections[plan->selection]);
+
+	if (plan->selection == SELECT_TOURNAMENT)
+		printf(", tournament %d", plan->tournamentSize);
+
+	printf(",\n          crossover %s, mutation %s, rate %.3f, threads %d.\n", crossovers[plan->crossover],
+				mutations[plan->mutation], plan->mutationRate, plan->threads);
+}
+
+// Pick from running totals of odds, with a binary search since there may be a lot of them
+
+int pickWeighted(double *weights, int count, rng_state *rng) {
+	double x = randomDouble(rng) * weights[count - 1];
+	int low = 0;
+	int high = count - 1;
+	int mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+
+		if (weights[mid] > x) {
+			high = mid;
+		} else {
+			low = mid + 1;
+		}
+	}
+
+	return low;
+}
+
+// Choose a parent with the plan's selection, returns a DNA number
+
+int selectParent(breeding_work *w, rng_state *rng) {
+	int best, other, i;
+
+	switch (w->plan->selection) {
+		case SELECT_TOURNAMENT:
+			best = randomInt(rng, w->keys->count);
+
+			for (i = 1; i < w->plan->tournamentSize; i++) {
+				other = randomInt(rng, w->keys->count);
+
+				if (ranksBefore(w->keys, other, best))
+					best = other;
+			}
+
+			return best;
+		case SELECT_RANK:
+			return w->order[pickWeighted(w->weights, w->keys->count, rng)];
+		case SELECT_FITNESS:
+			return pickWeighted(w->weights, w->keys->count, rng);
+		default:
+			return w->order[randomInt(rng, w->eliteCount)];
+	}
+}
+
+// A breeding thread. Each child has its own random stream, so it comes out the same whichever
+// thread breeds it and however many there are
+
+void *breedChildren(void *arg) {
+	breeding_work *w = (breeding_work *) arg;
+	rng_state rng;
+	int child, a, b;
+
+	while (true) {
+		child = __atomic_fetch_add(&w->nextChild, 1, __ATOMIC_RELAXED);
+
+		if (child >= w->childCount)
+			break;
+
+		seedRNG(&rng, masterSeed, STREAM_CHILDREN + child);
+
+		a = selectParent(w, &rng);
+		b = selectParent(w, &rng);
+
+		haveSex(&w->parents[a], &w->parentSteps[a], &w->parents[b], &w->parentSteps[b], &w->children[child],
+					&w->childSteps[child], w->plan, &rng);
+	}
+
+	return null;
+}
+
+// Give every gene the starting step size
+
+void resetSteps(gene_steps *steps) {
+	int i;
+
+	for (i = 0; i < MAX_GENES; i++)
+		steps->steps[i] = STEP_START;
+}
+
+// The generation in count.txt, 0 if there isn't one
+
+int currentGeneration() {
+	FILE *in = null;
+	int generation = 0;
+
+	in = fopen("count.txt", "r");
+
+	if (in != null) {
+		if (fscanf(in, "%d", &generation) != 1)
+			generation = 0;
+
+		fclose(in);
+	}
 
+	return generation;
+}
+
+// For sorting DNA so the same genes end up next to each other
+
+int compareGenes(const void *a, const void *b) {
+	dna *one = *(dna **) a;
+	dna *two = *(dna **) b;
+
+	return memcmp(one->genes, two->genes, sizeof(one->genes));
+}
+
+// Add a line to diversity.csv about the generation we're breeding from. If the genes have all
+// come together the spread and distance go to 0, and there's no point running more tourneys
+
+void logDiversity(dna dnaArray[], gene_steps steps[], rank_keys *k, int theCount) {
+	double mean[MAX_GENES];
+	double spread, distance, stepSize, points, d, sum;
+	int geneCount, distinct, best, i, j;
+	dna **sorted = null;
+	FILE *out = null;
+
+	geneCount = 0;
+
+	for (i = 0; i < theCount; i++) {
+		if ((int) dnaArray[i].geneCount > geneCount)
+			geneCount = dnaArray[i].geneCount;
+	}
+
+	// The middle of the population, then how far the genes are spread around it
+
+	memset(mean, 0, sizeof(mean));
+
+	for (i = 0; i < theCount; i++) {
+		for (j = 0; j < geneCount; j++)
+			mean[j] += dnaArray[i].genes[j] / theCount;
+	}
+
+	spread = 0.0;
+	distance = 0.0;
+	stepSize = 0.0;
+
+	for (j = 0; j < geneCount; j++) {
+		sum = 0.0;
+
+		for (i = 0; i < theCount; i++) {
+			d = dnaArray[i].genes[j] - mean[j];
+			sum += d * d;
+			stepSize += steps[i].steps[j];
+		}
+
+		spread += sqrt(sum / theCount);		// The gene's standard deviation
+	}
+
+	for (i = 0; i < theCount; i++) {
+		sum = 0.0;
+
+		for (j = 0; j < geneCount; j++) {
+			d = dnaArray[i].genes[j] - mean[j];
+			sum += d * d;
+		}
+
+		distance += sqrt(sum);
+	}
+
+	spread /= geneCount;
+	distance /= theCount;
+	stepSize /= (double) theCount * geneCount;
+
+	// Sorting puts copies of the same DNA together so they're easy to count
+
+	sorted = malloc(sizeof(dna *) * theCount);
+
+	if (sorted == null) {
+		printf("Unable to allcoate memory to count distinct DNA: error %d.\n", errno);
+		exit(1);
+	}
+
+	for (i = 0; i < theCount; i++)
+		sorted[i] = &dnaArray[i];
+
+	qsort(sorted, theCount, sizeof(dna *), compareGenes);
+
+	distinct = 1;
+
+	for (i = 1; i < theCount; i++) {
+		if (compareGenes(&sorted[i - 1], &sorted[i]) != 0)
+			distinct++;
+	}
+
+	free(sorted);
+
+	best = 0;
+	points = 0.0;
+
+	for (i = 0; i < theCount; i++) {
+		if (k->points[i] > best)
+			best = k->points[i];
+
+		points += k->points[i];
+	}
+
+	points /= theCount;
+
+	printf("Diversity: %d distinct, gene spread %.4f, distance %.4f, step size %.4f.\n", distinct, spread,
+				distance, stepSize);
+
+	// Then the same in the log
+
+	out = fopen(DIVERSITY_NAME, "a");
+
+	if (out == null) {
+		printf("Unable to open '%s': error %d.\n", DIVERSITY_NAME, errno);
+		return;
+	}
+
+	if (ftell(out) == 0)
+		fprintf(out, "Generation,DNA,Distinct,GeneSpread,Distance,StepSize,BestPoints,MeanPoints\n");
+
+	fprintf(out, "%d,%d,%d,%f,%f,%f,%d,%f\n", currentGeneration(), theCount, distinct, spread, distance, stepSize,
+				best, points);
+
+	fclose(out);
 }
 
 // Run a breeding program
@@ -2168,6 +3438,12 @@ void breedingProgram(int theCount, int startNum) {
 
 	printf("\nRunning a breeding program...\n\n");
 
+	// Breeding gets its own random stream
+
+	rng_state breedRNG;
+
+	seedRNG(&breedRNG, masterSeed, STREAM_BREEDING);
+
 	// First, get the memory we'll need
 
 	dna *oldDNAArray = null;
@@ -2186,19 +3462,24 @@ void breedingProgram(int theCount, int startNum) {
 		exit(1);
 	}
 
-	int *dnaScores = null;
-	dnaScores = malloc(sizeof(int) * theCount);
+	gene_steps *oldSteps = null;
+	gene_steps *newSteps = null;
+	oldSteps = malloc(sizeof(gene_steps) * theCount);
+	newSteps = malloc(sizeof(gene_steps) * theCount);
 
-	if (dnaScores == null) {
-		printf("Unable to allcoate DNA scores: error %d.\n", errno);
+	if ((oldSteps == null) || (newSteps == null)) {
+		printf("Unable to allcoate step sizes: error %d.\n", errno);
 		exit(1);
 	}
 
-	int *dnaNumbers = null;
-	dnaNumbers = malloc(sizeof(int) * theCount);
+	rank_keys keys;
+	makeRankKeys(&keys, theCount);
+
+	int *dnaOrder = null;
+	dnaOrder = malloc(sizeof(int) * theCount);
 
-	if (dnaNumbers == null) {
-		printf("Unable to allcoate DNA scores: error %d.\n", errno);
+	if (dnaOrder == null) {
+		printf("Unable to allcoate DNA order: error %d.\n", errno);
 		exit(1);
 	}
 
@@ -2211,7 +3492,7 @@ void breedingProgram(int theCount, int startNum) {
 
 	for (i = 0; i < theCount; i++) {
 		sprintf(buffer, "%d.dna", i + startNum);
-		loadDNA(buffer, &oldDNAArray[i]);
+		loadDNA(buffer, &oldDNAArray[i], &oldSteps[i]);
 	}
 
 	printf("OK\n");
@@ -2254,8 +3535,7 @@ void breedingProgram(int theCount, int startNum) {
 		}
 	
 		if (temp1 == i + startNum) {
-			dnaScores[i] = temp5;
-			dnaNumbers[i] = i + startNum;
+			keys.points[i] = temp5;
 		} else {
 			printf("Expected to read info for DNA %d, found it for %d.\n", i + startNum, temp1);
 			fclose(scores);
@@ -2267,14 +3547,65 @@ void breedingProgram(int theCount, int startNum) {
 
 	printf("OK\n");
 
-	// We've loaded everything, now sort it
+	// Ties are broken by head to head and time if the games are still in the results stream
+
+	if (access(RESULTS_NAME, R_OK) == 0) {
+		results_matrix results;
+
+		readResults(RESULTS_NAME, &results);
+
+		if ((results.count == theCount) && (results.startNum == startNum)) {
+			addHeadToHead(&keys, &results);
+		} else {
+			printf("'%s' is from a different tourney, ties are broken by number.\n", RESULTS_NAME);
+		}
+
+		freeResults(&results);
+	}
+
+	// Work out how many of each the plan makes
+
+	breeding_plan plan;
+
+	defaultBreedingPlan(&plan);
+
+	if (access(BREEDING_PLAN_NAME, R_OK) == 0)
+		readBreedingPlan(BREEDING_PLAN_NAME, &plan);
+
+	if (plan.threads > MAX_BREED_THREADS)
+		plan.threads = MAX_BREED_THREADS;
+
+	printBreedingPlan(&plan);
+
+	int eliteCount = (int) (plan.elite * theCount + 0.5);
+	int luckyCount = (int) (plan.lucky * theCount + 0.5);
+	int freshCount = (int) (plan.fresh * theCount + 0.5);
+
+	if ((eliteCount == 0) && (plan.selection == SELECT_TRUNCATION))
+		eliteCount = 1;		// Someone has to be the parents
+
+	int childCount = theCount - eliteCount - luckyCount - freshCount;
+
+	if (childCount < 0) {
+		printf("The breeding plan needs %d DNA, there are only %d.\n", eliteCount + luckyCount + freshCount, theCount);
+		exit(1);
+	}
+
+	printf("Making %d elite, %d children, %d lucky and %d new.\n", eliteCount, childCount, luckyCount, freshCount);
 
-	sortDNAByScore(oldDNAArray, dnaScores, dnaNumbers, theCount);
+	// We've loaded everything, now rank it. Only the elite and the ones we print need to be
+	// in order, unless they all do
+
+	if (plan.selection == SELECT_RANK) {
+		rankDNA(&keys, dnaOrder, theCount);
+	} else {
+		rankDNA(&keys, dnaOrder, (eliteCount > BEST_SHOWN) ? eliteCount : BEST_SHOWN);
+	}
 
 	printf("The best were:");
 
-	for (i = 0; i < 10; i++) {
-		printf(" %d (%d)", dnaNumbers[i], dnaScores[i]);
+	for (i = 0; (i < BEST_SHOWN) && (i < theCount); i++) {
+		printf(" %d (%d)", dnaOrder[i] + startNum, keys.points[dnaOrder[i]]);
 		if (i == 5) {
 			printf("\n              ");
 		}
@@ -2282,79 +3613,108 @@ void breedingProgram(int theCount, int startNum) {
 
 	printf(".\n");
 
-	// Now that we know that, we do the actual breeding
+	logDiversity(oldDNAArray, oldSteps, &keys, theCount);
 
-	/* The plan:
-	//
-	// DNA #  - Function
-	//
-	// 1-10   - Lucky breeders (each breeds with 5 good, 1 random)
-	// 11-70  - The offspring of above
-	// 71-80  - Random losers carried over
-	// 81-100 - New random DNA
-	//
-	*/
+	// Now that we know that, we do the actual breeding. The new DNA are the elite,
+	// then their children, then the lucky, then the new random ones
 
 	printf("Copying the best... ");
 
 	int outputNum = 0;
 
-	for (outputNum = 0; outputNum < 10; outputNum++) {
-		copyDNA(&oldDNAArray[outputNum], &newDNAArray[outputNum]);
+	for (outputNum = 0; outputNum < eliteCount; outputNum++) {
+		copyDNA(&oldDNAArray[dnaOrder[outputNum]], &newDNAArray[outputNum]);
+		newSteps[outputNum] = oldSteps[dnaOrder[outputNum]];
 	}
 
-	if (outputNum != 10) {
-		printf("OutputNum was %d after copying the best. Error?\n", outputNum);
-	} else {
-		printf("OK\n");
-	}
+	printf("OK\n");
 
 	printf("Breeding... ");
 
-	int p1, p2, p2c;
+	breeding_work work;
 
-	for (p1 = 0; p1 < 10; p1++) {	// Choose parrent one
-		for (p2c = 0; p2c < 5; p2c++) {	// Parrent two count
-			p2 = rand() % 10;			// Choose the parent
-			haveSex(&oldDNAArray[p1], &oldDNAArray[p2], &newDNAArray[outputNum]);	// Do it (no pun intended)
-			outputNum++;															// Setup next slot
+	memset(&work, 0, sizeof(breeding_work));
+
+	work.plan = &plan;
+	work.keys = &keys;
+	work.order = dnaOrder;
+	work.eliteCount = eliteCount;
+	work.parents = oldDNAArray;
+	work.parentSteps = oldSteps;
+	work.children = &newDNAArray[outputNum];
+	work.childSteps = &newSteps[outputNum];
+	work.childCount = childCount;
+
+	if ((plan.selection == SELECT_RANK) || (plan.selection == SELECT_FITNESS)) {
+		work.weights = malloc(sizeof(double) * theCount);
+
+		if (work.weights == null) {
+			printf("Unable to allcoate selection odds: error %d.\n", errno);
+			exit(1);
+		}
+
+		for (i = 0; i < theCount; i++) {
+			if (plan.selection == SELECT_RANK) {
+				work.weights[i] = theCount - i;			// By rank, the best has theCount shares
+			} else {
+				work.weights[i] = keys.points[i] + 1;	// By number
+			}
+
+			if (i > 0)
+				work.weights[i] += work.weights[i - 1];
 		}
-		p2 = rand() % 90 + 10;		// Random parent who was not in the top 10
-		haveSex(&oldDNAArray[p1], &oldDNAArray[p2], &newDNAArray[outputNum]);	// Do it (no pun intended)
-		outputNum++;															// Setup next slot
 	}
 
-	if (outputNum != 70) {
-		printf("OutputNum was %d after breeding. Error?\n", outputNum);
-	} else {
-		printf("OK\n");
+	pthread_t breedThreads[MAX_BREED_THREADS];
+	int threadCount = plan.threads;
+	uint64_t breedStart = nanoTime();
+
+	if (threadCount > childCount)
+		threadCount = childCount;
+
+	for (i = 0; i < threadCount; i++) {
+		if (pthread_create(&breedThreads[i], null, breedChildren, &work) != 0) {
+			printf("Unable to start a breeding thread: error %d.\n", errno);
+			exit(1);
+		}
 	}
 
+	for (i = 0; i < threadCount; i++)
+		pthread_join(breedThreads[i], null);
+
+	free(work.weights);
+
+	outputNum += childCount;
+
+	printf("OK, %d children in %.3f seconds\n", childCount, (nanoTime() - breedStart) / 1000000000.0);
+
 	printf("Copying over lucky... ");
 
 	int lucky;
 	
-	for (i = 0; i < 10; i++) {
-		lucky = rand() % 90 + 10;	// Someone who wasn't in the top 10
+	for (i = 0; i < luckyCount; i++) {
+		if (eliteCount < theCount) {
+			lucky = randomInt(&breedRNG, theCount - eliteCount) + eliteCount;	// Someone who wasn't in the elite
+		} else {
+			lucky = randomInt(&breedRNG, theCount);
+		}
 
-		copyDNA(&oldDNAArray[lucky], &newDNAArray[outputNum]);
+		copyDNA(&oldDNAArray[dnaOrder[lucky]], &newDNAArray[outputNum]);
+		newSteps[outputNum] = oldSteps[dnaOrder[lucky]];
 		outputNum++;
 	}
 
-	if (outputNum != 80) {
-		printf("OutputNum was %d after copying the lucky. Error?\n", outputNum);
-	} else {
-		printf("OK\n");
-	}
+	printf("OK\n");
 
 	printf("Generating new DNA... ");
 
-	for (i = 0; i < 20; i++) {
-		makeRandomDNA(&newDNAArray[outputNum]);
+	for (i = 0; i < freshCount; i++) {
+		makeRandomDNA(&newDNAArray[outputNum], &breedRNG);
+		resetSteps(&newSteps[outputNum]);
 		outputNum++;
 	}
 
-	if (outputNum != 100) {
+	if (outputNum != theCount) {
 		printf("OutputNum was %d after spontanioius generation. Error?\n", outputNum);
 	} else {
 		printf("OK\n");
@@ -2366,7 +3726,7 @@ void breedingProgram(int theCount, int startNum) {
 
 	for (i = 0; i < theCount; i++) {
 		sprintf(buffer, "%d.dna", i + startNum);
-		saveDNA(buffer, &newDNAArray[i]);
+		saveDNA(buffer, &newDNAArray[i], &newSteps[i]);
 	}
 
 	printf("OK\n");
@@ -2408,35 +3768,76 @@ void breedingProgram(int theCount, int startNum) {
 
 	free(oldDNAArray);
 	free(newDNAArray);
-	free(dnaScores);
-	free(dnaNumbers);
+	free(oldSteps);
+	free(newSteps);
+	free(dnaOrder);
+	freeRankKeys(&keys);
 }
 
 // The main function. All hail main!
 
 int main(int argc, char** argv) {
-	// Seed the RNG
-
-	srand((unsigned) time(NULL));
-
 	// Based on argv, we have to figure out what we want to do
 
 	if (argc == 1) {
-		printf("\nPlease call like: /path/to/master [m c s]|[i c s]|[b c s]\n\n");
+		printf("\nPlease call like: /path/to/master [m c s]|[i c s]|[b c s] [seed]\n\n");
 		printf("m - Make DNA, c is the number of DNA files, s is start num\n");
 		printf("i - Run a tourney, using dna numbers starting at s, count c\n");
 		printf("b - Breed the dna numbers starting at s, count c\n\n");
+		printf("Giving the same seed again repeats a run exactly\n");
 		printf("DNA files are text and end in .DNA\n");
 		printf("Tourneys place the starting board in startingBoard.txt,\n");
-		printf("\tand a results file in results.html.\n");
+		printf("\tand results in results.html, results.csv and results.json.\n");
+		printf("Each game's result goes in %s as soon as it's over, and\n", RESULTS_NAME);
+		printf("\t/path/to/master r %s writes the results files from it again.\n", RESULTS_NAME);
+		printf("Every game played is added to games-0.log, indexed by games-0.idx.\n");
+		printf("Breeding follows %s if it's there, \"name value\" lines changing the defaults:\n", BREEDING_PLAN_NAME);
+		printf("\telite %.2f, lucky %.2f and fresh %.2f are shares of the population, children fill the rest\n",
+					ELITE_SHARE, LUCKY_SHARE, FRESH_SHARE);
+		printf("\tselection truncation|tournament|rank|fitness, tournament %d\n", TOURNAMENT_SIZE);
+		printf("\tcrossover uniform|point|blend, mutation adaptive|scale|reset, rate %.2f, threads n\n", MUTATION_RATE);
+		printf("\tAdaptive mutation moves every gene, by step sizes kept in the DNA files. The rate is for the others\n");
+		printf("Each generation's diversity is added to %s.\n", DIVERSITY_NAME);
 		printf("\n");
 		
 		return 0;
-	} else if (argc != 4) {
+	} else if ((argc == 3) && (argv[1][0] == 'r')) {
+		// They want the reports from a results stream
+
+		results_matrix results;
+
+		readResults(argv[2], &results);
+		writeReports(&results);
+		freeResults(&results);
+
+		return 0;
+	} else if ((argc != 4) && (argc != 5)) {
 		printf("Not enough arguments, call the program with no arguments for instructions.\n");
 		return 0;
 	}
 
+	// Seed the RNG, every other stream comes from this one seed
+
+	if (argc == 5) {
+		unsigned long long seed;
+
+		if (sscanf(argv[4], "%llu", &seed) != 1) {
+			printf("Unable to read the seed.\n");
+			return 1;
+		}
+
+		masterSeed = (uint64_t) seed;
+	} else {
+		masterSeed = (uint64_t) time(NULL);
+	}
+
+	printf("Using seed %llu\n", (unsigned long long) masterSeed);
+
+	seedRNG(&masterRNG, masterSeed, STREAM_SETUP);
+
+	if (TIMING)
+		atexit(writeTimings);
+
 	// So, now we have to figure out which thing they want to do
 
 	if (argv[1][0] == 'm') {
@@ -2513,7 +3914,7 @@ int main(int argc, char** argv) {
 		runTourney(theCount, startNum);
 
 	} else if (argv[1][0] == 'b') {
-		// They want to run a tourney with IPC
+		// They want to breed
 
 		int startNum, theCount;
 		int got;
@@ -2546,12 +3947,7 @@ int main(int argc, char** argv) {
 
 		// Do it
 
-		if ((startNum == 1) && (theCount == 100)) {
-			breedingProgram(theCount, startNum);
-		} else {
-			printf("We currently artificially limit you to having to use 1 and 100 for start and count.\n\n");
-			exit(1);
-		}
+		breedingProgram(theCount, startNum);
 
 	}
 
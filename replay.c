@@ -0,0 +1,835 @@
+//------------------------------- Includes -------------------------------
+
+#define LAB_NO_MAIN
+#include "lab.c"
+
+//------------------------------- Constants -------------------------------
+
+#define GAME_LOG_MAGIC			"LBGL"	// These must match master.c
+#define GAME_LOG_VERSION		3
+#define GAME_LOG_OLDEST			1		// Older logs still read, their records, moves and DNA get widened
+#define GAME_LOG_BUFFER			(256 * 1024)	// How much of the log we read at a time
+
+#define MAX_GAME_MOVES			(2 * MAX_BOARD_SIDE * (MAX_BOARD_SIDE + 1))
+
+#define V1_MOVE_VERTICAL		0x8000	// Version 1 logs packed moves in 16 bits with 5 bit fields
+#define V1_MOVE_FIELD_BITS		5
+#define V1_MOVE_FIELD_MASK		0x1F
+
+#define PHASE_ANY				-1
+#define PHASE_OPENING			0		// Safe lines left and less than half the lines drawn
+#define PHASE_MIDDLE			1		// Safe lines left and at least half the lines drawn
+#define PHASE_END				2		// No safe lines left, only chains to give away
+#define PHASE_COUNT				3
+
+//------------------------------- Structs -------------------------------
+
+typedef struct {				// Starts every game log file, must match master.c
+	char magic[4];
+	uint32_t version;
+} game_log_header;
+
+typedef struct {				// Starts each game in a game log, must match master.c
+	uint64_t seed;
+	uint32_t stream;
+	int32_t playerOneNumber;
+	int32_t playerTwoNumber;
+	uint16_t moveCount;
+	uint8_t width;
+	uint8_t height;
+	uint8_t winner;
+	uint8_t unused[7];
+	dna playerOne;
+	dna playerTwo;
+} game_record;
+
+typedef struct {				// DNA before version 3 logs, just the six original genes
+	double genes[BASE_GENES];
+} dna_v2;
+
+typedef struct {				// How games started in version 2 logs
+	uint64_t seed;
+	uint32_t stream;
+	int32_t playerOneNumber;
+	int32_t playerTwoNumber;
+	uint16_t moveCount;
+	uint8_t width;
+	uint8_t height;
+	uint8_t winner;
+	uint8_t unused[7];
+	dna_v2 playerOne;
+	dna_v2 playerTwo;
+} game_record_v2;
+
+typedef struct {				// How games started in version 1 logs
+	uint64_t seed;
+	uint32_t stream;
+	int32_t playerOneNumber;
+	int32_t playerTwoNumber;
+	uint8_t width;
+	uint8_t height;
+	uint8_t winner;
+	uint8_t moveCount;
+	dna_v2 playerOne;
+	dna_v2 playerTwo;
+} game_record_v1;
+
+typedef struct {				// A game read back out of a log
+	game_record record;
+	uint8_t startCells[MAX_BOARD_SIDE * MAX_BOARD_SIDE];
+	packed_move moves[MAX_GAME_MOVES];
+} logged_game;
+
+typedef struct {				// Which positions we want pulled out of the games
+	int width;					// 0 for any size
+	int height;
+	int phase;					// PHASE_ANY or one of the phases
+	int sidesMin[4];			// Boxes with 0, 1, 2 and 3 sides must be in these ranges
+	int sidesMax[4];
+	long maxPositions;			// Stop after this many, 0 for no limit
+	int unique;					// Only write each position once, rotations and reflections included
+} position_filter;
+
+//------------------------------- Global Variables -------------------------------
+
+const char *phaseNames[PHASE_COUNT] = {"opening", "middle", "end"};
+
+int startCells[MAX_BOARD_SIDE * MAX_BOARD_SIDE];	// The start board of the game being replayed
+int logVersion;				// Version of the log we're reading, set by openGameLog
+
+long gamesRead = 0;
+long positionsSeen = 0;
+long positionsWritten = 0;
+
+uint64_t *seenKeys = null;	// positionKey of every position written so far with -u, 0 is an empty spot
+long seenRoom = 0;
+long seenCount = 0;
+
+// Function prototypes
+
+FILE *openGameLog(char *path);
+int readGame(FILE *log, char *path, logged_game *g);
+int readRecord(FILE *log, game_record *r);
+void widenDNA(dna_v2 *old, dna *d);
+int readMoves(FILE *log, packed_move *moves, int count);
+void readGameNumber(char *path, long n, logged_game *g);
+void startReplay(logged_game *g);
+int playerToMove(int moveIndex);
+int lineIsDrawn(int *board, int horizontal, int x, int y);
+int lineIsSafe(int *board, int horizontal, int x, int y);
+int positionPhase(int *board);
+int positionMatches(position_filter *f, int *board);
+void writeMoveLine(FILE *out, int player, int from_x, int from_y, int to_x, int to_y);
+void writePosition(FILE *out, logged_game *g, int moveIndex, int *board);
+void showGame(char *path, long n);
+void extractOne(char *path, long n, int moveIndex, char *outPath);
+void extractPositions(FILE *out, char *path, position_filter *f);
+int seenBefore(uint64_t key);
+int readRange(char *text, int *min, int *max);
+int readFilter(int argc, char** argv, int first, position_filter *f);
+
+//------------------------------- Function definitions -------------------------------
+
+// Open a game log and make sure it is one
+
+FILE *openGameLog(char *path) {
+	FILE *log = null;
+	game_log_header header;
+
+	log = fopen(path, "rb");
+
+	if (log == null) {
+		printf("Unable to open the game log '%s': error %d.\n", path, errno);
+		exit(1);
+	}
+
+	setvbuf(log, null, _IOFBF, GAME_LOG_BUFFER);
+
+	if ((fread(&header, sizeof(game_log_header), 1, log) != 1) ||
+				(memcmp(header.magic, GAME_LOG_MAGIC, 4) != 0)) {
+		printf("'%s' is not a game log.\n", path);
+		exit(1);
+	}
+
+	if ((header.version < GAME_LOG_OLDEST) || (header.version > GAME_LOG_VERSION)) {
+		printf("'%s' is version %u of the game log, we only know versions %d to %d.\n", path, header.version,
+					GAME_LOG_OLDEST, GAME_LOG_VERSION);
+		exit(1);
+	}
+
+	logVersion = header.version;
+
+	return log;
+}
+
+// Read the next game from a log. Returns false at the end of the log
+
+int readGame(FILE *log, char *path, logged_game *g) {
+	int cells;
+
+	if (!readRecord(log, &(g->record))) {
+		if (feof(log))
+			return false;
+
+		printf("Unable to read from '%s': error %d.\n", path, errno);
+		exit(1);
+	}
+
+	if ((g->record.width < MIN_BOARD_SIDE) || (g->record.width > MAX_BOARD_SIDE) ||
+				(g->record.height < MIN_BOARD_SIDE) || (g->record.height > MAX_BOARD_SIDE) ||
+				(g->record.moveCount > MAX_GAME_MOVES)) {
+		printf("Game %ld in '%s' is damaged.\n", gamesRead, path);
+		exit(1);
+	}
+
+	cells = g->record.width * g->record.height;
+
+	if ((fread(g->startCells, 1, cells, log) != (size_t) cells) ||
+				!readMoves(log, g->moves, g->record.moveCount)) {
+		printf("Game %ld in '%s' was cut off.\n", gamesRead, path);
+		exit(1);
+	}
+
+	gamesRead++;
+
+	return true;
+}
+
+// Read the record that starts a game, turning an old one into the current layout. Returns false if it isn't there
+
+int readRecord(FILE *log, game_record *r) {
+	game_record_v1 old;
+	game_record_v2 two;
+
+	if (logVersion == GAME_LOG_VERSION)
+		return fread(r, sizeof(game_record), 1, log) == 1;
+
+	memset(r, 0, sizeof(game_record));
+
+	if (logVersion == 2) {
+		if (fread(&two, sizeof(game_record_v2), 1, log) != 1)
+			return false;
+
+		r->seed = two.seed;
+		r->stream = two.stream;
+		r->playerOneNumber = two.playerOneNumber;
+		r->playerTwoNumber = two.playerTwoNumber;
+		r->moveCount = two.moveCount;
+		r->width = two.width;
+		r->height = two.height;
+		r->winner = two.winner;
+		widenDNA(&two.playerOne, &r->playerOne);
+		widenDNA(&two.playerTwo, &r->playerTwo);
+
+		return true;
+	}
+
+	if (fread(&old, sizeof(game_record_v1), 1, log) != 1)
+		return false;
+
+	r->seed = old.seed;
+	r->stream = old.stream;
+	r->playerOneNumber = old.playerOneNumber;
+	r->playerTwoNumber = old.playerTwoNumber;
+	r->moveCount = old.moveCount;
+	r->width = old.width;
+	r->height = old.height;
+	r->winner = old.winner;
+	widenDNA(&old.playerOne, &r->playerOne);
+	widenDNA(&old.playerTwo, &r->playerTwo);
+
+	return true;
+}
+
+// Turn six gene DNA from an old log into the gene array
+
+void widenDNA(dna_v2 *old, dna *d) {
+	int i;
+
+	memset(d, 0, sizeof(dna));
+
+	d->geneCount = BASE_GENES;
+
+	for (i = 0; i < BASE_GENES; i++)
+		d->genes[i] = old->genes[i];
+}
+
+// Read a game's moves, repacking old 16 bit ones. Returns false if they aren't all there
+
+int readMoves(FILE *log, packed_move *moves, int count) {
+	uint16_t old[MAX_GAME_MOVES];
+	int i, line, start, end;
+
+	if (logVersion >= 2)
+		return fread(moves, sizeof(packed_move), count, log) == (size_t) count;	// 32 bit since version 2
+
+	if (fread(old, sizeof(uint16_t), count, log) != (size_t) count)
+		return false;
+
+	for (i = 0; i < count; i++) {
+		line = (old[i] >> (2 * V1_MOVE_FIELD_BITS)) & V1_MOVE_FIELD_MASK;
+		start = (old[i] >> V1_MOVE_FIELD_BITS) & V1_MOVE_FIELD_MASK;
+		end = old[i] & V1_MOVE_FIELD_MASK;
+
+		if (old[i] & V1_MOVE_VERTICAL)
+			moves[i] = packMove(line, start, line, end);
+		else
+			moves[i] = packMove(start, line, end, line);
+	}
+
+	return true;
+}
+
+// Use the index next to a game log to read game n without reading the ones before it
+
+void readGameNumber(char *path, long n, logged_game *g) {
+	FILE *log, *index;
+	char indexPath[256];
+	uint64_t offset;
+	int length;
+
+	// games-0.log is indexed by games-0.idx
+
+	length = strlen(path);
+
+	if ((length < 4) || (length >= 256) || (strcmp(path + length - 4, ".log") != 0)) {
+		printf("Expected the game log name to end in '.log'.\n");
+		exit(1);
+	}
+
+	strcpy(indexPath, path);
+	strcpy(indexPath + length - 4, ".idx");
+
+	index = fopen(indexPath, "rb");
+
+	if (index == null) {
+		printf("Unable to open the game index '%s': error %d.\n", indexPath, errno);
+		exit(1);
+	}
+
+	if ((n < 0) || (fseek(index, n * sizeof(uint64_t), SEEK_SET) != 0) ||
+				(fread(&offset, sizeof(uint64_t), 1, index) != 1)) {
+		printf("There is no game %ld in '%s'.\n", n, path);
+		exit(1);
+	}
+
+	fclose(index);
+
+	log = openGameLog(path);
+
+	if ((fseek(log, offset, SEEK_SET) != 0) || !readGame(log, path, g)) {
+		printf("Unable to read game %ld from '%s'.\n", n, path);
+		exit(1);
+	}
+
+	fclose(log);
+}
+
+// Set lab's globals up for a game and put its start board in gameBoard
+
+void startReplay(logged_game *g) {
+	int i;
+
+	boardWidth = g->record.width;
+	boardHeight = g->record.height;
+
+	for (i = 0; i < boardWidth * boardHeight; i++) {
+		startCells[i] = g->startCells[i];
+	}
+
+	copyBoard(startCells, gameBoard);
+}
+
+// Turns alternate and player one always goes first
+
+int playerToMove(int moveIndex) {
+	if (moveIndex % 2 == 0)
+		return PLAYER_ONE;
+	else
+		return PLAYER_TWO;
+}
+
+// See if the line segment starting at x, y is already there
+
+int lineIsDrawn(int *board, int horizontal, int x, int y) {
+	if (horizontal) {
+		if (y < boardHeight)
+			return board[xyToIndex(x, y)] & TOP_LINE;
+		else
+			return board[xyToIndex(x, y - 1)] & BOTTOM_LINE;
+	} else {
+		if (x < boardWidth)
+			return board[xyToIndex(x, y)] & LEFT_LINE;
+		else
+			return board[xyToIndex(x - 1, y)] & RIGHT_LINE;
+	}
+}
+
+// See if drawing the line segment starting at x, y would leave a box with three sides
+
+int lineIsSafe(int *board, int horizontal, int x, int y) {
+	if (lineIsDrawn(board, horizontal, x, y))
+		return false;
+
+	if (horizontal) {
+		if ((y > 0) && (countLines(board, x, y - 1) >= 2))
+			return false;
+		if ((y < boardHeight) && (countLines(board, x, y) >= 2))
+			return false;
+	} else {
+		if ((x > 0) && (countLines(board, x - 1, y) >= 2))
+			return false;
+		if ((x < boardWidth) && (countLines(board, x, y) >= 2))
+			return false;
+	}
+
+	return true;
+}
+
+// Work out which phase of the game a board is in
+
+int positionPhase(int *board) {
+	int x, y, horizontal;
+	int totalLines, linesDrawn, safeLines;
+
+	totalLines = boardWidth * (boardHeight + 1) + boardHeight * (boardWidth + 1);
+	linesDrawn = 0;
+	safeLines = 0;
+
+	for (horizontal = 0; horizontal < 2; horizontal++) {
+		for (y = 0; y <= boardHeight; y++) {
+			for (x = 0; x <= boardWidth; x++) {
+				if ((horizontal && (x == boardWidth)) || (!horizontal && (y == boardHeight)))
+					continue;
+
+				if (lineIsDrawn(board, horizontal, x, y))
+					linesDrawn++;
+				else if (lineIsSafe(board, horizontal, x, y))
+					safeLines++;
+			}
+		}
+	}
+
+	if (safeLines == 0)
+		return PHASE_END;
+	else if (linesDrawn * 2 < totalLines)
+		return PHASE_OPENING;
+	else
+		return PHASE_MIDDLE;
+}
+
+// See if the position on the board is one the filter wants
+
+int positionMatches(position_filter *f, int *board) {
+	boardEvaluation *e;
+	int sides[4];
+	int i;
+
+	if ((f->width != 0) && ((boardWidth != f->width) || (boardHeight != f->height)))
+		return false;
+
+	e = evaluateBoard(board, NO_MOVE, null);
+
+	sides[0] = e->noSides;
+	sides[1] = e->oneSides;
+	sides[2] = e->twoSides;
+	sides[3] = e->threeSides;
+
+	arenaReset(&evalArena);
+
+	for (i = 0; i < 4; i++) {
+		if ((sides[i] < f->sidesMin[i]) || (sides[i] > f->sidesMax[i]))
+			return false;
+	}
+
+	if ((f->phase != PHASE_ANY) && (positionPhase(board) != f->phase))
+		return false;
+
+	return true;
+}
+
+// Write one move line of an input file
+
+void writeMoveLine(FILE *out, int player, int from_x, int from_y, int to_x, int to_y) {
+	fprintf(out, "%d %c%d %c%d\n", player, columnToChar(from_x), from_y + 1, columnToChar(to_x), to_y + 1);
+}
+
+// Write the position before move moveIndex of a game out in the input file format lab reads.
+// The start board goes in as segments by player 0, then the moves the players made to get here
+
+void writePosition(FILE *out, logged_game *g, int moveIndex, int *board) {
+	int x, y, i;
+	int from_x, from_y, to_x, to_y;
+	int scoreOne, scoreTwo;
+
+	// The scores are the boxes each player has taken
+
+	scoreOne = 0;
+	scoreTwo = 0;
+
+	for (i = 0; i < boardWidth * boardHeight; i++) {
+		if (board[i] & OWNED_BY_PLAYER_ONE)
+			scoreOne++;
+		else if (board[i] & OWNED_BY_PLAYER_TWO)
+			scoreTwo++;
+	}
+
+	fprintf(out, "%d %d %d\n", playerToMove(moveIndex), boardHeight, boardWidth);
+	fprintf(out, "1 %d %f\n", scoreOne, 60.0);
+	fprintf(out, "2 %d %f\n", scoreTwo, 60.0);
+
+	// Each segment of the start board, the bottom and right edges only show up on the last row and column
+
+	for (y = 0; y < boardHeight; y++) {
+		for (x = 0; x < boardWidth; x++) {
+			i = xyToIndex(x, y);
+
+			if (startCells[i] & TOP_LINE)
+				writeMoveLine(out, PLAYER_OTHER, x, y, x + 1, y);
+			if ((y == boardHeight - 1) && (startCells[i] & BOTTOM_LINE))
+				writeMoveLine(out, PLAYER_OTHER, x, y + 1, x + 1, y + 1);
+			if (startCells[i] & LEFT_LINE)
+				writeMoveLine(out, PLAYER_OTHER, x, y, x, y + 1);
+			if ((x == boardWidth - 1) && (startCells[i] & RIGHT_LINE))
+				writeMoveLine(out, PLAYER_OTHER, x + 1, y, x + 1, y + 1);
+		}
+	}
+
+	for (i = 0; i < moveIndex; i++) {
+		unpackMove(g->moves[i], &from_x, &from_y, &to_x, &to_y);
+		writeMoveLine(out, playerToMove(i), from_x, from_y, to_x, to_y);
+	}
+}
+
+// Print a game out move by move
+
+void showGame(char *path, long n) {
+	logged_game g;
+	int i;
+	int from_x, from_y, to_x, to_y;
+
+	readGameNumber(path, n, &g);
+	startReplay(&g);
+
+	printf("Game %ld: DNA %d (player 1) against DNA %d (player 2) on %dx%d\n", n,
+				g.record.playerOneNumber, g.record.playerTwoNumber, boardWidth, boardHeight);
+	printf("Seed %llu, stream %u. Winner: %d\n", (unsigned long long) g.record.seed, g.record.stream, g.record.winner);
+
+	printBoard(gameBoard);
+
+	for (i = 0; i < g.record.moveCount; i++) {
+		unpackMove(g.moves[i], &from_x, &from_y, &to_x, &to_y);
+
+		printf("\nMove %d: player %d plays %c%d %c%d (%s)\n", i, playerToMove(i), columnToChar(from_x), from_y + 1,
+					columnToChar(to_x), to_y + 1, phaseNames[positionPhase(gameBoard)]);
+
+		runPackedMove(playerToMove(i), g.moves[i], gameBoard);
+
+		printBoard(gameBoard);
+	}
+}
+
+// Write the position before one move of one game to its own input file
+
+void extractOne(char *path, long n, int moveIndex, char *outPath) {
+	logged_game g;
+	FILE *out = null;
+	int i;
+	int from_x, from_y, to_x, to_y;
+
+	readGameNumber(path, n, &g);
+	startReplay(&g);
+
+	if ((moveIndex < 0) || (moveIndex >= g.record.moveCount)) {
+		printf("Game %ld only has moves 0 to %d.\n", n, g.record.moveCount - 1);
+		exit(1);
+	}
+
+	for (i = 0; i < moveIndex; i++) {
+		runPackedMove(playerToMove(i), g.moves[i], gameBoard);
+	}
+
+	out = fopen(outPath, "w");
+
+	if (out == null) {
+		printf("Unable to open '%s' for writing: error %d.\n", outPath, errno);
+		exit(1);
+	}
+
+	writePosition(out, &g, moveIndex, gameBoard);
+
+	fclose(out);
+
+	unpackMove(g.moves[moveIndex], &from_x, &from_y, &to_x, &to_y);
+
+	printf("Player %d played %c%d %c%d from here in the game.\n", playerToMove(moveIndex),
+				columnToChar(from_x), from_y + 1, columnToChar(to_x), to_y + 1);
+}
+
+// Replay every game in a log, writing the positions the filter wants to the batch file
+
+void extractPositions(FILE *out, char *path, position_filter *f) {
+	FILE *log;
+	logged_game g;
+	int i;
+
+	log = openGameLog(path);
+
+	while (readGame(log, path, &g)) {
+		if ((f->width != 0) && ((g.record.width != f->width) || (g.record.height != f->height)))
+			continue;	// No need to replay games on the wrong size
+
+		startReplay(&g);
+
+		for (i = 0; i < g.record.moveCount; i++) {
+			positionsSeen++;
+
+			if (positionMatches(f, gameBoard) &&
+						!(f->unique && seenBefore(positionKey(gameBoard, playerToMove(i), null)))) {
+				writePosition(out, &g, i, gameBoard);
+				fprintf(out, "%s\n", BATCH_SEPARATOR);
+
+				positionsWritten++;
+
+				if ((f->maxPositions != 0) && (positionsWritten >= f->maxPositions))
+					break;
+			}
+
+			runPackedMove(playerToMove(i), g.moves[i], gameBoard);
+		}
+
+		if ((f->maxPositions != 0) && (positionsWritten >= f->maxPositions))
+			break;
+	}
+
+	fclose(log);
+}
+
+// Remember a position's key. Returns true if we had already seen it
+
+int seenBefore(uint64_t key) {
+	uint64_t *old;
+	long oldRoom, i, j;
+
+	if (key == 0)
+		key = 1;	// 0 marks an empty spot
+
+	// Keep the table at most half full so the runs stay short
+
+	if ((seenCount + 1) * 2 > seenRoom) {
+		old = seenKeys;
+		oldRoom = seenRoom;
+
+		seenRoom = (oldRoom == 0) ? 4096 : oldRoom * 2;
+		seenKeys = calloc(seenRoom, sizeof(uint64_t));
+
+		if (seenKeys == null) {
+			printf("Unable to allocate room to remember %ld positions.\n", seenRoom / 2);
+			exit(1);
+		}
+
+		for (i = 0; i < oldRoom; i++) {
+			if (old[i] == 0)
+				continue;
+
+			for (j = old[i] & (seenRoom - 1); seenKeys[j] != 0; j = (j + 1) & (seenRoom - 1));
+
+			seenKeys[j] = old[i];
+		}
+
+		free(old);
+	}
+
+	for (i = key & (seenRoom - 1); seenKeys[i] != 0; i = (i + 1) & (seenRoom - 1)) {
+		if (seenKeys[i] == key)
+			return true;
+	}
+
+	seenKeys[i] = key;
+	seenCount++;
+
+	return false;
+}
+
+// Read a range like "3", "3-", "-3", "3-5" or "*". Returns false if we can't
+
+int readRange(char *text, int *min, int *max) {
+	char *dash;
+
+	*min = 0;
+	*max = MAX_BOARD_SIDE * MAX_BOARD_SIDE;
+
+	if (strcmp(text, "*") == 0)
+		return true;
+
+	dash = strchr(text, '-');
+
+	if (dash == null) {
+		if (sscanf(text, "%d", min) != 1)
+			return false;
+
+		*max = *min;
+		return true;
+	}
+
+	if ((dash != text) && (sscanf(text, "%d", min) != 1))
+		return false;
+
+	if ((dash[1] != '\0') && (sscanf(dash + 1, "%d", max) != 1))
+		return false;
+
+	return true;
+}
+
+// Read the filter options off the command line, starting at argv[first]. Returns the first argument that isn't one
+
+int readFilter(int argc, char** argv, int first, position_filter *f) {
+	int i, p;
+	char *field;
+
+	f->width = 0;
+	f->height = 0;
+	f->phase = PHASE_ANY;
+	f->maxPositions = 0;
+	f->unique = false;
+
+	for (i = 0; i < 4; i++) {
+		f->sidesMin[i] = 0;
+		f->sidesMax[i] = MAX_BOARD_SIDE * MAX_BOARD_SIDE;
+	}
+
+	i = first;
+
+	while ((i + 1 < argc) && (argv[i][0] == '-')) {
+		if (strcmp(argv[i], "-u") == 0) {
+			f->unique = true;
+			i++;
+			continue;	// No value to skip
+		}
+
+		if (strcmp(argv[i], "-s") == 0) {
+			if (sscanf(argv[i + 1], "%dx%d", &(f->width), &(f->height)) != 2) {
+				printf("Unable to read the board size '%s', it should look like 5x4.\n", argv[i + 1]);
+				exit(1);
+			}
+		} else if (strcmp(argv[i], "-p") == 0) {
+			for (p = 0; p < PHASE_COUNT; p++) {
+				if (strcmp(argv[i + 1], phaseNames[p]) == 0)
+					f->phase = p;
+			}
+
+			if (f->phase == PHASE_ANY) {
+				printf("Unknown phase '%s'.\n", argv[i + 1]);
+				exit(1);
+			}
+		} else if (strcmp(argv[i], "-c") == 0) {
+			field = strtok(argv[i + 1], ",");
+
+			for (p = 0; p < 4; p++) {
+				if ((field == null) || !readRange(field, &(f->sidesMin[p]), &(f->sidesMax[p]))) {
+					printf("The side counts need four ranges, like '*,*,2-,1'.\n");
+					exit(1);
+				}
+
+				field = strtok(null, ",");
+			}
+		} else if (strcmp(argv[i], "-m") == 0) {
+			if ((sscanf(argv[i + 1], "%ld", &(f->maxPositions)) != 1) || (f->maxPositions < 0)) {
+				printf("Unable to read the position limit '%s'.\n", argv[i + 1]);
+				exit(1);
+			}
+		} else {
+			break;
+		}
+
+		i += 2;
+	}
+
+	return i;
+}
+
+// The main function. All hail main!
+
+int main(int argc, char** argv) {
+	position_filter filter;
+	FILE *out = null;
+	long n;
+	int moveIndex, first, i;
+	uint64_t start;
+
+	if ((argc < 3) || ((argv[1][0] != 's') && (argv[1][0] != 'p') && (argv[1][0] != 'x'))) {
+		printf("\nPlease call like: /path/to/replay [s log n]|[p log n m out]|[x out [filters] log...]\n\n");
+		printf("s - Show game n of the log, move by move\n");
+		printf("p - Write the position before move m of game n as an input file for lab\n");
+		printf("x - Replay every game in the logs and write the positions that match to a batch file\n\n");
+		printf("Filters for x:\n");
+		printf("\t-s WxH     only this board size\n");
+		printf("\t-p phase   opening, middle or end\n");
+		printf("\t-c a,b,c,d boxes with 0, 1, 2 and 3 sides, each a count, range (2-5, 2-) or *\n");
+		printf("\t-m max     stop after this many positions\n");
+		printf("\t-u         skip positions already written, counting rotations and reflections as the same\n\n");
+		printf("A batch file is input files one after the other, each ended by a line holding '%s'.\n\n", BATCH_SEPARATOR);
+		return 1;
+	}
+
+	// Lab needs DNA and a board to work with, even though we never pick a move
+
+	myDNA = malloc(sizeof(dna));
+	gameBoard = malloc(MAX_BOARD_SIDE * MAX_BOARD_SIDE * sizeof(int));
+
+	if ((myDNA == null) || (gameBoard == null)) {
+		printf("Unable to allocate memory to replay games in!\n");
+		return 1;
+	}
+
+	useDefaultDNA(myDNA);
+	setPlayer(PLAYER_ONE);
+
+	if (argv[1][0] == 's') {
+		if ((argc != 4) || (sscanf(argv[3], "%ld", &n) != 1)) {
+			printf("Need a game log and a game number.\n");
+			return 1;
+		}
+
+		showGame(argv[2], n);
+	} else if (argv[1][0] == 'p') {
+		if ((argc != 6) || (sscanf(argv[3], "%ld", &n) != 1) || (sscanf(argv[4], "%d", &moveIndex) != 1)) {
+			printf("Need a game log, a game number, a move number and an output file.\n");
+			return 1;
+		}
+
+		extractOne(argv[2], n, moveIndex, argv[5]);
+	} else {
+		first = readFilter(argc, argv, 3, &filter);
+
+		if (first >= argc) {
+			printf("Need at least one game log to read.\n");
+			return 1;
+		}
+
+		out = fopen(argv[2], "w");
+
+		if (out == null) {
+			printf("Unable to open '%s' for writing: error %d.\n", argv[2], errno);
+			return 1;
+		}
+
+		setvbuf(out, null, _IOFBF, GAME_LOG_BUFFER);
+
+		start = nanoTime();
+
+		for (i = first; i < argc; i++) {
+			extractPositions(out, argv[i], &filter);
+
+			if ((filter.maxPositions != 0) && (positionsWritten >= filter.maxPositions))
+				break;
+		}
+
+		fclose(out);
+
+		printf("Replayed %ld games (%ld positions) in %.2f seconds, wrote %ld positions to '%s'.\n", gamesRead,
+					positionsSeen, (nanoTime() - start) / 1000000000.0, positionsWritten, argv[2]);
+	}
+
+	return 0;
+}
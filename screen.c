@@ -0,0 +1,220 @@
+//------------------------------- Includes -------------------------------
+
+#define LAB_NO_MAIN
+#include "lab.c"
+
+//------------------------------- Global Variables -------------------------------
+
+dna referenceDNA;				// What the reference moves are played with, the default DNA
+dna *genomes = null;			// Every genome being screened
+char **genomeNames = null;		// The file each one came from
+int genomeCount = 0;
+int genomeRoom = 0;
+
+int *choices = null;			// The row each genome picked in the current position
+long *matches = null;			// Positions where each genome picked the reference move
+
+long positionsScreened = 0;
+
+arena screenArena;				// Holds the current position's feature matrix
+
+// Function prototypes
+
+void addGenome(char *path);
+void readGenomeList(FILE *in);
+void screenPosition(int depth, uint64_t *chooseTime);
+void printResults();
+
+//------------------------------- Function definitions -------------------------------
+
+// Load one genome and remember where it came from
+
+void addGenome(char *path) {
+	if (genomeCount == genomeRoom) {
+		genomeRoom = (genomeRoom == 0) ? 64 : genomeRoom * 2;
+
+		genomes = realloc(genomes, genomeRoom * sizeof(dna));
+		genomeNames = realloc(genomeNames, genomeRoom * sizeof(char *));
+
+		if ((genomes == null) || (genomeNames == null)) {
+			printf("Unable to allocate memory for %d genomes.\n", genomeRoom);
+			exit(1);
+		}
+	}
+
+	myDNA = &genomes[genomeCount];	// loadDNA always loads into myDNA
+	loadDNA(path);
+
+	genomeNames[genomeCount] = strdup(path);
+
+	if (genomeNames[genomeCount] == null) {
+		printf("Unable to allocate memory for a genome's name.\n");
+		exit(1);
+	}
+
+	genomeCount++;
+}
+
+// Load the genomes listed in a file, one path a line
+
+void readGenomeList(FILE *in) {
+	char buffer[1024];
+
+	while (fgets(buffer, 1024, in) != null) {
+		buffer[strcspn(buffer, "\r\n")] = '\0';
+
+		if (buffer[0] != '\0')
+			addGenome(buffer);
+	}
+}
+
+// Find the reference move for the position in gameBoard, then see which genomes pick it.
+// The candidates' features are worked out once and every genome chooses from them
+
+void screenPosition(int depth, uint64_t *chooseTime) {
+	feature_matrix m;
+	packed_move reference;
+	uint64_t start;
+	int i;
+
+	generateMoveList();
+
+	if (possibleMovesFound == 0) {
+		clearPossibleMoves();
+		return;		// The game is over, there's nothing to choose
+	}
+
+	arenaReset(&screenArena);
+
+	candidateFeatures(&m, &screenArena);
+
+	// The reference is what the default DNA plays, looking depth plies ahead
+
+	searchDepth = depth;
+	selectMove();
+	reference = finalMove;
+
+	clearPossibleMoves();
+
+	// Now every genome at once
+
+	start = nanoTime();
+
+	chooseForGenomes(&m, genomes, genomeCount, choices);
+
+	*chooseTime += nanoTime() - start;
+
+	for (i = 0; i < genomeCount; i++) {
+		if (m.moves[choices[i]] == reference)
+			matches[i]++;
+	}
+
+	positionsScreened++;
+}
+
+// One line per genome, in the order they were given
+
+void printResults() {
+	int i;
+
+	for (i = 0; i < genomeCount; i++) {
+		printf("%6.2f%%\t%ld/%ld\t%s\n", (positionsScreened == 0) ? 0.0 : matches[i] * 100.0 / positionsScreened,
+					matches[i], positionsScreened, genomeNames[i]);
+	}
+}
+
+// The main function. All hail main!
+
+int main(int argc, char** argv) {
+	FILE *in = null;
+	uint64_t start, chooseTime;
+	int depth, first, i;
+
+	first = 1;
+
+	if ((argc >= 3) && (strcmp(argv[1], "--threads") == 0)) {
+		if ((sscanf(argv[2], "%d", &playThreads) != 1) || (playThreads < 1) || (playThreads > MAX_PLAY_THREADS)) {
+			printf("The thread count needs to be between 1 and %d. Given '%s'.\n", MAX_PLAY_THREADS, argv[2]);
+			return 1;
+		}
+
+		first = 3;
+	}
+
+	if ((argc - first < 3) || (sscanf(argv[first + 1], "%d", &depth) != 1)) {
+		printf("\nPlease call like: /path/to/screen [--threads n] positions depth dna...|-\n\n");
+		printf("Works out the move for every position in a batch file with a depth ply search using the\n");
+		printf("default DNA (0 is a greedy move), then counts how often each DNA file picks the same move.\n");
+		printf("With - the DNA files are listed on stdin, one a line. It's a quick way to weed out DNA\n");
+		printf("before a tourney, thousands of genomes choose from each position in one pass.\n\n");
+		printf("Batch files can be made with replay's x command.\n\n");
+		return 1;
+	}
+
+	if ((depth < 0) || (depth > MAX_SEARCH_DEPTH)) {
+		printf("The depth needs to be between 0 and %d.\n", MAX_SEARCH_DEPTH);
+		return 1;
+	}
+
+	// Load the genomes
+
+	for (i = first + 2; i < argc; i++) {
+		if (strcmp(argv[i], "-") == 0) {
+			readGenomeList(stdin);
+		} else {
+			addGenome(argv[i]);
+		}
+	}
+
+	if (genomeCount == 0) {
+		printf("Need at least one DNA file to screen.\n");
+		return 1;
+	}
+
+	useDefaultDNA(&referenceDNA);
+	myDNA = &referenceDNA;
+
+	choices = malloc(genomeCount * sizeof(int));
+	matches = calloc(genomeCount, sizeof(long));
+	gameBoard = malloc(MAX_BOARD_SIDE * MAX_BOARD_SIDE * sizeof(int));
+
+	if ((choices == null) || (matches == null) || (gameBoard == null)) {
+		printf("Unable to allocate memory to screen in!\n");
+		return 1;
+	}
+
+	// Now every position in turn
+
+	in = fopen(argv[first], "r");
+
+	if (in == null) {
+		printf("Unable to open the batch file '%s': error %d.\n", argv[first], errno);
+		return 1;
+	}
+
+	seedRNG(&moveRNG, 0, 0);	// Only used to break ties in the reference moves
+
+	start = nanoTime();
+	chooseTime = 0;
+
+	while (true) {
+		playerOneScore = 0;
+		playerTwoScore = 0;
+
+		if (!readPosition(in, argv[first]))
+			break;
+
+		setPlayer(me);
+		screenPosition(depth, &chooseTime);
+	}
+
+	fclose(in);
+
+	printResults();
+
+	printf("\nScreened %d genomes on %ld positions in %.2f seconds, %.2f of them choosing (%.1fM choices/sec).\n",
+				genomeCount, positionsScreened, (nanoTime() - start) / 1000000000.0, chooseTime / 1000000000.0,
+				(chooseTime == 0) ? 0.0 : (double) genomeCount * positionsScreened * 1000.0 / chooseTime);
+
+	return 0;
+}
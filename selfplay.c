@@ -0,0 +1,343 @@
+//------------------------------- Includes -------------------------------
+
+#include <math.h>
+
+#define LAB_NO_MAIN
+#include "lab.c"
+
+//------------------------------- Constants -------------------------------
+
+#define SELFPLAY_SEED			2006	// Every run plays exactly the same games
+#define DEFAULT_GAMES			20		// Games played on each board size
+#define DEFAULT_DROP			15.0	// How many percent slower we can get before failing
+
+//------------------------------- Structs -------------------------------
+
+typedef struct {				// How fast we played on one board size
+	int width;
+	int height;
+	double gamesPerSecond;
+	double movesPerSecond;
+} throughput;
+
+//------------------------------- Global Variables -------------------------------
+
+throughput results[(CLASSIC_BOARD_SIDE + 1) * (CLASSIC_BOARD_SIDE + 1)];
+int resultCount = 0;
+
+rng_state setupRNG;				// Used for the start boards
+
+// Function prototypes
+
+void setupStartBoard(int *board);
+int boardIsFull(int *board);
+int playGame(int *startBoard);
+void runSize(int gamesPerSize);
+void writeBaseline(char *path);
+int checkBaseline(char *path, double allowedDrop);
+
+//------------------------------- Function definitions -------------------------------
+
+// Prepare the start board with some random moves on it, the same way master does
+
+void setupStartBoard(int *board) {
+	int c, i, t, sx, sy, ex, ey;
+
+	memset(board, 0, boardWidth * boardHeight * sizeof(int));
+
+	if (randomDouble(&setupRNG) < 0.5)
+		return;	// Half the games start empty
+
+	c = randomInt(&setupRNG, 15) + 1;	// Up to 15 lines
+
+	for (i = 0; i <= c; i++) {
+		if (randomInt(&setupRNG, 2) == 1) {
+			// Virticle line
+			sx = randomInt(&setupRNG, boardWidth + 1);
+			ex = sx;
+
+			sy = randomInt(&setupRNG, boardHeight + 1);
+			ey = randomInt(&setupRNG, boardHeight + 1);
+		} else {
+			// Horizontal line
+			sy = randomInt(&setupRNG, boardHeight + 1);
+			ey = sy;
+
+			sx = randomInt(&setupRNG, boardWidth + 1);
+			ex = randomInt(&setupRNG, boardWidth + 1);
+		}
+
+		if (sy > ey) {
+			t = sy;
+			sy = ey;
+			ey = t;
+		}
+
+		if (sx > ex) {
+			t = sx;
+			sx = ex;
+			ex = t;
+		}
+
+		if ((sx != ex) || (sy != ey))
+			runMove(PLAYER_OTHER, sx, sy, ex, ey, false, board);
+	}
+}
+
+// See if every box on a board has been taken
+
+int boardIsFull(int *board) {
+	int i;
+
+	for (i = 0; i < boardWidth * boardHeight; i++) {
+		if ((board[i] & FULL_BOX) != FULL_BOX)
+			return false;
+	}
+
+	return true;
+}
+
+// Play lab against itself from the start board to the end, returns the number of moves made
+
+int playGame(int *startBoard) {
+	int turn = PLAYER_ONE;
+	int moves = 0;
+
+	copyBoard(startBoard, gameBoard);
+
+	while (!boardIsFull(gameBoard)) {
+		setPlayer(turn);
+
+		generateMoveList();
+		selectMove();
+
+		clearPossibleMoves();
+
+		runPackedMove(turn, finalMove, gameBoard);
+		moves++;
+
+		if (turn == PLAYER_ONE)
+			turn = PLAYER_TWO;
+		else
+			turn = PLAYER_ONE;
+	}
+
+	return moves;
+}
+
+// Play all the games for the current board size and record how fast it went
+
+void runSize(int gamesPerSize) {
+	int *startBoard;
+	uint64_t start, elapsed, moves;
+	int game;
+	throughput *r;
+
+	gameBoard = malloc(boardWidth * boardHeight * sizeof(int));
+	startBoard = malloc(boardWidth * boardHeight * sizeof(int));
+
+	if ((gameBoard == null) || (startBoard == null)) {
+		printf("Unable to allocate the boards.\n");
+		exit(1);
+	}
+
+	moves = 0;
+	elapsed = 0;
+
+	for (game = 0; game < gamesPerSize; game++) {
+		// Each game gets its own streams, so changing the game count doesn't change the games
+
+		seedRNG(&setupRNG, SELFPLAY_SEED, ((boardWidth * (CLASSIC_BOARD_SIDE + 1) + boardHeight) << 16) + game);
+		seedRNG(&moveRNG, SELFPLAY_SEED, ((boardWidth * (CLASSIC_BOARD_SIDE + 1) + boardHeight) << 16) + game + 0x8000);
+
+		setupStartBoard(startBoard);
+
+		start = nanoTime();
+		moves += playGame(startBoard);
+		elapsed += nanoTime() - start;
+	}
+
+	r = &results[resultCount++];
+
+	r->width = boardWidth;
+	r->height = boardHeight;
+	r->gamesPerSecond = gamesPerSize * 1000000000.0 / elapsed;
+	r->movesPerSecond = moves * 1000000000.0 / elapsed;
+
+	printf("%dx%d\t%10.1f games/sec %12.1f moves/sec\n", r->width, r->height, r->gamesPerSecond, r->movesPerSecond);
+	fflush(stdout);
+
+	free(gameBoard);
+	free(startBoard);
+}
+
+// Write what we got out as the new baseline
+
+void writeBaseline(char *path) {
+	FILE *out = null;
+	int i;
+
+	out = fopen(path, "w");
+
+	if (out == null) {
+		printf("Unable to open '%s' for writing: error %d.\n", path, errno);
+		exit(1);
+	}
+
+	fprintf(out, "Width,Height,GamesPerSecond,MovesPerSecond\n");
+
+	for (i = 0; i < resultCount; i++) {
+		fprintf(out, "%d,%d,%f,%f\n", results[i].width, results[i].height,
+					results[i].gamesPerSecond, results[i].movesPerSecond);
+	}
+
+	fclose(out);
+}
+
+// Compare what we got against a baseline. Returns true if we're still fast enough
+
+int checkBaseline(char *path, double allowedDrop) {
+	FILE *in = null;
+	char buffer[80];
+	int width, height, i, found;
+	double games, moves, drop;
+	double logGames, logMoves;
+
+	in = fopen(path, "r");
+
+	if (in == null) {
+		printf("Unable to open the baseline '%s': error %d.\n", path, errno);
+		exit(1);
+	}
+
+	if ((fgets(buffer, 80, in) == null) || (strncmp(buffer, "Width,Height,GamesPerSecond", 27) != 0)) {
+		printf("'%s' is not a baseline file as we expected.\n", path);
+		fclose(in);
+		exit(1);
+	}
+
+	// Sizes differ by orders of magnitude, so we compare geometric means of the ratios
+
+	logGames = 0.0;
+	logMoves = 0.0;
+	found = 0;
+
+	printf("\nChange from baseline:\n");
+
+	while (fgets(buffer, 80, in) != null) {
+		if (sscanf(buffer, "%d,%d,%lf,%lf", &width, &height, &games, &moves) != 4) {
+			printf("Unable to interpret baseline line '%s'.\n", buffer);
+			fclose(in);
+			exit(1);
+		}
+
+		for (i = 0; i < resultCount; i++) {
+			if ((results[i].width == width) && (results[i].height == height))
+				break;
+		}
+
+		if (i == resultCount)
+			continue;	// We didn't play this size this time
+
+		printf("%dx%d\t%+7.1f%% games/sec %+7.1f%% moves/sec\n", width, height,
+					(results[i].gamesPerSecond / games - 1.0) * 100.0, (results[i].movesPerSecond / moves - 1.0) * 100.0);
+
+		logGames += log(results[i].gamesPerSecond / games);
+		logMoves += log(results[i].movesPerSecond / moves);
+		found++;
+	}
+
+	fclose(in);
+
+	if (found == 0) {
+		printf("The baseline had none of the board sizes we played.\n");
+		return false;
+	}
+
+	drop = (1.0 - exp(logMoves / found)) * 100.0;
+
+	printf("\nOverall: %+.1f%% games/sec, %+.1f%% moves/sec (allowed drop %.1f%%)\n",
+				(exp(logGames / found) - 1.0) * 100.0, -drop, allowedDrop);
+
+	if (drop > allowedDrop) {
+		printf("FAILED: moves/sec dropped by %.1f%%.\n", drop);
+		return false;
+	}
+
+	printf("OK\n");
+
+	return true;
+}
+
+// The main function. All hail main!
+
+int main(int argc, char** argv) {
+	int gamesPerSize;
+	double allowedDrop;
+
+	gamesPerSize = DEFAULT_GAMES;
+	allowedDrop = DEFAULT_DROP;
+
+	if ((argc == 1) || ((argv[1][0] != 'p') && (argv[1][0] != 'r') && (argv[1][0] != 'c'))) {
+		printf("\nPlease call like: /path/to/selfplay [p [g]]|[r file [g]]|[c file [d [g]]]\n\n");
+		printf("p - Play g games on every board size and print how fast it went\n");
+		printf("r - Play, then record the speeds as the baseline in file\n");
+		printf("c - Play, then fail if moves/sec dropped more than d%% against file (default %.0f)\n\n", DEFAULT_DROP);
+		printf("Games are the same every run. g defaults to %d.\n\n", DEFAULT_GAMES);
+		return 1;
+	}
+
+	if (argv[1][0] == 'p') {
+		if ((argc == 3) && (sscanf(argv[2], "%d", &gamesPerSize) != 1)) {
+			printf("Unable to read 'g'.\n");
+			return 1;
+		}
+	} else if (argv[1][0] == 'r') {
+		if ((argc < 3) || ((argc == 4) && (sscanf(argv[3], "%d", &gamesPerSize) != 1))) {
+			printf("Need a baseline file and an optional game count.\n");
+			return 1;
+		}
+	} else {
+		if ((argc < 3) || ((argc >= 4) && (sscanf(argv[3], "%lf", &allowedDrop) != 1)) ||
+					((argc == 5) && (sscanf(argv[4], "%d", &gamesPerSize) != 1))) {
+			printf("Need a baseline file, an optional allowed drop and an optional game count.\n");
+			return 1;
+		}
+	}
+
+	if (gamesPerSize <= 0) {
+		printf("The game count needs to be greater than 0.\n");
+		return 1;
+	}
+
+	// Set up lab the way it would be for a tourney
+
+	myDNA = malloc(sizeof(dna));
+
+	if (myDNA == null) {
+		printf("Unable to allocate memory for the DNA!\n");
+		return 1;
+	}
+
+	useDefaultDNA(myDNA);
+
+	// Play every size
+
+	for (boardHeight = MIN_BOARD_SIDE; boardHeight <= CLASSIC_BOARD_SIDE; boardHeight++) {
+		for (boardWidth = MIN_BOARD_SIDE; boardWidth <= CLASSIC_BOARD_SIDE; boardWidth++) {
+			runSize(gamesPerSize);
+		}
+	}
+
+	// Now deal with the baseline
+
+	if (argv[1][0] == 'r') {
+		writeBaseline(argv[2]);
+		printf("Wrote baseline to '%s'.\n", argv[2]);
+	} else if (argv[1][0] == 'c') {
+		if (!checkBaseline(argv[2], allowedDrop))
+			return 1;
+	}
+
+	return 0;
+}